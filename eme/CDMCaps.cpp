@@ -32,6 +32,22 @@ CDMCaps::Unlock()
   mMonitor.Unlock();
 }
 
+void
+CDMCaps::RecordKeyStatusChange(const CencKeyId& aKeyId,
+                               const nsString& aSessionId,
+                               const dom::Optional<dom::MediaKeyStatus>& aStatus)
+{
+  mMonitor.AssertCurrentThreadOwns();
+  KeyStatusChange change(aKeyId, aSessionId, aStatus);
+  for (KeyStatusChange& pending : mKeyStatusChanges) {
+    if (pending.mId == aKeyId && pending.mSessionId == aSessionId) {
+      pending = change;
+      return;
+    }
+  }
+  mKeyStatusChanges.AppendElement(change);
+}
+
 CDMCaps::AutoLock::AutoLock(CDMCaps& aInstance)
   : mData(aInstance)
 {
@@ -76,9 +92,13 @@ CDMCaps::AutoLock::SetKeyStatus(const CencKeyId& aKeyId,
   if (!aStatus.WasPassed()) {
     // Called from ForgetKeyStatus.
     // Return true if the element is found to notify key changes.
-    return mData.mKeyStatuses.RemoveElement(KeyStatus(aKeyId,
-                                                      aSessionId,
-                                                      dom::MediaKeyStatus::Internal_error));
+    if (!mData.mKeyStatuses.RemoveElement(KeyStatus(aKeyId,
+                                                    aSessionId,
+                                                    dom::MediaKeyStatus::Internal_error))) {
+      return false;
+    }
+    mData.RecordKeyStatusChange(aKeyId, aSessionId, aStatus);
+    return true;
   }
 
   KeyStatus key(aKeyId, aSessionId, aStatus.Value());
@@ -90,6 +110,7 @@ CDMCaps::AutoLock::SetKeyStatus(const CencKeyId& aKeyId,
     }
     auto oldStatus = mData.mKeyStatuses[index].mStatus;
     mData.mKeyStatuses[index].mStatus = aStatus.Value();
+    mData.RecordKeyStatusChange(aKeyId, aSessionId, aStatus);
     // The old key status was one for which we can decrypt media. We don't
     // need to do the "notify usable" step below, as it should be impossible
     // for us to have anything waiting on this key to become usable, since it
@@ -99,6 +120,7 @@ CDMCaps::AutoLock::SetKeyStatus(const CencKeyId& aKeyId,
     }
   } else {
     mData.mKeyStatuses.AppendElement(key);
+    mData.RecordKeyStatusChange(aKeyId, aSessionId, aStatus);
   }
 
   // Only call NotifyUsable() for a key when we are going from non-usable
@@ -142,6 +164,23 @@ CDMCaps::AutoLock::GetKeyStatusesForSession(const nsAString& aSessionId,
   }
 }
 
+void
+CDMCaps::AutoLock::TakeKeyStatusChangesForSession(const nsAString& aSessionId,
+                                                  nsTArray<KeyStatusChange>& aOutChanges)
+{
+  mData.mMonitor.AssertCurrentThreadOwns();
+  auto& changes = mData.mKeyStatusChanges;
+  size_t i = 0;
+  while (i < changes.Length()) {
+    if (changes[i].mSessionId.Equals(aSessionId)) {
+      aOutChanges.AppendElement(changes[i]);
+      changes.RemoveElementAt(i);
+    } else {
+      i++;
+    }
+  }
+}
+
 void
 CDMCaps::AutoLock::GetSessionIdsForKeyId(const CencKeyId& aKeyId,
                                          nsTArray<nsCString>& aOutSessionIds)
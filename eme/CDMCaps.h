@@ -50,6 +50,26 @@ public:
     dom::MediaKeyStatus mStatus;
   };
 
+  // A key status change a session hasn't reflected in its MediaKeyStatusMap
+  // yet. Only the latest change of each key is kept.
+  struct KeyStatusChange {
+    KeyStatusChange(const CencKeyId& aId,
+                    const nsString& aSessionId,
+                    const dom::Optional<dom::MediaKeyStatus>& aStatus)
+      : mId(aId)
+      , mSessionId(aSessionId)
+      , mRemoved(!aStatus.WasPassed())
+      , mStatus(aStatus.WasPassed() ? aStatus.Value()
+                                    : dom::MediaKeyStatus::Internal_error)
+    {}
+
+    CencKeyId mId;
+    nsString mSessionId;
+    // True if the key was removed, in which case mStatus is meaningless.
+    bool mRemoved;
+    dom::MediaKeyStatus mStatus;
+  };
+
   // Locks the CDMCaps. It must be locked to access its shared state.
   // Threadsafe when locked.
   class MOZ_STACK_CLASS AutoLock {
@@ -68,6 +88,11 @@ public:
     void GetKeyStatusesForSession(const nsAString& aSessionId,
                                   nsTArray<KeyStatus>& aOutKeyStatuses);
 
+    // Moves the key status changes of aSessionId made since the previous
+    // call into aOutChanges, so that sessions only apply what changed.
+    void TakeKeyStatusChangesForSession(const nsAString& aSessionId,
+                                        nsTArray<KeyStatusChange>& aOutChanges);
+
     void GetSessionIdsForKeyId(const CencKeyId& aKeyId,
                                nsTArray<nsCString>& aOutSessionIds);
 
@@ -87,6 +112,10 @@ private:
   void Lock();
   void Unlock();
 
+  void RecordKeyStatusChange(const CencKeyId& aKeyId,
+                             const nsString& aSessionId,
+                             const dom::Optional<dom::MediaKeyStatus>& aStatus);
+
   struct WaitForKeys {
     WaitForKeys(const CencKeyId& aKeyId,
                 SamplesWaitingForKey* aListener)
@@ -101,6 +130,8 @@ private:
 
   nsTArray<KeyStatus> mKeyStatuses;
 
+  nsTArray<KeyStatusChange> mKeyStatusChanges;
+
   nsTArray<WaitForKeys> mWaitForKeys;
 
   // It is not safe to copy this object.
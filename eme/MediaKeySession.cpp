@@ -65,6 +65,7 @@ MediaKeySession::MediaKeySession(JSContext* aCx,
   , mToken(sMediaKeySessionNum++)
   , mIsClosed(false)
   , mUninitialized(true)
+  , mKeyStatusesChangePending(false)
   , mKeyStatusMap(new MediaKeyStatusMap(aParent))
   , mExpiration(JS::GenericNaN())
 {
@@ -143,22 +144,23 @@ MediaKeySession::UpdateKeyStatusMap()
     return;
   }
 
-  nsTArray<CDMCaps::KeyStatus> keyStatuses;
+  nsTArray<CDMCaps::KeyStatusChange> changes;
   {
     CDMCaps::AutoLock caps(mKeys->GetCDMProxy()->Capabilites());
-    caps.GetKeyStatusesForSession(mSessionId, keyStatuses);
+    caps.TakeKeyStatusChangesForSession(mSessionId, changes);
   }
 
-  mKeyStatusMap->Update(keyStatuses);
+  mKeyStatusMap->Apply(changes);
 
   if (EME_LOG_ENABLED()) {
     nsAutoCString message(
       nsPrintfCString("MediaKeySession[%p,'%s'] key statuses change {",
                       this, NS_ConvertUTF16toUTF8(mSessionId).get()));
     using IntegerType = typename std::underlying_type<MediaKeyStatus>::type;
-    for (const CDMCaps::KeyStatus& status : keyStatuses) {
-      message.Append(nsPrintfCString(" (%s,%s)", ToHexString(status.mId).get(),
-        MediaKeyStatusValues::strings[static_cast<IntegerType>(status.mStatus)].value));
+    for (const CDMCaps::KeyStatusChange& change : changes) {
+      message.Append(nsPrintfCString(" (%s,%s)", ToHexString(change.mId).get(),
+        change.mRemoved ? "removed" :
+        MediaKeyStatusValues::strings[static_cast<IntegerType>(change.mStatus)].value));
     }
     message.Append(" }");
     EME_LOG(message.get());
@@ -523,6 +525,15 @@ MediaKeySession::OnClosed()
   }
   EME_LOG("MediaKeySession[%p,'%s'] session close operation complete.",
           this, NS_ConvertUTF16toUTF8(mSessionId).get());
+  // Key statuses usually change right before the session closes; report them
+  // now, as the pending notification won't run once closed.
+  NotifyKeyStatusesChange();
+  if (mKeys->GetCDMProxy()) {
+    // Don't keep changes no one will take anymore.
+    nsTArray<CDMCaps::KeyStatusChange> changes;
+    CDMCaps::AutoLock caps(mKeys->GetCDMProxy()->Capabilites());
+    caps.TakeKeyStatusChangesForSession(mSessionId, changes);
+  }
   mIsClosed = true;
   mKeys->OnSessionClosed(this);
   mKeys = nullptr;
@@ -608,9 +619,27 @@ MediaKeySession::DispatchKeyError(uint32_t aSystemCode)
 void
 MediaKeySession::DispatchKeyStatusesChange()
 {
-  if (IsClosed()) {
+  if (IsClosed() || mKeyStatusesChangePending) {
+    return;
+  }
+
+  // CDMs report key statuses one key at a time, so that a license with many
+  // keys results in as many calls in a row. Coalesce them into a single
+  // update of the map and a single event.
+  mKeyStatusesChangePending = true;
+  nsCOMPtr<nsIRunnable> task(
+    NewRunnableMethod(this, &MediaKeySession::NotifyKeyStatusesChange));
+  NS_DispatchToMainThread(task);
+}
+
+void
+MediaKeySession::NotifyKeyStatusesChange()
+{
+  MOZ_ASSERT(NS_IsMainThread());
+  if (!mKeyStatusesChangePending || IsClosed()) {
     return;
   }
+  mKeyStatusesChangePending = false;
 
   UpdateKeyStatusMap();
 
@@ -106,6 +106,9 @@ private:
   ~MediaKeySession();
 
   void UpdateKeyStatusMap();
+  // Applies the key status changes batched since DispatchKeyStatusesChange()
+  // was first called, and fires a single "keystatuseschange" for them.
+  void NotifyKeyStatusesChange();
 
   bool IsCallable() const {
     // The EME spec sets the "callable value" to true whenever the CDM sets
@@ -127,6 +130,8 @@ private:
   const uint32_t mToken;
   bool mIsClosed;
   bool mUninitialized;
+  // True while a NotifyKeyStatusesChange() runnable is pending.
+  bool mKeyStatusesChangePending;
   RefPtr<MediaKeyStatusMap> mKeyStatusMap;
   double mExpiration;
 };
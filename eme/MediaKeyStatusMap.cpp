@@ -109,11 +109,20 @@ MediaKeyStatusMap::Size() const
 }
 
 void
-MediaKeyStatusMap::Update(const nsTArray<CDMCaps::KeyStatus>& aKeys)
+MediaKeyStatusMap::Apply(const nsTArray<CDMCaps::KeyStatusChange>& aChanges)
 {
-  mStatuses.Clear();
-  for (const auto& key : aKeys) {
-    mStatuses.InsertElementSorted(KeyStatus(key.mId, key.mStatus));
+  for (const auto& change : aChanges) {
+    KeyStatus key(change.mId, change.mStatus);
+    size_t index = mStatuses.BinaryIndexOf(key);
+    if (change.mRemoved) {
+      if (index != mStatuses.NoIndex) {
+        mStatuses.RemoveElementAt(index);
+      }
+    } else if (index != mStatuses.NoIndex) {
+      mStatuses[index].mStatus = change.mStatus;
+    } else {
+      mStatuses.InsertElementSorted(key);
+    }
   }
 }
 
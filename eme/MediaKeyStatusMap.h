@@ -55,7 +55,9 @@ public:
   TypedArrayCreator<ArrayBuffer> GetKeyAtIndex(uint32_t aIndex) const;
   MediaKeyStatus GetValueAtIndex(uint32_t aIndex) const;
 
-  void Update(const nsTArray<CDMCaps::KeyStatus>& keys);
+  // Applies the changes made since the map was last updated, leaving the
+  // statuses of the other keys as they are.
+  void Apply(const nsTArray<CDMCaps::KeyStatusChange>& aChanges);
 
 private:
 
@@ -82,7 +84,7 @@ private:
       if (cmp != 0) {
         return cmp < 0;
       }
-      return self.Length() <= other.Length();
+      return self.Length() < other.Length();
     }
     nsTArray<uint8_t> mKeyId;
     MediaKeyStatus mStatus;
@@ -0,0 +1,159 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*-*/
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "EncodedFrameRingBuffer.h"
+#include <algorithm>
+#include "mozilla/IntegerPrintfMacros.h"
+#include "mozilla/Logging.h"
+#include "mozilla/SizePrintfMacros.h"
+#include "PassthroughTrackEncoder.h"
+
+extern mozilla::LazyLogModule gMediaEncoderLog;
+#define RB_LOG(type, msg) MOZ_LOG(gMediaEncoderLog, type, msg)
+
+namespace mozilla {
+
+EncodedFrameRingBuffer::EncodedFrameRingBuffer(uint64_t aWindow)
+  : mWindow(aWindow)
+  , mDroppedFrames(0)
+{
+}
+
+void
+EncodedFrameRingBuffer::AppendAudio(const EncodedFrameContainer& aData)
+{
+  mAudioFrames.AppendElements(aData.GetEncodedFrames());
+  Trim();
+}
+
+void
+EncodedFrameRingBuffer::AppendVideo(const EncodedFrameContainer& aData)
+{
+  for (const auto& frame : aData.GetEncodedFrames()) {
+    if (mVideoFrames.IsEmpty() &&
+        !PassthroughFrameQueue::IsKeyFrame(frame->GetFrameType())) {
+      mDroppedFrames++;
+      continue;
+    }
+    mVideoFrames.AppendElement(frame);
+  }
+  Trim();
+}
+
+void
+EncodedFrameRingBuffer::Trim()
+{
+  uint64_t end = 0;
+  if (!mAudioFrames.IsEmpty()) {
+    end = mAudioFrames.LastElement()->GetTimeStamp();
+  }
+  if (!mVideoFrames.IsEmpty()) {
+    end = std::max(end, mVideoFrames.LastElement()->GetTimeStamp());
+  }
+  if (end <= mWindow) {
+    return;
+  }
+  uint64_t windowStart = end - mWindow;
+
+  // Drop the GOPs entirely before the last keyframe that still leaves a full
+  // window buffered.
+  size_t keyFrame = 0;
+  for (size_t i = 0;
+       i < mVideoFrames.Length() &&
+       mVideoFrames[i]->GetTimeStamp() <= windowStart;
+       i++) {
+    if (PassthroughFrameQueue::IsKeyFrame(mVideoFrames[i]->GetFrameType())) {
+      keyFrame = i;
+    }
+  }
+  if (keyFrame) {
+    RB_LOG(LogLevel::Verbose,
+           ("RingBuffer: dropping %" PRIuSIZE " video frames before %" PRIu64,
+            keyFrame, mVideoFrames[keyFrame]->GetTimeStamp()));
+    mVideoFrames.RemoveElementsAt(0, keyFrame);
+  }
+
+  // Audio frames durations aren't in a common unit, a frame is known to have
+  // ended once the next one starts.
+  uint64_t audioStart = mVideoFrames.IsEmpty()
+    ? windowStart
+    : std::min(windowStart, mVideoFrames[0]->GetTimeStamp());
+  size_t ended = 0;
+  while (ended + 1 < mAudioFrames.Length() &&
+         mAudioFrames[ended + 1]->GetTimeStamp() <= audioStart) {
+    ended++;
+  }
+  mAudioFrames.RemoveElementsAt(0, ended);
+}
+
+uint64_t
+EncodedFrameRingBuffer::StartTime() const
+{
+  if (mVideoFrames.IsEmpty()) {
+    return mAudioFrames.IsEmpty() ? 0 : mAudioFrames[0]->GetTimeStamp();
+  }
+  if (mAudioFrames.IsEmpty()) {
+    return mVideoFrames[0]->GetTimeStamp();
+  }
+  return std::min(mAudioFrames[0]->GetTimeStamp(),
+                  mVideoFrames[0]->GetTimeStamp());
+}
+
+uint64_t
+EncodedFrameRingBuffer::BufferedTime() const
+{
+  uint64_t end = 0;
+  if (!mAudioFrames.IsEmpty()) {
+    end = mAudioFrames.LastElement()->GetTimeStamp();
+  }
+  if (!mVideoFrames.IsEmpty()) {
+    end = std::max(end, mVideoFrames.LastElement()->GetTimeStamp());
+  }
+  return end - StartTime();
+}
+
+void
+EncodedFrameRingBuffer::CopyFrames(const nsTArray<RefPtr<EncodedFrame>>& aFrames,
+                                   EncodedFrameContainer& aData) const
+{
+  uint64_t start = StartTime();
+  for (const auto& frame : aFrames) {
+    RefPtr<EncodedFrame> copy = new EncodedFrame();
+    copy->SetFrameType(frame->GetFrameType());
+    copy->SetTimeStamp(frame->GetTimeStamp() - start);
+    copy->SetDuration(frame->GetDuration());
+    nsTArray<uint8_t> data(frame->GetFrameData());
+    copy->SwapInFrameData(data);
+    aData.AppendEncodedFrame(copy);
+  }
+}
+
+void
+EncodedFrameRingBuffer::CopyAudio(EncodedFrameContainer& aData) const
+{
+  CopyFrames(mAudioFrames, aData);
+}
+
+void
+EncodedFrameRingBuffer::CopyVideo(EncodedFrameContainer& aData) const
+{
+  CopyFrames(mVideoFrames, aData);
+}
+
+size_t
+EncodedFrameRingBuffer::SizeOfExcludingThis(MallocSizeOf aMallocSizeOf) const
+{
+  size_t amount = mAudioFrames.ShallowSizeOfExcludingThis(aMallocSizeOf) +
+                  mVideoFrames.ShallowSizeOfExcludingThis(aMallocSizeOf);
+  for (const auto* frames : { &mAudioFrames, &mVideoFrames }) {
+    for (const auto& frame : *frames) {
+      amount += aMallocSizeOf(frame.get()) +
+                frame->GetFrameData().ShallowSizeOfExcludingThis(aMallocSizeOf);
+    }
+  }
+  return amount;
+}
+
+} // namespace mozilla
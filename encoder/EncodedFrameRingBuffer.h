@@ -0,0 +1,65 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*-*/
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef EncodedFrameRingBuffer_h_
+#define EncodedFrameRingBuffer_h_
+
+#include "EncodedFrameContainer.h"
+#include "mozilla/MemoryReporting.h"
+
+namespace mozilla {
+
+/**
+ * Keeps the most recent encoded audio and video frames of a recording, before
+ * they are muxed, so that a clip of the last moments can be written on
+ * demand. Video is trimmed a whole GOP at a time so that the buffer always
+ * starts at a keyframe; the buffer therefore holds at least aWindow
+ * microseconds, plus up to one GOP. Audio is trimmed to start with the video.
+ * Not thread-safe.
+ */
+class EncodedFrameRingBuffer
+{
+public:
+  explicit EncodedFrameRingBuffer(uint64_t aWindow);
+
+  // Append the frames of aData, then trim what fell out of the window.
+  void AppendAudio(const EncodedFrameContainer& aData);
+  void AppendVideo(const EncodedFrameContainer& aData);
+
+  /**
+   * Copy the buffered frames into aData, with timestamps rebased so that the
+   * clip starts at 0. The buffered frames are left untouched so that further
+   * clips can be taken.
+   */
+  void CopyAudio(EncodedFrameContainer& aData) const;
+  void CopyVideo(EncodedFrameContainer& aData) const;
+
+  bool IsEmpty() const
+  {
+    return mAudioFrames.IsEmpty() && mVideoFrames.IsEmpty();
+  }
+  // Timestamp of the earliest buffered frame, in microseconds.
+  uint64_t StartTime() const;
+  // Time between the earliest and the latest buffered frame, in microseconds.
+  uint64_t BufferedTime() const;
+  uint32_t DroppedFrames() const { return mDroppedFrames; }
+
+  size_t SizeOfExcludingThis(MallocSizeOf aMallocSizeOf) const;
+
+private:
+  void Trim();
+  void CopyFrames(const nsTArray<RefPtr<EncodedFrame>>& aFrames,
+                  EncodedFrameContainer& aData) const;
+
+  const uint64_t mWindow;
+  nsTArray<RefPtr<EncodedFrame>> mAudioFrames;
+  nsTArray<RefPtr<EncodedFrame>> mVideoFrames;
+  // Number of video frames dropped while waiting for the first keyframe.
+  uint32_t mDroppedFrames;
+};
+
+} // namespace mozilla
+
+#endif
@@ -204,6 +204,104 @@ MediaEncoder::CreateEncoder(const nsAString& aMIMEType, uint32_t aAudioBitrate,
   return encoder.forget();
 }
 
+/* static */
+already_AddRefed<MediaEncoder>
+MediaEncoder::CreatePassthroughEncoder(TrackMetadataBase* aAudioMetadata,
+                                       TrackMetadataBase* aVideoMetadata,
+                                       TrackRate aTrackRate)
+{
+  PROFILER_LABEL("MediaEncoder", "CreatePassthroughEncoder",
+    js::ProfileEntry::Category::OTHER);
+
+  if (aAudioMetadata &&
+      aAudioMetadata->GetKind() != TrackMetadataBase::METADATA_OPUS) {
+    LOG(LogLevel::Error, ("Passthrough of audio kind %d not supported",
+                          aAudioMetadata->GetKind()));
+    return nullptr;
+  }
+
+  nsAutoPtr<ContainerWriter> writer;
+  nsString mimeType;
+  if (aVideoMetadata) {
+#ifdef MOZ_WEBM_ENCODER
+    if (aVideoMetadata->GetKind() != TrackMetadataBase::METADATA_VP8) {
+      LOG(LogLevel::Error, ("Passthrough of video kind %d not supported",
+                            aVideoMetadata->GetKind()));
+      return nullptr;
+    }
+    uint8_t trackTypes = ContainerWriter::CREATE_VIDEO_TRACK;
+    if (aAudioMetadata) {
+      trackTypes |= ContainerWriter::CREATE_AUDIO_TRACK;
+    }
+    writer = new WebMWriter(trackTypes);
+    mimeType = NS_LITERAL_STRING(VIDEO_WEBM);
+#else
+    LOG(LogLevel::Error, ("Video passthrough needs the WebM encoder"));
+    return nullptr;
+#endif
+  } else if (aAudioMetadata) {
+    writer = new OggWriter();
+    mimeType = NS_LITERAL_STRING(AUDIO_OGG);
+  } else {
+    LOG(LogLevel::Error, ("NO TrackTypes!!!"));
+    return nullptr;
+  }
+
+  // Both tracks are rebased together to keep them in sync.
+  RefPtr<PassthroughTimeline> timeline = new PassthroughTimeline();
+  PassthroughAudioTrackEncoder* audioEncoder =
+    aAudioMetadata ? new PassthroughAudioTrackEncoder(aAudioMetadata, timeline)
+                   : nullptr;
+  PassthroughVideoTrackEncoder* videoEncoder =
+    aVideoMetadata ? new PassthroughVideoTrackEncoder(aVideoMetadata, aTrackRate,
+                                                      timeline)
+                   : nullptr;
+  LOG(LogLevel::Debug, ("Create passthrough encoder: a[%d] v[%d] mimeType = %s.",
+                        audioEncoder != nullptr, videoEncoder != nullptr,
+                        NS_ConvertUTF16toUTF8(mimeType).get()));
+  RefPtr<MediaEncoder> encoder =
+    new MediaEncoder(writer.forget(), audioEncoder, videoEncoder, mimeType,
+                     0, 0, 0);
+  encoder->mAudioPassthrough = audioEncoder;
+  encoder->mVideoPassthrough = videoEncoder;
+  return encoder.forget();
+}
+
+already_AddRefed<MediaEncoder>
+MediaEncoder::AddVideoRendition(int32_t aWidth, int32_t aHeight,
+                                uint32_t aBitrate)
+{
+#ifdef MOZ_WEBM_ENCODER
+  // Video that isn't passed through is encoded with VP8.
+  if (!mVideoEncoder || mVideoPassthrough) {
+    LOG(LogLevel::Error, ("No video to make a rendition of"));
+    return nullptr;
+  }
+  VP8TrackEncoder* vp8Encoder =
+    static_cast<VP8TrackEncoder*>(mVideoEncoder.get());
+  RefPtr<TrackMetadataBase> meta =
+    vp8Encoder->CreateRenditionMetadata(aWidth, aHeight);
+  RefPtr<MediaEncoder> rendition =
+    CreatePassthroughEncoder(nullptr, meta, vp8Encoder->GetTrackRate());
+  if (!rendition) {
+    return nullptr;
+  }
+  nsresult rv = vp8Encoder->AddRendition(aWidth, aHeight, aBitrate,
+                                         rendition->GetVideoPassthrough());
+  if (NS_FAILED(rv)) {
+    LOG(LogLevel::Error, ("Failed to add a %dx%d rendition", aWidth, aHeight));
+    return nullptr;
+  }
+  LOG(LogLevel::Debug, ("Added a %dx%d rendition at %u bps",
+                        aWidth, aHeight, aBitrate));
+  mRenditions.AppendElement(rendition);
+  return rendition.forget();
+#else
+  LOG(LogLevel::Error, ("Renditions need the WebM encoder"));
+  return nullptr;
+#endif
+}
+
 /**
  * GetEncodedData() runs as a state machine, starting with mState set to
  * GET_METADDATA, the procedure should be as follow:
@@ -253,6 +351,11 @@ MediaEncoder::GetEncodedData(nsTArray<nsTArray<uint8_t> >* aOutputBufs,
         LOG(LogLevel::Error, ("Error! Fail to Set Video Metadata"));
         break;
       }
+      if (mReplayBuffer) {
+        // The header is written with each clip.
+        mState = ENCODE_TRACK;
+        break;
+      }
 
       rv = mWriter->GetContainerData(aOutputBufs,
                                      ContainerWriter::GET_HEADER);
@@ -290,6 +393,12 @@ MediaEncoder::GetEncodedData(nsTArray<nsTArray<uint8_t> >* aOutputBufs,
       // In audio only or video only case, let unavailable track's flag to be true.
       bool isAudioCompleted = (mAudioEncoder && mAudioEncoder->IsEncodingComplete()) || !mAudioEncoder;
       bool isVideoCompleted = (mVideoEncoder && mVideoEncoder->IsEncodingComplete()) || !mVideoEncoder;
+      if (mReplayBuffer) {
+        // Nothing is muxed until a clip is requested.
+        reloop = false;
+        mState = isAudioCompleted && isVideoCompleted ? ENCODE_DONE : ENCODE_TRACK;
+        break;
+      }
       rv = mWriter->GetContainerData(aOutputBufs,
                                      isAudioCompleted && isVideoCompleted ?
                                      ContainerWriter::FLUSH_NEEDED : 0);
@@ -307,8 +416,13 @@ MediaEncoder::GetEncodedData(nsTArray<nsTArray<uint8_t> >* aOutputBufs,
       break;
     }
 
-    case ENCODE_DONE:
     case ENCODE_ERROR:
+      // The renditions won't get any more frames.
+      for (auto& rendition : mRenditions) {
+        rendition->Cancel();
+      }
+      MOZ_FALLTHROUGH;
+    case ENCODE_DONE:
       LOG(LogLevel::Debug, ("MediaEncoder has been shutdown."));
       mSizeOfBuffer = 0;
       mShutdown = true;
@@ -341,6 +455,14 @@ MediaEncoder::WriteEncodedDataToMuxer(TrackEncoder *aTrackEncoder)
     mState = ENCODE_ERROR;
     return rv;
   }
+  if (mReplayBuffer) {
+    if (aTrackEncoder == mVideoEncoder.get()) {
+      mReplayBuffer->AppendVideo(encodedVideoData);
+    } else {
+      mReplayBuffer->AppendAudio(encodedVideoData);
+    }
+    return NS_OK;
+  }
   rv = mWriter->WriteEncodedTrack(encodedVideoData,
                                   aTrackEncoder->IsEncodingComplete() ?
                                   ContainerWriter::END_OF_STREAM : 0);
@@ -367,6 +489,14 @@ MediaEncoder::CopyMetadataToMuxer(TrackEncoder *aTrackEncoder)
     mState = ENCODE_ERROR;
     return NS_ERROR_ABORT;
   }
+  if (mReplayBuffer) {
+    if (aTrackEncoder == mVideoEncoder.get()) {
+      mVideoMetadata = meta;
+    } else {
+      mAudioMetadata = meta;
+    }
+    return NS_OK;
+  }
 
   nsresult rv = mWriter->SetMetadata(meta);
   if (NS_FAILED(rv)) {
@@ -376,6 +506,85 @@ MediaEncoder::CopyMetadataToMuxer(TrackEncoder *aTrackEncoder)
   return rv;
 }
 
+void
+MediaEncoder::EnableReplayBuffer(const TimeDuration& aWindow)
+{
+  MOZ_ASSERT(mState == ENCODE_METADDATA, "Encoding already started");
+  LOG(LogLevel::Debug, ("Replay buffer of %f seconds", aWindow.ToSeconds()));
+  mReplayBuffer =
+    new EncodedFrameRingBuffer(uint64_t(aWindow.ToMicroseconds()));
+}
+
+ContainerWriter*
+MediaEncoder::CreateReplayWriter()
+{
+#ifdef MOZ_WEBM_ENCODER
+  if (mMIMEType.EqualsLiteral(VIDEO_WEBM)) {
+    uint8_t trackTypes = 0;
+    if (mAudioMetadata) {
+      trackTypes |= ContainerWriter::CREATE_AUDIO_TRACK;
+    }
+    if (mVideoMetadata) {
+      trackTypes |= ContainerWriter::CREATE_VIDEO_TRACK;
+    }
+    return new WebMWriter(trackTypes);
+  }
+#endif
+  if (mMIMEType.EqualsLiteral(AUDIO_OGG)) {
+    return new OggWriter();
+  }
+  return nullptr;
+}
+
+nsresult
+MediaEncoder::GetReplayClip(nsTArray<nsTArray<uint8_t> >* aOutputBufs,
+                            nsAString& aMIMEType)
+{
+  MOZ_ASSERT(!NS_IsMainThread());
+
+  aMIMEType = mMIMEType;
+  PROFILER_LABEL("MediaEncoder", "GetReplayClip",
+    js::ProfileEntry::Category::OTHER);
+
+  if (!mReplayBuffer || mReplayBuffer->IsEmpty() ||
+      (!mAudioMetadata && !mVideoMetadata)) {
+    return NS_ERROR_NOT_AVAILABLE;
+  }
+  nsAutoPtr<ContainerWriter> writer(CreateReplayWriter());
+  if (!writer) {
+    return NS_ERROR_FAILURE;
+  }
+  LOG(LogLevel::Debug, ("Writing replay clip of %f seconds from %f",
+                        mReplayBuffer->BufferedTime() / 1e6,
+                        mReplayBuffer->StartTime() / 1e6));
+
+  nsresult rv;
+  if (mAudioMetadata) {
+    rv = writer->SetMetadata(mAudioMetadata);
+    NS_ENSURE_SUCCESS(rv, rv);
+  }
+  if (mVideoMetadata) {
+    rv = writer->SetMetadata(mVideoMetadata);
+    NS_ENSURE_SUCCESS(rv, rv);
+  }
+  rv = writer->GetContainerData(aOutputBufs, ContainerWriter::GET_HEADER);
+  NS_ENSURE_SUCCESS(rv, rv);
+
+  if (mVideoMetadata) {
+    EncodedFrameContainer videoData;
+    mReplayBuffer->CopyVideo(videoData);
+    rv = writer->WriteEncodedTrack(videoData, ContainerWriter::END_OF_STREAM);
+    NS_ENSURE_SUCCESS(rv, rv);
+  }
+  if (mAudioMetadata) {
+    EncodedFrameContainer audioData;
+    mReplayBuffer->CopyAudio(audioData);
+    rv = writer->WriteEncodedTrack(audioData, ContainerWriter::END_OF_STREAM);
+    NS_ENSURE_SUCCESS(rv, rv);
+  }
+  return writer->GetContainerData(aOutputBufs, ContainerWriter::FLUSH_NEEDED);
+}
+
 #ifdef MOZ_WEBM_ENCODER
 bool
 MediaEncoder::IsWebMEncoderEnabled()
@@ -398,6 +607,9 @@ MediaEncoder::SizeOfExcludingThis(mozilla::MallocSizeOf aMallocSizeOf) const
              (mAudioEncoder != nullptr ? mAudioEncoder->SizeOfExcludingThis(aMallocSizeOf) : 0) +
              (mVideoEncoder != nullptr ? mVideoEncoder->SizeOfExcludingThis(aMallocSizeOf) : 0);
   }
+  if (mReplayBuffer) {
+    amount += mReplayBuffer->SizeOfExcludingThis(aMallocSizeOf);
+  }
   return amount;
 }
 
@@ -8,7 +8,9 @@
 
 #include "mozilla/DebugOnly.h"
 #include "TrackEncoder.h"
+#include "PassthroughTrackEncoder.h"
 #include "ContainerWriter.h"
+#include "EncodedFrameRingBuffer.h"
 #include "CubebUtils.h"
 #include "MediaStreamGraph.h"
 #include "MediaStreamListener.h"
@@ -68,6 +70,10 @@ private:
  *
  * 4) To stop encoding, remove this component from its source stream.
  *    => sourceStream->RemoveListener(encoder);
+ *
+ * For instant replay, EnableReplayBuffer() is called between 1) and 2): the
+ * encoded frames are then only kept for the last moments of the recording,
+ * and GetReplayClip() muxes them on demand.
  */
 class MediaEncoder : public DirectMediaStreamListener
 {
@@ -90,6 +96,8 @@ public :
     : mWriter(aWriter)
     , mAudioEncoder(aAudioEncoder)
     , mVideoEncoder(aVideoEncoder)
+    , mAudioPassthrough(nullptr)
+    , mVideoPassthrough(nullptr)
     , mVideoSink(new MediaStreamVideoRecorderSink(mVideoEncoder))
     , mStartTime(TimeStamp::Now())
     , mMIMEType(aMIMEType)
@@ -176,6 +184,31 @@ public :
                                                       uint32_t aBitrate,
                                                       uint8_t aTrackTypes = ContainerWriter::CREATE_AUDIO_TRACK,
                                                       TrackRate aTrackRate = CubebUtils::PreferredSampleRate());
+
+  /**
+   * Creates an encoder that muxes already-encoded tracks without re-encoding
+   * them. aAudioMetadata and aVideoMetadata describe the compressed tracks
+   * (OpusMetadata, VP8Metadata); either may be null but not both. Frames are
+   * then fed through GetAudioPassthrough() and GetVideoPassthrough(), and the
+   * encoder does not need to be connected to a MediaStream. Returns null if
+   * no container supports the given tracks.
+   */
+  static already_AddRefed<MediaEncoder>
+  CreatePassthroughEncoder(TrackMetadataBase* aAudioMetadata,
+                           TrackMetadataBase* aVideoMetadata,
+                           TrackRate aTrackRate = CubebUtils::PreferredSampleRate());
+  /**
+   * Adds a rendition of the video track at aWidth x aHeight and aBitrate,
+   * encoded from the same source frames with keyframes at the same times, and
+   * returns the encoder muxing it into a container of its own. Its data is
+   * pulled with GetEncodedData() like this encoder's, and it ends, or is
+   * canceled, along with this encoder. Only VP8 video can have renditions,
+   * and they must be added before encoding starts. Returns null on failure.
+   */
+  already_AddRefed<MediaEncoder> AddVideoRendition(int32_t aWidth,
+                                                   int32_t aHeight,
+                                                   uint32_t aBitrate);
+
   /**
    * Encodes the raw track data and returns the final container data. Assuming
    * it is called on a single worker thread. The buffer of container data is
@@ -186,6 +219,25 @@ public :
   void GetEncodedData(nsTArray<nsTArray<uint8_t> >* aOutputBufs,
                       nsAString& aMIMEType);
 
+  /**
+   * Keeps the encoded frames of the last aWindow of the recording in a ring
+   * buffer instead of muxing them: GetEncodedData() then only encodes and
+   * outputs no container data. This makes continuous background recording
+   * cost the encoding only. Must be called before the first
+   * GetEncodedData().
+   */
+  void EnableReplayBuffer(const TimeDuration& aWindow);
+
+  /**
+   * Muxes the frames currently in the replay buffer into a complete container
+   * starting at a keyframe, and appends it to aOutputBufs. The buffer is left
+   * as is, so that encoding and further clips carry on. Called on the thread
+   * calling GetEncodedData(). Returns NS_ERROR_NOT_AVAILABLE if the replay
+   * buffer isn't enabled or holds nothing yet.
+   */
+  nsresult GetReplayClip(nsTArray<nsTArray<uint8_t> >* aOutputBufs,
+                         nsAString& aMIMEType);
+
   /**
    * Return true if MediaEncoder has been shutdown. Reasons are encoding
    * complete, encounter an error, or being canceled by its caller.
@@ -206,6 +258,23 @@ public :
     if (mVideoEncoder) {
       mVideoEncoder->NotifyCancel();
     }
+    for (auto& rendition : mRenditions) {
+      rendition->Cancel();
+    }
+  }
+
+  /**
+   * Changes the target bitrates while encoding. The codecs are reconfigured
+   * in place. A bitrate of 0 leaves that track's bitrate unchanged.
+   */
+  void UpdateBitrates(uint32_t aAudioBitrate, uint32_t aVideoBitrate)
+  {
+    if (mAudioEncoder && aAudioBitrate) {
+      mAudioEncoder->UpdateBitrate(aAudioBitrate);
+    }
+    if (mVideoEncoder && aVideoBitrate) {
+      mVideoEncoder->UpdateBitrate(aVideoBitrate);
+    }
   }
 
   bool HasError()
@@ -228,14 +297,37 @@ public :
     return mVideoSink.get();
   }
 
+  /**
+   * The passthrough track encoders of an encoder made by
+   * CreatePassthroughEncoder(), null otherwise.
+   */
+  PassthroughAudioTrackEncoder* GetAudioPassthrough() {
+    return mAudioPassthrough;
+  }
+  PassthroughVideoTrackEncoder* GetVideoPassthrough() {
+    return mVideoPassthrough;
+  }
+
 private:
   // Get encoded data from trackEncoder and write to muxer
   nsresult WriteEncodedDataToMuxer(TrackEncoder *aTrackEncoder);
   // Get metadata from trackEncoder and copy to muxer
   nsresult CopyMetadataToMuxer(TrackEncoder* aTrackEncoder);
+  // A new writer of the container of mMIMEType for a replay clip.
+  ContainerWriter* CreateReplayWriter();
   nsAutoPtr<ContainerWriter> mWriter;
+  // Encoders of the video renditions, whose track encoders mVideoEncoder
+  // feeds; declared first so that they outlive it.
+  nsTArray<RefPtr<MediaEncoder>> mRenditions;
   nsAutoPtr<AudioTrackEncoder> mAudioEncoder;
   nsAutoPtr<VideoTrackEncoder> mVideoEncoder;
+  // Aliases of mAudioEncoder and mVideoEncoder in passthrough mode.
+  PassthroughAudioTrackEncoder* mAudioPassthrough;
+  PassthroughVideoTrackEncoder* mVideoPassthrough;
+  // Set in replay mode, with the metadata the clip writers need.
+  nsAutoPtr<EncodedFrameRingBuffer> mReplayBuffer;
+  RefPtr<TrackMetadataBase> mAudioMetadata;
+  RefPtr<TrackMetadataBase> mVideoMetadata;
   RefPtr<MediaStreamVideoRecorderSink> mVideoSink;
   TimeStamp mStartTime;
   nsString mMIMEType;
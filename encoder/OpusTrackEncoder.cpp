@@ -38,6 +38,9 @@ static const int kOpusSamplingRate = 48000;
 // The duration of an Opus frame, and it must be 2.5, 5, 10, 20, 40 or 60 ms.
 static const int kFrameDurationMs  = 20;
 
+// The Opus encoder complexity for each speed level. 10 is the libopus default.
+static const int kComplexityForSpeedLevel[] = { 10, 8, 6, 4, 2, 0 };
+
 // The supported sampling rate of input signal (Hz),
 // must be one of the following. Will resampled to 48kHz otherwise.
 static const int kOpusSupportedInputSamplingRates[] =
@@ -130,6 +133,7 @@ OpusTrackEncoder::OpusTrackEncoder()
   , mLookahead(0)
   , mResampler(nullptr)
   , mOutputTimeStamp(0)
+  , mSpeedController(ArrayLength(kComplexityForSpeedLevel) - 1)
 {
 }
 
@@ -194,6 +198,9 @@ OpusTrackEncoder::Init(int aChannels, int aSamplingRate)
   if (mAudioBitrate) {
     opus_encoder_ctl(mEncoder, OPUS_SET_BITRATE(static_cast<int>(mAudioBitrate)));
   }
+  if (mInitialized) {
+    ApplySpeedLevel();
+  }
 
   mReentrantMonitor.NotifyAll();
 
@@ -206,6 +213,14 @@ OpusTrackEncoder::GetOutputSampleRate()
   return mResampler ? kOpusSamplingRate : mSamplingRate;
 }
 
+void
+OpusTrackEncoder::ApplySpeedLevel()
+{
+  int complexity = kComplexityForSpeedLevel[mSpeedController.Level()];
+  LOG("[Opus] Complexity %d.", complexity);
+  opus_encoder_ctl(mEncoder, OPUS_SET_COMPLEXITY(complexity));
+}
+
 int
 OpusTrackEncoder::GetPacketDuration()
 {
@@ -275,6 +290,16 @@ OpusTrackEncoder::GetEncodedTrack(EncodedFrameContainer& aData)
   // calculation below depends on the truth that mInitialized is true.
   MOZ_ASSERT(mInitialized);
 
+  uint32_t bitrate = TakePendingBitrate();
+  if (bitrate) {
+    if (opus_encoder_ctl(mEncoder,
+                         OPUS_SET_BITRATE(static_cast<int>(bitrate))) == OPUS_OK) {
+      mAudioBitrate = bitrate;
+    } else {
+      LOG("[Opus] Fail to change the bitrate to %u.", bitrate);
+    }
+  }
+
   bool wait = true;
   int result = 0;
   // Only wait once, then loop until we run out of packets of input data
@@ -426,6 +451,7 @@ OpusTrackEncoder::GetEncodedTrack(EncodedFrameContainer& aData)
     frameData.SetLength(MAX_DATA_BYTES);
     // result is returned as opus error code if it is negative.
     result = 0;
+    TimeStamp encodeStart = TimeStamp::Now();
 #ifdef MOZ_SAMPLE_TYPE_S16
     const opus_int16* pcmBuf = static_cast<opus_int16*>(pcm.Elements());
     result = opus_encode(mEncoder, pcmBuf, GetPacketDuration(),
@@ -437,6 +463,14 @@ OpusTrackEncoder::GetEncodedTrack(EncodedFrameContainer& aData)
 #endif
     frameData.SetLength(result >= 0 ? result : 0);
 
+    if (mSpeedController.Update(
+          TimeStamp::Now() - encodeStart,
+          TimeDuration::FromMilliseconds(kFrameDurationMs),
+          TimeDuration::FromMicroseconds(
+            FramesToUsecs(mSourceSegment.GetDuration(), mSamplingRate).value()))) {
+      ApplySpeedLevel();
+    }
+
     if (result < 0) {
       LOG("[Opus] Fail to encode data! Result: %s.", opus_strerror(result));
     }
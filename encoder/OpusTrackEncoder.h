@@ -49,6 +49,11 @@ protected:
   int GetOutputSampleRate();
 
 private:
+  /**
+   * Apply the complexity for the current speed level to the encoder.
+   */
+  void ApplySpeedLevel();
+
   /**
    * The Opus encoder from libopus.
    */
@@ -84,6 +89,11 @@ private:
 
   // TimeStamp in microseconds.
   uint64_t mOutputTimeStamp;
+
+  /**
+   * Lowers the encoder complexity when we can't keep up with real time.
+   */
+  EncoderSpeedController mSpeedController;
 };
 
 } // namespace mozilla
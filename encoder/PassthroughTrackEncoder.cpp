@@ -0,0 +1,141 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*-*/
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "PassthroughTrackEncoder.h"
+#include <algorithm>
+#include "mozilla/IntegerPrintfMacros.h"
+#include "mozilla/Logging.h"
+#include "VideoUtils.h"
+
+namespace mozilla {
+
+extern LazyLogModule gTrackEncoderLog;
+#define PT_LOG(type, msg) MOZ_LOG(gTrackEncoderLog, type, msg)
+
+// Opus frames carry their duration in samples at 48kHz, as written to the
+// Ogg granule position, rather than in microseconds.
+static const uint32_t kOpusGranuleRate = 48000;
+
+static uint64_t
+DurationUsecs(const EncodedFrame* aFrame)
+{
+  if (aFrame->GetFrameType() == EncodedFrame::OPUS_AUDIO_FRAME) {
+    CheckedInt64 usecs = FramesToUsecs(aFrame->GetDuration(), kOpusGranuleRate);
+    return usecs.isValid() ? usecs.value() : 0;
+  }
+  return aFrame->GetDuration();
+}
+
+PassthroughTimeline::PassthroughTimeline()
+  : mMutex("PassthroughTimeline")
+  , mEndTime(0)
+{
+}
+
+int64_t
+PassthroughTimeline::OffsetFor(uint32_t aSource, uint64_t aKeyFrameTime)
+{
+  MutexAutoLock lock(mMutex);
+  if (aSource >= mOffsets.Length()) {
+    // Sources no track started from get the same offset, as they added
+    // nothing to the timeline.
+    int64_t offset = int64_t(mEndTime) - int64_t(aKeyFrameTime);
+    while (mOffsets.Length() <= aSource) {
+      mOffsets.AppendElement(offset);
+    }
+  }
+  return mOffsets[aSource];
+}
+
+void
+PassthroughTimeline::NotifyQueued(uint64_t aEndTime)
+{
+  MutexAutoLock lock(mMutex);
+  mEndTime = std::max(mEndTime, aEndTime);
+}
+
+PassthroughFrameQueue::PassthroughFrameQueue(PassthroughTimeline* aTimeline)
+  : mTimeline(aTimeline ? aTimeline : new PassthroughTimeline())
+  , mNeedKeyFrame(true)
+  , mSource(0)
+  , mOffset(0)
+  , mNextTime(0)
+  , mDroppedFrames(0)
+{
+}
+
+/* static */ bool
+PassthroughFrameQueue::IsKeyFrame(EncodedFrame::FrameType aType)
+{
+  switch (aType) {
+    case EncodedFrame::VP8_I_FRAME:
+    case EncodedFrame::AVC_I_FRAME:
+    case EncodedFrame::OPUS_AUDIO_FRAME:
+    case EncodedFrame::VORBIS_AUDIO_FRAME:
+    case EncodedFrame::AAC_AUDIO_FRAME:
+    case EncodedFrame::AMR_AUDIO_FRAME:
+    case EncodedFrame::EVRC_AUDIO_FRAME:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool
+PassthroughFrameQueue::Push(const EncodedFrame* aFrame)
+{
+  MOZ_ASSERT(aFrame);
+  if (aFrame->GetFrameType() == EncodedFrame::UNKNOWN) {
+    mDroppedFrames++;
+    return false;
+  }
+  if (mNeedKeyFrame) {
+    if (!IsKeyFrame(aFrame->GetFrameType())) {
+      mDroppedFrames++;
+      PT_LOG(LogLevel::Verbose,
+             ("Passthrough: dropping frame at %" PRIu64 ", waiting for a keyframe",
+              aFrame->GetTimeStamp()));
+      return false;
+    }
+    mNeedKeyFrame = false;
+    mOffset = mTimeline->OffsetFor(mSource, aFrame->GetTimeStamp());
+    PT_LOG(LogLevel::Debug,
+           ("Passthrough: starting at keyframe %" PRIu64 ", offset %" PRId64,
+            aFrame->GetTimeStamp(), mOffset));
+  }
+
+  // The muxer needs monotonic timestamps; frames overlapping the previous one
+  // (e.g. audio packets straddling a source change) are pushed back.
+  int64_t time = int64_t(aFrame->GetTimeStamp()) + mOffset;
+  uint64_t timestamp = std::max<int64_t>(time, int64_t(mNextTime));
+  RefPtr<EncodedFrame> frame = new EncodedFrame();
+  frame->SetFrameType(aFrame->GetFrameType());
+  frame->SetTimeStamp(timestamp);
+  frame->SetDuration(aFrame->GetDuration());
+  nsTArray<uint8_t> data(aFrame->GetFrameData());
+  frame->SwapInFrameData(data);
+  mNextTime = timestamp + DurationUsecs(frame);
+  mTimeline->NotifyQueued(mNextTime);
+  mFrames.AppendElement(frame.forget());
+  return true;
+}
+
+void
+PassthroughFrameQueue::SourceChanged()
+{
+  mSource++;
+  mNeedKeyFrame = true;
+}
+
+void
+PassthroughFrameQueue::TakeFrames(EncodedFrameContainer& aData)
+{
+  for (auto& frame : mFrames) {
+    aData.AppendEncodedFrame(frame);
+  }
+  mFrames.Clear();
+}
+
+} // namespace mozilla
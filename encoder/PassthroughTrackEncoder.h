@@ -0,0 +1,242 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*-*/
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef PassthroughTrackEncoder_h_
+#define PassthroughTrackEncoder_h_
+
+#include "TrackEncoder.h"
+#include "mozilla/Mutex.h"
+
+namespace mozilla {
+
+/**
+ * The output timeline shared by the passthrough tracks of a MediaEncoder.
+ * Each source is rebased by a single offset, set by the first keyframe of
+ * that source on any track, so that audio and video stay in sync. Thread-safe.
+ */
+class PassthroughTimeline
+{
+public:
+  NS_INLINE_DECL_THREADSAFE_REFCOUNTING(PassthroughTimeline)
+
+  PassthroughTimeline();
+
+  /**
+   * The offset to add to the timestamps of the aSource'th source. The first
+   * track asking places aKeyFrameTime right after the end of everything
+   * queued so far.
+   */
+  int64_t OffsetFor(uint32_t aSource, uint64_t aKeyFrameTime);
+
+  // A track queued frames up to aEndTime on the output timeline.
+  void NotifyQueued(uint64_t aEndTime);
+
+private:
+  ~PassthroughTimeline() {}
+
+  Mutex mMutex;
+  // Indexed by source. Protected by mMutex.
+  nsTArray<int64_t> mOffsets;
+  // End time of the last frame queued on any track. Protected by mMutex.
+  uint64_t mEndTime;
+};
+
+/**
+ * Queue of already-encoded frames on their way to the muxer. Frames are only
+ * accepted from a keyframe onwards, both at the start and after the source
+ * has changed, and their timestamps are rebased along aTimeline so that the
+ * output starts at 0 and stays continuous across source changes. Without a
+ * timeline, the queue rebases on its own. Not thread-safe; the owning track
+ * encoder protects it with its monitor.
+ */
+class PassthroughFrameQueue
+{
+public:
+  explicit PassthroughFrameQueue(PassthroughTimeline* aTimeline = nullptr);
+
+  /**
+   * Queues a copy of aFrame with the timestamp adjusted; aFrame is left
+   * untouched. Returns false if the frame was dropped because we're waiting
+   * for a keyframe.
+   */
+  bool Push(const EncodedFrame* aFrame);
+
+  /**
+   * Drops frames until the next keyframe. The new source is then placed
+   * right after the last frame queued on the timeline, unless another track
+   * of the timeline already placed it.
+   */
+  void SourceChanged();
+
+  // Moves all queued frames into aData.
+  void TakeFrames(EncodedFrameContainer& aData);
+
+  bool IsEmpty() const { return mFrames.IsEmpty(); }
+  uint32_t DroppedFrames() const { return mDroppedFrames; }
+
+  // True if a decoder can start decoding at a frame of type aType.
+  static bool IsKeyFrame(EncodedFrame::FrameType aType);
+
+private:
+  const RefPtr<PassthroughTimeline> mTimeline;
+  nsTArray<RefPtr<EncodedFrame>> mFrames;
+  bool mNeedKeyFrame;
+  // Number of source changes so far.
+  uint32_t mSource;
+  // Added to source timestamps, in microseconds.
+  int64_t mOffset;
+  // End time of the last queued frame on the output timeline.
+  uint64_t mNextTime;
+  uint32_t mDroppedFrames;
+};
+
+/**
+ * A track encoder that doesn't encode: it takes frames which are already
+ * compressed in the target format (e.g. VP8 or Opus coming from a demuxer)
+ * and hands them to the ContainerWriter as they are. This saves decoding and
+ * re-encoding when remuxing. Raw media from MediaStreamGraph is ignored, only
+ * its end-of-track event is honoured.
+ *
+ * Base is AudioTrackEncoder or VideoTrackEncoder so that MediaEncoder can own
+ * passthrough tracks like any other; use the Passthrough{Audio,Video}
+ * TrackEncoder subclasses below.
+ */
+template<class Base>
+class PassthroughTrackEncoder : public Base
+{
+public:
+  /**
+   * Appends a compressed frame with its timestamp in microseconds, and its
+   * duration in microseconds, or in 48kHz samples for Opus frames as
+   * OpusTrackEncoder produces them. aFrame is copied. Can be called on any
+   * thread.
+   */
+  void AppendEncodedFrame(const EncodedFrame* aFrame)
+  {
+    ReentrantMonitorAutoEnter mon(this->mReentrantMonitor);
+    if (this->mEndOfStream || this->mCanceled) {
+      return;
+    }
+    if (mQueue.Push(aFrame)) {
+      this->mReentrantMonitor.NotifyAll();
+    }
+  }
+
+  /**
+   * Tells the encoder that following frames come from a new source described
+   * by aMetadata. The container can't change codec mid-stream, so a source
+   * of another kind cancels the encoding. Can be called on any thread.
+   */
+  void NotifySourceChanged(TrackMetadataBase* aMetadata)
+  {
+    ReentrantMonitorAutoEnter mon(this->mReentrantMonitor);
+    if (!aMetadata || aMetadata->GetKind() != mMetadata->GetKind()) {
+      this->mCanceled = true;
+      this->mReentrantMonitor.NotifyAll();
+      return;
+    }
+    mQueue.SourceChanged();
+  }
+
+  /**
+   * No more frames will be appended. Can be called on any thread.
+   */
+  void NotifyEndOfEncodedStream()
+  {
+    this->NotifyEndOfStream();
+  }
+
+  void NotifyQueuedTrackChanges(MediaStreamGraph* aGraph, TrackID aID,
+                                StreamTime aTrackOffset,
+                                uint32_t aTrackEvents,
+                                const MediaSegment& aQueuedMedia) override
+  {
+    if (aTrackEvents == TrackEventCommand::TRACK_EVENT_ENDED) {
+      this->NotifyEndOfStream();
+    }
+  }
+
+  already_AddRefed<TrackMetadataBase> GetMetadata() override
+  {
+    RefPtr<TrackMetadataBase> meta = mMetadata;
+    return meta.forget();
+  }
+
+  nsresult GetEncodedTrack(EncodedFrameContainer& aData) override
+  {
+    ReentrantMonitorAutoEnter mon(this->mReentrantMonitor);
+    while (!this->mCanceled && !this->mEndOfStream && mQueue.IsEmpty()) {
+      this->mReentrantMonitor.Wait();
+    }
+    if (this->mCanceled) {
+      return NS_ERROR_FAILURE;
+    }
+    mQueue.TakeFrames(aData);
+    if (this->mEndOfStream) {
+      this->mEncodingComplete = true;
+    }
+    return NS_OK;
+  }
+
+  uint32_t DroppedFrames()
+  {
+    ReentrantMonitorAutoEnter mon(this->mReentrantMonitor);
+    return mQueue.DroppedFrames();
+  }
+
+protected:
+  template<typename... Args>
+  PassthroughTrackEncoder(TrackMetadataBase* aMetadata,
+                          PassthroughTimeline* aTimeline, Args... aArgs)
+    : Base(aArgs...)
+    , mMetadata(aMetadata)
+    , mQueue(aTimeline)
+  {
+    MOZ_ASSERT(aMetadata);
+    // There is no codec to set up, and the metadata is known up front.
+    this->mInitialized = true;
+  }
+
+private:
+  const RefPtr<TrackMetadataBase> mMetadata;
+  // Protected by mReentrantMonitor.
+  PassthroughFrameQueue mQueue;
+};
+
+class PassthroughAudioTrackEncoder
+  : public PassthroughTrackEncoder<AudioTrackEncoder>
+{
+public:
+  explicit PassthroughAudioTrackEncoder(TrackMetadataBase* aMetadata,
+                                        PassthroughTimeline* aTimeline = nullptr)
+    : PassthroughTrackEncoder<AudioTrackEncoder>(aMetadata, aTimeline)
+  {}
+
+protected:
+  nsresult Init(int aChannels, int aSamplingRate) override { return NS_OK; }
+};
+
+class PassthroughVideoTrackEncoder
+  : public PassthroughTrackEncoder<VideoTrackEncoder>
+{
+public:
+  PassthroughVideoTrackEncoder(TrackMetadataBase* aMetadata,
+                               TrackRate aTrackRate,
+                               PassthroughTimeline* aTimeline = nullptr)
+    : PassthroughTrackEncoder<VideoTrackEncoder>(aMetadata, aTimeline,
+                                                 aTrackRate)
+  {}
+
+protected:
+  nsresult Init(int aWidth, int aHeight, int aDisplayWidth,
+                int aDisplayHeight) override
+  {
+    return NS_OK;
+  }
+};
+
+} // namespace mozilla
+
+#endif
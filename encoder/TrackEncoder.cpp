@@ -30,6 +30,57 @@ static const int DEFAULT_TRACK_RATE = USECS_PER_S;
 // 30 seconds threshold if the encoder still can't not be initialized.
 static const int INIT_FAILED_DURATION = 30;
 
+// Speed up when encoding takes more than this share of real time, slow down
+// again when it takes less than this one.
+static const double SPEED_UP_LOAD = 0.7;
+static const double SLOW_DOWN_LOAD = 0.3;
+// Past this many frames waiting to be encoded we're falling behind.
+static const double MAX_QUEUED_FRAMES = 3.0;
+// Weight of the last frame in the moving average of the load.
+static const double LOAD_SMOOTHING = 0.1;
+// Frames to wait at a level before speeding up further, or slowing down.
+static const uint32_t SPEED_UP_HOLD_FRAMES = 10;
+static const uint32_t SLOW_DOWN_HOLD_FRAMES = 90;
+
+EncoderSpeedController::EncoderSpeedController(uint32_t aMaxLevel)
+  : mMaxLevel(aMaxLevel)
+  , mLevel(0)
+  , mLoad(0.0)
+  , mFramesAtLevel(0)
+{
+}
+
+bool
+EncoderSpeedController::Update(const TimeDuration& aEncodeTime,
+                               const TimeDuration& aFrameDuration,
+                               const TimeDuration& aQueued)
+{
+  if (aFrameDuration <= TimeDuration()) {
+    return false;
+  }
+  mLoad += LOAD_SMOOTHING * (aEncodeTime / aFrameDuration - mLoad);
+  mFramesAtLevel++;
+  double queuedFrames = aQueued / aFrameDuration;
+
+  uint32_t level = mLevel;
+  if ((mLoad > SPEED_UP_LOAD || queuedFrames > MAX_QUEUED_FRAMES) &&
+      mFramesAtLevel >= SPEED_UP_HOLD_FRAMES && mLevel < mMaxLevel) {
+    level++;
+  } else if (mLoad < SLOW_DOWN_LOAD && queuedFrames < 1.0 &&
+             mFramesAtLevel >= SLOW_DOWN_HOLD_FRAMES && mLevel > 0) {
+    level--;
+  }
+  if (level == mLevel) {
+    return false;
+  }
+  TRACK_LOG(LogLevel::Debug,
+            ("Encoder speed level %u -> %u, load %.2f, %.1f frames queued",
+             mLevel, level, mLoad, queuedFrames));
+  mLevel = level;
+  mFramesAtLevel = 0;
+  return true;
+}
+
 TrackEncoder::TrackEncoder()
   : mReentrantMonitor("media.TrackEncoder")
   , mEncodingComplete(false)
@@ -39,6 +90,7 @@ TrackEncoder::TrackEncoder()
   , mCanceled(false)
   , mInitCounter(0)
   , mNotInitDuration(0)
+  , mPendingBitrate(0)
 {
 }
 
@@ -6,7 +6,9 @@
 #ifndef TrackEncoder_h_
 #define TrackEncoder_h_
 
+#include "mozilla/Atomics.h"
 #include "mozilla/ReentrantMonitor.h"
+#include "mozilla/TimeStamp.h"
 
 #include "AudioSegment.h"
 #include "EncodedFrameContainer.h"
@@ -17,6 +19,38 @@
 
 namespace mozilla {
 
+/**
+ * Closed-loop speed control for real-time encoding. For each encoded frame it
+ * is given the time spent encoding it and how much media is waiting to be
+ * encoded, and picks a speed level from 0 (best quality) to aMaxLevel
+ * (fastest). Track encoders map the level onto codec settings, so that a
+ * loaded machine degrades quality rather than falling behind real time.
+ */
+class EncoderSpeedController
+{
+public:
+  explicit EncoderSpeedController(uint32_t aMaxLevel);
+
+  /**
+   * aEncodeTime is the wall-clock time it took to encode aFrameDuration of
+   * media, aQueued the duration of media still waiting to be encoded.
+   * Returns true if the level changed.
+   */
+  bool Update(const TimeDuration& aEncodeTime,
+              const TimeDuration& aFrameDuration,
+              const TimeDuration& aQueued);
+
+  uint32_t Level() const { return mLevel; }
+
+private:
+  const uint32_t mMaxLevel;
+  uint32_t mLevel;
+  // Moving average of the encode time over the frame duration.
+  double mLoad;
+  // Number of frames encoded since the level last changed.
+  uint32_t mFramesAtLevel;
+};
+
 /**
  * Base class of AudioTrackEncoder and VideoTrackEncoder. Lifetimes managed by
  * MediaEncoder. Most methods can only be called on the MediaEncoder's thread,
@@ -81,7 +115,25 @@ public:
 
   virtual void SetBitrate(const uint32_t aBitrate) {}
 
+  /**
+   * Changes the target bitrate while encoding. Can be called on any thread;
+   * the codec is reconfigured in place before the next frame is encoded.
+   */
+  void UpdateBitrate(uint32_t aBitrate)
+  {
+    mPendingBitrate = aBitrate;
+  }
+
 protected:
+  /**
+   * Returns the bitrate last passed to UpdateBitrate() if it hasn't been
+   * applied yet, 0 otherwise. Called on the worker thread.
+   */
+  uint32_t TakePendingBitrate()
+  {
+    return mPendingBitrate.exchange(0);
+  }
+
   /**
    * Notifies track encoder that we have reached the end of source stream, and
    * wakes up mReentrantMonitor if encoder is waiting for any source data.
@@ -129,6 +181,8 @@ protected:
   // How many times we have tried to initialize the encoder.
   uint32_t mInitCounter;
   StreamTime mNotInitDuration;
+
+  Atomic<uint32_t> mPendingBitrate;
 };
 
 class AudioTrackEncoder : public TrackEncoder
@@ -289,6 +343,8 @@ public:
     return mTrackRate * aS;
   }
 
+  TrackRate GetTrackRate() const { return mTrackRate; }
+
 protected:
   /**
    * Initialized the video encoder. In order to collect the value of width and
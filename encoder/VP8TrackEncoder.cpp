@@ -8,6 +8,7 @@
 #include "LayersLogging.h"
 #include "libyuv.h"
 #include "mozilla/gfx/2D.h"
+#include "PassthroughTrackEncoder.h"
 #include "prsystem.h"
 #include "VideoSegment.h"
 #include "VideoUtils.h"
@@ -26,6 +27,12 @@ LazyLogModule gVP8TrackEncoderLog("VP8TrackEncoder");
 #define DEFAULT_BITRATE_BPS 2500000
 #define DEFAULT_ENCODE_FRAMERATE 30
 
+// VP8E_SET_CPUUSED for each speed level, from the best quality we use in real
+// time to the fastest libvpx supports.
+static const int kCpuUsedForSpeedLevel[] = { -6, -8, -10, -12, -14, -16 };
+// From this speed level on, skip encoding blocks that barely changed.
+static const uint32_t kStaticThresholdSpeedLevel = 3;
+
 using namespace mozilla::gfx;
 using namespace mozilla::layers;
 using namespace mozilla::media;
@@ -54,13 +61,55 @@ GetSourceSurface(already_AddRefed<Image> aImg)
   return surf.forget();
 }
 
+// Number of encoder threads worth using for a frame of aWidth x aHeight.
+static unsigned int
+GetThreadsForSize(int32_t aWidth, int32_t aHeight)
+{
+  int32_t number_of_cores = PR_GetNumberOfProcessors();
+  if (aWidth * aHeight > 1280 * 960 && number_of_cores >= 6) {
+    return 3; // 3 threads for 1080p.
+  } else if (aWidth * aHeight > 640 * 480 && number_of_cores >= 3) {
+    return 2; // 2 threads for qHD/HD.
+  }
+  return 1; // 1 thread for VGA or less
+}
+
+VP8TrackEncoder::Rendition::Rendition(int32_t aWidth, int32_t aHeight,
+                                      uint32_t aBitrate,
+                                      PassthroughVideoTrackEncoder* aOutput)
+  : mWidth(aWidth)
+  , mHeight(aHeight)
+  , mBitrate(aBitrate)
+  , mOutput(aOutput)
+  , mInitialized(false)
+  , mFailed(false)
+  , mVPXContext(new vpx_codec_ctx_t())
+  , mVPXImageWrapper(new vpx_image_t())
+{
+}
+
+VP8TrackEncoder::Rendition::~Rendition()
+{
+  if (mInitialized) {
+    vpx_codec_destroy(mVPXContext);
+  }
+
+  if (mVPXImageWrapper) {
+    vpx_img_free(mVPXImageWrapper);
+  }
+}
+
 VP8TrackEncoder::VP8TrackEncoder(TrackRate aTrackRate)
   : VideoTrackEncoder(aTrackRate)
+  , mEncodedFrameRate(DEFAULT_ENCODE_FRAMERATE)
   , mEncodedFrameDuration(0)
   , mEncodedTimestamp(0)
   , mRemainingTicks(0)
+  , mSpeedController(ArrayLength(kCpuUsedForSpeedLevel) - 1)
   , mVPXContext(new vpx_codec_ctx_t())
+  , mVPXConfig(new vpx_codec_enc_cfg_t())
   , mVPXImageWrapper(new vpx_image_t())
+  , mFramesSinceKeyFrame(0)
 {
   MOZ_COUNT_CTOR(VP8TrackEncoder);
 }
@@ -123,14 +172,7 @@ VP8TrackEncoder::Init(int32_t aWidth, int32_t aHeight, int32_t aDisplayWidth,
 
   config.g_lag_in_frames = 0; // 0- no frame lagging
 
-  int32_t number_of_cores = PR_GetNumberOfProcessors();
-  if (mFrameWidth * mFrameHeight > 1280 * 960 && number_of_cores >= 6) {
-    config.g_threads = 3; // 3 threads for 1080p.
-  } else if (mFrameWidth * mFrameHeight > 640 * 480 && number_of_cores >= 3) {
-    config.g_threads = 2; // 2 threads for qHD/HD.
-  } else {
-    config.g_threads = 1; // 1 thread for VGA or less
-  }
+  config.g_threads = GetThreadsForSize(mFrameWidth, mFrameHeight);
 
   // rate control settings
   config.rc_dropframe_thresh = 0;
@@ -145,7 +187,8 @@ VP8TrackEncoder::Init(int32_t aWidth, int32_t aHeight, int32_t aDisplayWidth,
   config.rc_buf_optimal_sz = 600;
   config.rc_buf_sz = 1000;
 
-  config.kf_mode = VPX_KF_AUTO;
+  // With renditions, keyframes are forced in all of them at once instead.
+  config.kf_mode = mRenditions.IsEmpty() ? VPX_KF_AUTO : VPX_KF_DISABLED;
   // Ensure that we can output one I-frame per second.
   config.kf_max_dist = mEncodedFrameRate;
 
@@ -154,9 +197,17 @@ VP8TrackEncoder::Init(int32_t aWidth, int32_t aHeight, int32_t aDisplayWidth,
   if (vpx_codec_enc_init(mVPXContext, vpx_codec_vp8_cx(), &config, flags)) {
     return NS_ERROR_FAILURE;
   }
+  *mVPXConfig = config;
 
-  vpx_codec_control(mVPXContext, VP8E_SET_STATIC_THRESHOLD, 1);
-  vpx_codec_control(mVPXContext, VP8E_SET_CPUUSED, -6);
+  for (auto& rendition : mRenditions) {
+    if (NS_FAILED(InitRendition(*rendition, config))) {
+      VP8LOG("Failed to initialize the %dx%d rendition\n",
+             rendition->mWidth, rendition->mHeight);
+      FailRendition(*rendition);
+    }
+  }
+
+  ApplySpeedLevel();
   vpx_codec_control(mVPXContext, VP8E_SET_TOKEN_PARTITIONS,
                     VP8_ONE_TOKENPARTITION);
 
@@ -166,6 +217,173 @@ VP8TrackEncoder::Init(int32_t aWidth, int32_t aHeight, int32_t aDisplayWidth,
   return NS_OK;
 }
 
+nsresult
+VP8TrackEncoder::InitRendition(Rendition& aRendition,
+                               const vpx_codec_enc_cfg_t& aConfig)
+{
+  vpx_codec_enc_cfg_t config = aConfig;
+  config.g_w = aRendition.mWidth;
+  config.g_h = aRendition.mHeight;
+  config.g_threads = GetThreadsForSize(aRendition.mWidth, aRendition.mHeight);
+  // rc_target_bitrate needs kbit/s
+  config.rc_target_bitrate =
+    (aRendition.mBitrate != 0 ? aRendition.mBitrate : DEFAULT_BITRATE_BPS) / 1000;
+
+  vpx_codec_flags_t flags = 0;
+  flags |= VPX_CODEC_USE_OUTPUT_PARTITION;
+  if (vpx_codec_enc_init(aRendition.mVPXContext, vpx_codec_vp8_cx(), &config,
+                         flags)) {
+    return NS_ERROR_FAILURE;
+  }
+  aRendition.mInitialized = true;
+  vpx_codec_control(aRendition.mVPXContext, VP8E_SET_TOKEN_PARTITIONS,
+                    VP8_ONE_TOKENPARTITION);
+
+  uint32_t yPlaneSize = aRendition.mWidth * aRendition.mHeight;
+  uint32_t halfWidth = (aRendition.mWidth + 1) / 2;
+  uint32_t halfHeight = (aRendition.mHeight + 1) / 2;
+  uint32_t uvPlaneSize = halfWidth * halfHeight;
+  aRendition.mI420Frame.SetLength(yPlaneSize + uvPlaneSize * 2);
+
+  vpx_image_t* image = aRendition.mVPXImageWrapper;
+  vpx_img_wrap(image, VPX_IMG_FMT_I420, aRendition.mWidth, aRendition.mHeight,
+               1, nullptr);
+  image->planes[VPX_PLANE_Y] = aRendition.mI420Frame.Elements();
+  image->planes[VPX_PLANE_U] = aRendition.mI420Frame.Elements() + yPlaneSize;
+  image->planes[VPX_PLANE_V] =
+    aRendition.mI420Frame.Elements() + yPlaneSize + uvPlaneSize;
+  image->stride[VPX_PLANE_Y] = aRendition.mWidth;
+  image->stride[VPX_PLANE_U] = halfWidth;
+  image->stride[VPX_PLANE_V] = halfWidth;
+  return NS_OK;
+}
+
+nsresult
+VP8TrackEncoder::AddRendition(int32_t aWidth, int32_t aHeight,
+                              uint32_t aBitrate,
+                              PassthroughVideoTrackEncoder* aOutput)
+{
+  MOZ_ASSERT(aOutput);
+  if (aWidth < 1 || aHeight < 1) {
+    return NS_ERROR_INVALID_ARG;
+  }
+
+  ReentrantMonitorAutoEnter mon(mReentrantMonitor);
+  if (mInitialized) {
+    VP8LOG("Renditions can't be added once encoding started\n");
+    return NS_ERROR_FAILURE;
+  }
+  // Keep them from the largest to the smallest, so that each can be scaled
+  // from the previous one.
+  size_t index = 0;
+  while (index < mRenditions.Length() &&
+         mRenditions[index]->mWidth * mRenditions[index]->mHeight >=
+           aWidth * aHeight) {
+    index++;
+  }
+  mRenditions.InsertElementAt(index,
+    MakeUnique<Rendition>(aWidth, aHeight, aBitrate, aOutput));
+  return NS_OK;
+}
+
+already_AddRefed<TrackMetadataBase>
+VP8TrackEncoder::CreateRenditionMetadata(int32_t aWidth, int32_t aHeight)
+{
+  ReentrantMonitorAutoEnter mon(mReentrantMonitor);
+  RefPtr<VP8Metadata> meta = new VP8Metadata();
+  meta->mWidth = aWidth;
+  meta->mHeight = aHeight;
+  meta->mDisplayWidth = aWidth;
+  meta->mDisplayHeight = aHeight;
+  // Renditions get the frames of this track, at its rate.
+  meta->mEncodedFrameRate = mEncodedFrameRate;
+  return meta.forget();
+}
+
+void
+VP8TrackEncoder::FailRendition(Rendition& aRendition)
+{
+  aRendition.mFailed = true;
+  aRendition.mOutput->NotifyCancel();
+}
+
+void
+VP8TrackEncoder::EncodeRenditions(StreamTime aEncodedDuration, int aFlags,
+                                  nsTArray<EncodedFrameContainer>& aData)
+{
+  // Renditions are sorted largest first. Scaling down from the previous,
+  // larger, rendition costs less than scaling from the source each time.
+  const vpx_image_t* source = mVPXImageWrapper;
+  for (size_t i = 0; i < mRenditions.Length(); i++) {
+    Rendition& rendition = *mRenditions[i];
+    if (rendition.mFailed) {
+      continue;
+    }
+    if (int32_t(source->d_w) < rendition.mWidth ||
+        int32_t(source->d_h) < rendition.mHeight) {
+      source = mVPXImageWrapper;
+    }
+    vpx_image_t* image = rendition.mVPXImageWrapper;
+    int rv = libyuv::I420Scale(source->planes[VPX_PLANE_Y],
+                               source->stride[VPX_PLANE_Y],
+                               source->planes[VPX_PLANE_U],
+                               source->stride[VPX_PLANE_U],
+                               source->planes[VPX_PLANE_V],
+                               source->stride[VPX_PLANE_V],
+                               source->d_w, source->d_h,
+                               image->planes[VPX_PLANE_Y],
+                               image->stride[VPX_PLANE_Y],
+                               image->planes[VPX_PLANE_U],
+                               image->stride[VPX_PLANE_U],
+                               image->planes[VPX_PLANE_V],
+                               image->stride[VPX_PLANE_V],
+                               rendition.mWidth, rendition.mHeight,
+                               libyuv::kFilterBox);
+    if (rv != 0 ||
+        vpx_codec_encode(rendition.mVPXContext, image, mEncodedTimestamp,
+                         (unsigned long)aEncodedDuration, aFlags,
+                         VPX_DL_REALTIME)) {
+      VP8LOG("Encoding the %dx%d rendition failed\n",
+             rendition.mWidth, rendition.mHeight);
+      FailRendition(rendition);
+      continue;
+    }
+    GetEncodedPartitions(rendition.mVPXContext, aData[i]);
+    source = image;
+  }
+}
+
+void
+VP8TrackEncoder::OutputRenditions(nsTArray<EncodedFrameContainer>& aData,
+                                  bool aEndOfStream)
+{
+  for (size_t i = 0; i < mRenditions.Length(); i++) {
+    Rendition& rendition = *mRenditions[i];
+    if (rendition.mFailed) {
+      continue;
+    }
+    if (aEndOfStream) {
+      // Pull the frames still in the encoder, as for the main one.
+      do {
+        if (vpx_codec_encode(rendition.mVPXContext, nullptr, mEncodedTimestamp,
+                             mEncodedFrameDuration, 0, VPX_DL_REALTIME)) {
+          FailRendition(rendition);
+          break;
+        }
+      } while (GetEncodedPartitions(rendition.mVPXContext, aData[i]));
+      if (rendition.mFailed) {
+        continue;
+      }
+    }
+    for (const auto& frame : aData[i].GetEncodedFrames()) {
+      rendition.mOutput->AppendEncodedFrame(frame);
+    }
+    if (aEndOfStream) {
+      rendition.mOutput->NotifyEndOfEncodedStream();
+    }
+  }
+}
+
 already_AddRefed<TrackMetadataBase>
 VP8TrackEncoder::GetMetadata()
 {
@@ -194,13 +412,14 @@ VP8TrackEncoder::GetMetadata()
 }
 
 bool
-VP8TrackEncoder::GetEncodedPartitions(EncodedFrameContainer& aData)
+VP8TrackEncoder::GetEncodedPartitions(vpx_codec_ctx_t* aContext,
+                                      EncodedFrameContainer& aData)
 {
   vpx_codec_iter_t iter = nullptr;
   EncodedFrame::FrameType frameType = EncodedFrame::VP8_P_FRAME;
   nsTArray<uint8_t> frameData;
   const vpx_codec_cx_pkt_t *pkt = nullptr;
-  while ((pkt = vpx_codec_get_cx_data(mVPXContext, &iter)) != nullptr) {
+  while ((pkt = vpx_codec_get_cx_data(aContext, &iter)) != nullptr) {
     switch (pkt->kind) {
       case VPX_CODEC_CX_FRAME_PKT: {
         // Copy the encoded data from libvpx to frameData
@@ -458,6 +677,46 @@ nsresult VP8TrackEncoder::PrepareRawFrame(VideoChunk &aChunk)
   return NS_OK;
 }
 
+void
+VP8TrackEncoder::ApplySpeedLevel()
+{
+  uint32_t level = mSpeedController.Level();
+  VP8LOG("Speed level %u\n", level);
+  vpx_codec_control(mVPXContext, VP8E_SET_CPUUSED,
+                    kCpuUsedForSpeedLevel[level]);
+  vpx_codec_control(mVPXContext, VP8E_SET_STATIC_THRESHOLD,
+                    level >= kStaticThresholdSpeedLevel ? 100 : 1);
+  // The encode time measured includes the renditions, which follow the same
+  // level.
+  for (auto& rendition : mRenditions) {
+    if (!rendition->mInitialized) {
+      continue;
+    }
+    vpx_codec_control(rendition->mVPXContext, VP8E_SET_CPUUSED,
+                      kCpuUsedForSpeedLevel[level]);
+    vpx_codec_control(rendition->mVPXContext, VP8E_SET_STATIC_THRESHOLD,
+                      level >= kStaticThresholdSpeedLevel ? 100 : 1);
+  }
+}
+
+void
+VP8TrackEncoder::ApplyPendingBitrate()
+{
+  uint32_t bitrate = TakePendingBitrate();
+  if (!bitrate) {
+    return;
+  }
+  // rc_target_bitrate needs kbit/s
+  mVPXConfig->rc_target_bitrate = bitrate / 1000;
+  if (vpx_codec_enc_config_set(mVPXContext, mVPXConfig)) {
+    VP8LOG("Failed to change the bitrate to %u\n", bitrate);
+    mVPXConfig->rc_target_bitrate =
+      (mVideoBitrate != 0 ? mVideoBitrate : DEFAULT_BITRATE_BPS) / 1000;
+    return;
+  }
+  mVideoBitrate = bitrate;
+}
+
 // These two define value used in GetNextEncodeOperation to determine the
 // EncodeOperation for next target frame.
 #define I_FRAME_RATIO (0.5)
@@ -520,12 +779,16 @@ VP8TrackEncoder::CalculateEncodedDuration(StreamTime aDurationCopied)
  *      The encoding duration is a multiple of mEncodedFrameDuration.
  * 3.3: Setup the video chunk to mVPXImageWrapper by PrepareRawFrame().
  * 3.4: Send frame into vp8 encoder by vpx_codec_encode().
- * 3.5: Get the output frame from encoder by calling GetEncodedPartitions().
+ * 3.5: Get the output frame from encoder by calling GetEncodedPartitions(),
+ *      then scale and encode the frame for the renditions.
  * 3.6: Calculate the mRemainingTicks for next target frame.
  * 3.7: Set the nextEncodeOperation for the next target frame.
  *      There is a heuristic: If the frame duration we have processed in
  *      mSourceSegment is 100ms, means that we can't spend more than 100ms to
  *      encode it.
+ * 3.8: Feed the encode time and the amount of data left to mSpeedController,
+ *      and change the encoder speed settings if it asks to. Skipping frames
+ *      in 3.7 is the last resort once the fastest settings are in use.
  * 4. Remove the encoded chunks in mSourceSegment after for-loop.
  *
  * Ex1: Input frame rate is 100 => input frame duration is 10ms for each.
@@ -578,6 +841,12 @@ VP8TrackEncoder::GetEncodedTrack(EncodedFrameContainer& aData)
     EOS = mEndOfStream;
   }
 
+  ApplyPendingBitrate();
+
+  // Frames encoded for each rendition, output once done.
+  nsTArray<EncodedFrameContainer> renditionData;
+  renditionData.SetLength(mRenditions.Length());
+
   VideoSegment::ChunkIterator iter(mSourceSegment);
   StreamTime durationCopied = 0;
   StreamTime totalProcessedDuration = 0;
@@ -599,27 +868,53 @@ VP8TrackEncoder::GetEncodedTrack(EncodedFrameContainer& aData)
 
       // Encode frame.
       if (nextEncodeOperation != SKIP_FRAME) {
+        TimeStamp encodeStart = TimeStamp::Now();
         nsresult rv = PrepareRawFrame(chunk);
         NS_ENSURE_SUCCESS(rv, NS_ERROR_FAILURE);
 
         // Encode the data with VP8 encoder
         int flags = (nextEncodeOperation == ENCODE_NORMAL_FRAME) ?
                     0 : VPX_EFLAG_FORCE_KF;
+        if (!mRenditions.IsEmpty() &&
+            mFramesSinceKeyFrame >= mVPXConfig->kf_max_dist) {
+          flags |= VPX_EFLAG_FORCE_KF;
+        }
         if (vpx_codec_encode(mVPXContext, mVPXImageWrapper, mEncodedTimestamp,
                              (unsigned long)encodedDuration, flags,
                              VPX_DL_REALTIME)) {
           return NS_ERROR_FAILURE;
         }
         // Get the encoded data from VP8 encoder.
-        GetEncodedPartitions(aData);
+        GetEncodedPartitions(mVPXContext, aData);
+        EncodeRenditions(encodedDuration, flags, renditionData);
+        mFramesSinceKeyFrame =
+          (flags & VPX_EFLAG_FORCE_KF) ? 1 : mFramesSinceKeyFrame + 1;
+
+        TimeDuration encodeTime = TimeStamp::Now() - encodeStart;
+        TimeDuration frameDuration = TimeDuration::FromMicroseconds(
+          FramesToUsecs(encodedDuration, mTrackRate).value());
+        TimeDuration queued = TimeDuration::FromMicroseconds(
+          FramesToUsecs(mSourceSegment.GetDuration() - totalProcessedDuration -
+                        durationCopied, mTrackRate).value());
+        if (mSpeedController.Update(encodeTime, frameDuration, queued)) {
+          ApplySpeedLevel();
+        }
       } else {
         // SKIP_FRAME
         // Extend the duration of the last encoded data in aData
         // because this frame will be skip.
         RefPtr<EncodedFrame> last = nullptr;
         last = aData.GetEncodedFrames().LastElement();
-        if (last) {
-          last->SetDuration(last->GetDuration() + encodedDuration);
+        // Frame durations are in microseconds.
+        CheckedInt64 skipped = FramesToUsecs(encodedDuration, mTrackRate);
+        if (last && skipped.isValid()) {
+          last->SetDuration(last->GetDuration() + skipped.value());
+        }
+        for (auto& data : renditionData) {
+          if (!data.GetEncodedFrames().IsEmpty() && skipped.isValid()) {
+            last = data.GetEncodedFrames().LastElement();
+            last->SetDuration(last->GetDuration() + skipped.value());
+          }
         }
       }
       // Move forward the mEncodedTimestamp.
@@ -660,8 +955,9 @@ VP8TrackEncoder::GetEncodedTrack(EncodedFrameContainer& aData)
                            mEncodedFrameDuration, 0, VPX_DL_REALTIME)) {
         return NS_ERROR_FAILURE;
       }
-    } while(GetEncodedPartitions(aData));
+    } while(GetEncodedPartitions(mVPXContext, aData));
   }
+  OutputRenditions(renditionData, EOS);
 
   return NS_OK ;
 }
@@ -6,11 +6,14 @@
 #ifndef VP8TrackEncoder_h_
 #define VP8TrackEncoder_h_
 
+#include "mozilla/UniquePtr.h"
 #include "TrackEncoder.h"
 #include "vpx/vpx_codec.h"
 
 namespace mozilla {
 
+class PassthroughVideoTrackEncoder;
+
 typedef struct vpx_codec_ctx vpx_codec_ctx_t;
 typedef struct vpx_codec_enc_cfg vpx_codec_enc_cfg_t;
 typedef struct vpx_image vpx_image_t;
@@ -20,6 +23,11 @@ typedef struct vpx_image vpx_image_t;
  * We implement a realtime and fixed FPS encoder. In order to achieve that,
  * there is a pick target frame and drop frame encoding policy implemented in
  * GetEncodedTrack.
+ *
+ * The same source can also be encoded at other sizes and bitrates, as
+ * renditions, for adaptive streaming. Each source frame is then converted to
+ * I420 once and scaled down successively for the renditions, and keyframes
+ * are placed at the same frames in all of them.
  */
 class VP8TrackEncoder : public VideoTrackEncoder
 {
@@ -36,11 +44,45 @@ public:
 
   nsresult GetEncodedTrack(EncodedFrameContainer& aData) final override;
 
+  /**
+   * Adds a rendition of aWidth x aHeight at aBitrate, whose frames are
+   * appended to aOutput, which must outlive this encoder. aOutput is ended
+   * along with this track, and canceled if the rendition fails. Must be
+   * called before the encoder is initialized.
+   */
+  nsresult AddRendition(int32_t aWidth, int32_t aHeight, uint32_t aBitrate,
+                        PassthroughVideoTrackEncoder* aOutput);
+
+  // Metadata of the renditions of aWidth x aHeight of this track.
+  already_AddRefed<TrackMetadataBase>
+  CreateRenditionMetadata(int32_t aWidth, int32_t aHeight);
+
 protected:
   nsresult Init(int32_t aWidth, int32_t aHeight,
                 int32_t aDisplayWidth, int32_t aDisplayHeight) final override;
 
 private:
+  // The source encoded at another size and bitrate.
+  struct Rendition
+  {
+    Rendition(int32_t aWidth, int32_t aHeight, uint32_t aBitrate,
+              PassthroughVideoTrackEncoder* aOutput);
+    ~Rendition();
+
+    const int32_t mWidth;
+    const int32_t mHeight;
+    const uint32_t mBitrate;
+    PassthroughVideoTrackEncoder* const mOutput;
+    bool mInitialized;
+    // Set once encoding failed, the rendition is then skipped.
+    bool mFailed;
+    nsAutoPtr<vpx_codec_ctx_t> mVPXContext;
+    // Wraps mI420Frame.
+    nsAutoPtr<vpx_image_t> mVPXImageWrapper;
+    // The source frame scaled down to the rendition's size.
+    nsTArray<uint8_t> mI420Frame;
+  };
+
   // Calculate the target frame's encoded duration.
   StreamTime CalculateEncodedDuration(StreamTime aDurationCopied);
 
@@ -55,11 +97,35 @@ private:
   // Get the encoded data from encoder to aData.
   // Return value: false if the vpx_codec_get_cx_data returns null
   //               for EOS detection.
-  bool GetEncodedPartitions(EncodedFrameContainer& aData);
+  bool GetEncodedPartitions(vpx_codec_ctx_t* aContext,
+                            EncodedFrameContainer& aData);
 
   // Prepare the input data to the mVPXImageWrapper for encoding.
   nsresult PrepareRawFrame(VideoChunk &aChunk);
 
+  // Apply the speed settings for the current speed level to the encoder.
+  void ApplySpeedLevel();
+
+  // Set up the codec of aRendition from the main encoder's configuration.
+  nsresult InitRendition(Rendition& aRendition,
+                         const vpx_codec_enc_cfg_t& aConfig);
+
+  // Scale the frame prepared by PrepareRawFrame() and encode it for every
+  // rendition, the encoded frames going to the matching element of aData.
+  void EncodeRenditions(StreamTime aEncodedDuration, int aFlags,
+                        nsTArray<EncodedFrameContainer>& aData);
+
+  // Hand the frames encoded for the renditions to their outputs, and end
+  // them if aEndOfStream.
+  void OutputRenditions(nsTArray<EncodedFrameContainer>& aData,
+                        bool aEndOfStream);
+
+  // Mark aRendition as failed and cancel its output.
+  void FailRendition(Rendition& aRendition);
+
+  // Reconfigure the encoder if the bitrate was changed while encoding.
+  void ApplyPendingBitrate();
+
   // Output frame rate.
   uint32_t mEncodedFrameRate;
   // Duration for the output frame, reciprocal to mEncodedFrameRate.
@@ -75,6 +141,9 @@ private:
   // I420 frame, for converting to I420.
   nsTArray<uint8_t> mI420Frame;
 
+  // Trades quality for encoding speed when we can't keep up with real time.
+  EncoderSpeedController mSpeedController;
+
   /**
    * A local segment queue which takes the raw data out from mRawSegment in the
    * call of GetEncodedTrack(). Since we implement the fixed FPS encoding
@@ -86,8 +155,16 @@ private:
   // VP8 relative members.
   // Codec context structure.
   nsAutoPtr<vpx_codec_ctx_t> mVPXContext;
+  // Current encoder configuration, to update it in place.
+  nsAutoPtr<vpx_codec_enc_cfg_t> mVPXConfig;
   // Image Descriptor.
   nsAutoPtr<vpx_image_t> mVPXImageWrapper;
+
+  // From the largest to the smallest. Only changed before initialization.
+  nsTArray<UniquePtr<Rendition>> mRenditions;
+  // Frames encoded since the last keyframe. With renditions, keyframes are
+  // placed by us rather than libvpx, so that they line up.
+  uint32_t mFramesSinceKeyFrame;
 };
 
 } // namespace mozilla
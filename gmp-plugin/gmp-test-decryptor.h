@@ -9,6 +9,7 @@
 #include "gmp-decryption.h"
 #include "gmp-async-shutdown.h"
 #include <string>
+#include <string.h>
 #include "mozilla/Attributes.h"
 
 class FakeDecryptor : public GMPDecryptor7 {
@@ -60,9 +61,17 @@ public:
   {
   }
 
+  // Buffers using the "gmp-ipc-benchmark" key id are handed back as is, so
+  // that TestGMPIPCBenchmark can time the decrypt round trip. Others are
+  // ignored.
   void Decrypt(GMPBuffer* aBuffer,
                GMPEncryptedBufferMetadata* aMetadata) override
   {
+    static const char kEchoKeyId[] = "gmp-ipc-benchmark";
+    if (aMetadata->KeyIdSize() == sizeof(kEchoKeyId) - 1 &&
+        !memcmp(aMetadata->KeyId(), kEchoKeyId, sizeof(kEchoKeyId) - 1)) {
+      mCallback->Decrypted(aBuffer, GMPNoErr);
+    }
   }
 
   void DecryptingComplete() override;
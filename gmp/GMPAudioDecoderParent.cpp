@@ -33,6 +33,7 @@ GMPAudioDecoderParent::GMPAudioDecoderParent(GMPContentParent* aPlugin)
   , mIsAwaitingDrainComplete(false)
   , mPlugin(aPlugin)
   , mCallback(nullptr)
+  , mStats(aPlugin->CreateActorStats("audio-decoder"))
 {
   MOZ_ASSERT(mPlugin);
 }
@@ -97,6 +98,8 @@ GMPAudioDecoderParent::Decode(GMPAudioSamplesImpl& aEncodedSamples)
   if (!SendDecode(samples)) {
     return NS_ERROR_FAILURE;
   }
+  mStats->MessageSent(samples.mData().Length());
+  mStats->RequestSent(samples.mTimeStamp());
 
   // Async IPC, we don't have access to a return value.
   return NS_OK;
@@ -117,6 +120,8 @@ GMPAudioDecoderParent::Reset()
   if (!SendReset()) {
     return NS_ERROR_FAILURE;
   }
+  mStats->MessageSent();
+  mStats->ClearPendingRequests();
 
   mIsAwaitingResetComplete = true;
 
@@ -139,6 +144,7 @@ GMPAudioDecoderParent::Drain()
   if (!SendDrain()) {
     return NS_ERROR_FAILURE;
   }
+  mStats->MessageSent();
 
   mIsAwaitingDrainComplete = true;
 
@@ -218,7 +224,11 @@ GMPAudioDecoderParent::ActorDestroy(ActorDestroyReason aWhy)
 
   if (mCallback) {
     // May call Close() (and Shutdown()) immediately or with a delay
-    mCallback->Terminated();
+    if (aWhy == AbnormalShutdown) {
+      mCallback->Crashed();
+    } else {
+      mCallback->Terminated();
+    }
     mCallback = nullptr;
   }
   if (mPlugin) {
@@ -226,6 +236,7 @@ GMPAudioDecoderParent::ActorDestroy(ActorDestroyReason aWhy)
     mPlugin->AudioDecoderDestroyed(this);
     mPlugin = nullptr;
   }
+  mStats->ActorDestroyed();
   MaybeDisconnect(aWhy == AbnormalShutdown);
 }
 
@@ -234,6 +245,8 @@ GMPAudioDecoderParent::RecvDecoded(const GMPAudioDecodedSampleData& aDecoded)
 {
   LOGV(("GMPAudioDecoderParent[%p]::RecvDecoded() timestamp=%lld",
         this, aDecoded.mTimeStamp()));
+  mStats->MessageReceived(aDecoded.mData().Length() * sizeof(int16_t));
+  mStats->ReplyReceived(aDecoded.mTimeStamp());
 
   if (!mCallback) {
     return IPC_FAIL_NO_REASON(this);
@@ -251,6 +264,7 @@ mozilla::ipc::IPCResult
 GMPAudioDecoderParent::RecvInputDataExhausted()
 {
   LOGV(("GMPAudioDecoderParent[%p]::RecvInputDataExhausted()", this));
+  mStats->MessageReceived();
 
   if (!mCallback) {
     return IPC_FAIL_NO_REASON(this);
@@ -266,6 +280,7 @@ mozilla::ipc::IPCResult
 GMPAudioDecoderParent::RecvDrainComplete()
 {
   LOGD(("GMPAudioDecoderParent[%p]::RecvDrainComplete()", this));
+  mStats->MessageReceived();
 
   if (!mCallback) {
     return IPC_FAIL_NO_REASON(this);
@@ -286,6 +301,7 @@ mozilla::ipc::IPCResult
 GMPAudioDecoderParent::RecvResetComplete()
 {
   LOGD(("GMPAudioDecoderParent[%p]::RecvResetComplete()", this));
+  mStats->MessageReceived();
 
   if (!mCallback) {
     return IPC_FAIL_NO_REASON(this);
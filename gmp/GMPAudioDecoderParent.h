@@ -13,6 +13,7 @@
 #include "GMPMessageUtils.h"
 #include "GMPAudioDecoderProxy.h"
 #include "GMPCrashHelperHolder.h"
+#include "GMPStats.h"
 
 namespace mozilla {
 namespace gmp {
@@ -64,6 +65,7 @@ private:
   bool mIsAwaitingDrainComplete;
   RefPtr<GMPContentParent> mPlugin;
   GMPAudioDecoderCallbackProxy* mCallback;
+  RefPtr<GMPActorStats> mStats;
 };
 
 } // namespace gmp
@@ -25,6 +25,9 @@ public:
   virtual void DrainComplete() = 0;
   virtual void ResetComplete() = 0;
   virtual void Error(GMPErr aError) = 0;
+  // Called instead of Terminated() when the plugin went away unexpectedly,
+  // e.g. because its process crashed, rather than being shut down.
+  virtual void Crashed() { Terminated(); }
 };
 
 class GMPAudioDecoderProxy {
@@ -229,11 +229,63 @@ GMPCDMProxy::gmp_InitGetGMPDecryptor(nsresult aResult,
   mNodeId = aNodeId;
   MOZ_ASSERT(!GetNodeId().IsEmpty());
 
+  RefPtr<gmp::GeckoMediaPluginService> service =
+    gmp::GeckoMediaPluginService::GetGeckoMediaPluginService();
+  if (service && !service->IsOnShardThread(GetNodeId())) {
+    // The decryptor, and so everything we do from now on, lives on the GMP
+    // actor thread for our node id.
+    nsCOMPtr<nsIRunnable> task(
+      NewRunnableMethod<UniquePtr<InitData>&&>(this,
+                                               &GMPCDMProxy::MoveToShardThread,
+                                               Move(aData)));
+    NS_DispatchToMainThread(task);
+    return;
+  }
+
+  gmp_GetGMPDecryptor(Move(aData));
+}
+
+void
+GMPCDMProxy::MoveToShardThread(UniquePtr<InitData>&& aData)
+{
+  MOZ_ASSERT(NS_IsMainThread());
+  if (mKeys.IsNull()) {
+    // Shut down while we were getting the node id; gmp_Shutdown() has
+    // already been sent to the old owner thread.
+    return;
+  }
+
+  RefPtr<gmp::GeckoMediaPluginService> service =
+    gmp::GeckoMediaPluginService::GetGeckoMediaPluginService();
+  nsCOMPtr<nsIThread> shard;
+  if (!service ||
+      NS_FAILED(service->GetShardThread(GetNodeId(), getter_AddRefs(shard)))) {
+    RejectPromise(aData->mPromiseId, NS_ERROR_DOM_INVALID_STATE_ERR,
+                  NS_LITERAL_CSTRING("Couldn't get GMP thread in GMPCDMProxy::MoveToShardThread"));
+    return;
+  }
+
+  // mOwnerThread is only changed here, on the main thread, before anything
+  // other than Init() and Shutdown() is dispatched to it.
+  mOwnerThread = shard;
+  nsCOMPtr<nsIRunnable> task(
+    NewRunnableMethod<UniquePtr<InitData>&&>(this,
+                                             &GMPCDMProxy::gmp_GetGMPDecryptor,
+                                             Move(aData)));
+  mOwnerThread->Dispatch(task, NS_DISPATCH_NORMAL);
+}
+
+void
+GMPCDMProxy::gmp_GetGMPDecryptor(UniquePtr<InitData>&& aData)
+{
+  MOZ_ASSERT(IsOnOwnerThread());
+  uint32_t promiseID = aData->mPromiseId;
+
   nsCOMPtr<mozIGeckoMediaPluginService> mps =
     do_GetService("@mozilla.org/gecko-media-plugin-service;1");
   if (!mps) {
     RejectPromise(promiseID, NS_ERROR_DOM_INVALID_STATE_ERR,
-                  NS_LITERAL_CSTRING("Couldn't get MediaPluginService in GMPCDMProxy::gmp_InitGetGMPDecryptor"));
+                  NS_LITERAL_CSTRING("Couldn't get MediaPluginService in GMPCDMProxy::gmp_GetGMPDecryptor"));
     return;
   }
 
@@ -130,6 +130,10 @@ private:
   void gmp_InitGetGMPDecryptor(nsresult aResult,
                                const nsACString& aNodeId,
                                UniquePtr<InitData>&& aData);
+  void gmp_GetGMPDecryptor(UniquePtr<InitData>&& aData);
+
+  // Main thread only. Moves us to the GMP actor thread for our node id.
+  void MoveToShardThread(UniquePtr<InitData>&& aData);
 
   // GMP thread only.
   void gmp_Shutdown();
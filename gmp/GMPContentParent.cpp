@@ -44,6 +44,20 @@ GMPContentParent::GMPContentParent(GMPParent* aParent)
 
 GMPContentParent::~GMPContentParent()
 {
+  if (mStats) {
+    mStats->Unregister();
+  }
+}
+
+already_AddRefed<GMPActorStats>
+GMPContentParent::CreateActorStats(const char* aActorType)
+{
+  if (!mStats) {
+    // Created lazily as the display name and plugin id are only known once
+    // the content parent is connected.
+    mStats = new GMPPluginStats(mPluginId, mDisplayName);
+  }
+  return mStats->CreateActorStats(aActorType);
 }
 
 class ReleaseGMPContentParent : public Runnable
@@ -140,6 +154,7 @@ GMPContentParent::CloseIfUnused()
       mVideoDecoders.IsEmpty() &&
       mVideoEncoders.IsEmpty() &&
       mCloseBlockerCount == 0) {
+    mClosing = true;
     RefPtr<GMPContentParent> toClose;
     if (mParent) {
       toClose = mParent->ForgetGMPContentParent();
@@ -8,6 +8,7 @@
 
 #include "mozilla/gmp/PGMPContentParent.h"
 #include "GMPSharedMemManager.h"
+#include "GMPStats.h"
 #include "nsISupportsImpl.h"
 
 namespace mozilla {
@@ -41,9 +42,23 @@ public:
   void AudioDecoderDestroyed(GMPAudioDecoderParent* aDecoder);
 
   nsIThread* GMPThread();
+  // Binds a bridged content parent to a GMP actor shard thread. Must be
+  // called before the channel is opened.
+  void SetGMPThread(nsIThread* aThread)
+  {
+    MOZ_ASSERT(!mGMPThread);
+    mGMPThread = aThread;
+  }
+  // True once CloseIfUnused() has decided to close; no new actors may be
+  // created after that.
+  bool IsClosing() const { return mClosing; }
 
   // GMPSharedMem
   void CheckThread() override;
+  GMPPluginStats* Stats() override { return mStats; }
+
+  // Creates the performance counters for a new actor of this plugin.
+  already_AddRefed<GMPActorStats> CreateActorStats(const char* aActorType);
 
   void SetDisplayName(const nsCString& aDisplayName)
   {
@@ -116,6 +131,8 @@ private:
   nsCString mDisplayName;
   uint32_t mPluginId;
   uint32_t mCloseBlockerCount = 0;
+  bool mClosing = false;
+  RefPtr<GMPPluginStats> mStats;
 };
 
 } // namespace gmp
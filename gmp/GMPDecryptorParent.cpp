@@ -32,6 +32,7 @@ GMPDecryptorParent::GMPDecryptorParent(GMPContentParent* aPlugin)
 #ifdef DEBUG
   , mGMPThread(aPlugin->GMPThread())
 #endif
+  , mStats(aPlugin->CreateActorStats("decryptor"))
 {
   MOZ_ASSERT(mPlugin && mGMPThread);
 }
@@ -196,6 +197,8 @@ GMPDecryptorParent::Decrypt(uint32_t aId,
     GMPDecryptionData data;
     Unused << SendDecrypt(aId, aBuffer, data);
   }
+  mStats->MessageSent(aBuffer.Length());
+  mStats->RequestSent(aId);
 }
 
 mozilla::ipc::IPCResult
@@ -418,6 +421,8 @@ GMPDecryptorParent::RecvDecrypted(const uint32_t& aId,
     NS_WARNING("Trying to use a dead GMP decrypter!");
     return IPC_FAIL_NO_REASON(this);
   }
+  mStats->MessageReceived(aBuffer.Length());
+  mStats->ReplyReceived(aId);
   mCallback->Decrypted(aId, ToDecryptStatus(aErr), aBuffer);
   return IPC_OK();
 }
@@ -489,6 +494,7 @@ GMPDecryptorParent::ActorDestroy(ActorDestroyReason aWhy)
     mPlugin->DecryptorDestroyed(this);
     mPlugin = nullptr;
   }
+  mStats->ActorDestroyed();
   MaybeDisconnect(aWhy == AbnormalShutdown);
 }
 
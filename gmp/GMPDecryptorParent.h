@@ -11,6 +11,7 @@
 #include "gmp-decryption.h"
 #include "GMPDecryptorProxy.h"
 #include "GMPCrashHelperHolder.h"
+#include "GMPStats.h"
 
 namespace mozilla {
 
@@ -121,6 +122,7 @@ private:
 #ifdef DEBUG
   nsIThread* const mGMPThread;
 #endif
+  RefPtr<GMPActorStats> mStats;
 };
 
 } // namespace gmp
@@ -4,13 +4,16 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include "plhash.h"
+#include <algorithm>
 #include "nsDirectoryServiceUtils.h"
 #include "nsDirectoryServiceDefs.h"
 #include "nsAppDirectoryServiceDefs.h"
 #include "GMPParent.h"
+#include "GMPOriginIndex.h"
 #include "gmp-storage.h"
 #include "mozilla/Unused.h"
 #include "mozilla/EndianUtils.h"
+#include "mozilla/ScopeExit.h"
 #include "nsClassHashtable.h"
 #include "prio.h"
 #include "mozIGeckoMediaPluginService.h"
@@ -98,10 +101,12 @@ GetGMPStorageDir(nsIFile** aTempDir,
 //   record bytes (entire remainder of file)
 class GMPDiskStorage : public GMPStorage {
 public:
-  explicit GMPDiskStorage(const nsCString& aNodeId,
-                          const nsString& aGMPName)
+  GMPDiskStorage(const nsCString& aNodeId,
+                 const nsString& aGMPName,
+                 GMPOriginIndex* aIndex)
     : mNodeId(aNodeId)
     , mGMPName(aGMPName)
+    , mIndex(aIndex)
   {
   }
 
@@ -158,8 +163,10 @@ public:
     MOZ_ASSERT(!IsOpen(aRecordName));
     nsresult rv;
     Record* record = nullptr;
+    bool created = false;
     if (!mRecords.Get(aRecordName, &record)) {
       // New file.
+      created = true;
       nsAutoString filename;
       rv = GetUnusedFilename(aRecordName, filename);
       if (NS_WARN_IF(NS_FAILED(rv))) {
@@ -179,6 +186,10 @@ public:
     if (NS_WARN_IF(NS_FAILED(rv))) {
       return GMPGenericErr;
     }
+    if (mIndex && created) {
+      // Creating the file modified the directory.
+      NoteWrite(record->mFilename, 0);
+    }
 
     MOZ_ASSERT(IsOpen(aRecordName));
 
@@ -249,10 +260,20 @@ public:
     mRecords.Get(aRecordName, &record);
     MOZ_ASSERT(record && !!record->mFileDesc); // IsOpen() guarantees this.
 
+    // Size of the record before this write, for the index.
+    int64_t oldSize =
+      mIndex ? std::max<int64_t>(0, PR_Seek64(record->mFileDesc, 0, PR_SEEK_END))
+             : 0;
+
     // Write operations overwrite the entire record. So close it now.
     PR_Close(record->mFileDesc);
     record->mFileDesc = nullptr;
 
+    // Even a failed write may have modified the record.
+    auto noteWrite = MakeScopeExit([&] {
+      NoteWrite(record->mFilename, oldSize);
+    });
+
     // Writing 0 bytes means removing (deleting) the file.
     if (aBytes.Length() == 0) {
       nsresult rv = RemoveStorageFile(record->mFilename);
@@ -449,6 +470,36 @@ private:
     return NS_OK;
   }
 
+  // Notes in the index the time and size of the record stored in aFilename
+  // after a write, or its removal.
+  void NoteWrite(const nsString& aFilename, int64_t aOldSize)
+  {
+    if (!mIndex) {
+      return;
+    }
+    nsCOMPtr<nsIFile> dir;
+    nsresult rv = GetGMPStorageDir(getter_AddRefs(dir), mGMPName, mNodeId);
+    if (NS_WARN_IF(NS_FAILED(rv))) {
+      return;
+    }
+    // Creating or removing the file changes the time of the directory.
+    PRTime lastModified = 0;
+    Unused << dir->GetLastModifiedTime(&lastModified);
+    int64_t newSize = 0;
+    nsCOMPtr<nsIFile> f;
+    if (NS_SUCCEEDED(dir->Clone(getter_AddRefs(f))) &&
+        NS_SUCCEEDED(f->Append(aFilename))) {
+      PRTime fileLastModified = 0;
+      if (NS_SUCCEEDED(f->GetLastModifiedTime(&fileLastModified)) &&
+          NS_SUCCEEDED(f->GetFileSize(&newSize))) {
+        lastModified = std::max(lastModified, fileLastModified);
+      } else {
+        newSize = 0;
+      }
+    }
+    mIndex->NoteStorageWrite(mNodeId, lastModified, newSize - aOldSize);
+  }
+
   nsresult RemoveStorageFile(const nsString& aFilename)
   {
     nsCOMPtr<nsIFile> f;
@@ -482,12 +533,15 @@ private:
   nsClassHashtable<nsCStringHashKey, Record> mRecords;
   const nsCString mNodeId;
   const nsString mGMPName;
+  // May be null.
+  const RefPtr<GMPOriginIndex> mIndex;
 };
 
 already_AddRefed<GMPStorage> CreateGMPDiskStorage(const nsCString& aNodeId,
-                                                  const nsString& aGMPName)
+                                                  const nsString& aGMPName,
+                                                  GMPOriginIndex* aIndex)
 {
-  RefPtr<GMPDiskStorage> storage(new GMPDiskStorage(aNodeId, aGMPName));
+  RefPtr<GMPDiskStorage> storage(new GMPDiskStorage(aNodeId, aGMPName, aIndex));
   if (NS_FAILED(storage->Init())) {
     NS_WARNING("Failed to initialize on disk GMP storage");
     return nullptr;
@@ -0,0 +1,397 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "GMPOriginIndex.h"
+#include <algorithm>
+#include "GMPUtils.h"
+#include "mozilla/Logging.h"
+#include "mozilla/Move.h"
+#include "mozilla/Unused.h"
+#include "nsAutoPtr.h"
+#include "nsCRTGlue.h"
+#include "prio.h"
+
+namespace mozilla {
+
+#ifdef LOG
+#undef LOG
+#endif
+
+extern LogModule* GetGMPLog();
+
+#define LOGD(msg) MOZ_LOG(GetGMPLog(), mozilla::LogLevel::Debug, msg)
+#define LOG(level, msg) MOZ_LOG(GetGMPLog(), (level), msg)
+
+namespace gmp {
+
+// The file is a header line followed by one line per update:
+//   +\t$nodeId\t$originHash\t$lastModified\t$storageSize\t$origin\t$topLevelOrigin
+//   -\t$nodeId
+// Later lines override earlier ones for the same node id. Origins are
+// serialized URLs, so they contain neither tabs nor line breaks.
+static const char kIndexFileName[] = "originindex";
+static const char kIndexTempFileName[] = "originindex.tmp";
+// The closed header is followed by the state of the id/ and storage/
+// directories; see AppendDirectoryState().
+static const char kHeaderOpen[] = "gmp-origin-index 2 open";
+static const char kHeaderClosed[] = "gmp-origin-index 2 closed";
+
+// Don't bother compacting journals shorter than this.
+static const uint32_t kMinJournalLengthToCompact = 256;
+// Thousands of origins fit in well under this.
+static const int64_t kMaxIndexFileSize = 16 * 1024 * 1024;
+
+static nsresult
+WriteIndexFile(nsIFile* aPath, int32_t aFlags, const nsACString& aData)
+{
+  PRFileDesc* f = nullptr;
+  nsresult rv = aPath->OpenNSPRFileDesc(aFlags, PR_IRWXU, &f);
+  if (NS_FAILED(rv)) {
+    return rv;
+  }
+  int32_t len = PR_Write(f, aData.BeginReading(), aData.Length());
+  PR_Close(f);
+  if (len < 0 || (uint32_t)len != aData.Length()) {
+    return NS_ERROR_FAILURE;
+  }
+  return NS_OK;
+}
+
+// Older versions don't maintain the index, but they add and remove node ids
+// by creating and deleting entries of the id/ and storage/ directories,
+// which changes their modification time and entry count. Those are recorded
+// when the index is closed, and the index is only trusted while they match.
+static void
+AppendDirectoryState(nsIFile* aPluginStorageDir, const char* aName,
+                     nsACString& aOut)
+{
+  PRTime lastModified = 0;
+  uint32_t count = 0;
+  nsCOMPtr<nsIFile> dir;
+  bool isDirectory = false;
+  if (NS_SUCCEEDED(aPluginStorageDir->Clone(getter_AddRefs(dir))) &&
+      NS_SUCCEEDED(dir->AppendNative(nsDependentCString(aName))) &&
+      NS_SUCCEEDED(dir->IsDirectory(&isDirectory)) && isDirectory) {
+    Unused << dir->GetLastModifiedTime(&lastModified);
+    DirectoryEnumerator iter(dir, DirectoryEnumerator::FilesAndDirs);
+    for (nsCOMPtr<nsIFile> entry; (entry = iter.Next()) != nullptr;) {
+      count++;
+    }
+  }
+  aOut.Append(' ');
+  aOut.Append(aName);
+  aOut.Append(' ');
+  aOut.AppendInt(lastModified);
+  aOut.Append(' ');
+  aOut.AppendInt(count);
+}
+
+GMPOriginIndex::GMPOriginIndex(nsIFile* aPluginStorageDir)
+  : mMutex("GMPOriginIndex")
+  , mDir(aPluginStorageDir)
+  , mJournalLength(0)
+  , mFileValid(false)
+{
+}
+
+nsCString
+GMPOriginIndex::ClosedHeader() const
+{
+  nsCString header(kHeaderClosed);
+  AppendDirectoryState(mDir, "id", header);
+  AppendDirectoryState(mDir, "storage", header);
+  return header;
+}
+
+already_AddRefed<nsIFile>
+GMPOriginIndex::GetIndexFile(const nsACString& aName) const
+{
+  nsCOMPtr<nsIFile> path;
+  if (NS_FAILED(mDir->Clone(getter_AddRefs(path))) ||
+      NS_FAILED(path->AppendNative(aName))) {
+    return nullptr;
+  }
+  return path.forget();
+}
+
+void
+GMPOriginIndex::AppendEntryLine(const Entry& aEntry, nsACString& aOutLine) const
+{
+  aOutLine.AppendLiteral("+\t");
+  aOutLine.Append(aEntry.mNodeId);
+  aOutLine.Append('\t');
+  aOutLine.Append(aEntry.mOriginHash);
+  aOutLine.Append('\t');
+  aOutLine.AppendInt(aEntry.mLastModified);
+  aOutLine.Append('\t');
+  aOutLine.AppendInt(int64_t(aEntry.mStorageSize));
+  aOutLine.Append('\t');
+  aOutLine.Append(aEntry.mOrigin);
+  aOutLine.Append('\t');
+  aOutLine.Append(aEntry.mTopLevelOrigin);
+  aOutLine.Append('\n');
+}
+
+// Node ids and origin hashes are directory names; make sure a corrupt index
+// can't make us touch anything but the plugin's id/ and storage/ entries.
+static bool
+IsValidDirectoryName(const nsCString& aName)
+{
+  return !aName.IsEmpty() &&
+         !aName.EqualsLiteral(".") &&
+         !aName.EqualsLiteral("..") &&
+         aName.FindCharInSet(FILE_PATH_SEPARATOR FILE_ILLEGAL_CHARACTERS) ==
+           kNotFound;
+}
+
+bool
+GMPOriginIndex::ParseEntryLine(const nsACString& aLine, Entry& aOutEntry) const
+{
+  // Unlike SplitAt(), keeps empty fields.
+  nsTArray<nsDependentCSubstring> fields;
+  int32_t start = 0;
+  for (int32_t end; (end = aLine.FindChar('\t', start)) != kNotFound;
+       start = end + 1) {
+    fields.AppendElement(Substring(aLine, start, end - start));
+  }
+  fields.AppendElement(Substring(aLine, start));
+  if (fields.Length() != 7 || !fields[0].EqualsLiteral("+")) {
+    return false;
+  }
+  nsresult rv1, rv2;
+  aOutEntry.mNodeId = fields[1];
+  aOutEntry.mOriginHash = fields[2];
+  aOutEntry.mLastModified = nsCString(fields[3]).ToInteger64(&rv1);
+  aOutEntry.mStorageSize = uint64_t(nsCString(fields[4]).ToInteger64(&rv2));
+  aOutEntry.mOrigin = fields[5];
+  aOutEntry.mTopLevelOrigin = fields[6];
+  return NS_SUCCEEDED(rv1) && NS_SUCCEEDED(rv2) &&
+         IsValidDirectoryName(aOutEntry.mNodeId) &&
+         IsValidDirectoryName(aOutEntry.mOriginHash);
+}
+
+bool
+GMPOriginIndex::Load()
+{
+  MutexAutoLock lock(mMutex);
+  mEntries.Clear();
+  mFileValid = false;
+
+  nsCOMPtr<nsIFile> path = GetIndexFile(NS_LITERAL_CSTRING(kIndexFileName));
+  if (!path) {
+    return false;
+  }
+  PRFileDesc* f = nullptr;
+  if (NS_FAILED(path->OpenNSPRFileDesc(PR_RDONLY, 0, &f))) {
+    return false;
+  }
+  int64_t size = PR_Seek64(f, 0, PR_SEEK_END);
+  PR_Seek64(f, 0, PR_SEEK_SET);
+  if (size <= 0 || size > kMaxIndexFileSize) {
+    PR_Close(f);
+    return false;
+  }
+  nsAutoCString data;
+  data.SetLength(size);
+  int32_t len = PR_Read(f, data.BeginWriting(), size);
+  PR_Close(f);
+  // A missing trailing line break means the last update was torn.
+  if (len != size || data.Last() != '\n') {
+    LOGD(("GMPOriginIndex[%p]::Load() index truncated", this));
+    return false;
+  }
+
+  nsTArray<nsCString> lines;
+  SplitAt("\n", data, lines);
+  if (lines.IsEmpty() || !lines[0].Equals(ClosedHeader())) {
+    // Missing, the session which wrote it didn't shut down cleanly and may
+    // not have noted its last writes, or node ids were added or removed by a
+    // version which doesn't maintain the index.
+    LOGD(("GMPOriginIndex[%p]::Load() index not closed cleanly or stale",
+          this));
+    return false;
+  }
+  for (size_t i = 1; i < lines.Length(); i++) {
+    const nsCString& line = lines[i];
+    if (StringBeginsWith(line, NS_LITERAL_CSTRING("-\t"))) {
+      mEntries.Remove(Substring(line, 2));
+      continue;
+    }
+    nsAutoPtr<Entry> entry(new Entry());
+    if (!ParseEntryLine(line, *entry)) {
+      LOGD(("GMPOriginIndex[%p]::Load() corrupt line %u", this, uint32_t(i)));
+      mEntries.Clear();
+      return false;
+    }
+    nsCString nodeId = entry->mNodeId;
+    mEntries.Put(nodeId, entry.forget());
+  }
+
+  LOGD(("GMPOriginIndex[%p]::Load() %u entries from %u lines",
+        this, mEntries.Count(), lines.Length()));
+  // Mark the index as in use, so that it's rebuilt if we crash.
+  Unused << Compact(false);
+  return true;
+}
+
+void
+GMPOriginIndex::Reset(nsTArray<Entry>&& aEntries)
+{
+  MutexAutoLock lock(mMutex);
+  mEntries.Clear();
+  for (Entry& entry : aEntries) {
+    nsCString nodeId = entry.mNodeId;
+    mEntries.Put(nodeId, new Entry(Move(entry)));
+  }
+  Unused << Compact(false);
+}
+
+void
+GMPOriginIndex::Clear()
+{
+  MutexAutoLock lock(mMutex);
+  mEntries.Clear();
+  // The directory is gone along with the file; the next update writes the
+  // file again once the plugin's storage is recreated.
+  mFileValid = false;
+}
+
+void
+GMPOriginIndex::Close()
+{
+  MutexAutoLock lock(mMutex);
+  if (NS_FAILED(Compact(true))) {
+    NS_WARNING("Failed to persist GMP origin index");
+  }
+}
+
+nsresult
+GMPOriginIndex::Compact(bool aClosed)
+{
+  mMutex.AssertCurrentThreadOwns();
+  mFileValid = false;
+
+  nsAutoCString data;
+  if (aClosed) {
+    data.Append(ClosedHeader());
+  } else {
+    data.AppendLiteral(kHeaderOpen);
+  }
+  data.Append('\n');
+  for (auto iter = mEntries.ConstIter(); !iter.Done(); iter.Next()) {
+    AppendEntryLine(*iter.UserData(), data);
+  }
+
+  // Write aside then rename, so that a crash never leaves a partial index
+  // which looks valid.
+  nsCOMPtr<nsIFile> temp = GetIndexFile(NS_LITERAL_CSTRING(kIndexTempFileName));
+  if (!temp) {
+    return NS_ERROR_FAILURE;
+  }
+  nsresult rv = WriteIndexFile(temp, PR_WRONLY | PR_CREATE_FILE | PR_TRUNCATE,
+                               data);
+  if (NS_FAILED(rv)) {
+    return rv;
+  }
+  rv = temp->MoveToNative(nullptr, NS_LITERAL_CSTRING(kIndexFileName));
+  if (NS_FAILED(rv)) {
+    return rv;
+  }
+  mJournalLength = 0;
+  mFileValid = true;
+  return NS_OK;
+}
+
+nsresult
+GMPOriginIndex::Append(const nsACString& aLine)
+{
+  mMutex.AssertCurrentThreadOwns();
+  if (!mFileValid ||
+      (mJournalLength >= kMinJournalLengthToCompact &&
+       mJournalLength >= 2 * mEntries.Count())) {
+    return Compact(false);
+  }
+  nsCOMPtr<nsIFile> path = GetIndexFile(NS_LITERAL_CSTRING(kIndexFileName));
+  if (!path) {
+    return NS_ERROR_FAILURE;
+  }
+  // Don't create the file if it's gone, as it'd lack the entries before
+  // aLine; write them all instead.
+  nsresult rv = WriteIndexFile(path, PR_WRONLY | PR_APPEND, aLine);
+  if (NS_FAILED(rv)) {
+    return Compact(false);
+  }
+  mJournalLength++;
+  return NS_OK;
+}
+
+bool
+GMPOriginIndex::Contains(const nsACString& aNodeId)
+{
+  MutexAutoLock lock(mMutex);
+  return mEntries.Contains(aNodeId);
+}
+
+void
+GMPOriginIndex::AddNodeId(const nsACString& aNodeId,
+                          const nsACString& aOriginHash,
+                          const nsACString& aOrigin,
+                          const nsACString& aTopLevelOrigin,
+                          PRTime aLastModified)
+{
+  MutexAutoLock lock(mMutex);
+  Entry* entry = mEntries.LookupOrAdd(aNodeId);
+  entry->mNodeId = aNodeId;
+  entry->mOriginHash = aOriginHash;
+  entry->mOrigin = aOrigin;
+  entry->mTopLevelOrigin = aTopLevelOrigin;
+  entry->mLastModified = std::max(entry->mLastModified, aLastModified);
+
+  nsAutoCString line;
+  AppendEntryLine(*entry, line);
+  Unused << Append(line);
+}
+
+void
+GMPOriginIndex::NoteStorageWrite(const nsACString& aNodeId,
+                                 PRTime aLastModified,
+                                 int64_t aSizeDelta)
+{
+  MutexAutoLock lock(mMutex);
+  Entry* entry = mEntries.Get(aNodeId);
+  if (!entry) {
+    return;
+  }
+  entry->mLastModified = std::max(entry->mLastModified, aLastModified);
+  entry->mStorageSize =
+    uint64_t(std::max<int64_t>(0, int64_t(entry->mStorageSize) + aSizeDelta));
+
+  nsAutoCString line;
+  AppendEntryLine(*entry, line);
+  Unused << Append(line);
+}
+
+void
+GMPOriginIndex::TakeEntries(EntryFilter& aFilter, nsTArray<Entry>& aOutEntries)
+{
+  MutexAutoLock lock(mMutex);
+  nsAutoCString lines;
+  for (auto iter = mEntries.Iter(); !iter.Done(); iter.Next()) {
+    if (!aFilter(*iter.UserData())) {
+      continue;
+    }
+    lines.AppendLiteral("-\t");
+    lines.Append(iter.Key());
+    lines.Append('\n');
+    aOutEntries.AppendElement(Move(*iter.UserData()));
+    iter.Remove();
+  }
+  if (!lines.IsEmpty()) {
+    Unused << Append(lines);
+  }
+}
+
+} // namespace gmp
+} // namespace mozilla
@@ -0,0 +1,116 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef GMPOriginIndex_h_
+#define GMPOriginIndex_h_
+
+#include "mozilla/Mutex.h"
+#include "nsClassHashtable.h"
+#include "nsCOMPtr.h"
+#include "nsIFile.h"
+#include "nsISupportsImpl.h"
+#include "nsString.h"
+#include "nsTArray.h"
+#include "prtime.h"
+
+namespace mozilla {
+namespace gmp {
+
+/**
+ * Index of the node ids a GMP has persisted on disk, so that site data and
+ * history can be cleared without walking and stat'ing every file of the
+ * plugin's storage. Kept in $profileDir/gmp/$platform/$gmpName/originindex
+ * as a journal of updates, which is compacted when it grows.
+ *
+ * The index is only trusted if the session which last wrote it shut down
+ * cleanly, and the id/ and storage/ directories weren't changed since, e.g.
+ * by an older version; otherwise, or if the file is missing or corrupt, the
+ * caller rebuilds it from the directories on disk and passes it to Reset().
+ *
+ * Thread-safe: node ids are added on the GMP thread, storage writes are
+ * noted from the storage I/O threads.
+ */
+class GMPOriginIndex final
+{
+public:
+  NS_INLINE_DECL_THREADSAFE_REFCOUNTING(GMPOriginIndex)
+
+  struct Entry {
+    Entry()
+      : mLastModified(0)
+      , mStorageSize(0)
+    {}
+    // Salt of the node, i.e. the name of its storage/ directory.
+    nsCString mNodeId;
+    // Hash of the origin pair, i.e. the name of its id/ directory.
+    nsCString mOriginHash;
+    nsCString mOrigin;
+    nsCString mTopLevelOrigin;
+    // Latest modification time of the node's files, in milliseconds as
+    // returned by nsIFile::GetLastModifiedTime().
+    PRTime mLastModified;
+    // Size of the node's records, in bytes.
+    uint64_t mStorageSize;
+  };
+
+  struct EntryFilter {
+    virtual bool operator()(const Entry& aEntry) = 0;
+    ~EntryFilter() {}
+  };
+
+  // aPluginStorageDir is $profileDir/gmp/$platform/$gmpName/.
+  explicit GMPOriginIndex(nsIFile* aPluginStorageDir);
+
+  // Read the index from disk. Returns false if there is none that can be
+  // trusted, in which case the index is empty until Reset() is called.
+  bool Load();
+  // Replace the content of the index with aEntries and persist it.
+  void Reset(nsTArray<Entry>&& aEntries);
+  // Empty the index after the plugin's storage directory was deleted.
+  void Clear();
+  // Persist the index and mark it as cleanly shut down.
+  void Close();
+
+  bool Contains(const nsACString& aNodeId);
+  void AddNodeId(const nsACString& aNodeId,
+                 const nsACString& aOriginHash,
+                 const nsACString& aOrigin,
+                 const nsACString& aTopLevelOrigin,
+                 PRTime aLastModified);
+  // Note a record write of aNodeId; aSizeDelta is the change of the record's
+  // size on disk. Ignored if the node isn't indexed.
+  void NoteStorageWrite(const nsACString& aNodeId,
+                        PRTime aLastModified,
+                        int64_t aSizeDelta);
+  // Remove the entries matching aFilter from the index, and append them to
+  // aOutEntries.
+  void TakeEntries(EntryFilter& aFilter, nsTArray<Entry>& aOutEntries);
+
+private:
+  ~GMPOriginIndex() {}
+
+  nsresult Append(const nsACString& aLine);
+  nsresult Compact(bool aClosed);
+  void AppendEntryLine(const Entry& aEntry, nsACString& aOutLine) const;
+  bool ParseEntryLine(const nsACString& aLine, Entry& aOutEntry) const;
+  already_AddRefed<nsIFile> GetIndexFile(const nsACString& aName) const;
+  // Header of an index closed with the directories in their current state.
+  nsCString ClosedHeader() const;
+
+  Mutex mMutex;
+  const nsCOMPtr<nsIFile> mDir;
+  // Hashes node id to its entry.
+  nsClassHashtable<nsCStringHashKey, Entry> mEntries;
+  // Number of updates appended since the file was last compacted.
+  uint32_t mJournalLength;
+  // False if the file on disk isn't in sync with mEntries, in which case the
+  // next update rewrites it entirely.
+  bool mFileValid;
+};
+
+} // namespace gmp
+} // namespace mozilla
+
+#endif // GMPOriginIndex_h_
@@ -238,6 +238,10 @@ GMPParent::EnsureAsyncShutdownTimeoutSet()
   if (mAsyncShutdownTimeout) {
     return NS_OK;
   }
+  if (mService && mService->IsAsyncShutdownDeadlineArmed()) {
+    // The service is unloading all plugins against a shared deadline.
+    return NS_OK;
+  }
 
   nsresult rv;
   mAsyncShutdownTimeout = do_CreateInstance(NS_TIMER_CONTRACTID, &rv);
@@ -372,6 +376,39 @@ GMPParent::AbortAsyncShutdown()
   CloseIfUnused();
 }
 
+void
+GMPParent::KillAfterShutdownDeadline()
+{
+  MOZ_ASSERT(GMPThread() == NS_GetCurrentThread());
+  LOGD("%s: state %d", __FUNCTION__, mState);
+
+  RefPtr<GMPParent> kungFuDeathGrip(this);
+  if (mAsyncShutdownTimeout) {
+    mAsyncShutdownTimeout->Cancel();
+    mAsyncShutdownTimeout = nullptr;
+  }
+  if (mAsyncShutdownRequired) {
+    mService->AsyncShutdownComplete(this);
+    mAsyncShutdownRequired = false;
+    mAsyncShutdownInProgress = false;
+  }
+
+  if (mAbnormalShutdownInProgress ||
+      mState == GMPStateNotLoaded || mState == GMPStateClosing) {
+    return;
+  }
+
+  for (uint32_t i = mTimers.Length(); i > 0; i--) {
+    mTimers[i - 1]->Shutdown();
+  }
+  for (size_t i = mStorage.Length(); i > 0; i--) {
+    mStorage[i - 1]->Shutdown();
+  }
+  RejectGetContentParentPromises();
+  mDeleteProcessOnlyOnUnload = true;
+  DeleteProcess();
+}
+
 void
 GMPParent::CloseActive(bool aDieWhenUnloaded)
 {
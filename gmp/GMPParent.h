@@ -142,6 +142,11 @@ public:
 
   void AbortAsyncShutdown();
 
+  // Called by the GMPService when this plugin has not completed its shutdown
+  // by the global async shutdown deadline. Stops waiting for the plugin and
+  // tears down its process.
+  void KillAfterShutdownDeadline();
+
   // Called when the child process has died.
   void ChildTerminated();
 
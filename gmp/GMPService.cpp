@@ -14,8 +14,12 @@
 #include "nsIObserverService.h"
 #include "GeckoChildProcessHost.h"
 #include "mozilla/ClearOnShutdown.h"
+#include "mozilla/HashFunctions.h"
+#include "mozilla/Preferences.h"
 #include "mozilla/SyncRunnable.h"
+#include "nsPrintfCString.h"
 #include "nsXPCOMPrivate.h"
+#include "nsXULAppAPI.h"
 #include "mozilla/Services.h"
 #include "nsNativeCharsetUtils.h"
 #include "nsIXULAppInfo.h"
@@ -58,6 +62,11 @@ GetGMPLog()
 #define LOGD(msg) MOZ_LOG(GetGMPLog(), mozilla::LogLevel::Debug, msg)
 #define LOG(level, msg) MOZ_LOG(GetGMPLog(), (level), msg)
 
+// Number of GMP actor threads in content processes, including the GMP
+// thread, unless overridden by media.gmp.actor-thread-shards.
+static const uint32_t kDefaultActorThreadShards = 4;
+static const uint32_t kMaxActorThreadShards = 16;
+
 #ifdef __CLASS__
 #undef __CLASS__
 #endif
@@ -148,6 +157,7 @@ NS_IMPL_ISUPPORTS(GeckoMediaPluginService, mozIGeckoMediaPluginService, nsIObser
 
 GeckoMediaPluginService::GeckoMediaPluginService()
   : mMutex("GeckoMediaPluginService::mMutex")
+  , mShardCount(1)
   , mGMPThreadShutdown(false)
   , mShuttingDownOnGMPThread(false)
 {
@@ -225,6 +235,14 @@ GeckoMediaPluginService::Init()
   MOZ_ASSERT(obsService);
   MOZ_ALWAYS_SUCCEEDS(obsService->AddObserver(this, NS_XPCOM_SHUTDOWN_THREADS_OBSERVER_ID, false));
 
+  if (!XRE_IsParentProcess()) {
+    // Content process GMPContentParents are bridged straight to the plugin
+    // process, so they can be bound to any thread.
+    uint32_t shards = Preferences::GetUint("media.gmp.actor-thread-shards",
+                                           kDefaultActorThreadShards);
+    mShardCount = std::max(1u, std::min(shards, kMaxActorThreadShards));
+  }
+
   // Kick off scanning for plugins
   nsCOMPtr<nsIThread> thread;
   return GetThread(getter_AddRefs(thread));
@@ -235,13 +253,21 @@ GeckoMediaPluginService::ShutdownGMPThread()
 {
   LOGD(("%s::%s", __CLASS__, __FUNCTION__));
   nsCOMPtr<nsIThread> gmpThread;
+  nsTArray<nsCOMPtr<nsIThread>> shardThreads;
   {
     MutexAutoLock lock(mMutex);
     mGMPThreadShutdown = true;
     mGMPThread.swap(gmpThread);
     mAbstractGMPThread = nullptr;
+    mShardThreads.SwapElements(shardThreads);
+    mAbstractShardThreads.Clear();
   }
 
+  for (nsCOMPtr<nsIThread>& thread : shardThreads) {
+    if (thread) {
+      thread->Shutdown();
+    }
+  }
   if (gmpThread) {
     gmpThread->Shutdown();
   }
@@ -307,13 +333,99 @@ GeckoMediaPluginService::GetAbstractGMPThread()
   return mAbstractGMPThread;
 }
 
+uint32_t
+GeckoMediaPluginService::ShardIndex(const nsACString& aNodeId) const
+{
+  if (mShardCount <= 1 || aNodeId.IsEmpty()) {
+    return 0;
+  }
+  return HashString(aNodeId.BeginReading(), aNodeId.Length()) % mShardCount;
+}
+
+nsresult
+GeckoMediaPluginService::GetShardThread(const nsACString& aNodeId,
+                                        nsIThread** aThread)
+{
+  MOZ_ASSERT(aThread);
+
+  uint32_t index = ShardIndex(aNodeId);
+  if (!index) {
+    return GetThread(aThread);
+  }
+
+  // This can be called from any thread.
+  MutexAutoLock lock(mMutex);
+
+  if (mGMPThreadShutdown) {
+    return NS_ERROR_FAILURE;
+  }
+
+  if (mShardThreads.IsEmpty()) {
+    mShardThreads.SetLength(mShardCount - 1);
+    mAbstractShardThreads.SetLength(mShardCount - 1);
+  }
+
+  nsCOMPtr<nsIThread>& thread = mShardThreads[index - 1];
+  if (!thread) {
+    nsresult rv = NS_NewThread(getter_AddRefs(thread));
+    if (NS_FAILED(rv)) {
+      return rv;
+    }
+    NS_SetThreadName(thread, nsPrintfCString("GMPThread #%u", index));
+    mAbstractShardThreads[index - 1] =
+      AbstractThread::CreateXPCOMThreadWrapper(thread, false);
+  }
+
+  nsCOMPtr<nsIThread> copy = thread;
+  copy.forget(aThread);
+
+  return NS_OK;
+}
+
+RefPtr<AbstractThread>
+GeckoMediaPluginService::GetAbstractShardThread(const nsACString& aNodeId)
+{
+  uint32_t index = ShardIndex(aNodeId);
+  if (!index) {
+    return GetAbstractGMPThread();
+  }
+
+  nsCOMPtr<nsIThread> thread;
+  if (NS_FAILED(GetShardThread(aNodeId, getter_AddRefs(thread)))) {
+    return nullptr;
+  }
+  MutexAutoLock lock(mMutex);
+  return index <= mAbstractShardThreads.Length()
+         ? mAbstractShardThreads[index - 1] : nullptr;
+}
+
+bool
+GeckoMediaPluginService::IsOnShardThread(const nsACString& aNodeId)
+{
+  uint32_t index = ShardIndex(aNodeId);
+  nsIThread* current = NS_GetCurrentThread();
+  MutexAutoLock lock(mMutex);
+  if (!index) {
+    return current == mGMPThread;
+  }
+  return index <= mShardThreads.Length() && current == mShardThreads[index - 1];
+}
+
+bool
+GeckoMediaPluginService::IsOnActorThread()
+{
+  nsIThread* current = NS_GetCurrentThread();
+  MutexAutoLock lock(mMutex);
+  return current == mGMPThread || mShardThreads.Contains(current);
+}
+
 NS_IMETHODIMP
 GeckoMediaPluginService::GetGMPAudioDecoder(GMPCrashHelper* aHelper,
                                             nsTArray<nsCString>* aTags,
                                             const nsACString& aNodeId,
                                             UniquePtr<GetGMPAudioDecoderCallback>&& aCallback)
 {
-  MOZ_ASSERT(NS_GetCurrentThread() == mGMPThread);
+  MOZ_ASSERT(IsOnShardThread(aNodeId));
   NS_ENSURE_ARG(aTags && aTags->Length() > 0);
   NS_ENSURE_ARG(aCallback);
 
@@ -322,7 +434,7 @@ GeckoMediaPluginService::GetGMPAudioDecoder(GMPCrashHelper* aHelper,
   }
 
   GetGMPAudioDecoderCallback* rawCallback = aCallback.release();
-  RefPtr<AbstractThread> thread(GetAbstractGMPThread());
+  RefPtr<AbstractThread> thread(GetAbstractShardThread(aNodeId));
   RefPtr<GMPCrashHelper> helper(aHelper);
   GetContentParent(aHelper, aNodeId, NS_LITERAL_CSTRING(GMP_API_AUDIO_DECODER), *aTags)
     ->Then(thread, __func__,
@@ -350,7 +462,7 @@ GeckoMediaPluginService::GetDecryptingGMPVideoDecoder(GMPCrashHelper* aHelper,
                                                       UniquePtr<GetGMPVideoDecoderCallback>&& aCallback,
                                                       uint32_t aDecryptorId)
 {
-  MOZ_ASSERT(NS_GetCurrentThread() == mGMPThread);
+  MOZ_ASSERT(IsOnShardThread(aNodeId));
   NS_ENSURE_ARG(aTags && aTags->Length() > 0);
   NS_ENSURE_ARG(aCallback);
 
@@ -359,7 +471,7 @@ GeckoMediaPluginService::GetDecryptingGMPVideoDecoder(GMPCrashHelper* aHelper,
   }
 
   GetGMPVideoDecoderCallback* rawCallback = aCallback.release();
-  RefPtr<AbstractThread> thread(GetAbstractGMPThread());
+  RefPtr<AbstractThread> thread(GetAbstractShardThread(aNodeId));
   RefPtr<GMPCrashHelper> helper(aHelper);
   GetContentParent(aHelper, aNodeId, NS_LITERAL_CSTRING(GMP_API_VIDEO_DECODER), *aTags)
     ->Then(thread, __func__,
@@ -388,7 +500,7 @@ GeckoMediaPluginService::GetGMPVideoEncoder(GMPCrashHelper* aHelper,
                                             const nsACString& aNodeId,
                                             UniquePtr<GetGMPVideoEncoderCallback>&& aCallback)
 {
-  MOZ_ASSERT(NS_GetCurrentThread() == mGMPThread);
+  MOZ_ASSERT(IsOnShardThread(aNodeId));
   NS_ENSURE_ARG(aTags && aTags->Length() > 0);
   NS_ENSURE_ARG(aCallback);
 
@@ -397,7 +509,7 @@ GeckoMediaPluginService::GetGMPVideoEncoder(GMPCrashHelper* aHelper,
   }
 
   GetGMPVideoEncoderCallback* rawCallback = aCallback.release();
-  RefPtr<AbstractThread> thread(GetAbstractGMPThread());
+  RefPtr<AbstractThread> thread(GetAbstractShardThread(aNodeId));
   RefPtr<GMPCrashHelper> helper(aHelper);
   GetContentParent(aHelper, aNodeId, NS_LITERAL_CSTRING(GMP_API_VIDEO_ENCODER), *aTags)
     ->Then(thread, __func__,
@@ -434,7 +546,7 @@ GeckoMediaPluginService::GetGMPDecryptor(GMPCrashHelper* aHelper,
   }
 #endif
 
-  MOZ_ASSERT(NS_GetCurrentThread() == mGMPThread);
+  MOZ_ASSERT(IsOnShardThread(aNodeId));
   NS_ENSURE_ARG(aTags && aTags->Length() > 0);
   NS_ENSURE_ARG(aCallback);
 
@@ -443,7 +555,7 @@ GeckoMediaPluginService::GetGMPDecryptor(GMPCrashHelper* aHelper,
   }
 
   GetGMPDecryptorCallback* rawCallback = aCallback.release();
-  RefPtr<AbstractThread> thread(GetAbstractGMPThread());
+  RefPtr<AbstractThread> thread(GetAbstractShardThread(aNodeId));
   RefPtr<GMPCrashHelper> helper(aHelper);
   GetContentParent(aHelper, aNodeId, NS_LITERAL_CSTRING(GMP_API_DECRYPTOR), *aTags)
     ->Then(thread, __func__,
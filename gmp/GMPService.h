@@ -10,6 +10,7 @@
 #include "mozIGeckoMediaPluginService.h"
 #include "nsIObserver.h"
 #include "nsTArray.h"
+#include "mozilla/Atomics.h"
 #include "mozilla/Attributes.h"
 #include "mozilla/Monitor.h"
 #include "nsString.h"
@@ -87,6 +88,18 @@ public:
 
   RefPtr<AbstractThread> GetAbstractGMPThread();
 
+  // GMP actors are sharded by node id across a small pool of threads, so
+  // that plugin instances for different origins don't serialise their IPC
+  // behind each other. A GMPContentParent, its actors and the proxies handed
+  // out for them must only be used on the shard thread of the node id they
+  // were requested with. Shard 0 is the GMP thread itself, and the empty
+  // node id always maps to it.
+  nsresult GetShardThread(const nsACString& aNodeId, nsIThread** aThread);
+  RefPtr<AbstractThread> GetAbstractShardThread(const nsACString& aNodeId);
+  bool IsOnShardThread(const nsACString& aNodeId);
+  // True on the GMP thread or any shard thread.
+  bool IsOnActorThread();
+
   void ConnectCrashHelper(uint32_t aPluginId, GMPCrashHelper* aHelper);
   void DisconnectCrashHelper(GMPCrashHelper* aHelper);
 
@@ -102,16 +115,26 @@ protected:
                    const nsCString& aAPI,
                    const nsTArray<nsCString>& aTags) = 0;
 
+  uint32_t ShardIndex(const nsACString& aNodeId) const;
+
   nsresult GMPDispatch(nsIRunnable* event, uint32_t flags = NS_DISPATCH_NORMAL);
   nsresult GMPDispatch(already_AddRefed<nsIRunnable> event, uint32_t flags = NS_DISPATCH_NORMAL);
   void ShutdownGMPThread();
 
-  Mutex mMutex; // Protects mGMPThread, mAbstractGMPThread, mPluginCrashHelpers,
+  Mutex mMutex; // Protects mGMPThread, mAbstractGMPThread, mShardThreads,
+                // mAbstractShardThreads, mPluginCrashHelpers,
                 // mGMPThreadShutdown and some members in derived classes.
   nsCOMPtr<nsIThread> mGMPThread;
   RefPtr<AbstractThread> mAbstractGMPThread;
+  // Shards 1..mShardCount-1, created on first use.
+  nsTArray<nsCOMPtr<nsIThread>> mShardThreads;
+  nsTArray<RefPtr<AbstractThread>> mAbstractShardThreads;
+  // Set once in Init(). Always 1 in the chrome process, where content
+  // parents hang off GMPParent and so are bound to the GMP thread.
+  uint32_t mShardCount;
   bool mGMPThreadShutdown;
-  bool mShuttingDownOnGMPThread;
+  // Written on the GMP thread, read on shard threads.
+  Atomic<bool> mShuttingDownOnGMPThread;
 
   nsClassHashtable<nsUint32HashKey, nsTArray<RefPtr<GMPCrashHelper>>> mPluginCrashHelpers;
 };
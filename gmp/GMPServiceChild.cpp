@@ -58,64 +58,90 @@ GeckoMediaPluginServiceChild::GetContentParent(GMPCrashHelper* aHelper,
                                                const nsCString& aAPI,
                                                const nsTArray<nsCString>& aTags)
 {
-  MOZ_ASSERT(NS_GetCurrentThread() == mGMPThread);
+  MOZ_ASSERT(IsOnShardThread(aNodeId));
+
+  RefPtr<AbstractThread> thread(GetAbstractGMPThread());
+  RefPtr<AbstractThread> shardThread(GetAbstractShardThread(aNodeId));
+  if (!thread || !shardThread) {
+    return GetGMPContentParentPromise::CreateAndReject(NS_ERROR_FAILURE, __func__);
+  }
 
   MozPromiseHolder<GetGMPContentParentPromise>* rawHolder = new MozPromiseHolder<GetGMPContentParentPromise>();
   RefPtr<GetGMPContentParentPromise> promise = rawHolder->Ensure(__func__);
-  RefPtr<AbstractThread> thread(GetAbstractGMPThread());
 
+  nsCOMPtr<nsIThread> shard(NS_GetCurrentThread());
   nsCString nodeId(aNodeId);
   nsCString api(aAPI);
   nsTArray<nsCString> tags(aTags);
   RefPtr<GMPCrashHelper> helper(aHelper);
   RefPtr<GeckoMediaPluginServiceChild> self(this);
-  GetServiceChild()->Then(thread, __func__,
-    [self, nodeId, api, tags, helper, rawHolder](GMPServiceChild* child) {
-      UniquePtr<MozPromiseHolder<GetGMPContentParentPromise>> holder(rawHolder);
-      nsresult rv;
-
-      nsTArray<base::ProcessId> alreadyBridgedTo;
-      child->GetAlreadyBridgedTo(alreadyBridgedTo);
-
-      base::ProcessId otherProcess;
-      nsCString displayName;
-      uint32_t pluginId = 0;
-      bool ok = child->SendLaunchGMP(nodeId,
-                                     api,
-                                     tags,
-                                     alreadyBridgedTo,
-                                     &pluginId,
-                                     &otherProcess,
-                                     &displayName,
-                                     &rv);
-      if (helper && pluginId) {
-        // Note: Even if the launch failed, we need to connect the crash
-        // helper so that if the launch failed due to the plugin crashing,
-        // we can report the crash via the crash reporter. The crash
-        // handling notification will arrive shortly if the launch failed
-        // due to the plugin crashing.
-        self->ConnectCrashHelper(pluginId, helper);
-      }
-
-      if (!ok || NS_FAILED(rv)) {
-        LOGD(("GeckoMediaPluginServiceChild::GetContentParent SendLaunchGMP failed rv=%d", rv));
+  // The service child lives on the GMP thread, so the plugin is launched from
+  // there; the content parent is then handed back on the shard thread it is
+  // bound to.
+  thread->Dispatch(NS_NewRunnableFunction([=]() {
+    self->GetServiceChild()->Then(thread, __func__,
+      [self, shard, shardThread, nodeId, api, tags, helper, rawHolder](GMPServiceChild* child) {
+        nsresult rv;
+
+        nsTArray<base::ProcessId> alreadyBridgedTo;
+        child->GetAlreadyBridgedTo(alreadyBridgedTo);
+
+        base::ProcessId otherProcess;
+        nsCString displayName;
+        uint32_t pluginId = 0;
+        child->SetLaunchShardThread(shard);
+        bool ok = child->SendLaunchGMP(nodeId,
+                                       api,
+                                       tags,
+                                       alreadyBridgedTo,
+                                       &pluginId,
+                                       &otherProcess,
+                                       &displayName,
+                                       &rv);
+        child->SetLaunchShardThread(nullptr);
+        if (helper && pluginId) {
+          // Note: Even if the launch failed, we need to connect the crash
+          // helper so that if the launch failed due to the plugin crashing,
+          // we can report the crash via the crash reporter. The crash
+          // handling notification will arrive shortly if the launch failed
+          // due to the plugin crashing.
+          self->ConnectCrashHelper(pluginId, helper);
+        }
+
+        if (!ok || NS_FAILED(rv)) {
+          LOGD(("GeckoMediaPluginServiceChild::GetContentParent SendLaunchGMP failed rv=%d", rv));
+          UniquePtr<MozPromiseHolder<GetGMPContentParentPromise>> holder(rawHolder);
+          holder->Reject(rv, __func__);
+          return;
+        }
+
+        RefPtr<GMPContentParent> parent;
+        child->GetBridgedGMPContentParent(otherProcess, getter_AddRefs(parent));
+        if (!alreadyBridgedTo.Contains(otherProcess)) {
+          parent->SetDisplayName(displayName);
+          parent->SetPluginId(pluginId);
+        }
+        shardThread->Dispatch(NS_NewRunnableFunction(
+          [self, parent, nodeId, api, tags, helper, shardThread, rawHolder]() {
+            UniquePtr<MozPromiseHolder<GetGMPContentParentPromise>> holder(rawHolder);
+            MOZ_ASSERT(parent->GMPThread() == NS_GetCurrentThread());
+            if (parent->IsClosing()) {
+              // We raced with the last user of this content parent closing
+              // it. It has been unregistered by now, so asking again bridges
+              // a new one.
+              self->GetContentParent(helper, nodeId, api, tags)
+                ->ChainTo(holder->Steal(), __func__);
+              return;
+            }
+            RefPtr<GMPContentParent::CloseBlocker> blocker(new GMPContentParent::CloseBlocker(parent));
+            holder->Resolve(blocker, __func__);
+          }));
+      },
+      [rawHolder](nsresult rv) {
+        UniquePtr<MozPromiseHolder<GetGMPContentParentPromise>> holder(rawHolder);
         holder->Reject(rv, __func__);
-        return;
-      }
-
-      RefPtr<GMPContentParent> parent;
-      child->GetBridgedGMPContentParent(otherProcess, getter_AddRefs(parent));
-      if (!alreadyBridgedTo.Contains(otherProcess)) {
-        parent->SetDisplayName(displayName);
-        parent->SetPluginId(pluginId);
-      }
-      RefPtr<GMPContentParent::CloseBlocker> blocker(new GMPContentParent::CloseBlocker(parent));
-      holder->Resolve(blocker, __func__);
-    },
-    [rawHolder](nsresult rv) {
-      UniquePtr<MozPromiseHolder<GetGMPContentParentPromise>> holder(rawHolder);
-      holder->Reject(rv, __func__);
-    });
+      });
+  }));
 
   return promise;
 }
@@ -324,7 +350,16 @@ GeckoMediaPluginServiceChild::SetServiceChild(UniquePtr<GMPServiceChild>&& aServ
 void
 GeckoMediaPluginServiceChild::RemoveGMPContentParent(GMPContentParent* aGMPContentParent)
 {
-  MOZ_ASSERT(NS_GetCurrentThread() == mGMPThread);
+  if (NS_GetCurrentThread() != mGMPThread) {
+    // Content parents on other shards are unregistered on the GMP thread,
+    // which owns the service child.
+    RefPtr<GeckoMediaPluginServiceChild> self(this);
+    RefPtr<GMPContentParent> parent(aGMPContentParent);
+    GMPDispatch(NS_NewRunnableFunction([self, parent]() {
+      self->RemoveGMPContentParent(parent);
+    }));
+    return;
+  }
 
   if (mServiceChild) {
     mServiceChild->RemoveGMPContentParent(aGMPContentParent);
@@ -350,10 +385,23 @@ GMPServiceChild::AllocPGMPContentParent(Transport* aTransport,
 
   RefPtr<GMPContentParent> parent = new GMPContentParent();
 
-  DebugOnly<bool> ok = parent->Open(aTransport, aOtherPid,
-                                    XRE_GetIOMessageLoop(),
-                                    mozilla::ipc::ParentSide);
-  MOZ_ASSERT(ok);
+  nsCOMPtr<nsIThread> shard = mLaunchShardThread;
+  if (shard && shard != NS_GetCurrentThread()) {
+    // Bind the channel to the shard thread; whoever asked for this content
+    // parent will only use it once this has run.
+    parent->SetGMPThread(shard);
+    shard->Dispatch(NS_NewRunnableFunction([parent, aTransport, aOtherPid]() {
+      DebugOnly<bool> ok = parent->Open(aTransport, aOtherPid,
+                                        XRE_GetIOMessageLoop(),
+                                        mozilla::ipc::ParentSide);
+      MOZ_ASSERT(ok);
+    }), NS_DISPATCH_NORMAL);
+  } else {
+    DebugOnly<bool> ok = parent->Open(aTransport, aOtherPid,
+                                      XRE_GetIOMessageLoop(),
+                                      mozilla::ipc::ParentSide);
+    MOZ_ASSERT(ok);
+  }
 
   mContentParents.Put(aOtherPid, parent);
   return parent;
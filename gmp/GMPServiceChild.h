@@ -79,10 +79,18 @@ public:
 
   void GetAlreadyBridgedTo(nsTArray<ProcessId>& aAlreadyBridgedTo);
 
+  // The shard thread that a content parent bridged by the next LaunchGMP
+  // should be bound to.
+  void SetLaunchShardThread(nsIThread* aThread)
+  {
+    mLaunchShardThread = aThread;
+  }
+
   static PGMPServiceChild* Create(Transport* aTransport, ProcessId aOtherPid);
 
 private:
   nsRefPtrHashtable<nsUint64HashKey, GMPContentParent> mContentParents;
+  nsCOMPtr<nsIThread> mLaunchShardThread;
 };
 
 } // namespace gmp
@@ -17,6 +17,9 @@
 #include "mozilla/Preferences.h"
 #include "mozilla/ClearOnShutdown.h"
 #include "mozilla/SyncRunnable.h"
+#include "mozilla/IntegerPrintfMacros.h"
+#include "mozilla/Move.h"
+#include "mozilla/SharedThreadPool.h"
 #include "nsXPCOMPrivate.h"
 #include "mozilla/Services.h"
 #include "nsNativeCharsetUtils.h"
@@ -42,6 +45,7 @@
 #endif
 #include "nsIXULRuntime.h"
 #include "GMPDecoderModule.h"
+#include <algorithm>
 #include <limits>
 #include "MediaPrefs.h"
 
@@ -65,6 +69,9 @@ namespace gmp {
 
 static const uint32_t NodeIdSaltLength = 32;
 
+// http://en.wikipedia.org/wiki/Domain_Name_System#Domain_name_syntax
+static const uint32_t MaxDomainLength = 253;
+
 already_AddRefed<GeckoMediaPluginServiceParent>
 GeckoMediaPluginServiceParent::GetSingleton()
 {
@@ -397,8 +404,10 @@ GeckoMediaPluginServiceParent::Observe(nsISupports* aSubject,
     // event to run its loop. This will unblock the main thread, and shutdown
     // of other components will proceed.
     //
-    // During shutdown, each GMPParent starts a timer, and pretends shutdown
-    // is complete if it is taking too long.
+    // During shutdown, UnloadPlugins() arms a single timer covering all
+    // plugins, so they all shut down in parallel against the same deadline.
+    // Plugins still shutting down when it fires are killed, without holding
+    // up the ones that have already finished.
     //
     // We shutdown in "profile-change-teardown", as the profile dir is
     // still writable then, and it's required for GMPStorage. We block the
@@ -615,12 +624,23 @@ GeckoMediaPluginServiceParent::AsyncShutdownComplete(GMPParent* aParent)
         aParent, aParent->GetDisplayName().get()));
   MOZ_ASSERT(NS_GetCurrentThread() == mGMPThread);
 
+  bool removed;
+  bool allComplete;
   {
     MutexAutoLock lock(mMutex);
-    mAsyncShutdownPlugins.RemoveElement(aParent);
+    removed = mAsyncShutdownPlugins.RemoveElement(aParent);
+    allComplete = mAsyncShutdownPlugins.IsEmpty();
   }
 
   if (mShuttingDownOnGMPThread) {
+    if (removed) {
+      RecordPluginShutdownTime(aParent, false);
+    }
+    if (allComplete && mAsyncShutdownDeadline) {
+      mAsyncShutdownDeadline->Cancel();
+      mAsyncShutdownDeadline = nullptr;
+    }
+
     // The main thread may be waiting for async shutdown of plugins,
     // one of which has completed. Wake up the main thread by sending a task.
     nsCOMPtr<nsIRunnable> task(NewRunnableMethod(
@@ -741,6 +761,15 @@ GeckoMediaPluginServiceParent::UnloadPlugins()
           plugin->GetDisplayName().get()));
   }
 #endif
+  // Arm a single deadline for all plugins before asking any of them to close,
+  // so that they all shut down in parallel against the same budget, instead
+  // of each plugin starting its own timeout.
+  mUnloadPluginsStartTime = TimeStamp::Now();
+  if (NS_FAILED(ArmAsyncShutdownDeadline())) {
+    NS_WARNING("Failed to arm GMP async shutdown deadline, "
+               "falling back to per-plugin timeouts");
+  }
+
   // Note: CloseActive may be async; it could actually finish
   // shutting down when all the plugins have unloaded.
   for (const auto& plugin : plugins) {
@@ -751,6 +780,30 @@ GeckoMediaPluginServiceParent::UnloadPlugins()
     plugin->CloseActive(true);
   }
 
+  LOGD(("%s::%s sent close to %u plugins in %.1fms", __CLASS__, __FUNCTION__,
+        plugins.Length(),
+        (TimeStamp::Now() - mUnloadPluginsStartTime).ToMilliseconds()));
+
+  // Record that the indexes are up to date, so that the next session can
+  // trust them.
+  for (auto iter = mOriginIndexes.Iter(); !iter.Done(); iter.Next()) {
+    iter.UserData()->Close();
+  }
+  if (mStorageClearTaskQueue) {
+    // Deletions already queued still complete.
+    mStorageClearTaskQueue->BeginShutdown();
+    mStorageClearTaskQueue = nullptr;
+  }
+
+  {
+    MutexAutoLock lock(mMutex);
+    if (mAsyncShutdownPlugins.IsEmpty() && mAsyncShutdownDeadline) {
+      // Nobody is doing async shutdown, no need for the deadline.
+      mAsyncShutdownDeadline->Cancel();
+      mAsyncShutdownDeadline = nullptr;
+    }
+  }
+
 #ifdef MOZ_CRASHREPORTER
       SetAsyncShutdownPluginState(nullptr, '3',
         NS_LITERAL_CSTRING("Dispatching sync-shutdown-complete"));
@@ -760,6 +813,89 @@ GeckoMediaPluginServiceParent::UnloadPlugins()
   NS_DispatchToMainThread(task);
 }
 
+nsresult
+GeckoMediaPluginServiceParent::ArmAsyncShutdownDeadline()
+{
+  MOZ_ASSERT(NS_GetCurrentThread() == mGMPThread);
+  MOZ_ASSERT(!mAsyncShutdownDeadline);
+
+  nsresult rv;
+  nsCOMPtr<nsITimer> timer = do_CreateInstance(NS_TIMER_CONTRACTID, &rv);
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+  rv = timer->SetTarget(mGMPThread);
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+  rv = timer->InitWithFuncCallback(&AsyncShutdownDeadlineReached, this,
+                                   AsyncShutdownTimeoutMs(),
+                                   nsITimer::TYPE_ONE_SHOT);
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return rv;
+  }
+  mAsyncShutdownDeadline = timer.forget();
+  return NS_OK;
+}
+
+bool
+GeckoMediaPluginServiceParent::IsAsyncShutdownDeadlineArmed() const
+{
+  MOZ_ASSERT(NS_GetCurrentThread() == mGMPThread);
+  return !!mAsyncShutdownDeadline;
+}
+
+// static
+void
+GeckoMediaPluginServiceParent::AsyncShutdownDeadlineReached(nsITimer* aTimer,
+                                                            void* aClosure)
+{
+  NS_WARNING("Timed out waiting for GMP async shutdown!");
+  RefPtr<GeckoMediaPluginServiceParent> self =
+    static_cast<GeckoMediaPluginServiceParent*>(aClosure);
+  MOZ_ASSERT(NS_GetCurrentThread() == self->mGMPThread);
+  self->mAsyncShutdownDeadline = nullptr;
+
+  nsTArray<RefPtr<GMPParent>> stragglers;
+  {
+    MutexAutoLock lock(self->mMutex);
+    Swap(stragglers, self->mAsyncShutdownPlugins);
+  }
+
+  LOGD(("%s::%s killing %u plugins still shutting down", __CLASS__,
+        __FUNCTION__, stragglers.Length()));
+  for (const auto& plugin : stragglers) {
+#ifdef MOZ_CRASHREPORTER
+    self->SetAsyncShutdownPluginState(plugin, 'T',
+      NS_LITERAL_CSTRING("Killed at async shutdown deadline"));
+#endif
+    self->RecordPluginShutdownTime(plugin, true);
+    // This also notifies AsyncShutdownComplete(), which wakes up the main
+    // thread waiting in Observe().
+    plugin->KillAfterShutdownDeadline();
+  }
+
+  nsCOMPtr<nsIRunnable> task(NewRunnableMethod(
+    self, &GeckoMediaPluginServiceParent::NotifyAsyncShutdownComplete));
+  NS_DispatchToMainThread(task);
+}
+
+void
+GeckoMediaPluginServiceParent::RecordPluginShutdownTime(GMPParent* aParent,
+                                                        bool aTimedOut)
+{
+  MOZ_ASSERT(NS_GetCurrentThread() == mGMPThread);
+  MOZ_ASSERT(!mUnloadPluginsStartTime.IsNull());
+  double ms = (TimeStamp::Now() - mUnloadPluginsStartTime).ToMilliseconds();
+  LOGD(("%s::%s plugin '%s' %p %s after %.1fms", __CLASS__, __FUNCTION__,
+        aParent->GetDisplayName().get(), aParent,
+        aTimedOut ? "killed" : "shut down", ms));
+#ifdef MOZ_CRASHREPORTER
+  SetAsyncShutdownPluginState(aParent, aTimedOut ? 'X' : 'Y',
+    nsPrintfCString("%s after %.0fms", aTimedOut ? "Killed" : "Shut down", ms));
+#endif
+}
+
 void
 GeckoMediaPluginServiceParent::CrashPlugins()
 {
@@ -1370,6 +1506,139 @@ GeckoMediaPluginServiceParent::GetMemoryStorageFor(const nsACString& aNodeId)
   return s.forget();
 }
 
+// Latest modification time of aPath and of the files under it.
+static PRTime
+GetMaxModifiedTime(nsIFile* aPath)
+{
+  PRTime result = 0;
+  PRTime lastModified;
+  if (NS_SUCCEEDED(aPath->GetLastModifiedTime(&lastModified))) {
+    result = lastModified;
+  }
+  DirectoryEnumerator iter(aPath, DirectoryEnumerator::FilesAndDirs);
+  for (nsCOMPtr<nsIFile> dirEntry; (dirEntry = iter.Next()) != nullptr;) {
+    result = std::max(result, GetMaxModifiedTime(dirEntry));
+  }
+  return result;
+}
+
+static uint64_t
+GetRecordsSize(nsIFile* aStorageDir)
+{
+  uint64_t size = 0;
+  DirectoryEnumerator iter(aStorageDir, DirectoryEnumerator::FilesAndDirs);
+  for (nsCOMPtr<nsIFile> dirEntry; (dirEntry = iter.Next()) != nullptr;) {
+    int64_t fileSize = 0;
+    if (NS_SUCCEEDED(dirEntry->GetFileSize(&fileSize)) && fileSize > 0) {
+      size += uint64_t(fileSize);
+    }
+  }
+  return size;
+}
+
+// Builds the index of a plugin's node ids from its storage on disk, for when
+// there is no index which can be trusted.
+static void
+ScanOriginEntries(nsIFile* aPluginStorageDir,
+                  nsTArray<GMPOriginIndex::Entry>& aOutEntries)
+{
+  // $profileDir/gmp/$platform/$gmpName/id/
+  nsCOMPtr<nsIFile> idDir = CloneAndAppend(aPluginStorageDir, NS_LITERAL_STRING("id"));
+  // $profileDir/gmp/$platform/$gmpName/storage/
+  nsCOMPtr<nsIFile> storageDir = CloneAndAppend(aPluginStorageDir, NS_LITERAL_STRING("storage"));
+  if (!idDir || !storageDir) {
+    return;
+  }
+
+  DirectoryEnumerator iter(idDir, DirectoryEnumerator::DirsOnly);
+  for (nsCOMPtr<nsIFile> dirEntry; (dirEntry = iter.Next()) != nullptr;) {
+    // dirEntry is the hash of origins, i.e.:
+    // $profileDir/gmp/$platform/$gmpName/id/$originHash/
+    GMPOriginIndex::Entry entry;
+    if (NS_FAILED(ReadSalt(dirEntry, entry.mNodeId)) ||
+        entry.mNodeId.Length() != NodeIdSaltLength ||
+        NS_FAILED(dirEntry->GetNativeLeafName(entry.mOriginHash))) {
+      // Without salt there can be no storage; GetNodeId() would generate new
+      // salt for the origin pair anyway.
+      if (NS_FAILED(dirEntry->Remove(true))) {
+        NS_WARNING("Failed to delete the directory for the origin pair");
+      }
+      continue;
+    }
+    if (NS_FAILED(ReadFromFile(dirEntry, NS_LITERAL_CSTRING("origin"),
+                               entry.mOrigin, MaxDomainLength))) {
+      entry.mOrigin.Truncate();
+    }
+    if (NS_FAILED(ReadFromFile(dirEntry, NS_LITERAL_CSTRING("topLevelOrigin"),
+                               entry.mTopLevelOrigin, MaxDomainLength))) {
+      entry.mTopLevelOrigin.Truncate();
+    }
+    // The index is line and tab separated; neither appear in real origins.
+    entry.mOrigin.StripChars("\t\r\n");
+    entry.mTopLevelOrigin.StripChars("\t\r\n");
+    entry.mLastModified = GetMaxModifiedTime(dirEntry);
+
+    // $profileDir/gmp/$platform/$gmpName/storage/$nodeId/
+    nsCOMPtr<nsIFile> nodeStorageDir;
+    if (NS_SUCCEEDED(storageDir->Clone(getter_AddRefs(nodeStorageDir))) &&
+        NS_SUCCEEDED(nodeStorageDir->AppendNative(entry.mNodeId))) {
+      entry.mLastModified = std::max(entry.mLastModified,
+                                     GetMaxModifiedTime(nodeStorageDir));
+      entry.mStorageSize = GetRecordsSize(nodeStorageDir);
+    }
+    aOutEntries.AppendElement(Move(entry));
+  }
+}
+
+already_AddRefed<GMPOriginIndex>
+GeckoMediaPluginServiceParent::GetOriginIndex(const nsAString& aGMPName)
+{
+  MOZ_ASSERT(NS_GetCurrentThread() == mGMPThread);
+
+  RefPtr<GMPOriginIndex> index;
+  if (mOriginIndexes.Get(aGMPName, getter_AddRefs(index))) {
+    return index.forget();
+  }
+
+  nsCOMPtr<nsIFile> path; // $profileDir/gmp/$platform/
+  nsresult rv = GetStorageDir(getter_AddRefs(path));
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return nullptr;
+  }
+  // $profileDir/gmp/$platform/$gmpName/
+  rv = path->Append(aGMPName);
+  if (NS_WARN_IF(NS_FAILED(rv))) {
+    return nullptr;
+  }
+
+  index = new GMPOriginIndex(path);
+  if (!index->Load()) {
+    // Missing, e.g. written by an older version, or not shut down cleanly:
+    // pay for walking the plugin's storage once.
+    TimeStamp start = TimeStamp::Now();
+    nsTArray<GMPOriginIndex::Entry> entries;
+    ScanOriginEntries(path, entries);
+    LOGD(("%s::%s: rebuilt index of %u node ids for %s in %.1fms",
+          __CLASS__, __FUNCTION__, entries.Length(),
+          NS_ConvertUTF16toUTF8(aGMPName).get(),
+          (TimeStamp::Now() - start).ToMilliseconds()));
+    index->Reset(Move(entries));
+  }
+
+  // Whatever is left in the trash was still being deleted when the last
+  // session ended.
+  nsCOMPtr<nsIFile> trash = CloneAndAppend(path, NS_LITERAL_STRING("trash"));
+  if (trash) {
+    DirectoryEnumerator iter(trash, DirectoryEnumerator::DirsOnly);
+    for (nsCOMPtr<nsIFile> dirEntry; (dirEntry = iter.Next()) != nullptr;) {
+      DeleteInBackground(dirEntry);
+    }
+  }
+
+  mOriginIndexes.Put(aGMPName, index);
+  return index.forget();
+}
+
 NS_IMETHODIMP
 GeckoMediaPluginServiceParent::IsPersistentStorageAllowed(const nsACString& aNodeId,
                                                           bool* aOutAllowed)
@@ -1484,6 +1753,8 @@ GeckoMediaPluginServiceParent::GetNodeId(const nsAString& aOrigin,
     return rv;
   }
 
+  RefPtr<GMPOriginIndex> index = GetOriginIndex(aGMPName);
+
   nsCOMPtr<nsIFile> saltFile;
   rv = path->Clone(getter_AddRefs(saltFile));
   if (NS_WARN_IF(NS_FAILED(rv))) {
@@ -1539,6 +1810,13 @@ GeckoMediaPluginServiceParent::GetNodeId(const nsAString& aOrigin,
     }
   }
 
+  if (index && (!exists || !index->Contains(salt))) {
+    index->AddNodeId(salt, hashStr,
+                     NS_ConvertUTF16toUTF8(aOrigin),
+                     NS_ConvertUTF16toUTF8(aTopLevelOrigin),
+                     GetMaxModifiedTime(path));
+  }
+
   aOutId = salt;
   mPersistentStorageAllowed.Put(salt, true);
 
@@ -1579,42 +1857,50 @@ ExtractHostName(const nsACString& aOrigin, nsACString& aOutData)
   return true;
 }
 
-bool
-MatchOrigin(nsIFile* aPath,
-            const nsACString& aSite,
-            const mozilla::OriginAttributesPattern& aPattern)
+// Returns true if aOrigin is on aSite and its attributes match aPattern.
+static bool
+MatchSite(const nsACString& aOrigin,
+          const nsACString& aSite,
+          const mozilla::OriginAttributesPattern& aPattern)
 {
-  // http://en.wikipedia.org/wiki/Domain_Name_System#Domain_name_syntax
-  static const uint32_t MaxDomainLength = 253;
-
-  nsresult rv;
-  nsCString str;
+  nsCString host;
   nsCString originNoSuffix;
   mozilla::PrincipalOriginAttributes originAttributes;
-
-  rv = ReadFromFile(aPath, NS_LITERAL_CSTRING("origin"), str, MaxDomainLength);
-  if (!originAttributes.PopulateFromOrigin(str, originNoSuffix)) {
+  if (!originAttributes.PopulateFromOrigin(aOrigin, originNoSuffix)) {
     // Fails on parsing the originAttributes, treat this as a non-match.
     return false;
   }
+  return ExtractHostName(originNoSuffix, host) && host.Equals(aSite) &&
+         aPattern.Matches(originAttributes);
+}
 
-  if (NS_SUCCEEDED(rv) && ExtractHostName(originNoSuffix, str) && str.Equals(aSite) &&
-      aPattern.Matches(originAttributes)) {
-    return true;
-  }
+static bool
+MatchOrigin(const nsACString& aOrigin,
+            const nsACString& aTopLevelOrigin,
+            const nsACString& aSite,
+            const mozilla::OriginAttributesPattern& aPattern)
+{
+  return MatchSite(aOrigin, aSite, aPattern) ||
+         MatchSite(aTopLevelOrigin, aSite, aPattern);
+}
 
-  mozilla::PrincipalOriginAttributes topLevelOriginAttributes;
-  rv = ReadFromFile(aPath, NS_LITERAL_CSTRING("topLevelOrigin"), str, MaxDomainLength);
-  if (!topLevelOriginAttributes.PopulateFromOrigin(str, originNoSuffix)) {
-    // Fails on paring the originAttributes, treat this as a non-match.
-    return false;
+bool
+MatchOrigin(nsIFile* aPath,
+            const nsACString& aSite,
+            const mozilla::OriginAttributesPattern& aPattern)
+{
+  // Origins which can't be read are left empty, and don't match.
+  nsCString origin;
+  if (NS_FAILED(ReadFromFile(aPath, NS_LITERAL_CSTRING("origin"),
+                             origin, MaxDomainLength))) {
+    origin.Truncate();
   }
-
-  if (NS_SUCCEEDED(rv) && ExtractHostName(originNoSuffix, str) && str.Equals(aSite) &&
-      aPattern.Matches(topLevelOriginAttributes)) {
-    return true;
+  nsCString topLevelOrigin;
+  if (NS_FAILED(ReadFromFile(aPath, NS_LITERAL_CSTRING("topLevelOrigin"),
+                             topLevelOrigin, MaxDomainLength))) {
+    topLevelOrigin.Truncate();
   }
-  return false;
+  return MatchOrigin(origin, topLevelOrigin, aSite, aPattern);
 }
 
 template<typename T> static void
@@ -1670,7 +1956,59 @@ private:
 };
 
 void
-GeckoMediaPluginServiceParent::ClearNodeIdAndPlugin(DirectoryFilter& aFilter)
+GeckoMediaPluginServiceParent::DeleteInBackground(nsIFile* aPath)
+{
+  MOZ_ASSERT(NS_GetCurrentThread() == mGMPThread);
+
+  if (mShuttingDownOnGMPThread) {
+    if (NS_FAILED(DeleteDir(aPath))) {
+      NS_WARNING("Failed to delete GMP storage directory");
+    }
+    return;
+  }
+  if (!mStorageClearTaskQueue) {
+    mStorageClearTaskQueue = new TaskQueue(
+      SharedThreadPool::Get(NS_LITERAL_CSTRING("GMPStorage"), 1));
+  }
+  nsCOMPtr<nsIFile> path = aPath;
+  mStorageClearTaskQueue->Dispatch(NS_NewRunnableFunction([path]() {
+    if (NS_FAILED(DeleteDir(path))) {
+      NS_WARNING("Failed to delete GMP storage directory");
+    }
+  }));
+}
+
+// Moves $gmpName/aSubDir/aName into aTrash, or deletes it in place if it
+// can't be moved.
+static void
+MoveToTrash(nsIFile* aPluginStorageDir,
+            const nsACString& aSubDir,
+            const nsACString& aName,
+            nsIFile* aTrash)
+{
+  nsCOMPtr<nsIFile> path;
+  if (NS_FAILED(aPluginStorageDir->Clone(getter_AddRefs(path))) ||
+      NS_FAILED(path->AppendNative(aSubDir)) ||
+      NS_FAILED(path->AppendNative(aName))) {
+    return;
+  }
+  bool exists = false;
+  if (NS_FAILED(path->Exists(&exists)) || !exists) {
+    return;
+  }
+  // Origin hashes and node ids can't clash once prefixed.
+  nsAutoCString trashName(aSubDir);
+  trashName.Append('-');
+  trashName.Append(aName);
+  if (!aTrash || NS_FAILED(path->MoveToNative(aTrash, trashName))) {
+    if (NS_FAILED(path->Remove(true))) {
+      NS_WARNING("Failed to delete GMP storage directory");
+    }
+  }
+}
+
+void
+GeckoMediaPluginServiceParent::ClearNodeIdAndPlugin(GMPOriginIndex::EntryFilter& aFilter)
 {
   // $profileDir/gmp/$platform/
   nsCOMPtr<nsIFile> path;
@@ -1689,60 +2027,64 @@ GeckoMediaPluginServiceParent::ClearNodeIdAndPlugin(DirectoryFilter& aFilter)
 
 void
 GeckoMediaPluginServiceParent::ClearNodeIdAndPlugin(nsIFile* aPluginStorageDir,
-                                                    DirectoryFilter& aFilter)
+                                                    GMPOriginIndex::EntryFilter& aFilter)
 {
-  // $profileDir/gmp/$platform/$gmpName/id/
-  nsCOMPtr<nsIFile> path = CloneAndAppend(aPluginStorageDir, NS_LITERAL_STRING("id"));
-  if (!path) {
+  nsAutoString gmpName;
+  if (NS_FAILED(aPluginStorageDir->GetLeafName(gmpName))) {
+    return;
+  }
+  RefPtr<GMPOriginIndex> index = GetOriginIndex(gmpName);
+  if (!index) {
     return;
   }
 
-  // Iterate all sub-folders of $profileDir/gmp/$platform/$gmpName/id/
-  nsTArray<nsCString> nodeIDsToClear;
-  DirectoryEnumerator iter(path, DirectoryEnumerator::DirsOnly);
-  for (nsCOMPtr<nsIFile> dirEntry; (dirEntry = iter.Next()) != nullptr;) {
-    // dirEntry is the hash of origins, i.e.:
-    // $profileDir/gmp/$platform/$gmpName/id/$originHash/
-    if (!aFilter(dirEntry)) {
-      continue;
-    }
-    nsAutoCString salt;
-    if (NS_SUCCEEDED(ReadSalt(dirEntry, salt))) {
-      // Keep node IDs to clear data/plugins associated with them later.
-      nodeIDsToClear.AppendElement(salt);
-      // Also remove node IDs from the table.
-      mPersistentStorageAllowed.Remove(salt);
-    }
-    // Now we can remove the directory for the origin pair.
-    if (NS_FAILED(dirEntry->Remove(true))) {
-      NS_WARNING("Failed to delete the directory for the origin pair");
-    }
+  // Only the index is searched, not the files of every origin pair.
+  nsTArray<GMPOriginIndex::Entry> entries;
+  index->TakeEntries(aFilter, entries);
+  if (entries.IsEmpty()) {
+    return;
   }
 
+  nsTArray<nsCString> nodeIDsToClear;
+  uint64_t storageSize = 0;
+  for (const GMPOriginIndex::Entry& entry : entries) {
+    // Keep node IDs to clear data/plugins associated with them later.
+    nodeIDsToClear.AppendElement(entry.mNodeId);
+    // Also remove node IDs from the table.
+    mPersistentStorageAllowed.Remove(entry.mNodeId);
+    storageSize += entry.mStorageSize;
+  }
+  LOGD(("%s::%s: clearing %u node ids of %s, %" PRIu64 " bytes of storage",
+        __CLASS__, __FUNCTION__, nodeIDsToClear.Length(),
+        NS_ConvertUTF16toUTF8(gmpName).get(), storageSize));
+
   // Kill plugin instances that have node IDs being cleared.
   KillPlugins(mPlugins, mMutex, NodeFilter(nodeIDsToClear));
 
-  // Clear all storage in $profileDir/gmp/$platform/$gmpName/storage/$nodeId/
-  path = CloneAndAppend(aPluginStorageDir, NS_LITERAL_STRING("storage"));
-  if (!path) {
-    return;
+  // Move the directories of the origin pairs and of their storage out of
+  // the way, a rename each, so that GetNodeId() and storage opened from now
+  // on don't see them. Deleting their files is left to a background task.
+  // $profileDir/gmp/$platform/$gmpName/trash/$random/
+  nsCOMPtr<nsIFile> trash = CloneAndAppend(aPluginStorageDir, NS_LITERAL_STRING("trash"));
+  nsAutoCString trashName;
+  if (!trash ||
+      NS_FAILED(GenerateRandomPathName(trashName, NodeIdSaltLength)) ||
+      NS_FAILED(trash->AppendNative(trashName)) ||
+      NS_FAILED(trash->Create(nsIFile::DIRECTORY_TYPE, 0700))) {
+    trash = nullptr;
   }
 
-  for (const nsCString& nodeId : nodeIDsToClear) {
-    nsCOMPtr<nsIFile> dirEntry;
-    nsresult rv = path->Clone(getter_AddRefs(dirEntry));
-    if (NS_FAILED(rv)) {
-      continue;
-    }
-
-    rv = dirEntry->AppendNative(nodeId);
-    if (NS_FAILED(rv)) {
-      continue;
-    }
+  for (const GMPOriginIndex::Entry& entry : entries) {
+    // $profileDir/gmp/$platform/$gmpName/id/$originHash/
+    MoveToTrash(aPluginStorageDir, NS_LITERAL_CSTRING("id"),
+                entry.mOriginHash, trash);
+    // $profileDir/gmp/$platform/$gmpName/storage/$nodeId/
+    MoveToTrash(aPluginStorageDir, NS_LITERAL_CSTRING("storage"),
+                entry.mNodeId, trash);
+  }
 
-    if (NS_FAILED(DeleteDir(dirEntry))) {
-      NS_WARNING("Failed to delete GMP storage directory for the node");
-    }
+  if (trash) {
+    DeleteInBackground(trash);
   }
 }
 
@@ -1753,14 +2095,15 @@ GeckoMediaPluginServiceParent::ForgetThisSiteOnGMPThread(const nsACString& aSite
   MOZ_ASSERT(NS_GetCurrentThread() == mGMPThread);
   LOGD(("%s::%s: origin=%s", __CLASS__, __FUNCTION__, aSite.Data()));
 
-  struct OriginFilter : public DirectoryFilter {
+  struct OriginFilter : public GMPOriginIndex::EntryFilter {
     explicit OriginFilter(const nsACString& aSite,
                           const mozilla::OriginAttributesPattern& aPattern)
     : mSite(aSite)
     , mPattern(aPattern)
     { }
-    bool operator()(nsIFile* aPath) override {
-      return MatchOrigin(aPath, mSite, mPattern);
+    bool operator()(const GMPOriginIndex::Entry& aEntry) override {
+      return MatchOrigin(aEntry.mOrigin, aEntry.mTopLevelOrigin,
+                         mSite, mPattern);
     }
   private:
     const nsACString& mSite;
@@ -1776,54 +2119,14 @@ GeckoMediaPluginServiceParent::ClearRecentHistoryOnGMPThread(PRTime aSince)
   MOZ_ASSERT(NS_GetCurrentThread() == mGMPThread);
   LOGD(("%s::%s: since=%lld", __CLASS__, __FUNCTION__, (int64_t)aSince));
 
-  struct MTimeFilter : public DirectoryFilter {
+  struct MTimeFilter : public GMPOriginIndex::EntryFilter {
     explicit MTimeFilter(PRTime aSince)
       : mSince(aSince) {}
 
-    // Return true if any files under aPath is modified after |mSince|.
-    bool IsModifiedAfter(nsIFile* aPath) {
-      PRTime lastModified;
-      nsresult rv = aPath->GetLastModifiedTime(&lastModified);
-      if (NS_SUCCEEDED(rv) && lastModified >= mSince) {
-        return true;
-      }
-      DirectoryEnumerator iter(aPath, DirectoryEnumerator::FilesAndDirs);
-      for (nsCOMPtr<nsIFile> dirEntry; (dirEntry = iter.Next()) != nullptr;) {
-        if (IsModifiedAfter(dirEntry)) {
-          return true;
-        }
-      }
-      return false;
-    }
-
-    // |aPath| is $profileDir/gmp/$platform/$gmpName/id/$originHash/
-    bool operator()(nsIFile* aPath) override {
-      if (IsModifiedAfter(aPath)) {
-        return true;
-      }
-
-      nsAutoCString salt;
-      if (NS_FAILED(ReadSalt(aPath, salt))) {
-        return false;
-      }
-
-      // $profileDir/gmp/$platform/$gmpName/id/
-      nsCOMPtr<nsIFile> idDir;
-      if (NS_FAILED(aPath->GetParent(getter_AddRefs(idDir)))) {
-        return false;
-      }
-      // $profileDir/gmp/$platform/$gmpName/
-      nsCOMPtr<nsIFile> temp;
-      if (NS_FAILED(idDir->GetParent(getter_AddRefs(temp)))) {
-        return false;
-      }
-
-      // $profileDir/gmp/$platform/$gmpName/storage/
-      if (NS_FAILED(temp->Append(NS_LITERAL_STRING("storage")))) {
-        return false;
-      }
-      // $profileDir/gmp/$platform/$gmpName/storage/$originSalt
-      return NS_SUCCEEDED(temp->AppendNative(salt)) && IsModifiedAfter(temp);
+    // True if any file of the origin pair or of its storage was modified
+    // after |mSince|.
+    bool operator()(const GMPOriginIndex::Entry& aEntry) override {
+      return aEntry.mLastModified >= mSince;
     }
   private:
     const PRTime mSince;
@@ -1831,7 +2134,16 @@ GeckoMediaPluginServiceParent::ClearRecentHistoryOnGMPThread(PRTime aSince)
 
   ClearNodeIdAndPlugin(filter);
 
-  NS_DispatchToMainThread(new NotifyObserversTask("gmp-clear-storage-complete"), NS_DISPATCH_NORMAL);
+  nsCOMPtr<nsIRunnable> task =
+    new NotifyObserversTask("gmp-clear-storage-complete");
+  if (mStorageClearTaskQueue) {
+    // Notify once the cleared directories are deleted.
+    mStorageClearTaskQueue->Dispatch(NS_NewRunnableFunction([task]() {
+      NS_DispatchToMainThread(task, NS_DISPATCH_NORMAL);
+    }));
+  } else {
+    NS_DispatchToMainThread(task, NS_DISPATCH_NORMAL);
+  }
 }
 
 NS_IMETHODIMP
@@ -1938,6 +2250,12 @@ GeckoMediaPluginServiceParent::ClearStorage()
     NS_WARNING("Failed to delete GMP storage directory");
   }
 
+  // The indexes may still be referenced by storage in use, so empty them
+  // rather than dropping them.
+  for (auto iter = mOriginIndexes.Iter(); !iter.Done(); iter.Next()) {
+    iter.UserData()->Clear();
+  }
+
   // Clear private-browsing storage.
   mTempGMPStorage.Clear();
 
@@ -15,7 +15,11 @@
 #include "nsIAsyncShutdown.h"
 #include "nsThreadUtils.h"
 #include "mozilla/MozPromise.h"
+#include "mozilla/TimeStamp.h"
+#include "nsITimer.h"
 #include "GMPStorage.h"
+#include "GMPOriginIndex.h"
+#include "mozilla/TaskQueue.h"
 
 template <class> struct already_AddRefed;
 
@@ -53,6 +57,9 @@ public:
   void AsyncShutdownComplete(GMPParent* aParent);
 
   int32_t AsyncShutdownTimeoutMs();
+  // True while UnloadPlugins() has armed the global async-shutdown deadline.
+  // GMP thread access only.
+  bool IsAsyncShutdownDeadlineArmed() const;
 #ifdef MOZ_CRASHREPORTER
   void SetAsyncShutdownPluginState(GMPParent* aGMPParent, char aId, const nsCString& aState);
 #endif // MOZ_CRASHREPORTER
@@ -63,6 +70,9 @@ public:
   bool IsShuttingDown();
 
   already_AddRefed<GMPStorage> GetMemoryStorageFor(const nsACString& aNodeId);
+  // Index of the node ids stored on disk for aGMPName, loaded or rebuilt on
+  // first use. GMP thread only.
+  already_AddRefed<GMPOriginIndex> GetOriginIndex(const nsAString& aGMPName);
   nsresult ForgetThisSiteNative(const nsAString& aSite,
                                 const mozilla::OriginAttributesPattern& aPattern);
 
@@ -92,6 +102,9 @@ private:
                      const nsAString& aGMPName, nsACString& aOutId);
 
   void UnloadPlugins();
+  nsresult ArmAsyncShutdownDeadline();
+  static void AsyncShutdownDeadlineReached(nsITimer* aTimer, void* aClosure);
+  void RecordPluginShutdownTime(GMPParent* aParent, bool aTimedOut);
   void CrashPlugins();
   void NotifySyncShutdownComplete();
   void NotifyAsyncShutdownComplete();
@@ -104,13 +117,11 @@ private:
 
   nsresult SetAsyncShutdownTimeout();
 
-  struct DirectoryFilter {
-    virtual bool operator()(nsIFile* aPath) = 0;
-    ~DirectoryFilter() {}
-  };
-  void ClearNodeIdAndPlugin(DirectoryFilter& aFilter);
+  void ClearNodeIdAndPlugin(GMPOriginIndex::EntryFilter& aFilter);
   void ClearNodeIdAndPlugin(nsIFile* aPluginStorageDir,
-                            DirectoryFilter& aFilter);
+                            GMPOriginIndex::EntryFilter& aFilter);
+  // Deletes aPath on mStorageClearTaskQueue.
+  void DeleteInBackground(nsIFile* aPath);
   void ForgetThisSiteOnGMPThread(const nsACString& aOrigin,
                                  const mozilla::OriginAttributesPattern& aPattern);
   void ClearRecentHistoryOnGMPThread(PRTime aSince);
@@ -168,6 +179,13 @@ private:
   bool mShuttingDown;
   nsTArray<RefPtr<GMPParent>> mAsyncShutdownPlugins;
 
+  // Single deadline shared by all plugins shutting down in UnloadPlugins().
+  // Plugins which haven't completed their async shutdown when it fires are
+  // killed, so browser shutdown is bounded by the slowest plugin rather than
+  // by the sum of their timeouts. GMP thread only.
+  nsCOMPtr<nsITimer> mAsyncShutdownDeadline;
+  TimeStamp mUnloadPluginsStartTime;
+
 #ifdef MOZ_CRASHREPORTER
   Mutex mAsyncShutdownPluginStatesMutex; // Protects mAsyncShutdownPluginStates.
   class AsyncShutdownPluginStates
@@ -225,6 +243,13 @@ private:
   // Hashes nodeId to the hashtable of storage for that nodeId.
   nsRefPtrHashtable<nsCStringHashKey, GMPStorage> mTempGMPStorage;
 
+  // Hashes GMP name to the index of its node ids on disk. GMP thread only.
+  nsRefPtrHashtable<nsStringHashKey, GMPOriginIndex> mOriginIndexes;
+
+  // Deletes cleared storage off the GMP thread; created on first use, and
+  // null once plugins are unloaded. GMP thread only.
+  RefPtr<TaskQueue> mStorageClearTaskQueue;
+
   // Tracks how many users are running (on the GMP thread). Only when this count
   // drops to 0 can we safely shut down the thread.
   MainThreadOnly<int32_t> mServiceUserCount;
@@ -5,6 +5,7 @@
 
 #include "GMPSharedMemManager.h"
 #include "GMPMessageUtils.h"
+#include "GMPStats.h"
 #include "mozilla/ipc/SharedMemory.h"
 #include "mozilla/StaticPtr.h"
 #include "mozilla/ClearOnShutdown.h"
@@ -32,6 +33,9 @@ GMPSharedMemManager::MgrAllocShmem(GMPSharedMem::GMPMemoryClasses aClass, size_t
     if (aSize <= GetGmpFreelist(aClass)[i].Size<uint8_t>()) {
       *aMem = GetGmpFreelist(aClass)[i];
       GetGmpFreelist(aClass).RemoveElementAt(i);
+      if (GMPPluginStats* stats = mData->Stats()) {
+        stats->ShmemAllocated(aClass, true, NumInUse(aClass));
+      }
       return true;
     }
   }
@@ -44,6 +48,9 @@ GMPSharedMemManager::MgrAllocShmem(GMPSharedMem::GMPMemoryClasses aClass, size_t
     // The allocator (or NeedsShmem call) should never return less than we ask for...
     MOZ_ASSERT(aMem->Size<uint8_t>() >= aSize);
     mData->mGmpAllocated[aClass]++;
+    if (GMPPluginStats* stats = mData->Stats()) {
+      stats->ShmemAllocated(aClass, false, NumInUse(aClass));
+    }
   }
   return retval;
 }
@@ -12,6 +12,7 @@
 namespace mozilla {
 namespace gmp {
 
+class GMPPluginStats;
 class GMPSharedMemManager;
 
 class GMPSharedMem
@@ -41,7 +42,11 @@ public:
   // Parent and child impls will differ here
   virtual void CheckThread() = 0;
 
+  // Performance counters for the pools, if any are kept on this side.
+  virtual GMPPluginStats* Stats() { return nullptr; }
+
 protected:
+  friend class GMPPluginStats;
   friend class GMPSharedMemManager;
 
   nsTArray<ipc::Shmem> mGmpFreelist[GMPSharedMem::kGMPNumTypes];
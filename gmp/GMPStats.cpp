@@ -0,0 +1,333 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "GMPStats.h"
+#include "GMPSharedMemManager.h"
+#include "GeckoProfiler.h"
+#include "mozilla/MathAlgorithms.h"
+#include "mozilla/StaticMutex.h"
+#include "mozilla/StaticPtr.h"
+#include "nsIMemoryReporter.h"
+#include "nsPrintfCString.h"
+#include "nsThreadUtils.h"
+
+namespace mozilla {
+namespace gmp {
+
+static_assert(GMPSharedMem::kGMPNumTypes == 2,
+              "GMPPluginStats::kNumClasses must match GMPSharedMem");
+
+// Requests slower than this get a profiler marker.
+static const double kSlowRoundTripMs = 50.0;
+
+// If a plugin never replies to some requests (e.g. it drops frames), don't
+// let the pending table grow without bounds.
+static const uint32_t kMaxPendingRequests = 256;
+
+GMPLatencyHistogram::GMPLatencyHistogram()
+{
+  for (auto& bucket : mBuckets) {
+    bucket = 0;
+  }
+}
+
+void
+GMPLatencyHistogram::Accumulate(const TimeDuration& aDuration)
+{
+  double us = aDuration.ToMicroseconds();
+  size_t bucket = 0;
+  if (us >= 1.0) {
+    bucket = std::min<size_t>(FloorLog2(uint64_t(us)), kNumBuckets - 1);
+  }
+  mBuckets[bucket]++;
+}
+
+uint32_t
+GMPLatencyHistogram::Count() const
+{
+  uint32_t count = 0;
+  for (const auto& bucket : mBuckets) {
+    count += bucket;
+  }
+  return count;
+}
+
+uint64_t
+GMPLatencyHistogram::PercentileUs(uint32_t aPercentile) const
+{
+  uint32_t count = Count();
+  if (!count) {
+    return 0;
+  }
+  uint64_t target = (uint64_t(count) * std::min(aPercentile, 100u) + 99) / 100;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kNumBuckets; i++) {
+    seen += mBuckets[i];
+    if (seen >= target && seen) {
+      return uint64_t(1) << (i + 1);
+    }
+  }
+  return uint64_t(1) << kNumBuckets;
+}
+
+GMPActorStats::GMPActorStats(GMPPluginStats* aPlugin, const char* aActorType)
+  : mPlugin(aPlugin)
+  , mActorType(aActorType)
+  , mMessagesSent(0)
+  , mMessagesReceived(0)
+  , mBytesSent(0)
+  , mBytesReceived(0)
+  , mNeedShmemCalls(0)
+  , mBufferLimitHits(0)
+  , mQueueDepth(0)
+  , mMaxQueueDepth(0)
+{
+}
+
+void
+GMPActorStats::MessageSent(size_t aBytes)
+{
+  mMessagesSent++;
+  mBytesSent += aBytes;
+}
+
+void
+GMPActorStats::MessageReceived(size_t aBytes)
+{
+  mMessagesReceived++;
+  mBytesReceived += aBytes;
+}
+
+void
+GMPActorStats::NeedShmem()
+{
+  mNeedShmemCalls++;
+}
+
+void
+GMPActorStats::BufferLimitHit()
+{
+  mBufferLimitHits++;
+  PROFILER_MARKER("GMP shmem buffer limit hit");
+}
+
+void
+GMPActorStats::ActorDestroyed()
+{
+  ClearPendingRequests();
+  mPlugin->ActorDestroyed(this);
+}
+
+void
+GMPActorStats::RequestSent(uint64_t aId)
+{
+  if (mPending.Count() >= kMaxPendingRequests) {
+    ClearPendingRequests();
+  }
+  mPending.Put(aId, TimeStamp::Now());
+  mQueueDepth = mPending.Count();
+  if (mQueueDepth > mMaxQueueDepth) {
+    mMaxQueueDepth = uint32_t(mQueueDepth);
+  }
+}
+
+void
+GMPActorStats::ReplyReceived(uint64_t aId)
+{
+  TimeStamp sent;
+  if (!mPending.Get(aId, &sent)) {
+    return;
+  }
+  mPending.Remove(aId);
+  mQueueDepth = mPending.Count();
+
+  TimeDuration roundTrip = TimeStamp::Now() - sent;
+  mRoundTrip.Accumulate(roundTrip);
+  if (roundTrip.ToMilliseconds() > kSlowRoundTripMs) {
+    PROFILER_MARKER("GMP slow round-trip");
+  }
+}
+
+void
+GMPActorStats::ClearPendingRequests()
+{
+  mPending.Clear();
+  mQueueDepth = 0;
+}
+
+static StaticMutex sRegistryMutex;
+static StaticAutoPtr<nsTArray<GMPPluginStats*>> sRegistry;
+
+class GMPStatsReporter final : public nsIMemoryReporter
+{
+  ~GMPStatsReporter() {}
+
+public:
+  NS_DECL_ISUPPORTS
+
+  NS_IMETHOD CollectReports(nsIHandleReportCallback* aHandleReport,
+                            nsISupports* aData, bool aAnonymize) override
+  {
+    nsTArray<RefPtr<GMPPluginStats>> plugins;
+    GMPPluginStats::GetAll(plugins);
+
+    for (const auto& plugin : plugins) {
+      nsPrintfCString pluginPath("gmp-stats/%s(id=%u)/",
+                                 plugin->DisplayName().get(),
+                                 plugin->PluginId());
+      static const char* const kClassNames[] = { "frame", "encoded" };
+      for (size_t i = 0; i < ArrayLength(kClassNames); i++) {
+        Report(aHandleReport, aData,
+               pluginPath + nsPrintfCString("shmem-%s/allocations", kClassNames[i]),
+               plugin->ShmemAllocations(i),
+               "Shmem buffers requested from the pool.");
+        Report(aHandleReport, aData,
+               pluginPath + nsPrintfCString("shmem-%s/pool-hits", kClassNames[i]),
+               plugin->ShmemPoolHits(i),
+               "Shmem requests satisfied from the free list.");
+        Report(aHandleReport, aData,
+               pluginPath + nsPrintfCString("shmem-%s/high-water", kClassNames[i]),
+               plugin->ShmemHighWater(i),
+               "Maximum number of shmem buffers in use at once.");
+      }
+
+      nsTArray<RefPtr<GMPActorStats>> actors;
+      plugin->GetActors(actors);
+      for (const auto& actor : actors) {
+        nsCString path = pluginPath +
+          nsPrintfCString("%s(0x%p)/", actor->ActorType(), actor.get());
+        Report(aHandleReport, aData, path + NS_LITERAL_CSTRING("messages-sent"),
+               actor->MessagesSent(), "Messages sent to the plugin.");
+        Report(aHandleReport, aData, path + NS_LITERAL_CSTRING("messages-received"),
+               actor->MessagesReceived(), "Messages received from the plugin.");
+        Report(aHandleReport, aData, path + NS_LITERAL_CSTRING("bytes-sent"),
+               actor->BytesSent(), "Media payload bytes sent to the plugin.");
+        Report(aHandleReport, aData, path + NS_LITERAL_CSTRING("bytes-received"),
+               actor->BytesReceived(), "Media payload bytes received from the plugin.");
+        Report(aHandleReport, aData, path + NS_LITERAL_CSTRING("need-shmem-calls"),
+               actor->NeedShmemCalls(), "Synchronous NeedShmem calls from the plugin.");
+        Report(aHandleReport, aData, path + NS_LITERAL_CSTRING("buffer-limit-hits"),
+               actor->BufferLimitHits(),
+               "Requests rejected because too many shmem buffers were in use.");
+        Report(aHandleReport, aData, path + NS_LITERAL_CSTRING("queue-depth"),
+               actor->QueueDepth(), "Requests awaiting a reply from the plugin.");
+        Report(aHandleReport, aData, path + NS_LITERAL_CSTRING("queue-depth-max"),
+               actor->MaxQueueDepth(),
+               "Maximum number of requests awaiting a reply at once.");
+        const GMPLatencyHistogram& rtt = actor->RoundTrip();
+        Report(aHandleReport, aData, path + NS_LITERAL_CSTRING("round-trips"),
+               rtt.Count(), "Completed request/reply round-trips.");
+        static const uint32_t kPercentiles[] = { 50, 90, 99 };
+        for (uint32_t p : kPercentiles) {
+          Report(aHandleReport, aData,
+                 path + nsPrintfCString("round-trip-p%u-us", p),
+                 rtt.PercentileUs(p),
+                 "Round-trip latency percentile in microseconds "
+                 "(upper bound of log2 bucket).");
+        }
+      }
+    }
+    return NS_OK;
+  }
+
+private:
+  static void Report(nsIHandleReportCallback* aHandleReport, nsISupports* aData,
+                     const nsACString& aPath, int64_t aAmount,
+                     const char* aDescription)
+  {
+    aHandleReport->Callback(EmptyCString(), aPath,
+                            KIND_OTHER, UNITS_COUNT, aAmount,
+                            nsDependentCString(aDescription), aData);
+  }
+};
+
+NS_IMPL_ISUPPORTS(GMPStatsReporter, nsIMemoryReporter)
+
+GMPPluginStats::GMPPluginStats(uint32_t aPluginId, const nsCString& aDisplayName)
+  : mPluginId(aPluginId)
+  , mDisplayName(aDisplayName)
+{
+  for (size_t i = 0; i < kNumClasses; i++) {
+    mShmemAllocations[i] = 0;
+    mShmemPoolHits[i] = 0;
+    mShmemHighWater[i] = 0;
+  }
+
+  bool registerReporter = false;
+  {
+    StaticMutexAutoLock lock(sRegistryMutex);
+    if (!sRegistry) {
+      // Intentionally never freed; the reporter outlives every plugin.
+      sRegistry = new nsTArray<GMPPluginStats*>();
+      registerReporter = true;
+    }
+    sRegistry->AppendElement(this);
+  }
+  if (registerReporter) {
+    NS_DispatchToMainThread(NS_NewRunnableFunction([]() {
+      RegisterStrongMemoryReporter(new GMPStatsReporter());
+    }));
+  }
+}
+
+void
+GMPPluginStats::Unregister()
+{
+  StaticMutexAutoLock lock(sRegistryMutex);
+  if (sRegistry) {
+    sRegistry->RemoveElement(this);
+  }
+  // Break the actor <-> plugin reference cycle.
+  mActors.Clear();
+}
+
+// static
+void
+GMPPluginStats::GetAll(nsTArray<RefPtr<GMPPluginStats>>& aOutPlugins)
+{
+  StaticMutexAutoLock lock(sRegistryMutex);
+  if (sRegistry) {
+    aOutPlugins.AppendElements(*sRegistry);
+  }
+}
+
+already_AddRefed<GMPActorStats>
+GMPPluginStats::CreateActorStats(const char* aActorType)
+{
+  RefPtr<GMPActorStats> actor = new GMPActorStats(this, aActorType);
+  StaticMutexAutoLock lock(sRegistryMutex);
+  mActors.AppendElement(actor);
+  return actor.forget();
+}
+
+void
+GMPPluginStats::ActorDestroyed(GMPActorStats* aActor)
+{
+  StaticMutexAutoLock lock(sRegistryMutex);
+  mActors.RemoveElement(aActor);
+}
+
+void
+GMPPluginStats::GetActors(nsTArray<RefPtr<GMPActorStats>>& aOutActors)
+{
+  StaticMutexAutoLock lock(sRegistryMutex);
+  aOutActors.AppendElements(mActors);
+}
+
+void
+GMPPluginStats::ShmemAllocated(size_t aClass, bool aPoolHit, uint32_t aInUse)
+{
+  MOZ_ASSERT(aClass < kNumClasses);
+  mShmemAllocations[aClass]++;
+  if (aPoolHit) {
+    mShmemPoolHits[aClass]++;
+  }
+  if (aInUse > mShmemHighWater[aClass]) {
+    mShmemHighWater[aClass] = aInUse;
+  }
+}
+
+} // namespace gmp
+} // namespace mozilla
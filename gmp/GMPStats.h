@@ -0,0 +1,160 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef GMPStats_h_
+#define GMPStats_h_
+
+#include "mozilla/Atomics.h"
+#include "mozilla/TimeStamp.h"
+#include "nsDataHashtable.h"
+#include "nsHashKeys.h"
+#include "nsISupportsImpl.h"
+#include "nsString.h"
+#include "nsTArray.h"
+
+namespace mozilla {
+namespace gmp {
+
+class GMPPluginStats;
+
+// Cheap always-on performance counters for the parent side of the GMP IPC
+// protocols. Each actor's counters are written on the thread its
+// GMPContentParent is bound to, which in content processes is one of the
+// GMP actor shard threads rather than the GMP thread. They may be read from
+// any thread, e.g. by the "gmp-stats" memory reporter.
+
+// Log2 histogram of latencies. Bucket i holds samples in
+// [2^i, 2^(i+1)) microseconds; the last bucket holds everything longer.
+class GMPLatencyHistogram
+{
+public:
+  static const size_t kNumBuckets = 24;
+
+  GMPLatencyHistogram();
+
+  void Accumulate(const TimeDuration& aDuration);
+
+  uint32_t Count() const;
+  uint32_t BucketCount(size_t aBucket) const { return mBuckets[aBucket]; }
+  // Upper bound, in microseconds, of the bucket containing the given
+  // percentile (0-100), or 0 if no samples have been recorded.
+  uint64_t PercentileUs(uint32_t aPercentile) const;
+
+private:
+  Atomic<uint32_t, Relaxed> mBuckets[kNumBuckets];
+};
+
+// Counters for one IPC actor (audio or video decoder, video encoder or
+// decryptor).
+class GMPActorStats
+{
+public:
+  NS_INLINE_DECL_THREADSAFE_REFCOUNTING(GMPActorStats)
+
+  GMPActorStats(GMPPluginStats* aPlugin, const char* aActorType);
+
+  // Call after a message has been sent to / received from the child.
+  // aBytes is the size of the media payload carried, if any.
+  void MessageSent(size_t aBytes = 0);
+  void MessageReceived(size_t aBytes = 0);
+
+  // Call when the child asks for a shmem through the intr NeedShmem message.
+  void NeedShmem();
+
+  // Round-trip tracking for decode/encode/decrypt requests. aId is the
+  // timestamp or request id the child echoes back in its reply.
+  void RequestSent(uint64_t aId);
+  void ReplyReceived(uint64_t aId);
+  // Forget about requests whose replies won't come, e.g. after Reset().
+  void ClearPendingRequests();
+
+  // Called when the shmem buffer-limit kill-switch rejects a request.
+  void BufferLimitHit();
+
+  // Called from the actor's ActorDestroy(); stops reporting this actor.
+  void ActorDestroyed();
+
+  const char* ActorType() const { return mActorType; }
+  uint64_t MessagesSent() const { return mMessagesSent; }
+  uint64_t MessagesReceived() const { return mMessagesReceived; }
+  uint64_t BytesSent() const { return mBytesSent; }
+  uint64_t BytesReceived() const { return mBytesReceived; }
+  uint32_t NeedShmemCalls() const { return mNeedShmemCalls; }
+  uint32_t BufferLimitHits() const { return mBufferLimitHits; }
+  uint32_t QueueDepth() const { return mQueueDepth; }
+  uint32_t MaxQueueDepth() const { return mMaxQueueDepth; }
+  const GMPLatencyHistogram& RoundTrip() const { return mRoundTrip; }
+
+private:
+  ~GMPActorStats() {}
+
+  RefPtr<GMPPluginStats> mPlugin;
+  const char* const mActorType;
+
+  Atomic<uint64_t, Relaxed> mMessagesSent;
+  Atomic<uint64_t, Relaxed> mMessagesReceived;
+  Atomic<uint64_t, Relaxed> mBytesSent;
+  Atomic<uint64_t, Relaxed> mBytesReceived;
+  Atomic<uint32_t, Relaxed> mNeedShmemCalls;
+  Atomic<uint32_t, Relaxed> mBufferLimitHits;
+  Atomic<uint32_t, Relaxed> mQueueDepth;
+  Atomic<uint32_t, Relaxed> mMaxQueueDepth;
+  GMPLatencyHistogram mRoundTrip;
+
+  // Send time of requests awaiting a reply. Owning actor's thread only.
+  nsDataHashtable<nsUint64HashKey, TimeStamp> mPending;
+};
+
+// Counters for one plugin instance as seen from one process, i.e. for one
+// GMPContentParent. Aggregates its actors and its shmem pools.
+class GMPPluginStats
+{
+public:
+  NS_INLINE_DECL_THREADSAFE_REFCOUNTING(GMPPluginStats)
+
+  GMPPluginStats(uint32_t aPluginId, const nsCString& aDisplayName);
+
+  already_AddRefed<GMPActorStats> CreateActorStats(const char* aActorType);
+  void ActorDestroyed(GMPActorStats* aActor);
+
+  // Called by GMPSharedMemManager. aInUse is the number of buffers of that
+  // class handed out after the allocation.
+  void ShmemAllocated(size_t aClass, bool aPoolHit, uint32_t aInUse);
+
+  uint32_t PluginId() const { return mPluginId; }
+  const nsCString& DisplayName() const { return mDisplayName; }
+  uint32_t ShmemAllocations(size_t aClass) const { return mShmemAllocations[aClass]; }
+  uint32_t ShmemPoolHits(size_t aClass) const { return mShmemPoolHits[aClass]; }
+  uint32_t ShmemHighWater(size_t aClass) const { return mShmemHighWater[aClass]; }
+
+  // Snapshot of the live actors, for reporting.
+  void GetActors(nsTArray<RefPtr<GMPActorStats>>& aOutActors);
+
+  // Snapshot of the plugin instances with live stats in this process.
+  static void GetAll(nsTArray<RefPtr<GMPPluginStats>>& aOutPlugins);
+
+  // Remove from the registry; called when the GMPContentParent goes away.
+  void Unregister();
+
+private:
+  ~GMPPluginStats() {}
+
+  const uint32_t mPluginId;
+  const nsCString mDisplayName;
+
+  // Indexed by GMPSharedMem::GMPMemoryClasses.
+  static const size_t kNumClasses = 2;
+  Atomic<uint32_t, Relaxed> mShmemAllocations[kNumClasses];
+  Atomic<uint32_t, Relaxed> mShmemPoolHits[kNumClasses];
+  Atomic<uint32_t, Relaxed> mShmemHighWater[kNumClasses];
+
+  // Protected by the registry lock.
+  nsTArray<RefPtr<GMPActorStats>> mActors;
+};
+
+} // namespace gmp
+} // namespace mozilla
+
+#endif // GMPStats_h_
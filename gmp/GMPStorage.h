@@ -15,6 +15,8 @@
 namespace mozilla {
 namespace gmp {
 
+class GMPOriginIndex;
+
 class GMPStorage {
 public:
   NS_INLINE_DECL_THREADSAFE_REFCOUNTING(GMPStorage)
@@ -32,8 +34,10 @@ protected:
 };
 
 already_AddRefed<GMPStorage> CreateGMPMemoryStorage();
+// Record writes are noted in aIndex, if not null.
 already_AddRefed<GMPStorage> CreateGMPDiskStorage(const nsCString& aNodeId,
-                                                  const nsString& aGMPName);
+                                                  const nsString& aGMPName,
+                                                  GMPOriginIndex* aIndex);
 
 } // namespace gmp
 } // namespace mozilla
@@ -6,6 +6,8 @@
 #include "GMPStorageParent.h"
 #include "GMPParent.h"
 #include "gmp-storage.h"
+#include "mozilla/Move.h"
+#include "mozilla/SharedThreadPool.h"
 #include "mozilla/Unused.h"
 #include "mozIGeckoMediaPluginService.h"
 
@@ -22,6 +24,22 @@ extern LogModule* GetGMPLog();
 
 namespace gmp {
 
+// Threads shared by the storage I/O of all plugins.
+static const uint32_t kIOThreads = 2;
+
+// The bytes of a record, passed between the actor's thread and the I/O
+// threads by reference rather than copied into each task.
+class GMPRecordData final
+{
+public:
+  NS_INLINE_DECL_THREADSAFE_REFCOUNTING(GMPRecordData)
+
+  nsTArray<uint8_t> mBytes;
+
+private:
+  ~GMPRecordData() {}
+};
+
 GMPStorageParent::GMPStorageParent(const nsCString& aNodeId,
                                    GMPParent* aPlugin)
   : mNodeId(aNodeId)
@@ -48,7 +66,10 @@ GMPStorageParent::Init()
     return NS_ERROR_FAILURE;
   }
   if (persistent) {
-    mStorage = CreateGMPDiskStorage(mNodeId, mPlugin->GetPluginBaseName());
+    RefPtr<GMPOriginIndex> index =
+      mps->GetOriginIndex(mPlugin->GetPluginBaseName());
+    mStorage = CreateGMPDiskStorage(mNodeId, mPlugin->GetPluginBaseName(),
+                                    index);
   } else {
     mStorage = mps->GetMemoryStorageFor(mNodeId);
   }
@@ -56,10 +77,47 @@ GMPStorageParent::Init()
     return NS_ERROR_FAILURE;
   }
 
+  mThread = NS_GetCurrentThread();
+  if (persistent) {
+    // Memory storage is shared by the actors of a node and never blocks, so
+    // it stays on the actor's thread.
+    mIOTaskQueue = new TaskQueue(
+      SharedThreadPool::Get(NS_LITERAL_CSTRING("GMPStorage"), kIOThreads));
+  }
+
   mShutdown = false;
   return NS_OK;
 }
 
+template<typename Function>
+void
+GMPStorageParent::RunStorageTask(Function&& aTask)
+{
+  if (!mIOTaskQueue) {
+    aTask();
+    return;
+  }
+  mIOTaskQueue->Dispatch(NS_NewRunnableFunction(Move(aTask)));
+}
+
+template<typename Function>
+void
+GMPStorageParent::RunReply(Function&& aReply)
+{
+  if (NS_GetCurrentThread() == mThread) {
+    if (!mShutdown) {
+      aReply();
+    }
+    return;
+  }
+  RefPtr<GMPStorageParent> self = this;
+  mThread->Dispatch(NS_NewRunnableFunction([self, aReply]() {
+    if (!self->mShutdown) {
+      aReply();
+    }
+  }), NS_DISPATCH_NORMAL);
+}
+
 mozilla::ipc::IPCResult
 GMPStorageParent::RecvOpen(const nsCString& aRecordName)
 {
@@ -86,18 +144,24 @@ GMPStorageParent::RecvOpen(const nsCString& aRecordName)
     return IPC_OK();
   }
 
-  if (mStorage->IsOpen(aRecordName)) {
-    LOGD(("GMPStorageParent[%p]::RecvOpen(record='%s') failed; record in use",
-          this, aRecordName.get()));
-    Unused << SendOpenComplete(aRecordName, GMPRecordInUse);
-    return IPC_OK();
-  }
-
-  auto err = mStorage->Open(aRecordName);
-  MOZ_ASSERT(GMP_FAILED(err) || mStorage->IsOpen(aRecordName));
-  LOGD(("GMPStorageParent[%p]::RecvOpen(record='%s') complete; rv=%d",
-        this, aRecordName.get(), err));
-  Unused << SendOpenComplete(aRecordName, err);
+  RefPtr<GMPStorageParent> self = this;
+  RefPtr<GMPStorage> storage = mStorage;
+  RunStorageTask([self, storage, aRecordName]() {
+    GMPErr err;
+    if (storage->IsOpen(aRecordName)) {
+      LOGD(("GMPStorageParent[%p]::RecvOpen(record='%s') failed; record in use",
+            self.get(), aRecordName.get()));
+      err = GMPRecordInUse;
+    } else {
+      err = storage->Open(aRecordName);
+      MOZ_ASSERT(GMP_FAILED(err) || storage->IsOpen(aRecordName));
+      LOGD(("GMPStorageParent[%p]::RecvOpen(record='%s') complete; rv=%d",
+            self.get(), aRecordName.get(), err));
+    }
+    self->RunReply([self, aRecordName, err]() {
+      Unused << self->SendOpenComplete(aRecordName, err);
+    });
+  });
 
   return IPC_OK();
 }
@@ -112,17 +176,24 @@ GMPStorageParent::RecvRead(const nsCString& aRecordName)
     return IPC_FAIL_NO_REASON(this);
   }
 
-  nsTArray<uint8_t> data;
-  if (!mStorage->IsOpen(aRecordName)) {
-    LOGD(("GMPStorageParent[%p]::RecvRead(record='%s') failed; record not open",
-         this, aRecordName.get()));
-    Unused << SendReadComplete(aRecordName, GMPClosedErr, data);
-  } else {
-    GMPErr rv = mStorage->Read(aRecordName, data);
-    LOGD(("GMPStorageParent[%p]::RecvRead(record='%s') read %d bytes rv=%d",
-      this, aRecordName.get(), data.Length(), rv));
-    Unused << SendReadComplete(aRecordName, rv, data);
-  }
+  RefPtr<GMPStorageParent> self = this;
+  RefPtr<GMPStorage> storage = mStorage;
+  RunStorageTask([self, storage, aRecordName]() {
+    RefPtr<GMPRecordData> data = new GMPRecordData();
+    GMPErr rv;
+    if (!storage->IsOpen(aRecordName)) {
+      LOGD(("GMPStorageParent[%p]::RecvRead(record='%s') failed; record not open",
+           self.get(), aRecordName.get()));
+      rv = GMPClosedErr;
+    } else {
+      rv = storage->Read(aRecordName, data->mBytes);
+      LOGD(("GMPStorageParent[%p]::RecvRead(record='%s') read %d bytes rv=%d",
+        self.get(), aRecordName.get(), data->mBytes.Length(), rv));
+    }
+    self->RunReply([self, aRecordName, rv, data]() {
+      Unused << self->SendReadComplete(aRecordName, rv, data->mBytes);
+    });
+  });
 
   return IPC_OK();
 }
@@ -138,25 +209,30 @@ GMPStorageParent::RecvWrite(const nsCString& aRecordName,
     return IPC_FAIL_NO_REASON(this);
   }
 
-  if (!mStorage->IsOpen(aRecordName)) {
-    LOGD(("GMPStorageParent[%p]::RecvWrite(record='%s') failed record not open",
-          this, aRecordName.get()));
-    Unused << SendWriteComplete(aRecordName, GMPClosedErr);
-    return IPC_OK();
-  }
-
-  if (aBytes.Length() > GMP_MAX_RECORD_SIZE) {
-    LOGD(("GMPStorageParent[%p]::RecvWrite(record='%s') failed record too big",
-          this, aRecordName.get()));
-    Unused << SendWriteComplete(aRecordName, GMPQuotaExceededErr);
-    return IPC_OK();
-  }
-
-  GMPErr rv = mStorage->Write(aRecordName, aBytes);
-  LOGD(("GMPStorageParent[%p]::RecvWrite(record='%s') write complete rv=%d",
-        this, aRecordName.get(), rv));
-
-  Unused << SendWriteComplete(aRecordName, rv);
+  RefPtr<GMPStorageParent> self = this;
+  RefPtr<GMPStorage> storage = mStorage;
+  RefPtr<GMPRecordData> data = new GMPRecordData();
+  data->mBytes.SwapElements(aBytes);
+  RunStorageTask([self, storage, aRecordName, data]() {
+    const nsTArray<uint8_t>& bytes = data->mBytes;
+    GMPErr rv;
+    if (!storage->IsOpen(aRecordName)) {
+      LOGD(("GMPStorageParent[%p]::RecvWrite(record='%s') failed record not open",
+            self.get(), aRecordName.get()));
+      rv = GMPClosedErr;
+    } else if (bytes.Length() > GMP_MAX_RECORD_SIZE) {
+      LOGD(("GMPStorageParent[%p]::RecvWrite(record='%s') failed record too big",
+            self.get(), aRecordName.get()));
+      rv = GMPQuotaExceededErr;
+    } else {
+      rv = storage->Write(aRecordName, bytes);
+      LOGD(("GMPStorageParent[%p]::RecvWrite(record='%s') write complete rv=%d",
+            self.get(), aRecordName.get(), rv));
+    }
+    self->RunReply([self, aRecordName, rv]() {
+      Unused << self->SendWriteComplete(aRecordName, rv);
+    });
+  });
 
   return IPC_OK();
 }
@@ -168,13 +244,19 @@ GMPStorageParent::RecvGetRecordNames()
     return IPC_OK();
   }
 
-  nsTArray<nsCString> recordNames;
-  GMPErr status = mStorage->GetRecordNames(recordNames);
+  RefPtr<GMPStorageParent> self = this;
+  RefPtr<GMPStorage> storage = mStorage;
+  RunStorageTask([self, storage]() {
+    nsTArray<nsCString> recordNames;
+    GMPErr status = storage->GetRecordNames(recordNames);
 
-  LOGD(("GMPStorageParent[%p]::RecvGetRecordNames() status=%d numRecords=%d",
-        this, status, recordNames.Length()));
+    LOGD(("GMPStorageParent[%p]::RecvGetRecordNames() status=%d numRecords=%d",
+          self.get(), status, recordNames.Length()));
 
-  Unused << SendRecordNames(recordNames, status);
+    self->RunReply([self, recordNames, status]() {
+      Unused << self->SendRecordNames(recordNames, status);
+    });
+  });
 
   return IPC_OK();
 }
@@ -189,7 +271,10 @@ GMPStorageParent::RecvClose(const nsCString& aRecordName)
     return IPC_OK();
   }
 
-  mStorage->Close(aRecordName);
+  RefPtr<GMPStorage> storage = mStorage;
+  RunStorageTask([storage, aRecordName]() {
+    storage->Close(aRecordName);
+  });
 
   return IPC_OK();
 }
@@ -213,7 +298,12 @@ GMPStorageParent::Shutdown()
   Unused << SendShutdown();
 
   mStorage = nullptr;
-
+  if (mIOTaskQueue) {
+    // Operations already queued still complete, so that no write is lost;
+    // their replies are dropped.
+    mIOTaskQueue->BeginShutdown();
+    mIOTaskQueue = nullptr;
+  }
 }
 
 } // namespace gmp
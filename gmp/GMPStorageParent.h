@@ -7,7 +7,9 @@
 #define GMPStorageParent_h_
 
 #include "mozilla/gmp/PGMPStorageParent.h"
+#include "mozilla/TaskQueue.h"
 #include "GMPStorage.h"
+#include "nsThreadUtils.h"
 
 namespace mozilla {
 namespace gmp {
@@ -16,7 +18,7 @@ class GMPParent;
 
 class GMPStorageParent : public PGMPStorageParent {
 public:
-  NS_INLINE_DECL_REFCOUNTING(GMPStorageParent)
+  NS_INLINE_DECL_THREADSAFE_REFCOUNTING(GMPStorageParent)
   GMPStorageParent(const nsCString& aNodeId,
                    GMPParent* aPlugin);
 
@@ -35,7 +37,23 @@ protected:
 private:
   ~GMPStorageParent() {}
 
+  // Runs aTask, which accesses mStorage, on mIOTaskQueue if there is one, or
+  // synchronously otherwise.
+  template<typename Function>
+  void RunStorageTask(Function&& aTask);
+  // Runs aReply on the actor's thread, unless shut down by then. Used to
+  // send the result of a storage task.
+  template<typename Function>
+  void RunReply(Function&& aReply);
+
   RefPtr<GMPStorage> mStorage;
+  // Disk storage is only accessed on this queue, so that file I/O never
+  // blocks the thread carrying the plugin's decoding and decryption
+  // messages. Operations run in the order they are received in, so those
+  // on a record complete in order. Null for memory storage.
+  RefPtr<TaskQueue> mIOTaskQueue;
+  // Thread the actor runs on, where replies are sent from.
+  nsCOMPtr<nsIThread> mThread;
 
   const nsCString mNodeId;
   RefPtr<GMPParent> mPlugin;
@@ -52,6 +52,7 @@ GMPVideoDecoderParent::GMPVideoDecoderParent(GMPContentParent* aPlugin)
   , mVideoHost(this)
   , mPluginId(aPlugin->GetPluginId())
   , mFrameCount(0)
+  , mStats(aPlugin->CreateActorStats("video-decoder"))
 {
   MOZ_ASSERT(mPlugin);
 }
@@ -157,11 +158,12 @@ GMPVideoDecoderParent::Decode(GMPUniquePtr<GMPVideoEncodedFrame> aInputFrame,
 
   // Very rough kill-switch if the plugin stops processing.  If it's merely
   // hung and continues, we'll come back to life eventually.
-  // 3* is because we're using 3 buffers per frame for i420 data for now.
-  if ((NumInUse(GMPSharedMem::kGMPFrameData) > 3*GMPSharedMem::kGMPBufLimit) ||
+  // i420 frames are sent in a single buffer each.
+  if ((NumInUse(GMPSharedMem::kGMPFrameData) > GMPSharedMem::kGMPBufLimit) ||
       (NumInUse(GMPSharedMem::kGMPEncodedData) > GMPSharedMem::kGMPBufLimit)) {
     LOGE(("GMPVideoDecoderParent[%p]::Decode() ERROR; shmem buffer limit hit frame=%d encoded=%d",
           this, NumInUse(GMPSharedMem::kGMPFrameData), NumInUse(GMPSharedMem::kGMPEncodedData)));
+    mStats->BufferLimitHit();
     return NS_ERROR_FAILURE;
   }
 
@@ -176,6 +178,8 @@ GMPVideoDecoderParent::Decode(GMPUniquePtr<GMPVideoEncodedFrame> aInputFrame,
     return NS_ERROR_FAILURE;
   }
   mFrameCount++;
+  mStats->MessageSent(frameData.mSize());
+  mStats->RequestSent(frameData.mTimestamp());
 
   // Async IPC, we don't have access to a return value.
   return NS_OK;
@@ -196,6 +200,8 @@ GMPVideoDecoderParent::Reset()
   if (!SendReset()) {
     return NS_ERROR_FAILURE;
   }
+  mStats->MessageSent();
+  mStats->ClearPendingRequests();
 
   mIsAwaitingResetComplete = true;
 
@@ -237,6 +243,7 @@ GMPVideoDecoderParent::Drain()
   if (!SendDrain()) {
     return NS_ERROR_FAILURE;
   }
+  mStats->MessageSent();
 
   mIsAwaitingDrainComplete = true;
 
@@ -303,7 +310,11 @@ GMPVideoDecoderParent::ActorDestroy(ActorDestroyReason aWhy)
 
   if (mCallback) {
     // May call Close() (and Shutdown()) immediately or with a delay
-    mCallback->Terminated();
+    if (aWhy == AbnormalShutdown) {
+      mCallback->Crashed();
+    } else {
+      mCallback->Terminated();
+    }
     mCallback = nullptr;
   }
   if (mPlugin) {
@@ -312,6 +323,7 @@ GMPVideoDecoderParent::ActorDestroy(ActorDestroyReason aWhy)
     mPlugin = nullptr;
   }
   mVideoHost.ActorDestroyed();
+  mStats->ActorDestroyed();
   MaybeDisconnect(aWhy == AbnormalShutdown);
 }
 
@@ -321,6 +333,10 @@ GMPVideoDecoderParent::RecvDecoded(const GMPVideoi420FrameData& aDecodedFrame)
   --mFrameCount;
   LOGV(("GMPVideoDecoderParent[%p]::RecvDecoded() timestamp=%lld frameCount=%d",
     this, aDecodedFrame.mTimestamp(), mFrameCount));
+  mStats->MessageReceived(aDecodedFrame.mYPlane().mSize() +
+                          aDecodedFrame.mUPlane().mSize() +
+                          aDecodedFrame.mVPlane().mSize());
+  mStats->ReplyReceived(aDecodedFrame.mTimestamp());
 
   if (!mCallback) {
     return IPC_FAIL_NO_REASON(this);
@@ -369,6 +385,7 @@ mozilla::ipc::IPCResult
 GMPVideoDecoderParent::RecvInputDataExhausted()
 {
   LOGV(("GMPVideoDecoderParent[%p]::RecvInputDataExhausted()", this));
+  mStats->MessageReceived();
 
   if (!mCallback) {
     return IPC_FAIL_NO_REASON(this);
@@ -384,6 +401,7 @@ mozilla::ipc::IPCResult
 GMPVideoDecoderParent::RecvDrainComplete()
 {
   LOGD(("GMPVideoDecoderParent[%p]::RecvDrainComplete() frameCount=%d", this, mFrameCount));
+  mStats->MessageReceived();
   nsAutoString msg;
   msg.AppendLiteral("GMPVideoDecoderParent::RecvDrainComplete() outstanding frames=");
   msg.AppendInt(mFrameCount);
@@ -407,6 +425,7 @@ mozilla::ipc::IPCResult
 GMPVideoDecoderParent::RecvResetComplete()
 {
   LOGD(("GMPVideoDecoderParent[%p]::RecvResetComplete()", this));
+  mStats->MessageReceived();
 
   CancelResetCompleteTimeout();
 
@@ -458,6 +477,7 @@ GMPVideoDecoderParent::RecvShutdown()
 mozilla::ipc::IPCResult
 GMPVideoDecoderParent::RecvParentShmemForPool(Shmem&& aEncodedBuffer)
 {
+  mStats->MessageReceived();
   if (aEncodedBuffer.IsWritable()) {
     mVideoHost.SharedMemMgr()->MgrDeallocShmem(GMPSharedMem::kGMPEncodedData,
                                                aEncodedBuffer);
@@ -469,6 +489,7 @@ mozilla::ipc::IPCResult
 GMPVideoDecoderParent::AnswerNeedShmem(const uint32_t& aFrameBufferSize,
                                        Shmem* aMem)
 {
+  mStats->NeedShmem();
   ipc::Shmem mem;
 
   if (!mVideoHost.SharedMemMgr()->MgrAllocShmem(GMPSharedMem::kGMPFrameData,
@@ -16,6 +16,7 @@
 #include "GMPVideoDecoderProxy.h"
 #include "VideoUtils.h"
 #include "GMPCrashHelperHolder.h"
+#include "GMPStats.h"
 
 namespace mozilla {
 namespace gmp {
@@ -96,6 +97,7 @@ private:
   const uint32_t mPluginId;
   int32_t mFrameCount;
   RefPtr<SimpleTimer> mResetCompleteTimeout;
+  RefPtr<GMPActorStats> mStats;
 };
 
 } // namespace gmp
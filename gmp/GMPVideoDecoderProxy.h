@@ -19,6 +19,9 @@ class GMPVideoDecoderCallbackProxy : public GMPCallbackBase,
 {
 public:
   virtual ~GMPVideoDecoderCallbackProxy() {}
+  // Called instead of Terminated() when the plugin went away unexpectedly,
+  // e.g. because its process crashed, rather than being shut down.
+  virtual void Crashed() { Terminated(); }
 };
 
 // A proxy to GMPVideoDecoder in the child process.
@@ -27,7 +30,7 @@ public:
 // an extra copy when doing so.
 
 // The consumer must call Close() when done with the codec, or when
-// Terminated() is called by the GMP plugin indicating an abnormal shutdown
+// Terminated() or Crashed() is called by the GMP plugin indicating a shutdown
 // of the underlying plugin.  After calling Close(), the consumer must
 // not access this again.
 
@@ -53,7 +53,8 @@ GMPVideoEncoderParent::GMPVideoEncoderParent(GMPContentParent *aPlugin)
   mPlugin(aPlugin),
   mCallback(nullptr),
   mVideoHost(this),
-  mPluginId(aPlugin->GetPluginId())
+  mPluginId(aPlugin->GetPluginId()),
+  mStats(aPlugin->CreateActorStats("video-encoder"))
 {
   MOZ_ASSERT(mPlugin);
 
@@ -139,9 +140,10 @@ GMPVideoEncoderParent::Encode(GMPUniquePtr<GMPVideoi420Frame> aInputFrame,
 
   // Very rough kill-switch if the plugin stops processing.  If it's merely
   // hung and continues, we'll come back to life eventually.
-  // 3* is because we're using 3 buffers per frame for i420 data for now.
-  if ((NumInUse(GMPSharedMem::kGMPFrameData) > 3*GMPSharedMem::kGMPBufLimit) ||
+  // i420 frames are sent in a single buffer each.
+  if ((NumInUse(GMPSharedMem::kGMPFrameData) > GMPSharedMem::kGMPBufLimit) ||
       (NumInUse(GMPSharedMem::kGMPEncodedData) > GMPSharedMem::kGMPBufLimit)) {
+    mStats->BufferLimitHit();
     return GMPGenericErr;
   }
 
@@ -153,6 +155,10 @@ GMPVideoEncoderParent::Encode(GMPUniquePtr<GMPVideoi420Frame> aInputFrame,
                   aFrameTypes)) {
     return GMPGenericErr;
   }
+  mStats->MessageSent(frameData.mYPlane().mSize() +
+                      frameData.mUPlane().mSize() +
+                      frameData.mVPlane().mSize());
+  mStats->RequestSent(frameData.mTimestamp());
 
   // Async IPC, we don't have access to a return value.
   return GMPNoErr;
@@ -269,6 +275,7 @@ GMPVideoEncoderParent::ActorDestroy(ActorDestroyReason aWhy)
     mPlugin = nullptr;
   }
   mVideoHost.ActorDestroyed(); // same as DoneWithAPI
+  mStats->ActorDestroyed();
   MaybeDisconnect(aWhy == AbnormalShutdown);
 }
 
@@ -295,6 +302,9 @@ GMPVideoEncoderParent::RecvEncoded(const GMPVideoEncodedFrameData& aEncodedFrame
     return IPC_FAIL_NO_REASON(this);
   }
 
+  mStats->MessageReceived(aEncodedFrame.mSize());
+  mStats->ReplyReceived(aEncodedFrame.mTimestamp());
+
   auto f = new GMPVideoEncodedFrameImpl(aEncodedFrame, &mVideoHost);
   nsTArray<uint8_t> *codecSpecificInfo = new nsTArray<uint8_t>;
   codecSpecificInfo->AppendElements((uint8_t*)aCodecSpecificInfo.Elements(), aCodecSpecificInfo.Length());
@@ -348,6 +358,7 @@ mozilla::ipc::IPCResult
 GMPVideoEncoderParent::AnswerNeedShmem(const uint32_t& aEncodedBufferSize,
                                        Shmem* aMem)
 {
+  mStats->NeedShmem();
   ipc::Shmem mem;
 
   // This test may be paranoia now that we don't shut down the VideoHost
@@ -15,6 +15,7 @@
 #include "GMPVideoHost.h"
 #include "GMPVideoEncoderProxy.h"
 #include "GMPCrashHelperHolder.h"
+#include "GMPStats.h"
 
 namespace mozilla {
 namespace gmp {
@@ -85,6 +86,7 @@ private:
   GMPVideoHostImpl mVideoHost;
   nsCOMPtr<nsIThread> mEncodedThread;
   const uint32_t mPluginId;
+  RefPtr<GMPActorStats> mStats;
 };
 
 } // namespace gmp
@@ -64,6 +64,7 @@ GMPPlaneImpl::InitPlaneData(GMPPlaneData& aPlaneData)
   aPlaneData.mBuffer() = mBuffer;
   aPlaneData.mSize() = mSize;
   aPlaneData.mStride() = mStride;
+  aPlaneData.mOffset() = 0;
 
   // This method is called right before Shmem is sent to another process.
   // We need to effectively zero out our member copy so that we don't
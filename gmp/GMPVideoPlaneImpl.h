@@ -33,6 +33,9 @@ public:
 
   bool InitPlaneData(GMPPlaneData& aPlaneData);
 
+  // Returns the buffer to the pool.
+  void DestroyBuffer();
+
   // GMPPlane
   GMPErr CreateEmptyPlane(int32_t aAllocatedSize,
                           int32_t aStride,
@@ -52,7 +55,6 @@ public:
 
 private:
   GMPErr MaybeResize(int32_t aNewSize);
-  void DestroyBuffer();
 
   ipc::Shmem mBuffer;
   int32_t mSize;
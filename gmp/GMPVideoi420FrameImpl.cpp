@@ -4,13 +4,21 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include "GMPVideoi420FrameImpl.h"
+#include "mozilla/CheckedInt.h"
+#include "mozilla/PodOperations.h"
 #include "mozilla/gmp/GMPTypes.h"
+#include <algorithm>
 
 namespace mozilla {
 namespace gmp {
 
+// Alignment of the planes in the contiguous layout.
+static const int32_t kPlaneAlignment = 16;
+
 GMPVideoi420FrameImpl::GMPVideoi420FrameImpl(GMPVideoHostImpl* aHost)
-: mYPlane(aHost),
+: mContiguous(true),
+  mBuffer(aHost),
+  mYPlane(aHost),
   mUPlane(aHost),
   mVPlane(aHost),
   mWidth(0),
@@ -19,11 +27,14 @@ GMPVideoi420FrameImpl::GMPVideoi420FrameImpl(GMPVideoHostImpl* aHost)
   mDuration(0ll)
 {
   MOZ_ASSERT(aHost);
+  PodArrayZero(mLayout);
 }
 
 GMPVideoi420FrameImpl::GMPVideoi420FrameImpl(const GMPVideoi420FrameData& aFrameData,
                                              GMPVideoHostImpl* aHost)
-: mYPlane(aFrameData.mYPlane(), aHost),
+: mContiguous(aFrameData.mBuffer().mBuffer().IsReadable()),
+  mBuffer(aFrameData.mBuffer(), aHost),
+  mYPlane(aFrameData.mYPlane(), aHost),
   mUPlane(aFrameData.mUPlane(), aHost),
   mVPlane(aFrameData.mVPlane(), aHost),
   mWidth(aFrameData.mWidth()),
@@ -32,6 +43,14 @@ GMPVideoi420FrameImpl::GMPVideoi420FrameImpl(const GMPVideoi420FrameData& aFrame
   mDuration(aFrameData.mDuration())
 {
   MOZ_ASSERT(aHost);
+  const GMPPlaneData* planes[] = { &aFrameData.mYPlane(),
+                                   &aFrameData.mUPlane(),
+                                   &aFrameData.mVPlane() };
+  for (int i = 0; i < kGMPNumOfPlanes; i++) {
+    mLayout[i].mOffset = mContiguous ? planes[i]->mOffset() : 0;
+    mLayout[i].mSize = planes[i]->mSize();
+    mLayout[i].mStride = planes[i]->mStride();
+  }
 }
 
 GMPVideoi420FrameImpl::~GMPVideoi420FrameImpl()
@@ -41,9 +60,24 @@ GMPVideoi420FrameImpl::~GMPVideoi420FrameImpl()
 bool
 GMPVideoi420FrameImpl::InitFrameData(GMPVideoi420FrameData& aFrameData)
 {
-  mYPlane.InitPlaneData(aFrameData.mYPlane());
-  mUPlane.InitPlaneData(aFrameData.mUPlane());
-  mVPlane.InitPlaneData(aFrameData.mVPlane());
+  if (mContiguous) {
+    mBuffer.InitPlaneData(aFrameData.mBuffer());
+    GMPPlaneData* planes[] = { &aFrameData.mYPlane(),
+                               &aFrameData.mUPlane(),
+                               &aFrameData.mVPlane() };
+    for (int i = 0; i < kGMPNumOfPlanes; i++) {
+      planes[i]->mOffset() = mLayout[i].mOffset;
+      planes[i]->mSize() = mLayout[i].mSize;
+      planes[i]->mStride() = mLayout[i].mStride;
+    }
+  } else {
+    mYPlane.InitPlaneData(aFrameData.mYPlane());
+    mUPlane.InitPlaneData(aFrameData.mUPlane());
+    mVPlane.InitPlaneData(aFrameData.mVPlane());
+    aFrameData.mBuffer().mSize() = 0;
+    aFrameData.mBuffer().mStride() = 0;
+    aFrameData.mBuffer().mOffset() = 0;
+  }
   aFrameData.mWidth() = mWidth;
   aFrameData.mHeight() = mHeight;
   aFrameData.mTimestamp() = mTimestamp;
@@ -63,6 +97,22 @@ GMPVideoi420FrameImpl::Destroy()
   delete this;
 }
 
+// Checks a plane of aHeight rows of at least aMinStride bytes lies within
+// aBuffer.
+static bool
+CheckPlaneData(const GMPPlaneData& aPlane, const ipc::Shmem& aBuffer,
+               int32_t aOffset, int32_t aMinStride, int32_t aHeight)
+{
+  if (aPlane.mStride() <= 0 || aPlane.mSize() <= 0 || aOffset < 0 ||
+      aPlane.mStride() < aMinStride || !aBuffer.IsReadable()) {
+    return false;
+  }
+  CheckedInt<int32_t> minSize = CheckedInt<int32_t>(aPlane.mStride()) * aHeight;
+  CheckedInt<size_t> end = CheckedInt<size_t>(aOffset) + aPlane.mSize();
+  return minSize.isValid() && aPlane.mSize() >= minSize.value() &&
+         end.isValid() && end.value() <= aBuffer.Size<uint8_t>();
+}
+
 /* static */ bool
 GMPVideoi420FrameImpl::CheckFrameData(const GMPVideoi420FrameData& aFrameData)
 {
@@ -70,22 +120,25 @@ GMPVideoi420FrameImpl::CheckFrameData(const GMPVideoi420FrameData& aFrameData)
   // This implies a bug or serious error on the child size.  Ignore this frame if so.
   // Note: Size() greater than expected is also an error, but with no negative consequences
   int32_t half_width = (aFrameData.mWidth() + 1) / 2;
-  if ((aFrameData.mYPlane().mStride() <= 0) || (aFrameData.mYPlane().mSize() <= 0) ||
-      (aFrameData.mUPlane().mStride() <= 0) || (aFrameData.mUPlane().mSize() <= 0) ||
-      (aFrameData.mVPlane().mStride() <= 0) || (aFrameData.mVPlane().mSize() <= 0) ||
-      (aFrameData.mYPlane().mSize() > (int32_t) aFrameData.mYPlane().mBuffer().Size<uint8_t>()) ||
-      (aFrameData.mUPlane().mSize() > (int32_t) aFrameData.mUPlane().mBuffer().Size<uint8_t>()) ||
-      (aFrameData.mVPlane().mSize() > (int32_t) aFrameData.mVPlane().mBuffer().Size<uint8_t>()) ||
-      (aFrameData.mYPlane().mStride() < aFrameData.mWidth()) ||
-      (aFrameData.mUPlane().mStride() < half_width) ||
-      (aFrameData.mVPlane().mStride() < half_width) ||
-      (aFrameData.mYPlane().mSize() < aFrameData.mYPlane().mStride() * aFrameData.mHeight()) ||
-      (aFrameData.mUPlane().mSize() < aFrameData.mUPlane().mStride() * ((aFrameData.mHeight()+1)/2)) ||
-      (aFrameData.mVPlane().mSize() < aFrameData.mVPlane().mStride() * ((aFrameData.mHeight()+1)/2)))
-  {
-    return false;
+  int32_t half_height = (aFrameData.mHeight() + 1) / 2;
+  if (aFrameData.mBuffer().mBuffer().IsReadable()) {
+    const ipc::Shmem& buffer = aFrameData.mBuffer().mBuffer();
+    return CheckPlaneData(aFrameData.mYPlane(), buffer,
+                          aFrameData.mYPlane().mOffset(),
+                          aFrameData.mWidth(), aFrameData.mHeight()) &&
+           CheckPlaneData(aFrameData.mUPlane(), buffer,
+                          aFrameData.mUPlane().mOffset(),
+                          half_width, half_height) &&
+           CheckPlaneData(aFrameData.mVPlane(), buffer,
+                          aFrameData.mVPlane().mOffset(),
+                          half_width, half_height);
   }
-  return true;
+  return CheckPlaneData(aFrameData.mYPlane(), aFrameData.mYPlane().mBuffer(), 0,
+                        aFrameData.mWidth(), aFrameData.mHeight()) &&
+         CheckPlaneData(aFrameData.mUPlane(), aFrameData.mUPlane().mBuffer(), 0,
+                        half_width, half_height) &&
+         CheckPlaneData(aFrameData.mVPlane(), aFrameData.mVPlane().mBuffer(), 0,
+                        half_width, half_height);
 }
 
 bool
@@ -131,6 +184,61 @@ GMPVideoi420FrameImpl::GetPlane(GMPPlaneType aType) {
   return nullptr;
 }
 
+const GMPVideoi420FrameImpl::PlaneLayout&
+GMPVideoi420FrameImpl::Layout(GMPPlaneType aType) const
+{
+  switch (aType) {
+    case kGMPYPlane:
+    case kGMPUPlane:
+    case kGMPVPlane:
+      return mLayout[aType];
+    default:
+      MOZ_CRASH("Unknown plane type!");
+  }
+}
+
+GMPErr
+GMPVideoi420FrameImpl::CreateContiguousBuffer(const int32_t (&aSizes)[kGMPNumOfPlanes],
+                                              const int32_t (&aStrides)[kGMPNumOfPlanes])
+{
+  PlaneLayout layout[kGMPNumOfPlanes];
+  CheckedInt<int32_t> size = 0;
+  for (int i = 0; i < kGMPNumOfPlanes; i++) {
+    size = (size + kPlaneAlignment - 1) / kPlaneAlignment * kPlaneAlignment;
+    if (!size.isValid()) {
+      return GMPGenericErr;
+    }
+    layout[i].mOffset = size.value();
+    layout[i].mSize = aSizes[i];
+    layout[i].mStride = aStrides[i];
+    size += aSizes[i];
+  }
+  if (!size.isValid()) {
+    return GMPGenericErr;
+  }
+
+  GMPErr err = mBuffer.CreateEmptyPlane(size.value(), size.value(), size.value());
+  if (err != GMPNoErr) {
+    return err;
+  }
+  PodArrayCopy(mLayout, layout);
+  mContiguous = true;
+  mYPlane.DestroyBuffer();
+  mUPlane.DestroyBuffer();
+  mVPlane.DestroyBuffer();
+  return GMPNoErr;
+}
+
+int32_t
+GMPVideoi420FrameImpl::ContiguousSize() const
+{
+  int32_t size = 0;
+  for (const PlaneLayout& plane : mLayout) {
+    size = std::max(size, plane.mOffset + plane.mSize);
+  }
+  return size;
+}
+
 GMPErr
 GMPVideoi420FrameImpl::CreateEmptyFrame(int32_t aWidth, int32_t aHeight,
                                         int32_t aStride_y, int32_t aStride_u, int32_t aStride_v)
@@ -144,15 +252,9 @@ GMPVideoi420FrameImpl::CreateEmptyFrame(int32_t aWidth, int32_t aHeight,
   int32_t size_u = aStride_u * half_height;
   int32_t size_v = aStride_v * half_height;
 
-  GMPErr err = mYPlane.CreateEmptyPlane(size_y, aStride_y, size_y);
-  if (err != GMPNoErr) {
-    return err;
-  }
-  err = mUPlane.CreateEmptyPlane(size_u, aStride_u, size_u);
-  if (err != GMPNoErr) {
-    return err;
-  }
-  err = mVPlane.CreateEmptyPlane(size_v, aStride_v, size_v);
+  const int32_t sizes[] = { size_y, size_u, size_v };
+  const int32_t strides[] = { aStride_y, aStride_u, aStride_v };
+  GMPErr err = CreateContiguousBuffer(sizes, strides);
   if (err != GMPNoErr) {
     return err;
   }
@@ -184,18 +286,15 @@ GMPVideoi420FrameImpl::CreateFrame(int32_t aSize_y, const uint8_t* aBuffer_y,
     return GMPGenericErr;
   }
 
-  GMPErr err = mYPlane.Copy(aSize_y, aStride_y, aBuffer_y);
-  if (err != GMPNoErr) {
-    return err;
-  }
-  err = mUPlane.Copy(aSize_u, aStride_u, aBuffer_u);
-  if (err != GMPNoErr) {
-    return err;
-  }
-  err = mVPlane.Copy(aSize_v, aStride_v, aBuffer_v);
+  const int32_t sizes[] = { aSize_y, aSize_u, aSize_v };
+  const int32_t strides[] = { aStride_y, aStride_u, aStride_v };
+  GMPErr err = CreateContiguousBuffer(sizes, strides);
   if (err != GMPNoErr) {
     return err;
   }
+  memcpy(Buffer(kGMPYPlane), aBuffer_y, aSize_y);
+  memcpy(Buffer(kGMPUPlane), aBuffer_u, aSize_u);
+  memcpy(Buffer(kGMPVPlane), aBuffer_v, aSize_v);
 
   mWidth = aWidth;
   mHeight = aHeight;
@@ -208,19 +307,34 @@ GMPVideoi420FrameImpl::CopyFrame(const GMPVideoi420Frame& aFrame)
 {
   auto& f = static_cast<const GMPVideoi420FrameImpl&>(aFrame);
 
-  GMPErr err = mYPlane.Copy(f.mYPlane);
-  if (err != GMPNoErr) {
-    return err;
-  }
-
-  err = mUPlane.Copy(f.mUPlane);
-  if (err != GMPNoErr) {
-    return err;
-  }
-
-  err = mVPlane.Copy(f.mVPlane);
-  if (err != GMPNoErr) {
-    return err;
+  if (f.mContiguous) {
+    int32_t size = f.ContiguousSize();
+    GMPErr err = mBuffer.Copy(size, size, f.mBuffer.Buffer());
+    if (err != GMPNoErr) {
+      return err;
+    }
+    PodArrayCopy(mLayout, f.mLayout);
+    mContiguous = true;
+    mYPlane.DestroyBuffer();
+    mUPlane.DestroyBuffer();
+    mVPlane.DestroyBuffer();
+  } else {
+    GMPErr err = mYPlane.Copy(f.mYPlane);
+    if (err != GMPNoErr) {
+      return err;
+    }
+
+    err = mUPlane.Copy(f.mUPlane);
+    if (err != GMPNoErr) {
+      return err;
+    }
+
+    err = mVPlane.Copy(f.mVPlane);
+    if (err != GMPNoErr) {
+      return err;
+    }
+    mContiguous = false;
+    mBuffer.DestroyBuffer();
   }
 
   mWidth = f.mWidth;
@@ -235,6 +349,9 @@ void
 GMPVideoi420FrameImpl::SwapFrame(GMPVideoi420Frame* aFrame)
 {
   auto f = static_cast<GMPVideoi420FrameImpl*>(aFrame);
+  std::swap(mContiguous, f->mContiguous);
+  mBuffer.Swap(f->mBuffer);
+  std::swap(mLayout, f->mLayout);
   mYPlane.Swap(f->mYPlane);
   mUPlane.Swap(f->mUPlane);
   mVPlane.Swap(f->mVPlane);
@@ -247,6 +364,10 @@ GMPVideoi420FrameImpl::SwapFrame(GMPVideoi420Frame* aFrame)
 uint8_t*
 GMPVideoi420FrameImpl::Buffer(GMPPlaneType aType)
 {
+  if (mContiguous) {
+    uint8_t* buffer = mBuffer.Buffer();
+    return buffer ? buffer + Layout(aType).mOffset : nullptr;
+  }
   GMPPlane* p = GetPlane(aType);
   if (p) {
     return p->Buffer();
@@ -257,7 +378,11 @@ GMPVideoi420FrameImpl::Buffer(GMPPlaneType aType)
 const uint8_t*
 GMPVideoi420FrameImpl::Buffer(GMPPlaneType aType) const
 {
- const GMPPlane* p = GetPlane(aType);
+  if (mContiguous) {
+    const uint8_t* buffer = mBuffer.Buffer();
+    return buffer ? buffer + Layout(aType).mOffset : nullptr;
+  }
+  const GMPPlane* p = GetPlane(aType);
   if (p) {
     return p->Buffer();
   }
@@ -267,6 +392,9 @@ GMPVideoi420FrameImpl::Buffer(GMPPlaneType aType) const
 int32_t
 GMPVideoi420FrameImpl::AllocatedSize(GMPPlaneType aType) const
 {
+  if (mContiguous) {
+    return mBuffer.AllocatedSize() ? Layout(aType).mSize : 0;
+  }
   const GMPPlane* p = GetPlane(aType);
   if (p) {
     return p->AllocatedSize();
@@ -277,6 +405,9 @@ GMPVideoi420FrameImpl::AllocatedSize(GMPPlaneType aType) const
 int32_t
 GMPVideoi420FrameImpl::Stride(GMPPlaneType aType) const
 {
+  if (mContiguous) {
+    return Layout(aType).mStride;
+  }
   const GMPPlane* p = GetPlane(aType);
   if (p) {
     return p->Stride();
@@ -288,8 +419,8 @@ GMPErr
 GMPVideoi420FrameImpl::SetWidth(int32_t aWidth)
 {
   if (!CheckDimensions(aWidth, mHeight,
-                       mYPlane.Stride(), mUPlane.Stride(),
-                       mVPlane.Stride())) {
+                       Stride(kGMPYPlane), Stride(kGMPUPlane),
+                       Stride(kGMPVPlane))) {
     return GMPGenericErr;
   }
   mWidth = aWidth;
@@ -300,8 +431,8 @@ GMPErr
 GMPVideoi420FrameImpl::SetHeight(int32_t aHeight)
 {
   if (!CheckDimensions(mWidth, aHeight,
-                       mYPlane.Stride(), mUPlane.Stride(),
-                       mVPlane.Stride())) {
+                       Stride(kGMPYPlane), Stride(kGMPUPlane),
+                       Stride(kGMPVPlane))) {
     return GMPGenericErr;
   }
   mHeight = aHeight;
@@ -347,12 +478,20 @@ GMPVideoi420FrameImpl::Duration() const
 bool
 GMPVideoi420FrameImpl::IsZeroSize() const
 {
+  if (mContiguous) {
+    return !mLayout[kGMPYPlane].mSize && !mLayout[kGMPUPlane].mSize &&
+           !mLayout[kGMPVPlane].mSize;
+  }
   return (mYPlane.IsZeroSize() && mUPlane.IsZeroSize() && mVPlane.IsZeroSize());
 }
 
 void
 GMPVideoi420FrameImpl::ResetSize()
 {
+  for (PlaneLayout& plane : mLayout) {
+    plane.mSize = 0;
+  }
+  mBuffer.ResetSize();
   mYPlane.ResetSize();
   mUPlane.ResetSize();
   mVPlane.ResetSize();
@@ -15,6 +15,9 @@ namespace gmp {
 
 class GMPVideoi420FrameData;
 
+// Frames are stored and sent either in a single shmem segment holding the
+// three planes (the contiguous layout, used for all frames created on this
+// side) or in one segment per plane, as sent by older versions.
 class GMPVideoi420FrameImpl : public GMPVideoi420Frame
 {
   friend struct IPC::ParamTraits<mozilla::gmp::GMPVideoi420FrameImpl>;
@@ -65,9 +68,28 @@ public:
   void ResetSize() override;
 
 private:
+  // Where a plane lies in mBuffer, in the contiguous layout.
+  struct PlaneLayout
+  {
+    int32_t mOffset;
+    int32_t mSize;
+    int32_t mStride;
+  };
+
   bool CheckDimensions(int32_t aWidth, int32_t aHeight,
                        int32_t aStride_y, int32_t aStride_u, int32_t aStride_v);
+  const PlaneLayout& Layout(GMPPlaneType aType) const;
+  // Lays the planes out in mBuffer, growing it if needed, and releases the
+  // per-plane buffers.
+  GMPErr CreateContiguousBuffer(const int32_t (&aSizes)[kGMPNumOfPlanes],
+                                const int32_t (&aStrides)[kGMPNumOfPlanes]);
+  // Bytes of mBuffer used by the planes.
+  int32_t ContiguousSize() const;
 
+  bool mContiguous;
+  GMPPlaneImpl mBuffer;
+  PlaneLayout mLayout[kGMPNumOfPlanes];
+  // Planes of the three-segment layout.
   GMPPlaneImpl mYPlane;
   GMPPlaneImpl mUPlane;
   GMPPlaneImpl mVPlane;
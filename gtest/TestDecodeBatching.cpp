@@ -0,0 +1,147 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "gtest/gtest.h"
+#include "DecodeBatching.h"
+#include "MediaData.h"
+#include "PlatformDecoderModule.h"
+
+using namespace mozilla;
+
+static already_AddRefed<MediaRawData>
+MakeSample(int64_t aTime)
+{
+  RefPtr<MediaRawData> sample = new MediaRawData();
+  sample->mTime = aTime;
+  return sample.forget();
+}
+
+TEST(InputBatcher, BatchesUntilTaken)
+{
+  InputBatcher batcher;
+  EXPECT_TRUE(batcher.Push(RefPtr<MediaRawData>(MakeSample(0))));
+  EXPECT_FALSE(batcher.Push(RefPtr<MediaRawData>(MakeSample(1))));
+  EXPECT_FALSE(batcher.Push(RefPtr<MediaRawData>(MakeSample(2))));
+
+  nsTArray<RefPtr<MediaRawData>> batch = batcher.TakeBatch();
+  ASSERT_EQ(3u, batch.Length());
+  EXPECT_EQ(2, batch[2]->mTime);
+
+  // Once taken, the next sample needs a new task.
+  EXPECT_TRUE(batcher.Push(RefPtr<MediaRawData>(MakeSample(3))));
+  EXPECT_EQ(1u, batcher.TakeBatch().Length());
+}
+
+TEST(InputBatcher, SealKeepsOrder)
+{
+  InputBatcher batcher;
+  EXPECT_TRUE(batcher.Push(RefPtr<MediaRawData>(MakeSample(0))));
+  // E.g. a drain dispatched after the first sample; the second one mustn't
+  // be decoded before it.
+  batcher.Seal();
+  EXPECT_TRUE(batcher.Push(RefPtr<MediaRawData>(MakeSample(1))));
+
+  nsTArray<RefPtr<MediaRawData>> first = batcher.TakeBatch();
+  ASSERT_EQ(1u, first.Length());
+  EXPECT_EQ(0, first[0]->mTime);
+  nsTArray<RefPtr<MediaRawData>> second = batcher.TakeBatch();
+  ASSERT_EQ(1u, second.Length());
+  EXPECT_EQ(1, second[0]->mTime);
+}
+
+TEST(InputBatcher, ClearDropsQueuedBatches)
+{
+  InputBatcher batcher;
+  EXPECT_TRUE(batcher.Push(RefPtr<MediaRawData>(MakeSample(0))));
+  batcher.Clear();
+  EXPECT_TRUE(batcher.Push(RefPtr<MediaRawData>(MakeSample(1))));
+
+  // The task of the dropped batch gets nothing, the next one gets the sample
+  // pushed after clearing.
+  EXPECT_TRUE(batcher.TakeBatch().IsEmpty());
+  nsTArray<RefPtr<MediaRawData>> batch = batcher.TakeBatch();
+  ASSERT_EQ(1u, batch.Length());
+  EXPECT_EQ(1, batch[0]->mTime);
+}
+
+class AudioCallback : public MediaDataDecoderCallback
+{
+public:
+  void Output(MediaData* aData) override
+  {
+    mOutput.AppendElement(static_cast<AudioData*>(aData));
+  }
+  void Error(const MediaResult& aError) override {}
+  void InputExhausted() override {}
+  void DrainComplete() override {}
+  bool OnReaderTaskQueue() override { return true; }
+
+  nsTArray<RefPtr<AudioData>> mOutput;
+};
+
+// 10ms of stereo audio at 48kHz, whose samples are aValue.
+static already_AddRefed<AudioData>
+MakeAudio(int64_t aTime, AudioDataValue aValue, uint32_t aRate = 48000)
+{
+  const uint32_t frames = aRate / 100;
+  AlignedAudioBuffer buffer(frames * 2);
+  for (uint32_t i = 0; i < frames * 2; i++) {
+    buffer[i] = aValue;
+  }
+  RefPtr<AudioData> data =
+    new AudioData(aTime, aTime, 10000, frames, Move(buffer), 2, aRate);
+  return data.forget();
+}
+
+TEST(AudioDataMerger, MergesContiguousData)
+{
+  AudioCallback callback;
+  AudioDataMerger merger(&callback, 30000);
+  for (int i = 0; i < 5; i++) {
+    merger.Output(RefPtr<AudioData>(MakeAudio(i * 10000, i)));
+  }
+  merger.OutputPending();
+
+  // Merged in chunks of up to 30ms.
+  ASSERT_EQ(2u, callback.mOutput.Length());
+  EXPECT_EQ(0, callback.mOutput[0]->mTime);
+  EXPECT_EQ(30000, callback.mOutput[0]->mDuration);
+  EXPECT_EQ(1440u, callback.mOutput[0]->mFrames);
+  EXPECT_EQ(AudioDataValue(2), callback.mOutput[0]->mAudioData[1440 * 2 - 1]);
+  EXPECT_EQ(30000, callback.mOutput[1]->mTime);
+  EXPECT_EQ(20000, callback.mOutput[1]->mDuration);
+  EXPECT_EQ(AudioDataValue(3), callback.mOutput[1]->mAudioData[0]);
+}
+
+TEST(AudioDataMerger, KeepsDiscontinuities)
+{
+  AudioCallback callback;
+  AudioDataMerger merger(&callback);
+  merger.Output(RefPtr<AudioData>(MakeAudio(0, 0)));
+  // A gap.
+  merger.Output(RefPtr<AudioData>(MakeAudio(20000, 1)));
+  // A rate change.
+  merger.Output(RefPtr<AudioData>(MakeAudio(30000, 2, 44100)));
+  // A flagged discontinuity.
+  RefPtr<AudioData> discontinuity = MakeAudio(40000, 3, 44100);
+  discontinuity->mDiscontinuity = true;
+  merger.Output(discontinuity);
+  merger.OutputPending();
+
+  ASSERT_EQ(4u, callback.mOutput.Length());
+  EXPECT_EQ(20000, callback.mOutput[1]->mTime);
+  EXPECT_EQ(44100u, callback.mOutput[2]->mRate);
+  EXPECT_TRUE(callback.mOutput[3]->mDiscontinuity);
+}
+
+TEST(AudioDataMerger, ResetDropsPendingData)
+{
+  AudioCallback callback;
+  AudioDataMerger merger(&callback);
+  merger.Output(RefPtr<AudioData>(MakeAudio(0, 0)));
+  merger.Reset();
+  merger.OutputPending();
+  EXPECT_TRUE(callback.mOutput.IsEmpty());
+}
@@ -0,0 +1,115 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "gtest/gtest.h"
+#include "MediaInfo.h"
+#include "PDMFactory.h"
+#include "mozilla/ArrayUtils.h"
+#include "mozilla/SharedThreadPool.h"
+#include "mozilla/TaskQueue.h"
+#include "VideoUtils.h"
+
+using namespace mozilla;
+
+class NullCallback : public MediaDataDecoderCallback
+{
+public:
+  void Output(MediaData* aData) override {}
+  void Error(const MediaResult& aError) override {}
+  void InputExhausted() override {}
+  void DrainComplete() override {}
+  bool OnReaderTaskQueue() override { return true; }
+};
+
+// avcC configuration of 1280x720 baseline H.264, so that H264Converter
+// creates the actual decoder right away rather than waiting for an SPS.
+static const uint8_t sAvcC[] = {
+  0x01, 0x42, 0xc0, 0x1f, 0xff,
+  0xe1, 0x00, 0x09, 0x67, 0x42, 0xc0, 0x1f, 0xda, 0x01, 0x40, 0x16, 0xe4,
+  0x01, 0x00, 0x04, 0x68, 0xce, 0x3c, 0x80,
+};
+
+static bool
+IsFFmpegDecoder(MediaDataDecoder* aDecoder)
+{
+  return !strcmp(aDecoder->GetDescriptionName(), "ffmpeg video decoder") ||
+         !strcmp(aDecoder->GetDescriptionName(), "ffvpx video decoder");
+}
+
+// Creates, initializes and shuts down FFmpeg decoders for aMimeType from
+// several task queues at once, as happens when a page starts many videos
+// together. Does nothing if another PDM handles aMimeType.
+static void
+CreateConcurrently(const char* aMimeType)
+{
+  const uint32_t kQueues = 8;
+  const uint32_t kDecodersPerQueue = 16;
+
+  RefPtr<PDMFactory> factory = new PDMFactory();
+  VideoInfo info(1280, 720);
+  info.mMimeType = aMimeType;
+  if (info.mMimeType.EqualsLiteral("video/avc")) {
+    info.mExtraData->AppendElements(sAvcC, MOZ_ARRAY_LENGTH(sAvcC));
+  }
+  if (!factory->Supports(info, nullptr)) {
+    return;
+  }
+
+  NullCallback callback;
+  bool isFFmpeg = false;
+  RefPtr<TaskQueue> probeQueue =
+    new TaskQueue(GetMediaThreadPool(MediaThreadType::PLATFORM_DECODER));
+  probeQueue->Dispatch(NS_NewRunnableFunction([&]() {
+    RefPtr<MediaDataDecoder> decoder =
+      factory->CreateDecoder(CreateDecoderParams(info, probeQueue.get(),
+                                                 &callback));
+    if (decoder) {
+      isFFmpeg = IsFFmpegDecoder(decoder);
+      decoder->Shutdown();
+    }
+  }));
+  probeQueue->BeginShutdown();
+  probeQueue->AwaitShutdownAndIdle();
+  if (!isFFmpeg) {
+    return;
+  }
+
+  Atomic<uint32_t> created(0);
+  nsTArray<RefPtr<TaskQueue>> queues;
+  for (uint32_t i = 0; i < kQueues; i++) {
+    RefPtr<TaskQueue> queue =
+      new TaskQueue(GetMediaThreadPool(MediaThreadType::PLATFORM_DECODER));
+    for (uint32_t j = 0; j < kDecodersPerQueue; j++) {
+      queue->Dispatch(NS_NewRunnableFunction([&, queue]() {
+        RefPtr<MediaDataDecoder> decoder =
+          factory->CreateDecoder(CreateDecoderParams(info, queue.get(),
+                                                     &callback));
+        if (!decoder) {
+          return;
+        }
+        created++;
+        decoder->Init();
+        decoder->Shutdown();
+      }));
+    }
+    queues.AppendElement(queue);
+  }
+
+  for (auto& queue : queues) {
+    queue->BeginShutdown();
+    queue->AwaitShutdownAndIdle();
+  }
+  EXPECT_EQ(kQueues * kDecodersPerQueue, uint32_t(created));
+}
+
+TEST(DecoderCreation, ConcurrentH264)
+{
+  CreateConcurrently("video/avc");
+}
+
+TEST(DecoderCreation, ConcurrentVP9)
+{
+  CreateConcurrently("video/vp9");
+}
@@ -0,0 +1,291 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "gtest/gtest.h"
+#include "FuzzingWrapper.h"
+#include "MediaData.h"
+#include "mozilla/Logging.h"
+#include "nsPrintfCString.h"
+#include "nsThreadUtils.h"
+
+using namespace mozilla;
+
+static LazyLogModule sBenchmarkLog("DecoderLatencyBenchmark");
+#define BENCH_LOG(msg, ...) \
+  MOZ_LOG(sBenchmarkLog, LogLevel::Info, (msg, ##__VA_ARGS__))
+
+static DecoderLatencyModel
+JitteryModel(uint64_t aSeed)
+{
+  DecoderLatencyModel model;
+  model.mSeed = aSeed;
+  model.mMeanLatency = TimeDuration::FromMilliseconds(10);
+  model.mLatencyJitter = TimeDuration::FromMilliseconds(5);
+  return model;
+}
+
+TEST(DecoderLatencyModel, SameSeedSameSchedule)
+{
+  TimeStamp now = TimeStamp::Now();
+  DecoderLatencySimulator a(JitteryModel(42));
+  DecoderLatencySimulator b(JitteryModel(42));
+  DecoderLatencySimulator c(JitteryModel(43));
+  bool differs = false;
+  for (int i = 0; i < 100; i++) {
+    TimeStamp batchA, batchB, batchC;
+    TimeStamp dueA = a.NextFrameDue(now, &batchA);
+    TimeStamp dueB = b.NextFrameDue(now, &batchB);
+    TimeStamp dueC = c.NextFrameDue(now, &batchC);
+    EXPECT_EQ(dueA, dueB);
+    EXPECT_GE((dueA - now).ToMilliseconds(), 5.0 - 1e-3);
+    EXPECT_LE((dueA - now).ToMilliseconds(), 15.0 + 1e-3);
+    differs |= dueA != dueC;
+    now += TimeDuration::FromMilliseconds(20);
+  }
+  EXPECT_TRUE(differs) << "Different seeds should give different latencies";
+}
+
+TEST(DecoderLatencyModel, OutputStaysInOrder)
+{
+  DecoderLatencySimulator sim(JitteryModel(7));
+  TimeStamp now = TimeStamp::Now();
+  TimeStamp previous;
+  for (int i = 0; i < 100; i++) {
+    TimeStamp batch;
+    // Input arrives faster than the jitter, so latencies would reorder frames
+    // if the simulator didn't prevent it.
+    TimeStamp due = sim.NextFrameDue(now, &batch);
+    if (!previous.IsNull()) {
+      EXPECT_GE(due, previous);
+    }
+    previous = due;
+    now += TimeDuration::FromMilliseconds(1);
+  }
+}
+
+TEST(DecoderLatencyModel, PeriodicStalls)
+{
+  DecoderLatencyModel model;
+  model.mStallPeriod = 5;
+  model.mStallDuration = TimeDuration::FromMilliseconds(100);
+  DecoderLatencySimulator sim(model);
+  TimeStamp now = TimeStamp::Now();
+  for (int i = 1; i <= 20; i++) {
+    TimeStamp batch;
+    TimeStamp due = sim.NextFrameDue(now, &batch);
+    if (i % 5 == 0) {
+      EXPECT_EQ((due - now).ToMilliseconds(), 100.0);
+    } else {
+      EXPECT_EQ(due, now);
+    }
+    // Far enough apart that a stall doesn't push the next frame back.
+    now += TimeDuration::FromMilliseconds(200);
+  }
+  EXPECT_EQ(sim.Stalls(), 4u);
+}
+
+TEST(DecoderLatencyModel, Batching)
+{
+  DecoderLatencyModel model;
+  model.mBatchSize = 3;
+  DecoderLatencySimulator sim(model);
+  TimeStamp now = TimeStamp::Now();
+  TimeStamp batch;
+  EXPECT_TRUE(sim.NextFrameDue(now, &batch).IsNull());
+  EXPECT_TRUE(sim.NextFrameDue(now, &batch).IsNull());
+  EXPECT_TRUE(batch.IsNull());
+  EXPECT_EQ(sim.FramesInBatch(), 2u);
+  EXPECT_FALSE(sim.NextFrameDue(now, &batch).IsNull());
+  EXPECT_EQ(batch, now);
+  EXPECT_EQ(sim.FramesInBatch(), 0u);
+
+  EXPECT_TRUE(sim.NextFrameDue(now, &batch).IsNull());
+  EXPECT_EQ(sim.FlushBatch(), now);
+  EXPECT_EQ(sim.FramesInBatch(), 0u);
+}
+
+// Decoder outputting one frame per input sample, immediately.
+class InstantDecoder : public MediaDataDecoder
+{
+public:
+  explicit InstantDecoder(MediaDataDecoderCallback* aCallback)
+    : mCallback(aCallback)
+  {}
+
+  RefPtr<InitPromise> Init() override
+  {
+    return InitPromise::CreateAndResolve(TrackInfo::kVideoTrack, __func__);
+  }
+  void Input(MediaRawData* aSample) override
+  {
+    mCallback->Output(new NullData(aSample->mOffset, aSample->mTime,
+                                   aSample->mDuration));
+    mCallback->InputExhausted();
+  }
+  void Flush() override {}
+  void Drain() override { mCallback->DrainComplete(); }
+  void Shutdown() override {}
+  const char* GetDescriptionName() const override { return "instant decoder"; }
+
+private:
+  MediaDataDecoderCallback* mCallback;
+};
+
+// Plays back a stream through the latency model as a media element would:
+// samples are fed as soon as the decoder asks for more, and each frame is
+// due at its presentation time after a fixed preroll.
+//
+// Underruns depend on the wall clock, so the benchmarks are disabled. Run
+// them with --gtest_also_run_disabled_tests and
+// --gtest_filter='DecoderLatencyModel.DISABLED_Benchmark*'; each records one
+// property, also logged with MOZ_LOG=DecoderLatencyBenchmark:3.
+class LatencyBenchmark : public MediaDataDecoderCallback
+{
+public:
+  NS_INLINE_DECL_THREADSAFE_REFCOUNTING(LatencyBenchmark)
+
+  struct Result
+  {
+    uint32_t mFrames = 0;
+    uint32_t mUnderruns = 0;
+    uint32_t mDropped = 0;
+    bool mInOrder = true;
+    DecoderLatencyStats mStats;
+  };
+
+  LatencyBenchmark(const DecoderLatencyModel& aModel, uint32_t aFrames,
+                   TimeDuration aFrameDuration, TimeDuration aPreroll)
+    : mFrames(aFrames)
+    , mFrameDuration(aFrameDuration)
+    , mPreroll(aPreroll)
+  {
+    mCallbackWrapper = new DecoderCallbackFuzzingWrapper(this);
+    mCallbackWrapper->SetLatencyModel(aModel);
+    RefPtr<MediaDataDecoder> decoder = new InstantDecoder(mCallbackWrapper);
+    RefPtr<DecoderCallbackFuzzingWrapper> callbackWrapper = mCallbackWrapper;
+    mDecoder = new DecoderFuzzingWrapper(decoder.forget(),
+                                         callbackWrapper.forget());
+  }
+
+  Result Run()
+  {
+    mStart = TimeStamp::Now();
+    FeedNext();
+    while (!mDone) {
+      NS_ProcessNextEvent();
+    }
+    mResult.mStats = mCallbackWrapper->GetLatencyStats();
+    mDecoder->Shutdown();
+    return mResult;
+  }
+
+  // MediaDataDecoderCallback, called on the wrapper's task queue.
+  void Output(MediaData* aData) override
+  {
+    TimeStamp deadline = mStart + mPreroll +
+      TimeDuration::FromMicroseconds(aData->mTime);
+    TimeStamp now = TimeStamp::Now();
+    if (now > deadline + mFrameDuration) {
+      mResult.mDropped++;
+    } else if (now > deadline) {
+      mResult.mUnderruns++;
+    }
+    if (aData->mTime < mLastTime) {
+      mResult.mInOrder = false;
+    }
+    mLastTime = aData->mTime;
+    mResult.mFrames++;
+  }
+  void Error(const MediaResult& aError) override { Finish(); }
+  void InputExhausted() override
+  {
+    NS_DispatchToMainThread(NewRunnableMethod(this, &LatencyBenchmark::FeedNext));
+  }
+  void DrainComplete() override { Finish(); }
+  bool OnReaderTaskQueue() override { return true; }
+
+private:
+  void FeedNext()
+  {
+    if (mFed == mFrames) {
+      if (!mDraining) {
+        mDraining = true;
+        mDecoder->Drain();
+      }
+      return;
+    }
+    RefPtr<MediaRawData> sample = new MediaRawData();
+    sample->mTime = mFrameDuration.ToMicroseconds() * mFed;
+    sample->mDuration = mFrameDuration.ToMicroseconds();
+    sample->mOffset = mFed;
+    mFed++;
+    mDecoder->Input(sample);
+  }
+  void Finish()
+  {
+    NS_DispatchToMainThread(NS_NewRunnableFunction([this]() { mDone = true; }));
+  }
+
+  ~LatencyBenchmark() {}
+
+  const uint32_t mFrames;
+  const TimeDuration mFrameDuration;
+  const TimeDuration mPreroll;
+  RefPtr<DecoderCallbackFuzzingWrapper> mCallbackWrapper;
+  RefPtr<MediaDataDecoder> mDecoder;
+  TimeStamp mStart;
+  uint32_t mFed = 0;
+  bool mDraining = false;
+  bool mDone = false;
+  int64_t mLastTime = -1;
+  Result mResult;
+};
+
+static LatencyBenchmark::Result
+RunLatencyBenchmark(const char* aName, const DecoderLatencyModel& aModel)
+{
+  RefPtr<LatencyBenchmark> benchmark =
+    new LatencyBenchmark(aModel, 60,
+                         TimeDuration::FromMilliseconds(10),
+                         TimeDuration::FromMilliseconds(30));
+  LatencyBenchmark::Result result = benchmark->Run();
+  nsPrintfCString results("frames=%u underruns=%u dropped=%u stalls=%u "
+                          "max-queued=%u",
+                          result.mFrames, result.mUnderruns, result.mDropped,
+                          result.mStats.mStalls,
+                          result.mStats.mMaxQueuedFrames);
+  BENCH_LOG("%s: %s", aName, results.get());
+  ::testing::Test::RecordProperty(aName, results.get());
+  EXPECT_EQ(result.mFrames, 60u);
+  EXPECT_EQ(result.mStats.mFramesOutput, 60u);
+  EXPECT_TRUE(result.mInOrder);
+  return result;
+}
+
+TEST(DecoderLatencyModel, DISABLED_BenchmarkJitter)
+{
+  DecoderLatencyModel model = JitteryModel(1);
+  RunLatencyBenchmark("jitter", model);
+}
+
+TEST(DecoderLatencyModel, DISABLED_BenchmarkStalls)
+{
+  DecoderLatencyModel model;
+  model.mMeanLatency = TimeDuration::FromMilliseconds(8);
+  model.mStallPeriod = 20;
+  model.mStallDuration = TimeDuration::FromMilliseconds(150);
+  LatencyBenchmark::Result result = RunLatencyBenchmark("stalls", model);
+  // Decoding only runs 2ms per frame ahead of playback, so a 150ms stall
+  // can't be absorbed by a 30ms preroll: expect underruns in the results.
+  EXPECT_EQ(result.mStats.mStalls, 3u);
+}
+
+TEST(DecoderLatencyModel, DISABLED_BenchmarkBatches)
+{
+  DecoderLatencyModel model;
+  model.mBatchSize = 4;
+  LatencyBenchmark::Result result = RunLatencyBenchmark("batches", model);
+  EXPECT_GE(result.mStats.mMaxQueuedFrames, 3u);
+}
@@ -0,0 +1,298 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "gtest/gtest.h"
+#include "MediaData.h"
+#include "MediaDataDecoderProxy.h"
+#include "MediaInfo.h"
+#include "PDMFactory.h"
+#include "SamplesWaitingForKey.h"
+#include "mozilla/CDMProxy.h"
+#include "mozilla/Mutex.h"
+#include "mozilla/Pair.h"
+#include "mozilla/SharedThreadPool.h"
+#include "mozilla/TaskQueue.h"
+#include "VideoUtils.h"
+
+#include <functional>
+
+using namespace mozilla;
+
+// CDM decrypting on its own task queue, as the GMP CDM does on the GMP
+// thread. Decrypts are held until ResolveDecrypts() is called.
+class FakeCDMProxy : public CDMProxy
+{
+public:
+  NS_INLINE_DECL_THREADSAFE_REFCOUNTING(FakeCDMProxy, override)
+
+  FakeCDMProxy()
+    : CDMProxy(nullptr, NS_LITERAL_STRING("org.mozilla.test"), false, false)
+    , mDecrypts(0)
+    , mQueue(new TaskQueue(
+        GetMediaThreadPool(MediaThreadType::PLATFORM_DECODER)))
+    , mMutex("FakeCDMProxy")
+  {}
+
+  void Init(PromiseId, const nsAString&, const nsAString&,
+            const nsAString&) override {}
+  void CreateSession(uint32_t, MediaKeySessionType, PromiseId,
+                     const nsAString&, nsTArray<uint8_t>&) override {}
+  void LoadSession(PromiseId, const nsAString&) override {}
+  void SetServerCertificate(PromiseId, nsTArray<uint8_t>&) override {}
+  void UpdateSession(const nsAString&, PromiseId,
+                     nsTArray<uint8_t>&) override {}
+  void CloseSession(const nsAString&, PromiseId) override {}
+  void RemoveSession(const nsAString&, PromiseId) override {}
+  void Shutdown() override {}
+  void Terminated() override {}
+  const nsCString& GetNodeId() const override { return mNodeId; }
+  void OnSetSessionId(uint32_t, const nsAString&) override {}
+  void OnResolveLoadSessionPromise(uint32_t, bool) override {}
+  void OnSessionMessage(const nsAString&, dom::MediaKeyMessageType,
+                        nsTArray<uint8_t>&) override {}
+  void OnExpirationChange(const nsAString&, UnixTime) override {}
+  void OnSessionClosed(const nsAString&) override {}
+  void OnSessionError(const nsAString&, nsresult, uint32_t,
+                      const nsAString&) override {}
+  void OnRejectPromise(uint32_t, nsresult, const nsCString&) override {}
+  void OnDecrypted(uint32_t, DecryptStatus,
+                   const nsTArray<uint8_t>&) override {}
+  void RejectPromise(PromiseId, nsresult, const nsCString&) override {}
+  void ResolvePromise(PromiseId) override {}
+  const nsString& KeySystem() const override { return mKeySystem; }
+  CDMCaps& Capabilites() override { return mCaps; }
+  void OnKeyStatusesChange(const nsAString&) override {}
+  void GetSessionIdsForKeyId(const nsTArray<uint8_t>&,
+                             nsTArray<nsCString>&) override {}
+#ifdef DEBUG
+  bool IsOnOwnerThread() override { return mQueue->IsCurrentThreadIn(); }
+#endif
+
+  RefPtr<DecryptPromise> Decrypt(MediaRawData* aSample) override
+  {
+    mDecrypts++;
+    RefPtr<DecryptPromise::Private> promise =
+      new DecryptPromise::Private(__func__);
+    MutexAutoLock lock(mMutex);
+    mPending.AppendElement(MakePair(promise, RefPtr<MediaRawData>(aSample)));
+    return promise;
+  }
+
+  void ResolveDecrypts()
+  {
+    RefPtr<FakeCDMProxy> self = this;
+    mQueue->Dispatch(NS_NewRunnableFunction([self]() {
+      MutexAutoLock lock(self->mMutex);
+      for (auto& pending : self->mPending) {
+        pending.first()->Resolve(DecryptResult(Ok, pending.second()),
+                                 __func__);
+      }
+      self->mPending.Clear();
+    }));
+    mQueue->AwaitIdle();
+  }
+
+  void SetKeyUsable(const CencKeyId& aKeyId)
+  {
+    dom::Optional<dom::MediaKeyStatus> usable;
+    usable.Construct(dom::MediaKeyStatus::Usable);
+    CDMCaps::AutoLock caps(mCaps);
+    caps.SetKeyStatus(aKeyId, NS_LITERAL_STRING("session"), usable);
+  }
+
+  void ShutdownQueue()
+  {
+    mQueue->BeginShutdown();
+    mQueue->AwaitShutdownAndIdle();
+  }
+
+  Atomic<uint32_t> mDecrypts;
+
+private:
+  ~FakeCDMProxy() {}
+
+  RefPtr<TaskQueue> mQueue;
+  Mutex mMutex;
+  nsTArray<Pair<RefPtr<DecryptPromise::Private>, RefPtr<MediaRawData>>> mPending;
+  CDMCaps mCaps;
+  nsCString mNodeId;
+};
+
+// Records, in order, the times of decoded output and of the markers the test
+// dispatches, so that whether output needed a further task can be told.
+class HopCallback : public MediaDataDecoderCallback
+{
+public:
+  HopCallback() : mMutex("HopCallback") {}
+
+  void Output(MediaData* aData) override { Record(aData->mTime); }
+  void Error(const MediaResult& aError) override { EXPECT_TRUE(false); }
+  void InputExhausted() override {}
+  void DrainComplete() override {}
+  bool OnReaderTaskQueue() override { return true; }
+
+  void Record(int64_t aTime)
+  {
+    MutexAutoLock lock(mMutex);
+    mEvents.AppendElement(aTime);
+  }
+
+  nsTArray<int64_t> TakeEvents()
+  {
+    MutexAutoLock lock(mMutex);
+    nsTArray<int64_t> events;
+    events.SwapElements(mEvents);
+    return events;
+  }
+
+private:
+  Mutex mMutex;
+  nsTArray<int64_t> mEvents;
+};
+
+static const int64_t kMarker = -1;
+
+static already_AddRefed<MediaRawData>
+MakeSample(int64_t aTime, const CencKeyId* aKeyId = nullptr)
+{
+  // 10ms of 16 bit stereo PCM at 8kHz.
+  uint8_t data[320] = {};
+  RefPtr<MediaRawData> sample = new MediaRawData(data, sizeof(data));
+  sample->mTime = aTime;
+  sample->mDuration = 10000;
+  if (aKeyId) {
+    UniquePtr<MediaRawDataWriter> writer(sample->CreateWriter());
+    writer->mCrypto.mValid = true;
+    writer->mCrypto.mKeyId = *aKeyId;
+  }
+  return sample.forget();
+}
+
+// The CDM only decrypts; decoding is done by the WAV decoder, which outputs
+// synchronously from Input(), so any task hop before output is the EME
+// layer's.
+TEST(EMEDecoderHops, DecryptOnly)
+{
+  RefPtr<FakeCDMProxy> cdm = new FakeCDMProxy();
+  CencKeyId keyId;
+  keyId.AppendElement(1);
+  cdm->SetKeyUsable(keyId);
+
+  RefPtr<PDMFactory> factory = new PDMFactory();
+  factory->SetCDMProxy(cdm);
+
+  AudioInfo info;
+  info.mMimeType = "audio/x-wav";
+  info.mRate = 8000;
+  info.mChannels = 2;
+  info.mBitDepth = 16;
+  info.mProfile = 1;
+  info.mCrypto.mValid = true;
+
+  HopCallback callback;
+  RefPtr<TaskQueue> queue =
+    new TaskQueue(GetMediaThreadPool(MediaThreadType::PLATFORM_DECODER));
+  RefPtr<MediaDataDecoder> decoder;
+  auto run = [&](std::function<void()> aTask) {
+    queue->Dispatch(NS_NewRunnableFunction(aTask));
+    queue->AwaitIdle();
+  };
+
+  run([&]() {
+    decoder = factory->CreateDecoder(CreateDecoderParams(info, queue.get(),
+                                                         &callback));
+  });
+  ASSERT_TRUE(decoder);
+  run([&]() { decoder->Init(); });
+
+  // A clear lead-in is decoded without leaving the caller's task: its output
+  // precedes the marker dispatched right after it.
+  run([&]() {
+    decoder->Input(RefPtr<MediaRawData>(MakeSample(0)));
+    decoder->Input(RefPtr<MediaRawData>(MakeSample(10000)));
+    queue->Dispatch(NS_NewRunnableFunction([&]() {
+      callback.Record(kMarker);
+    }));
+  });
+  EXPECT_EQ(nsTArray<int64_t>({ 0, 10000, kMarker }), callback.TakeEvents());
+  EXPECT_EQ(0u, uint32_t(cdm->mDecrypts));
+
+  // Encrypted samples take one round trip through the CDM each, and clear
+  // samples following them wait their turn rather than overtaking them.
+  run([&]() {
+    decoder->Input(RefPtr<MediaRawData>(MakeSample(20000, &keyId)));
+    decoder->Input(RefPtr<MediaRawData>(MakeSample(30000)));
+  });
+  EXPECT_EQ(2u, uint32_t(cdm->mDecrypts));
+  EXPECT_TRUE(callback.TakeEvents().IsEmpty());
+  cdm->ResolveDecrypts();
+  queue->AwaitIdle();
+  EXPECT_EQ(nsTArray<int64_t>({ 20000, 30000 }), callback.TakeEvents());
+
+  run([&]() { decoder->Shutdown(); });
+  queue->BeginShutdown();
+  queue->AwaitShutdownAndIdle();
+  cdm->ShutdownQueue();
+}
+
+// Stands in for the GMP decoder behind the proxy.
+class RecordingDecoder : public MediaDataDecoder
+{
+public:
+  explicit RecordingDecoder(HopCallback* aCallback) : mCallback(aCallback) {}
+
+  RefPtr<InitPromise> Init() override
+  {
+    return InitPromise::CreateAndResolve(TrackInfo::kAudioTrack, __func__);
+  }
+  void Input(MediaRawData* aSample) override
+  {
+    mCallback->Record(aSample->mTime);
+  }
+  void Flush() override {}
+  void Drain() override {}
+  void Shutdown() override {}
+  const char* GetDescriptionName() const override { return "recording decoder"; }
+
+private:
+  HopCallback* mCallback;
+};
+
+// The CDM decodes: a sample waiting for its key goes back through the decode
+// task queue once the key is usable, as the proxy is only fed from there, and
+// then on to the decoder on the proxy thread.
+TEST(EMEDecoderHops, DecryptAndDecode)
+{
+  RefPtr<FakeCDMProxy> cdm = new FakeCDMProxy();
+  CencKeyId keyId;
+  keyId.AppendElement(2);
+
+  HopCallback callback;
+  RefPtr<TaskQueue> queue =
+    new TaskQueue(GetMediaThreadPool(MediaThreadType::PLATFORM_DECODER));
+  RefPtr<TaskQueue> proxyQueue =
+    new TaskQueue(GetMediaThreadPool(MediaThreadType::PLATFORM_DECODER));
+  RefPtr<AbstractThread> proxyThread = proxyQueue.get();
+  RefPtr<MediaDataDecoderProxy> proxy =
+    new MediaDataDecoderProxy(proxyThread.forget(), &callback);
+  proxy->SetProxyTarget(new RecordingDecoder(&callback));
+
+  RefPtr<SamplesWaitingForKey> waiting =
+    new SamplesWaitingForKey(proxy, &callback, queue, cdm);
+  RefPtr<MediaRawData> sample = MakeSample(0, &keyId);
+  EXPECT_TRUE(waiting->WaitIfKeyNotUsable(sample));
+
+  cdm->SetKeyUsable(keyId);
+  queue->AwaitIdle();
+  proxyQueue->AwaitIdle();
+  EXPECT_EQ(nsTArray<int64_t>({ 0 }), callback.TakeEvents());
+
+  waiting->BreakCycles();
+  queue->BeginShutdown();
+  queue->AwaitShutdownAndIdle();
+  proxyQueue->BeginShutdown();
+  proxyQueue->AwaitShutdownAndIdle();
+  cdm->ShutdownQueue();
+}
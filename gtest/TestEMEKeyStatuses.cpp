@@ -0,0 +1,93 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "gtest/gtest.h"
+#include "mozilla/CDMCaps.h"
+#include "mozilla/dom/MediaKeyStatusMap.h"
+
+using namespace mozilla;
+using namespace mozilla::dom;
+
+static CencKeyId
+KeyId(uint8_t aByte)
+{
+  CencKeyId id;
+  id.AppendElement(aByte);
+  return id;
+}
+
+static Optional<MediaKeyStatus>
+Status(MediaKeyStatus aStatus)
+{
+  Optional<MediaKeyStatus> status;
+  status.Construct(aStatus);
+  return status;
+}
+
+// A burst of status changes, as a CDM reports them one key at a time, is
+// taken as a single batch holding the latest change of each key, which the
+// session then applies to its map at once.
+TEST(EMEKeyStatuses, CoalescedChanges)
+{
+  CDMCaps caps;
+  const nsString session = NS_LITERAL_STRING("session");
+  const nsString other = NS_LITERAL_STRING("other");
+  {
+    CDMCaps::AutoLock lock(caps);
+    EXPECT_TRUE(lock.SetKeyStatus(KeyId(2), session,
+                                  Status(MediaKeyStatus::Usable)));
+    EXPECT_TRUE(lock.SetKeyStatus(KeyId(1), session,
+                                  Status(MediaKeyStatus::Usable)));
+    EXPECT_TRUE(lock.SetKeyStatus(KeyId(1), session,
+                                  Status(MediaKeyStatus::Expired)));
+    EXPECT_TRUE(lock.SetKeyStatus(KeyId(3), session,
+                                  Status(MediaKeyStatus::Usable)));
+    EXPECT_TRUE(lock.SetKeyStatus(KeyId(3), session,
+                                  Optional<MediaKeyStatus>()));
+    // Setting the same status again isn't a change.
+    EXPECT_FALSE(lock.SetKeyStatus(KeyId(2), session,
+                                   Status(MediaKeyStatus::Usable)));
+    EXPECT_TRUE(lock.SetKeyStatus(KeyId(4), other,
+                                  Status(MediaKeyStatus::Usable)));
+  }
+
+  nsTArray<CDMCaps::KeyStatusChange> changes;
+  {
+    CDMCaps::AutoLock lock(caps);
+    lock.TakeKeyStatusChangesForSession(session, changes);
+  }
+  // One change per key of the session.
+  ASSERT_EQ(changes.Length(), 3u);
+
+  RefPtr<MediaKeyStatusMap> map = new MediaKeyStatusMap(nullptr);
+  map->Apply(changes);
+  // Sorted by key id, without the removed key.
+  ASSERT_EQ(map->Size(), 2u);
+  EXPECT_EQ(map->GetValueAtIndex(0), MediaKeyStatus::Expired);
+  EXPECT_EQ(map->GetValueAtIndex(1), MediaKeyStatus::Usable);
+
+  // Nothing is left to apply, while the other session's change still is.
+  changes.Clear();
+  {
+    CDMCaps::AutoLock lock(caps);
+    lock.TakeKeyStatusChangesForSession(session, changes);
+    EXPECT_TRUE(changes.IsEmpty());
+    lock.TakeKeyStatusChangesForSession(other, changes);
+  }
+  EXPECT_EQ(changes.Length(), 1u);
+
+  // Later changes update the map in place.
+  {
+    CDMCaps::AutoLock lock(caps);
+    EXPECT_TRUE(lock.SetKeyStatus(KeyId(2), session,
+                                  Status(MediaKeyStatus::Released)));
+    changes.Clear();
+    lock.TakeKeyStatusChangesForSession(session, changes);
+  }
+  map->Apply(changes);
+  ASSERT_EQ(map->Size(), 2u);
+  EXPECT_EQ(map->GetValueAtIndex(0), MediaKeyStatus::Expired);
+  EXPECT_EQ(map->GetValueAtIndex(1), MediaKeyStatus::Released);
+}
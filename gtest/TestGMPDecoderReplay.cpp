@@ -0,0 +1,107 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "gtest/gtest.h"
+#include "GMPDecoderReplay.h"
+
+using namespace mozilla;
+
+static already_AddRefed<MediaRawData>
+CreateSample(int64_t aTime, bool aKeyframe)
+{
+  RefPtr<MediaRawData> sample = new MediaRawData();
+  sample->mTime = aTime;
+  sample->mKeyframe = aKeyframe;
+  return sample.forget();
+}
+
+TEST(GMPDecoderReplay, KeepsSamplesSinceLastKeyframe)
+{
+  GMPReplaySamples replay(10);
+  // Nothing to replay before the first keyframe.
+  RefPtr<MediaRawData> sample = CreateSample(0, false);
+  replay.Append(sample, false);
+  EXPECT_FALSE(replay.IsReplayable());
+  EXPECT_TRUE(replay.Samples().IsEmpty());
+
+  for (int64_t i = 1; i < 4; i++) {
+    sample = CreateSample(i, i == 1);
+    replay.Append(sample, false);
+  }
+  EXPECT_TRUE(replay.IsReplayable());
+  ASSERT_EQ(replay.Samples().Length(), 3u);
+  EXPECT_EQ(replay.Samples()[0]->mTime, 1);
+
+  // A keyframe drops the samples before it.
+  sample = CreateSample(4, true);
+  replay.Append(sample, false);
+  ASSERT_EQ(replay.Samples().Length(), 1u);
+  EXPECT_EQ(replay.Samples()[0]->mTime, 4);
+
+  // As after a flush.
+  replay.Clear();
+  sample = CreateSample(5, false);
+  replay.Append(sample, false);
+  EXPECT_FALSE(replay.IsReplayable());
+  EXPECT_TRUE(replay.Samples().IsEmpty());
+}
+
+TEST(GMPDecoderReplay, LongGopIsNotReplayable)
+{
+  GMPReplaySamples replay(3);
+  for (int64_t i = 0; i < 4; i++) {
+    RefPtr<MediaRawData> sample = CreateSample(i, i == 0);
+    replay.Append(sample, false);
+  }
+  EXPECT_FALSE(replay.IsReplayable());
+  EXPECT_TRUE(replay.Samples().IsEmpty());
+
+  // Until the next keyframe.
+  RefPtr<MediaRawData> sample = CreateSample(4, true);
+  replay.Append(sample, false);
+  EXPECT_TRUE(replay.IsReplayable());
+  EXPECT_EQ(replay.Samples().Length(), 1u);
+}
+
+TEST(GMPDecoderReplay, KeepsEverythingWhileRestarting)
+{
+  GMPReplaySamples replay(3);
+  for (int64_t i = 0; i < 3; i++) {
+    RefPtr<MediaRawData> sample = CreateSample(i, i == 0);
+    replay.Append(sample, false);
+  }
+  // The restarting GMP needs the samples given meanwhile as well.
+  for (int64_t i = 3; i < 6; i++) {
+    RefPtr<MediaRawData> sample = CreateSample(i, false);
+    replay.Append(sample, true);
+  }
+  EXPECT_TRUE(replay.IsReplayable());
+  EXPECT_EQ(replay.Samples().Length(), 6u);
+}
+
+TEST(GMPDecoderReplay, SkipsFramesOutputBeforeRestart)
+{
+  GMPOutputSkipper skipper;
+  // Output in decode order, which isn't presentation order.
+  for (int64_t time : { 0, 80, 40 }) {
+    EXPECT_TRUE(skipper.ShouldOutput(time));
+    skipper.NotifyOutput(time);
+  }
+
+  // The restarted GMP decodes again from the keyframe at 0.
+  skipper.Restarted();
+  EXPECT_FALSE(skipper.ShouldOutput(0));
+  EXPECT_FALSE(skipper.ShouldOutput(40));
+  EXPECT_FALSE(skipper.ShouldOutput(80));
+  EXPECT_TRUE(skipper.ShouldOutput(120));
+  skipper.NotifyOutput(120);
+
+  // After a flush, decoding starts over elsewhere.
+  skipper.Reset();
+  EXPECT_TRUE(skipper.ShouldOutput(0));
+  // Restarting with nothing output since skips nothing.
+  skipper.Restarted();
+  EXPECT_TRUE(skipper.ShouldOutput(0));
+}
@@ -0,0 +1,842 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* vim: set ts=8 sts=2 et sw=2 tw=80: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Throughput and latency of the GMP IPC path, measured by driving the fake
+// plugins (gmp-fake and gmp-fakeopenh264) through the video decoder, video
+// encoder and decryptor actors. Each run records one property, also logged
+// with MOZ_LOG=GMPIPCBenchmark:3, which can be compared before and after a
+// change.
+//
+// The benchmarks are too slow to run with the other gtests, and are disabled.
+// Run them with --gtest_also_run_disabled_tests and
+// --gtest_filter='GMPIPCBenchmark.*'.
+//
+// By default every actor is run unthrottled at a few sizes. The following
+// environment variables select a single configuration instead:
+//   MOZ_GMP_BENCH_WIDTH, MOZ_GMP_BENCH_HEIGHT  frame size (video)
+//   MOZ_GMP_BENCH_BUFFER_SIZE                  buffer size (decryptor)
+//   MOZ_GMP_BENCH_FRAMES                       number of requests
+//   MOZ_GMP_BENCH_FPS                          request rate, 0 for unthrottled
+//   MOZ_GMP_BENCH_WINDOW                       max requests awaiting a reply
+
+#include "gtest/gtest.h"
+#include "GMPDecryptorProxy.h"
+#include "GMPServiceParent.h"
+#include "GMPSharedMemManager.h"
+#include "GMPStats.h"
+#include "GMPTestMonitor.h"
+#include "GMPVideoDecoderProxy.h"
+#include "GMPVideoEncoderProxy.h"
+#include "MediaData.h"
+#include "MediaPrefs.h"
+#include "mozilla/CDMProxy.h"
+#include "mozilla/Logging.h"
+#include "mozilla/PodOperations.h"
+#include "mozilla/TimeStamp.h"
+#include "mozilla/dom/MediaKeyMessageEventBinding.h"
+#include "nsITimer.h"
+#include "nsPrintfCString.h"
+#include "prenv.h"
+#include "prsystem.h"
+
+#include <algorithm>
+#include <stdlib.h>
+
+using namespace mozilla;
+using namespace mozilla::gmp;
+
+static LazyLogModule sBenchmarkLog("GMPIPCBenchmark");
+#define BENCH_LOG(msg, ...) \
+  MOZ_LOG(sBenchmarkLog, LogLevel::Info, (msg, ##__VA_ARGS__))
+
+struct BenchmarkConfig
+{
+  uint32_t mWidth;
+  uint32_t mHeight;
+  uint32_t mBufferSize;
+  uint32_t mFrames;
+  // Rate at which requests are sent. With 0, a request is sent as soon as
+  // the window has room; otherwise requests finding the window full are
+  // dropped, as a real-time producer would.
+  uint32_t mFps;
+  uint32_t mWindow;
+};
+
+static uint32_t
+BenchmarkEnv(const char* aName, uint32_t aDefault)
+{
+  const char* value = PR_GetEnv(aName);
+  if (!value || !*value) {
+    return aDefault;
+  }
+  return strtoul(value, nullptr, 10);
+}
+
+static BenchmarkConfig
+BenchmarkDefaults()
+{
+  BenchmarkConfig config;
+  config.mWidth = 0;
+  config.mHeight = 0;
+  config.mBufferSize = 0;
+  config.mFrames = BenchmarkEnv("MOZ_GMP_BENCH_FRAMES", 100);
+  config.mFps = BenchmarkEnv("MOZ_GMP_BENCH_FPS", 0);
+  // Below the shmem buffer limit, so the actors never reject a request.
+  config.mWindow = BenchmarkEnv("MOZ_GMP_BENCH_WINDOW", 8);
+  return config;
+}
+
+static nsTArray<BenchmarkConfig>
+VideoConfigs()
+{
+  static const uint32_t kSizes[][2] = {
+    { 320, 240 }, { 1280, 720 }, { 1920, 1080 }
+  };
+  nsTArray<BenchmarkConfig> configs;
+  BenchmarkConfig config = BenchmarkDefaults();
+  if (PR_GetEnv("MOZ_GMP_BENCH_WIDTH")) {
+    config.mWidth = BenchmarkEnv("MOZ_GMP_BENCH_WIDTH", 0);
+    config.mHeight = BenchmarkEnv("MOZ_GMP_BENCH_HEIGHT", config.mWidth * 9 / 16);
+    configs.AppendElement(config);
+    return configs;
+  }
+  for (const auto& size : kSizes) {
+    config.mWidth = size[0];
+    config.mHeight = size[1];
+    configs.AppendElement(config);
+  }
+  return configs;
+}
+
+static nsTArray<BenchmarkConfig>
+DecryptorConfigs()
+{
+  static const uint32_t kSizes[] = { 4 * 1024, 64 * 1024, 512 * 1024 };
+  nsTArray<BenchmarkConfig> configs;
+  BenchmarkConfig config = BenchmarkDefaults();
+  if (PR_GetEnv("MOZ_GMP_BENCH_BUFFER_SIZE")) {
+    config.mBufferSize = BenchmarkEnv("MOZ_GMP_BENCH_BUFFER_SIZE", 0);
+    configs.AppendElement(config);
+    return configs;
+  }
+  for (uint32_t size : kSizes) {
+    config.mBufferSize = size;
+    configs.AppendElement(config);
+  }
+  return configs;
+}
+
+static already_AddRefed<nsIThread>
+GetBenchmarkGMPThread()
+{
+  RefPtr<GeckoMediaPluginService> service =
+    GeckoMediaPluginService::GetGeckoMediaPluginService();
+  nsCOMPtr<nsIThread> thread;
+  EXPECT_TRUE(NS_SUCCEEDED(service->GetThread(getter_AddRefs(thread))));
+  return thread.forget();
+}
+
+// Sends numbered requests to one actor and times the reply carrying the same
+// number back. Everything but Run() happens on the GMP thread.
+class GMPIPCBenchmark
+{
+public:
+  NS_INLINE_DECL_THREADSAFE_REFCOUNTING(GMPIPCBenchmark)
+
+  // Main thread. Returns once every request was answered or dropped, or the
+  // actor failed, and records the results.
+  void Run()
+  {
+    mThread = GetBenchmarkGMPThread();
+    mThread->Dispatch(NewRunnableMethod(this, &GMPIPCBenchmark::Start),
+                      NS_DISPATCH_NORMAL);
+    mMonitor.AwaitFinished();
+    Report();
+  }
+
+  // aWhen is when the reply reached the consumer, which may be on another
+  // thread than the GMP thread.
+  void Replied(uint64_t aIndex, TimeStamp aWhen)
+  {
+    if (mFinished ||
+        aIndex >= mSendTimes.Length() || mSendTimes[aIndex].IsNull()) {
+      return;
+    }
+    mLatencies.AppendElement(aWhen - mSendTimes[aIndex]);
+    mSendTimes[aIndex] = TimeStamp();
+    mReceived++;
+    if (mReceived + mDropped == mConfig.mFrames) {
+      Finish();
+    } else if (!mConfig.mFps) {
+      Fill();
+    }
+  }
+
+protected:
+  GMPIPCBenchmark(const char* aActorType, const BenchmarkConfig& aConfig)
+    : mActorType(aActorType)
+    , mConfig(aConfig)
+    , mSent(0)
+    , mReceived(0)
+    , mDropped(0)
+    , mFinished(false)
+    , mFailed(false)
+  {
+    MediaPrefs::GetSingleton();
+  }
+  virtual ~GMPIPCBenchmark() {}
+
+  // Gets and initializes the actor, then calls Started().
+  virtual void Start() = 0;
+  // Sends request aIndex; its reply must carry aIndex as timestamp or id.
+  virtual bool Send(uint64_t aIndex) = 0;
+  virtual void Close() = 0;
+
+  void Started(uint32_t aPluginId)
+  {
+    nsTArray<RefPtr<GMPPluginStats>> plugins;
+    GMPPluginStats::GetAll(plugins);
+    for (const auto& plugin : plugins) {
+      if (plugin->PluginId() == aPluginId) {
+        mPlugin = plugin;
+        break;
+      }
+    }
+    if (!mPlugin) {
+      Failed("no stats for plugin");
+      return;
+    }
+    // Actors are appended as they are created, so the last one of our type
+    // is ours.
+    nsTArray<RefPtr<GMPActorStats>> actors;
+    mPlugin->GetActors(actors);
+    for (const auto& actor : actors) {
+      if (!strcmp(actor->ActorType(), mActorType)) {
+        mActor = actor;
+      }
+    }
+    if (!mActor) {
+      Failed("no stats for actor");
+      return;
+    }
+    // The pools are shared with earlier runs on the same plugin instance.
+    for (size_t i = 0; i < GMPSharedMem::kGMPNumTypes; i++) {
+      mResults.mShmemAllocations[i] = mPlugin->ShmemAllocations(i);
+      mResults.mShmemPoolHits[i] = mPlugin->ShmemPoolHits(i);
+    }
+
+    mStart = TimeStamp::Now();
+    if (!mConfig.mFps) {
+      Fill();
+      return;
+    }
+    mTimer = do_CreateInstance("@mozilla.org/timer;1");
+    mTimer->SetTarget(mThread);
+    mTimer->InitWithFuncCallback(&GMPIPCBenchmark::TimerCallback, this,
+                                 std::max(1000u / mConfig.mFps, 1u),
+                                 nsITimer::TYPE_REPEATING_PRECISE_CAN_SKIP);
+    Tick();
+  }
+
+  void Failed(const char* aWhat)
+  {
+    if (mFinished) {
+      return;
+    }
+    ADD_FAILURE() << mActorType << ": " << aWhat;
+    mFailed = true;
+    Finish();
+  }
+
+  const char* const mActorType;
+  const BenchmarkConfig mConfig;
+
+private:
+  uint32_t InFlight() const { return mSent - mReceived - mDropped; }
+
+  bool SendOne()
+  {
+    uint64_t index = mSent++;
+    mSendTimes.AppendElement(TimeStamp::Now());
+    if (!Send(index)) {
+      Failed("send failed");
+      return false;
+    }
+    return true;
+  }
+
+  void Fill()
+  {
+    while (!mFinished && mSent < mConfig.mFrames &&
+           InFlight() < mConfig.mWindow) {
+      if (!SendOne()) {
+        return;
+      }
+    }
+  }
+
+  static void TimerCallback(nsITimer* aTimer, void* aClosure)
+  {
+    static_cast<GMPIPCBenchmark*>(aClosure)->Tick();
+  }
+
+  void Tick()
+  {
+    if (mFinished || mSent == mConfig.mFrames) {
+      return;
+    }
+    if (InFlight() < mConfig.mWindow) {
+      SendOne();
+      return;
+    }
+    mSent++;
+    mSendTimes.AppendElement(TimeStamp());
+    mDropped++;
+    if (mReceived + mDropped == mConfig.mFrames) {
+      Finish();
+    }
+  }
+
+  void Finish()
+  {
+    mFinished = true;
+    mResults.mElapsed = TimeStamp::Now() - mStart;
+    if (mTimer) {
+      mTimer->Cancel();
+      mTimer = nullptr;
+    }
+    // Read before closing; closing the actor stops its stats.
+    if (mActor) {
+      mResults.mMessagesSent = mActor->MessagesSent();
+      mResults.mMessagesReceived = mActor->MessagesReceived();
+      mResults.mBytesSent = mActor->BytesSent();
+      mResults.mBytesReceived = mActor->BytesReceived();
+      mResults.mNeedShmemCalls = mActor->NeedShmemCalls();
+      mResults.mBufferLimitHits = mActor->BufferLimitHits();
+      mResults.mMaxQueueDepth = mActor->MaxQueueDepth();
+    }
+    if (mPlugin) {
+      for (size_t i = 0; i < GMPSharedMem::kGMPNumTypes; i++) {
+        mResults.mShmemAllocations[i] =
+          mPlugin->ShmemAllocations(i) - mResults.mShmemAllocations[i];
+        mResults.mShmemPoolHits[i] =
+          mPlugin->ShmemPoolHits(i) - mResults.mShmemPoolHits[i];
+      }
+    }
+    Close();
+    mMonitor.SetFinished();
+  }
+
+  double PercentileUs(uint32_t aPercentile) const
+  {
+    if (mLatencies.IsEmpty()) {
+      return 0;
+    }
+    size_t index = std::min(mLatencies.Length() * aPercentile / 100,
+                            mLatencies.Length() - 1);
+    return mLatencies[index].ToMicroseconds();
+  }
+
+  void Report()
+  {
+    mLatencies.Sort();
+    double seconds = mResults.mElapsed.ToSeconds();
+    // Also used as an XML attribute name by --gtest_output.
+    nsPrintfCString name("%s_size%ux%u_buffer%u_frames%u_rate%u_window%u",
+                         mActorType, mConfig.mWidth, mConfig.mHeight,
+                         mConfig.mBufferSize, mConfig.mFrames, mConfig.mFps,
+                         mConfig.mWindow);
+    nsPrintfCString results(
+      "%.1f fps, dropped %u, latency us p50=%.0f p90=%.0f "
+      "p99=%.0f max=%.0f, messages sent=%llu received=%llu, bytes "
+      "sent=%llu received=%llu, shmem frame hits=%u/%u encoded "
+      "hits=%u/%u, need-shmem=%u, buffer-limit-hits=%u, "
+      "max-queue-depth=%u",
+      seconds > 0 ? mReceived / seconds : 0.0, mDropped,
+      PercentileUs(50), PercentileUs(90), PercentileUs(99),
+      PercentileUs(100),
+      (unsigned long long)mResults.mMessagesSent,
+      (unsigned long long)mResults.mMessagesReceived,
+      (unsigned long long)mResults.mBytesSent,
+      (unsigned long long)mResults.mBytesReceived,
+      mResults.mShmemPoolHits[GMPSharedMem::kGMPFrameData],
+      mResults.mShmemAllocations[GMPSharedMem::kGMPFrameData],
+      mResults.mShmemPoolHits[GMPSharedMem::kGMPEncodedData],
+      mResults.mShmemAllocations[GMPSharedMem::kGMPEncodedData],
+      mResults.mNeedShmemCalls, mResults.mBufferLimitHits,
+      mResults.mMaxQueueDepth);
+    BENCH_LOG("%s: %s", name.get(), results.get());
+    ::testing::Test::RecordProperty(name.get(), results.get());
+
+    EXPECT_FALSE(mFailed);
+    EXPECT_EQ(mConfig.mFrames, mReceived + mDropped);
+    EXPECT_EQ(0u, mResults.mBufferLimitHits);
+  }
+
+  struct Results
+  {
+    Results()
+      : mMessagesSent(0)
+      , mMessagesReceived(0)
+      , mBytesSent(0)
+      , mBytesReceived(0)
+      , mNeedShmemCalls(0)
+      , mBufferLimitHits(0)
+      , mMaxQueueDepth(0)
+    {
+      PodArrayZero(mShmemAllocations);
+      PodArrayZero(mShmemPoolHits);
+    }
+
+    TimeDuration mElapsed;
+    uint64_t mMessagesSent;
+    uint64_t mMessagesReceived;
+    uint64_t mBytesSent;
+    uint64_t mBytesReceived;
+    uint32_t mNeedShmemCalls;
+    uint32_t mBufferLimitHits;
+    uint32_t mMaxQueueDepth;
+    uint32_t mShmemAllocations[GMPSharedMem::kGMPNumTypes];
+    uint32_t mShmemPoolHits[GMPSharedMem::kGMPNumTypes];
+  };
+
+  GMPTestMonitor mMonitor;
+  nsCOMPtr<nsIThread> mThread;
+  nsCOMPtr<nsITimer> mTimer;
+  RefPtr<GMPPluginStats> mPlugin;
+  RefPtr<GMPActorStats> mActor;
+  TimeStamp mStart;
+  // Send time of each request, null once replied to or if dropped.
+  nsTArray<TimeStamp> mSendTimes;
+  nsTArray<TimeDuration> mLatencies;
+  uint32_t mSent;
+  uint32_t mReceived;
+  uint32_t mDropped;
+  bool mFinished;
+  bool mFailed;
+  Results mResults;
+};
+
+static const char* const kFakeVideoTags[] = { "h264", "fake" };
+
+// Must match EncodedFrame in gmp-plugin-openh264/gmp-fake-openh264.cpp; the
+// fake decoder outputs an i420 frame of the size it describes.
+struct FakeEncodedFrame
+{
+  uint32_t length_;
+  uint8_t h264_compat_;
+  uint32_t magic_;
+  uint32_t width_;
+  uint32_t height_;
+  uint8_t y_;
+  uint8_t u_;
+  uint8_t v_;
+  uint32_t timestamp_;
+};
+
+static const uint32_t kFakeEncodedFrameMagic = 0x4652414d;
+
+// Small compressed frames go to the plugin, full size decoded frames come
+// back in shmem from the parent's frame pool.
+class VideoDecoderBenchmark : public GMPIPCBenchmark
+                            , public GMPVideoDecoderCallbackProxy
+{
+public:
+  explicit VideoDecoderBenchmark(const BenchmarkConfig& aConfig)
+    : GMPIPCBenchmark("video-decoder", aConfig)
+    , mGMP(nullptr)
+    , mHost(nullptr)
+  {
+  }
+
+  void Decoded(GMPVideoi420Frame* aDecodedFrame) override
+  {
+    uint64_t index = aDecodedFrame->Timestamp();
+    aDecodedFrame->Destroy();
+    Replied(index, TimeStamp::Now());
+  }
+  void ReceivedDecodedReferenceFrame(const uint64_t aPictureId) override {}
+  void ReceivedDecodedFrame(const uint64_t aPictureId) override {}
+  void InputDataExhausted() override {}
+  void DrainComplete() override {}
+  void ResetComplete() override {}
+  void Error(GMPErr aError) override { Failed("decoder error"); }
+  void Terminated() override { Failed("decoder terminated"); }
+
+private:
+  class DecoderReady : public GetGMPVideoDecoderCallback
+  {
+  public:
+    explicit DecoderReady(VideoDecoderBenchmark* aBenchmark)
+      : mBenchmark(aBenchmark)
+    {
+    }
+
+    void Done(GMPVideoDecoderProxy* aGMP, GMPVideoHost* aHost) override
+    {
+      mBenchmark->Init(aGMP, aHost);
+    }
+
+  private:
+    RefPtr<VideoDecoderBenchmark> mBenchmark;
+  };
+
+  void Start() override
+  {
+    nsTArray<nsCString> tags;
+    for (const char* tag : kFakeVideoTags) {
+      tags.AppendElement(nsDependentCString(tag));
+    }
+    UniquePtr<GetGMPVideoDecoderCallback> callback(new DecoderReady(this));
+    RefPtr<GeckoMediaPluginService> service =
+      GeckoMediaPluginService::GetGeckoMediaPluginService();
+    if (NS_FAILED(service->GetGMPVideoDecoder(nullptr, &tags, EmptyCString(),
+                                              Move(callback)))) {
+      Failed("GetGMPVideoDecoder failed");
+    }
+  }
+
+  void Init(GMPVideoDecoderProxy* aGMP, GMPVideoHost* aHost)
+  {
+    if (!aGMP) {
+      Failed("no decoder");
+      return;
+    }
+    mGMP = aGMP;
+    mHost = aHost;
+
+    GMPVideoCodec codec;
+    memset(&codec, 0, sizeof(codec));
+    codec.mGMPApiVersion = kGMPVersion33;
+    codec.mCodecType = kGMPVideoCodecH264;
+    codec.mWidth = mConfig.mWidth;
+    codec.mHeight = mConfig.mHeight;
+    nsTArray<uint8_t> codecSpecific;
+    codecSpecific.AppendElement(0); // mPacketizationMode.
+    if (NS_FAILED(mGMP->InitDecode(codec, codecSpecific, this,
+                                   PR_GetNumberOfProcessors()))) {
+      Failed("InitDecode failed");
+      return;
+    }
+    Started(mGMP->GetPluginId());
+  }
+
+  bool Send(uint64_t aIndex) override
+  {
+    GMPVideoFrame* ftmp = nullptr;
+    if (GMP_FAILED(mHost->CreateFrame(kGMPEncodedVideoFrame, &ftmp))) {
+      return false;
+    }
+    GMPUniquePtr<GMPVideoEncodedFrame> frame(
+      static_cast<GMPVideoEncodedFrame*>(ftmp));
+    if (GMP_FAILED(frame->CreateEmptyFrame(sizeof(FakeEncodedFrame)))) {
+      return false;
+    }
+    FakeEncodedFrame* eframe =
+      reinterpret_cast<FakeEncodedFrame*>(frame->Buffer());
+    eframe->length_ = sizeof(*eframe) - sizeof(uint32_t);
+    eframe->h264_compat_ = 5;
+    eframe->magic_ = kFakeEncodedFrameMagic;
+    eframe->width_ = mConfig.mWidth;
+    eframe->height_ = mConfig.mHeight;
+    eframe->y_ = aIndex & 0xff;
+    eframe->u_ = 0x80;
+    eframe->v_ = 0x80;
+    eframe->timestamp_ = aIndex;
+
+    frame->SetBufferType(GMP_BufferLength32);
+    frame->SetEncodedWidth(mConfig.mWidth);
+    frame->SetEncodedHeight(mConfig.mHeight);
+    frame->SetTimeStamp(aIndex);
+    frame->SetCompleteFrame(true);
+    frame->SetFrameType(aIndex ? kGMPDeltaFrame : kGMPKeyFrame);
+
+    nsTArray<uint8_t> info;
+    return NS_SUCCEEDED(mGMP->Decode(Move(frame), false, info));
+  }
+
+  void Close() override
+  {
+    if (mGMP) {
+      mGMP->Close();
+      mGMP = nullptr;
+    }
+  }
+
+  GMPVideoDecoderProxy* mGMP;
+  GMPVideoHost* mHost;
+};
+
+// Full size i420 frames go to the plugin in shmem from the parent's frame
+// pool, small encoded frames come back.
+class VideoEncoderBenchmark : public GMPIPCBenchmark
+                            , public GMPVideoEncoderCallbackProxy
+{
+public:
+  explicit VideoEncoderBenchmark(const BenchmarkConfig& aConfig)
+    : GMPIPCBenchmark("video-encoder", aConfig)
+    , mGMP(nullptr)
+    , mHost(nullptr)
+  {
+  }
+
+  // Called on the encoder parent's callback thread; the frame is destroyed
+  // by the parent afterwards.
+  void Encoded(GMPVideoEncodedFrame* aEncodedFrame,
+               const nsTArray<uint8_t>& aCodecSpecificInfo) override
+  {
+    RefPtr<GMPIPCBenchmark> self = this;
+    uint64_t index = aEncodedFrame->TimeStamp();
+    TimeStamp now = TimeStamp::Now();
+    nsCOMPtr<nsIThread> thread(GetBenchmarkGMPThread());
+    thread->Dispatch(NS_NewRunnableFunction([self, index, now]() {
+      self->Replied(index, now);
+    }), NS_DISPATCH_NORMAL);
+  }
+  void Error(GMPErr aError) override { Failed("encoder error"); }
+  void Terminated() override { Failed("encoder terminated"); }
+
+private:
+  class EncoderReady : public GetGMPVideoEncoderCallback
+  {
+  public:
+    explicit EncoderReady(VideoEncoderBenchmark* aBenchmark)
+      : mBenchmark(aBenchmark)
+    {
+    }
+
+    void Done(GMPVideoEncoderProxy* aGMP, GMPVideoHost* aHost) override
+    {
+      mBenchmark->Init(aGMP, aHost);
+    }
+
+  private:
+    RefPtr<VideoEncoderBenchmark> mBenchmark;
+  };
+
+  void Start() override
+  {
+    nsTArray<nsCString> tags;
+    for (const char* tag : kFakeVideoTags) {
+      tags.AppendElement(nsDependentCString(tag));
+    }
+    UniquePtr<GetGMPVideoEncoderCallback> callback(new EncoderReady(this));
+    RefPtr<GeckoMediaPluginService> service =
+      GeckoMediaPluginService::GetGeckoMediaPluginService();
+    if (NS_FAILED(service->GetGMPVideoEncoder(nullptr, &tags, EmptyCString(),
+                                              Move(callback)))) {
+      Failed("GetGMPVideoEncoder failed");
+    }
+  }
+
+  void Init(GMPVideoEncoderProxy* aGMP, GMPVideoHost* aHost)
+  {
+    if (!aGMP) {
+      Failed("no encoder");
+      return;
+    }
+    mGMP = aGMP;
+    mHost = aHost;
+
+    GMPVideoCodec codec;
+    memset(&codec, 0, sizeof(codec));
+    codec.mGMPApiVersion = kGMPVersion33;
+    codec.mCodecType = kGMPVideoCodecH264;
+    codec.mWidth = mConfig.mWidth;
+    codec.mHeight = mConfig.mHeight;
+    codec.mMaxFramerate = mConfig.mFps ? mConfig.mFps : 30;
+    nsTArray<uint8_t> codecSpecific;
+    if (GMP_FAILED(mGMP->InitEncode(codec, codecSpecific, this, 1, 0))) {
+      Failed("InitEncode failed");
+      return;
+    }
+    Started(mGMP->GetPluginId());
+  }
+
+  bool Send(uint64_t aIndex) override
+  {
+    GMPVideoFrame* ftmp = nullptr;
+    if (GMP_FAILED(mHost->CreateFrame(kGMPI420VideoFrame, &ftmp))) {
+      return false;
+    }
+    GMPUniquePtr<GMPVideoi420Frame> frame(
+      static_cast<GMPVideoi420Frame*>(ftmp));
+    int32_t width = mConfig.mWidth;
+    int32_t halfWidth = (width + 1) / 2;
+    // The contents don't matter to the fake encoder; leaving them alone
+    // keeps the cost of filling frames out of the measurement.
+    if (GMP_FAILED(frame->CreateEmptyFrame(width, mConfig.mHeight,
+                                           width, halfWidth, halfWidth))) {
+      return false;
+    }
+    frame->SetTimestamp(aIndex);
+
+    nsTArray<uint8_t> info;
+    nsTArray<GMPVideoFrameType> frameTypes;
+    // Fake keyframes carry a large padding; only the first one is a
+    // keyframe so that the encoded pool sees steady sizes.
+    frameTypes.AppendElement(aIndex ? kGMPDeltaFrame : kGMPKeyFrame);
+    return GMP_SUCCEEDED(mGMP->Encode(Move(frame), info, frameTypes));
+  }
+
+  void Close() override
+  {
+    if (mGMP) {
+      mGMP->Close();
+      mGMP = nullptr;
+    }
+  }
+
+  GMPVideoEncoderProxy* mGMP;
+  GMPVideoHost* mHost;
+};
+
+// Buffers are copied over IPC both ways; the fake decryptor returns them
+// untouched.
+// Must match the key id gmp-fake echoes buffers for; see
+// gmp-plugin/gmp-test-decryptor.h.
+static const char kEchoKeyId[] = "gmp-ipc-benchmark";
+
+class DecryptorBenchmark : public GMPIPCBenchmark
+                         , public GMPDecryptorProxyCallback
+{
+public:
+  explicit DecryptorBenchmark(const BenchmarkConfig& aConfig)
+    : GMPIPCBenchmark("decryptor", aConfig)
+    , mGMP(nullptr)
+  {
+  }
+
+  void SetDecryptorId(uint32_t aId) override
+  {
+    if (mGMP) {
+      Started(mGMP->GetPluginId());
+    }
+  }
+  void SetSessionId(uint32_t aCreateSessionToken,
+                    const nsCString& aSessionId) override {}
+  void ResolveLoadSessionPromise(uint32_t aPromiseId,
+                                 bool aSuccess) override {}
+  void ResolvePromise(uint32_t aPromiseId) override {}
+  void RejectPromise(uint32_t aPromiseId,
+                     nsresult aException,
+                     const nsCString& aSessionId) override {}
+  void SessionMessage(const nsCString& aSessionId,
+                      dom::MediaKeyMessageType aMessageType,
+                      const nsTArray<uint8_t>& aMessage) override {}
+  void ExpirationChange(const nsCString& aSessionId,
+                        UnixTime aExpiryTime) override {}
+  void SessionClosed(const nsCString& aSessionId) override {}
+  void SessionError(const nsCString& aSessionId,
+                    nsresult aException,
+                    uint32_t aSystemCode,
+                    const nsCString& aMessage) override {}
+  void Decrypted(uint32_t aId,
+                 DecryptStatus aResult,
+                 const nsTArray<uint8_t>& aDecryptedData) override
+  {
+    if (aResult != Ok || aDecryptedData.Length() != mConfig.mBufferSize) {
+      Failed("decrypt failed");
+      return;
+    }
+    Replied(aId, TimeStamp::Now());
+  }
+  void BatchedKeyStatusChanged(const nsCString& aSessionId,
+                               const nsTArray<CDMKeyInfo>& aKeyInfos) override {}
+  void Terminated() override { Failed("decryptor terminated"); }
+
+private:
+  class DecryptorReady : public GetGMPDecryptorCallback
+  {
+  public:
+    explicit DecryptorReady(DecryptorBenchmark* aBenchmark)
+      : mBenchmark(aBenchmark)
+    {
+    }
+
+    void Done(GMPDecryptorProxy* aDecryptor) override
+    {
+      mBenchmark->Init(aDecryptor);
+    }
+
+  private:
+    RefPtr<DecryptorBenchmark> mBenchmark;
+  };
+
+  void Start() override
+  {
+    nsTArray<nsCString> tags;
+    tags.AppendElement(NS_LITERAL_CSTRING("fake"));
+    UniquePtr<GetGMPDecryptorCallback> callback(new DecryptorReady(this));
+    RefPtr<GeckoMediaPluginService> service =
+      GeckoMediaPluginService::GetGeckoMediaPluginService();
+    if (NS_FAILED(service->GetGMPDecryptor(nullptr, &tags, EmptyCString(),
+                                           Move(callback)))) {
+      Failed("GetGMPDecryptor failed");
+    }
+  }
+
+  // Requests are sent once the decryptor id arrives, as the CDM does.
+  void Init(GMPDecryptorProxy* aDecryptor)
+  {
+    if (!aDecryptor) {
+      Failed("no decryptor");
+      return;
+    }
+    mGMP = aDecryptor;
+    if (NS_FAILED(mGMP->Init(this, false, false))) {
+      Failed("decryptor Init failed");
+    }
+  }
+
+  bool Send(uint64_t aIndex) override
+  {
+    nsTArray<uint8_t> buffer;
+    buffer.SetLength(mConfig.mBufferSize);
+    memset(buffer.Elements(), aIndex & 0xff, buffer.Length());
+    // The fake decryptor only hands back buffers using this key id.
+    CryptoSample crypto;
+    crypto.mValid = true;
+    crypto.mKeyId.AppendElements(reinterpret_cast<const uint8_t*>(kEchoKeyId),
+                                  sizeof(kEchoKeyId) - 1);
+    mGMP->Decrypt(uint32_t(aIndex), crypto, buffer);
+    return true;
+  }
+
+  void Close() override
+  {
+    if (mGMP) {
+      mGMP->Close();
+      mGMP = nullptr;
+    }
+  }
+
+  GMPDecryptorProxy* mGMP;
+};
+
+TEST(GMPIPCBenchmark, DISABLED_VideoDecoder)
+{
+  for (const auto& config : VideoConfigs()) {
+    RefPtr<VideoDecoderBenchmark> benchmark = new VideoDecoderBenchmark(config);
+    benchmark->Run();
+  }
+}
+
+TEST(GMPIPCBenchmark, DISABLED_VideoEncoder)
+{
+  for (const auto& config : VideoConfigs()) {
+    RefPtr<VideoEncoderBenchmark> benchmark = new VideoEncoderBenchmark(config);
+    benchmark->Run();
+  }
+}
+
+TEST(GMPIPCBenchmark, DISABLED_Decryptor)
+{
+  for (const auto& config : DecryptorConfigs()) {
+    RefPtr<DecryptorBenchmark> benchmark = new DecryptorBenchmark(config);
+    benchmark->Run();
+  }
+}
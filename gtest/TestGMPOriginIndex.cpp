@@ -0,0 +1,194 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "gtest/gtest.h"
+#include "GMPOriginIndex.h"
+#include "nsDirectoryServiceDefs.h"
+#include "nsDirectoryServiceUtils.h"
+#include "prio.h"
+
+using namespace mozilla;
+using namespace mozilla::gmp;
+
+static already_AddRefed<nsIFile>
+CreateTempDir()
+{
+  nsCOMPtr<nsIFile> dir;
+  if (NS_FAILED(NS_GetSpecialDirectory(NS_OS_TEMP_DIR, getter_AddRefs(dir))) ||
+      NS_FAILED(dir->AppendNative(NS_LITERAL_CSTRING("TestGMPOriginIndex"))) ||
+      NS_FAILED(dir->CreateUnique(nsIFile::DIRECTORY_TYPE, 0700))) {
+    return nullptr;
+  }
+  return dir.forget();
+}
+
+struct ModifiedSinceFilter : public GMPOriginIndex::EntryFilter {
+  explicit ModifiedSinceFilter(PRTime aSince) : mSince(aSince) {}
+  bool operator()(const GMPOriginIndex::Entry& aEntry) override {
+    return aEntry.mLastModified >= mSince;
+  }
+  const PRTime mSince;
+};
+
+static void
+AddNodes(GMPOriginIndex* aIndex)
+{
+  aIndex->AddNodeId(NS_LITERAL_CSTRING("salt1"), NS_LITERAL_CSTRING("1"),
+                    NS_LITERAL_CSTRING("http://example1.com"),
+                    NS_LITERAL_CSTRING("http://example2.com"), 1000);
+  aIndex->AddNodeId(NS_LITERAL_CSTRING("salt2"), NS_LITERAL_CSTRING("2"),
+                    NS_LITERAL_CSTRING("http://example3.com^userContextId=1"),
+                    NS_LITERAL_CSTRING("http://example3.com^userContextId=1"),
+                    2000);
+}
+
+TEST(GMPOriginIndex, PersistsUpdates)
+{
+  nsCOMPtr<nsIFile> dir = CreateTempDir();
+  ASSERT_TRUE(dir);
+
+  RefPtr<GMPOriginIndex> index = new GMPOriginIndex(dir);
+  EXPECT_FALSE(index->Load());
+  index->Reset(nsTArray<GMPOriginIndex::Entry>());
+  AddNodes(index);
+  index->NoteStorageWrite(NS_LITERAL_CSTRING("salt1"), 3000, 100);
+  index->NoteStorageWrite(NS_LITERAL_CSTRING("salt1"), 2500, -40);
+  // Writes of nodes which aren't indexed are ignored.
+  index->NoteStorageWrite(NS_LITERAL_CSTRING("salt3"), 3000, 100);
+  index->Close();
+
+  index = new GMPOriginIndex(dir);
+  ASSERT_TRUE(index->Load());
+  EXPECT_TRUE(index->Contains(NS_LITERAL_CSTRING("salt1")));
+  EXPECT_TRUE(index->Contains(NS_LITERAL_CSTRING("salt2")));
+  EXPECT_FALSE(index->Contains(NS_LITERAL_CSTRING("salt3")));
+
+  // Only the entries modified since 2500 are taken.
+  ModifiedSinceFilter filter(2500);
+  nsTArray<GMPOriginIndex::Entry> entries;
+  index->TakeEntries(filter, entries);
+  ASSERT_EQ(1u, entries.Length());
+  EXPECT_TRUE(entries[0].mNodeId.EqualsLiteral("salt1"));
+  EXPECT_TRUE(entries[0].mOriginHash.EqualsLiteral("1"));
+  EXPECT_TRUE(entries[0].mOrigin.EqualsLiteral("http://example1.com"));
+  EXPECT_TRUE(entries[0].mTopLevelOrigin.EqualsLiteral("http://example2.com"));
+  EXPECT_EQ(3000, entries[0].mLastModified);
+  EXPECT_EQ(60u, entries[0].mStorageSize);
+  index->Close();
+
+  index = new GMPOriginIndex(dir);
+  ASSERT_TRUE(index->Load());
+  EXPECT_FALSE(index->Contains(NS_LITERAL_CSTRING("salt1")));
+  EXPECT_TRUE(index->Contains(NS_LITERAL_CSTRING("salt2")));
+
+  dir->Remove(true);
+}
+
+TEST(GMPOriginIndex, DistrustsUncleanShutdown)
+{
+  nsCOMPtr<nsIFile> dir = CreateTempDir();
+  ASSERT_TRUE(dir);
+
+  // Never closed, as after a crash.
+  RefPtr<GMPOriginIndex> index = new GMPOriginIndex(dir);
+  index->Reset(nsTArray<GMPOriginIndex::Entry>());
+  AddNodes(index);
+  index = new GMPOriginIndex(dir);
+  EXPECT_FALSE(index->Load());
+  EXPECT_FALSE(index->Contains(NS_LITERAL_CSTRING("salt1")));
+
+  // Closed, but with a torn update at the end.
+  index->Reset(nsTArray<GMPOriginIndex::Entry>());
+  AddNodes(index);
+  index->Close();
+  nsCOMPtr<nsIFile> file;
+  ASSERT_TRUE(NS_SUCCEEDED(dir->Clone(getter_AddRefs(file))));
+  ASSERT_TRUE(NS_SUCCEEDED(file->AppendNative(NS_LITERAL_CSTRING("originindex"))));
+  PRFileDesc* fd = nullptr;
+  ASSERT_TRUE(NS_SUCCEEDED(file->OpenNSPRFileDesc(PR_WRONLY | PR_APPEND, 0, &fd)));
+  const char torn[] = "+\tsalt3\t3\t30";
+  PR_Write(fd, torn, sizeof(torn) - 1);
+  PR_Close(fd);
+  index = new GMPOriginIndex(dir);
+  EXPECT_FALSE(index->Load());
+
+  dir->Remove(true);
+}
+
+static void
+CreateSubdirectory(nsIFile* aDir, const char* aParent, const char* aName)
+{
+  nsCOMPtr<nsIFile> path;
+  ASSERT_TRUE(NS_SUCCEEDED(aDir->Clone(getter_AddRefs(path))));
+  ASSERT_TRUE(NS_SUCCEEDED(path->AppendNative(nsDependentCString(aParent))));
+  ASSERT_TRUE(NS_SUCCEEDED(path->AppendNative(nsDependentCString(aName))));
+  ASSERT_TRUE(NS_SUCCEEDED(path->Create(nsIFile::DIRECTORY_TYPE, 0700)));
+}
+
+TEST(GMPOriginIndex, DistrustsChangesByOlderVersions)
+{
+  nsCOMPtr<nsIFile> dir = CreateTempDir();
+  ASSERT_TRUE(dir);
+  CreateSubdirectory(dir, "id", "1");
+  CreateSubdirectory(dir, "storage", "salt1");
+
+  RefPtr<GMPOriginIndex> index = new GMPOriginIndex(dir);
+  index->Reset(nsTArray<GMPOriginIndex::Entry>());
+  AddNodes(index);
+  index->Close();
+  index = new GMPOriginIndex(dir);
+  ASSERT_TRUE(index->Load());
+  index->Close();
+
+  // A version which doesn't maintain the index adds a node id.
+  CreateSubdirectory(dir, "id", "3");
+  index = new GMPOriginIndex(dir);
+  EXPECT_FALSE(index->Load());
+  index->Reset(nsTArray<GMPOriginIndex::Entry>());
+  AddNodes(index);
+  index->Close();
+
+  // Or clears one.
+  nsCOMPtr<nsIFile> storage;
+  ASSERT_TRUE(NS_SUCCEEDED(dir->Clone(getter_AddRefs(storage))));
+  ASSERT_TRUE(NS_SUCCEEDED(storage->AppendNative(NS_LITERAL_CSTRING("storage"))));
+  ASSERT_TRUE(NS_SUCCEEDED(storage->AppendNative(NS_LITERAL_CSTRING("salt1"))));
+  ASSERT_TRUE(NS_SUCCEEDED(storage->Remove(true)));
+  index = new GMPOriginIndex(dir);
+  EXPECT_FALSE(index->Load());
+
+  dir->Remove(true);
+}
+
+TEST(GMPOriginIndex, ClearAfterStorageDeleted)
+{
+  nsCOMPtr<nsIFile> dir = CreateTempDir();
+  ASSERT_TRUE(dir);
+
+  RefPtr<GMPOriginIndex> index = new GMPOriginIndex(dir);
+  index->Reset(nsTArray<GMPOriginIndex::Entry>());
+  AddNodes(index);
+
+  // As ClearStorage() does.
+  ASSERT_TRUE(NS_SUCCEEDED(dir->Remove(true)));
+  index->Clear();
+  EXPECT_FALSE(index->Contains(NS_LITERAL_CSTRING("salt1")));
+  bool exists = true;
+  ASSERT_TRUE(NS_SUCCEEDED(dir->Exists(&exists)));
+  EXPECT_FALSE(exists);
+
+  // The next update once the storage is recreated writes the whole index.
+  ASSERT_TRUE(NS_SUCCEEDED(dir->Create(nsIFile::DIRECTORY_TYPE, 0700)));
+  index->AddNodeId(NS_LITERAL_CSTRING("salt3"), NS_LITERAL_CSTRING("3"),
+                   NS_LITERAL_CSTRING("http://example4.com"),
+                   NS_LITERAL_CSTRING("http://example4.com"), 4000);
+  index->Close();
+  index = new GMPOriginIndex(dir);
+  ASSERT_TRUE(index->Load());
+  EXPECT_FALSE(index->Contains(NS_LITERAL_CSTRING("salt1")));
+  EXPECT_TRUE(index->Contains(NS_LITERAL_CSTRING("salt3")));
+
+  dir->Remove(true);
+}
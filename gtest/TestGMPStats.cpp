@@ -0,0 +1,87 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* vim: set ts=8 sts=2 et sw=2 tw=80: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "gtest/gtest.h"
+#include "GMPStats.h"
+#include "GMPSharedMemManager.h"
+
+using namespace mozilla;
+using namespace mozilla::gmp;
+
+TEST(GeckoMediaPlugins, GMPLatencyHistogram)
+{
+  GMPLatencyHistogram histogram;
+  EXPECT_EQ(histogram.Count(), 0u);
+  EXPECT_EQ(histogram.PercentileUs(50), 0u);
+
+  // 90 samples of ~100us, 10 samples of ~10ms.
+  for (int i = 0; i < 90; i++) {
+    histogram.Accumulate(TimeDuration::FromMicroseconds(100));
+  }
+  for (int i = 0; i < 10; i++) {
+    histogram.Accumulate(TimeDuration::FromMilliseconds(10));
+  }
+  EXPECT_EQ(histogram.Count(), 100u);
+  // 100us is in [64, 128).
+  EXPECT_EQ(histogram.BucketCount(6), 90u);
+  EXPECT_EQ(histogram.PercentileUs(50), 128u);
+  EXPECT_EQ(histogram.PercentileUs(90), 128u);
+  // 10000us is in [8192, 16384).
+  EXPECT_EQ(histogram.PercentileUs(99), 16384u);
+}
+
+TEST(GeckoMediaPlugins, GMPActorStats)
+{
+  RefPtr<GMPPluginStats> plugin =
+    new GMPPluginStats(1, NS_LITERAL_CSTRING("fake"));
+  RefPtr<GMPActorStats> actor = plugin->CreateActorStats("video-decoder");
+
+  nsTArray<RefPtr<GMPPluginStats>> plugins;
+  GMPPluginStats::GetAll(plugins);
+  EXPECT_TRUE(plugins.Contains(plugin));
+
+  actor->MessageSent(100);
+  actor->RequestSent(1);
+  actor->MessageSent(200);
+  actor->RequestSent(2);
+  EXPECT_EQ(actor->MessagesSent(), 2u);
+  EXPECT_EQ(actor->BytesSent(), 300u);
+  EXPECT_EQ(actor->QueueDepth(), 2u);
+
+  actor->MessageReceived(50);
+  actor->ReplyReceived(1);
+  // Unknown ids are ignored.
+  actor->ReplyReceived(42);
+  EXPECT_EQ(actor->BytesReceived(), 50u);
+  EXPECT_EQ(actor->QueueDepth(), 1u);
+  EXPECT_EQ(actor->MaxQueueDepth(), 2u);
+  EXPECT_EQ(actor->RoundTrip().Count(), 1u);
+
+  actor->ClearPendingRequests();
+  EXPECT_EQ(actor->QueueDepth(), 0u);
+
+  plugin->ShmemAllocated(GMPSharedMem::kGMPFrameData, false, 1);
+  plugin->ShmemAllocated(GMPSharedMem::kGMPFrameData, true, 3);
+  plugin->ShmemAllocated(GMPSharedMem::kGMPFrameData, true, 2);
+  EXPECT_EQ(plugin->ShmemAllocations(GMPSharedMem::kGMPFrameData), 3u);
+  EXPECT_EQ(plugin->ShmemPoolHits(GMPSharedMem::kGMPFrameData), 2u);
+  EXPECT_EQ(plugin->ShmemHighWater(GMPSharedMem::kGMPFrameData), 3u);
+  EXPECT_EQ(plugin->ShmemAllocations(GMPSharedMem::kGMPEncodedData), 0u);
+
+  nsTArray<RefPtr<GMPActorStats>> actors;
+  plugin->GetActors(actors);
+  EXPECT_EQ(actors.Length(), 1u);
+  actors.Clear();
+
+  actor->ActorDestroyed();
+  plugin->GetActors(actors);
+  EXPECT_TRUE(actors.IsEmpty());
+
+  plugin->Unregister();
+  plugins.Clear();
+  GMPPluginStats::GetAll(plugins);
+  EXPECT_FALSE(plugins.Contains(plugin));
+}
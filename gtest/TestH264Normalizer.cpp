@@ -0,0 +1,94 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "gtest/gtest.h"
+#include "H264Normalizer.h"
+#include "mozilla/ArrayUtils.h"
+
+using namespace mozilla;
+
+static const uint8_t*
+NaiveFindStartCode(const uint8_t* aStart, const uint8_t* aEnd)
+{
+  for (const uint8_t* p = aStart; aEnd - p >= 3; p++) {
+    if (p[0] == 0 && p[1] == 0 && p[2] == 1) {
+      return p;
+    }
+  }
+  return aEnd;
+}
+
+TEST(H264Normalizer, FindStartCode)
+{
+  // Start codes at every offset and alignment, with zero bytes around them
+  // that aren't start codes.
+  uint8_t buffer[64];
+  for (size_t offset = 0; offset + 3 <= sizeof(buffer); offset++) {
+    for (size_t length = offset + 3; length <= sizeof(buffer); length += 5) {
+      memset(buffer, 0xaa, sizeof(buffer));
+      if (offset >= 2) {
+        buffer[offset - 2] = 0;
+      }
+      buffer[offset] = 0;
+      buffer[offset + 1] = 0;
+      buffer[offset + 2] = 1;
+      for (size_t start = 0; start < length; start += 3) {
+        EXPECT_EQ(H264Normalizer::FindStartCode(buffer + start, buffer + length),
+                  NaiveFindStartCode(buffer + start, buffer + length));
+      }
+    }
+  }
+
+  // A start code cut short by the end of the buffer isn't found.
+  const uint8_t truncated[] = { 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0x00, 0x00 };
+  EXPECT_EQ(H264Normalizer::FindStartCode(truncated, ArrayEnd(truncated)),
+            ArrayEnd(truncated));
+}
+
+TEST(H264Normalizer, ExtractParameterSets)
+{
+  const uint8_t sample[] = {
+    0x00, 0x00, 0x00, 0x01, 0x09, 0xf0,                   // AUD
+    0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0xc0, 0x1e, 0xd9, // SPS
+    0x00, 0x00, 0x01, 0x68, 0xce, 0x3c, 0x80,             // PPS
+    0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x21, 0x00,       // IDR slice
+    0x00, 0x00, 0x01, 0x67, 0x64, 0x00, 0x1f, 0xac,       // after the slice
+  };
+  RefPtr<MediaRawData> raw = new MediaRawData(sample, sizeof(sample));
+  raw->mKeyframe = true;
+
+  EXPECT_EQ(H264Normalizer::DetectFormat(nullptr, raw),
+            H264Normalizer::Format::AnnexB);
+  EXPECT_TRUE(H264Normalizer::HasAnnexBSPS(raw));
+
+  const uint8_t expected[] = {
+    0x01, 0x42, 0xc0, 0x1e, 0xff,
+    0xe1, 0x00, 0x05, 0x67, 0x42, 0xc0, 0x1e, 0xd9,
+    0x01, 0x00, 0x04, 0x68, 0xce, 0x3c, 0x80,
+  };
+  RefPtr<MediaByteBuffer> extraData =
+    H264Normalizer::ExtractAnnexBExtraData(raw);
+  ASSERT_EQ(extraData->Length(), sizeof(expected));
+  EXPECT_EQ(memcmp(extraData->Elements(), expected, sizeof(expected)), 0);
+
+  // An avcC configuration means length-prefixed samples.
+  RefPtr<MediaByteBuffer> avcC = new MediaByteBuffer;
+  avcC->AppendElements(expected, sizeof(expected));
+  EXPECT_EQ(H264Normalizer::DetectFormat(avcC, raw),
+            H264Normalizer::Format::AVCC);
+
+  // The trailing zero byte of the slice isn't part of it.
+  AnnexBNALIterator it(raw->Data(), raw->Size());
+  const uint8_t* nal;
+  size_t size;
+  uint32_t count = 0;
+  while (it.Next(&nal, &size)) {
+    if ((nal[0] & 0x1f) == 5) {
+      EXPECT_EQ(size, 4u);
+    }
+    count++;
+  }
+  EXPECT_EQ(count, 5u);
+}
@@ -12,6 +12,8 @@
 #include "mozilla/TaskQueue.h"
 #include "mozilla/ArrayUtils.h"
 #include "MockMediaResource.h"
+#include "H264Normalizer.h"
+#include "mp4_demuxer/AnnexB.h"
 #include "VideoUtils.h"
 
 using namespace mozilla;
@@ -460,4 +462,76 @@ TEST(MP4Demuxer, IgnoreMinus1Duration)
   });
 }
 
+// NAL units of a sample with 4 bytes length prefixes.
+static nsTArray<nsTArray<uint8_t>>
+AVCCNALUnits(const MediaRawData* aSample)
+{
+  nsTArray<nsTArray<uint8_t>> units;
+  const uint8_t* p = aSample->Data();
+  const uint8_t* end = p + aSample->Size();
+  while (end - p >= 4) {
+    uint32_t size = (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+    p += 4;
+    if (size > uint32_t(end - p)) {
+      break;
+    }
+    units.AppendElement()->AppendElements(p, size);
+    p += size;
+  }
+  return units;
+}
+
+static nsTArray<nsTArray<uint8_t>>
+AnnexBNALUnits(const MediaRawData* aSample)
+{
+  nsTArray<nsTArray<uint8_t>> units;
+  AnnexBNALIterator it(aSample->Data(), aSample->Size());
+  const uint8_t* nal;
+  size_t size;
+  while (it.Next(&nal, &size)) {
+    units.AppendElement()->AppendElements(nal, size);
+  }
+  return units;
+}
+
+// Checks the single-pass Annex B handling of H264Converter against the
+// AVCC round-trip it replaces, on every video sample of the fixture.
+TEST(MP4Demuxer, H264NormalizerMatchesAnnexBConversion)
+{
+  RefPtr<MP4DemuxerBinding> binding = new MP4DemuxerBinding();
+
+  binding->RunTestAndWait([binding] () {
+    binding->mVideoTrack = binding->mDemuxer->GetTrackDemuxer(TrackInfo::kVideoTrack, 0);
+    binding->CheckTrackSamples(binding->mVideoTrack)
+      ->Then(binding->mTaskQueue, __func__,
+        [binding] () {
+          uint32_t keyframes = 0;
+          for (const auto& sample : binding->mSamples) {
+            RefPtr<MediaRawData> annexB = sample->Clone();
+            EXPECT_TRUE(mp4_demuxer::AnnexB::ConvertSampleToAnnexB(annexB));
+            EXPECT_EQ(H264Normalizer::DetectFormat(nullptr, annexB),
+                      H264Normalizer::Format::AnnexB);
+
+            RefPtr<MediaRawData> avcc = annexB->Clone();
+            EXPECT_TRUE(mp4_demuxer::AnnexB::ConvertSampleToAVCC(avcc));
+            EXPECT_EQ(AnnexBNALUnits(annexB), AVCCNALUnits(avcc));
+
+            RefPtr<MediaByteBuffer> expected =
+              mp4_demuxer::AnnexB::ExtractExtraData(avcc);
+            RefPtr<MediaByteBuffer> extraData =
+              H264Normalizer::ExtractAnnexBExtraData(annexB);
+            EXPECT_EQ(*extraData, *expected);
+            EXPECT_EQ(H264Normalizer::HasAnnexBSPS(annexB),
+                      mp4_demuxer::AnnexB::HasSPS(expected));
+            if (sample->mKeyframe) {
+              keyframes++;
+              EXPECT_TRUE(H264Normalizer::HasAnnexBSPS(annexB));
+            }
+          }
+          EXPECT_GT(keyframes, 0u);
+          binding->mTaskQueue->BeginShutdown();
+        }, DO_FAIL);
+  });
+}
+
 #undef DO_FAIL
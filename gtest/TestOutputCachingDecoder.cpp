@@ -0,0 +1,234 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "gtest/gtest.h"
+#include "MediaData.h"
+#include "MediaInfo.h"
+#include "OutputCachingDecoder.h"
+#include "mozilla/Mutex.h"
+#include "mozilla/SharedThreadPool.h"
+#include "mozilla/TaskQueue.h"
+#include "VideoUtils.h"
+
+using namespace mozilla;
+
+// Decoder outputting one frame per input sample from its task queue, and
+// counting the samples it is fed.
+class CountingDecoder : public MediaDataDecoder
+{
+public:
+  CountingDecoder(TaskQueue* aTaskQueue, MediaDataDecoderCallback* aCallback)
+    : mInputs(0)
+    , mTaskQueue(aTaskQueue)
+    , mCallback(aCallback)
+    , mInfo(64, 64)
+  {}
+
+  RefPtr<InitPromise> Init() override
+  {
+    return InitPromise::CreateAndResolve(TrackInfo::kVideoTrack, __func__);
+  }
+  void Input(MediaRawData* aSample) override
+  {
+    mInputs++;
+    RefPtr<VideoData> frame =
+      VideoData::CreateFromImage(mInfo, aSample->mOffset, aSample->mTime,
+                                 aSample->mDuration, nullptr,
+                                 aSample->mKeyframe, aSample->mTimecode,
+                                 gfx::IntRect(0, 0, 64, 64));
+    MediaDataDecoderCallback* callback = mCallback;
+    mTaskQueue->Dispatch(NS_NewRunnableFunction([callback, frame]() {
+      callback->Output(frame);
+      callback->InputExhausted();
+    }));
+  }
+  void Flush() override { mTaskQueue->AwaitIdle(); }
+  void Drain() override
+  {
+    MediaDataDecoderCallback* callback = mCallback;
+    mTaskQueue->Dispatch(NS_NewRunnableFunction([callback]() {
+      callback->DrainComplete();
+    }));
+  }
+  void Shutdown() override {}
+  const char* GetDescriptionName() const override { return "counting decoder"; }
+
+  Atomic<uint32_t> mInputs;
+
+private:
+  const RefPtr<TaskQueue> mTaskQueue;
+  MediaDataDecoderCallback* mCallback;
+  VideoInfo mInfo;
+};
+
+class RecordingCallback : public MediaDataDecoderCallback
+{
+public:
+  RecordingCallback()
+    : mMutex("RecordingCallback")
+    , mInputExhausted(0)
+    , mDrainComplete(0)
+  {}
+
+  void Output(MediaData* aData) override
+  {
+    MutexAutoLock lock(mMutex);
+    mTimes.AppendElement(aData->mTime);
+  }
+  void Error(const MediaResult& aError) override { EXPECT_TRUE(false); }
+  void InputExhausted() override { mInputExhausted++; }
+  void DrainComplete() override { mDrainComplete++; }
+  bool OnReaderTaskQueue() override { return true; }
+
+  nsTArray<int64_t> TakeTimes()
+  {
+    MutexAutoLock lock(mMutex);
+    nsTArray<int64_t> times;
+    times.SwapElements(mTimes);
+    return times;
+  }
+
+  Mutex mMutex;
+  nsTArray<int64_t> mTimes;
+  Atomic<uint32_t> mInputExhausted;
+  Atomic<uint32_t> mDrainComplete;
+};
+
+class CachingDecoderTest : public ::testing::Test
+{
+protected:
+  CachingDecoderTest()
+    : mTaskQueue(new TaskQueue(
+        GetMediaThreadPool(MediaThreadType::PLATFORM_DECODER)))
+    , mCache(new OutputCachingDecoder(mTaskQueue, &mCallback))
+    , mDecoder(new CountingDecoder(mTaskQueue, mCache))
+  {
+    RefPtr<MediaDataDecoder> decoder = mDecoder;
+    mCache->SetDecoder(decoder.forget());
+  }
+
+  ~CachingDecoderTest()
+  {
+    mCache->Shutdown();
+    mTaskQueue->BeginShutdown();
+    mTaskQueue->AwaitShutdownAndIdle();
+  }
+
+  // Ten samples of 40ms, with a keyframe every fourth one. aChanged alters
+  // the content of that sample.
+  static nsTArray<RefPtr<MediaRawData>> MakeSamples(int aChanged = -1)
+  {
+    nsTArray<RefPtr<MediaRawData>> samples;
+    for (int i = 0; i < 10; i++) {
+      uint8_t data[16];
+      memset(data, i == aChanged ? 0xff : i, sizeof(data));
+      RefPtr<MediaRawData> sample = new MediaRawData(data, sizeof(data));
+      sample->mTime = i * 40000;
+      sample->mTimecode = sample->mTime;
+      sample->mDuration = 40000;
+      sample->mKeyframe = i % 4 == 0;
+      samples.AppendElement(sample);
+    }
+    return samples;
+  }
+
+  // Feeds aSamples from the start, as after a seek to the beginning, and
+  // drains the decoder.
+  nsTArray<int64_t> Play(const nsTArray<RefPtr<MediaRawData>>& aSamples)
+  {
+    mCache->Flush();
+    for (const auto& sample : aSamples) {
+      mCache->Input(sample);
+    }
+    mCache->Drain();
+    mTaskQueue->AwaitIdle();
+    return mCallback.TakeTimes();
+  }
+
+  RecordingCallback mCallback;
+  RefPtr<TaskQueue> mTaskQueue;
+  RefPtr<OutputCachingDecoder> mCache;
+  RefPtr<CountingDecoder> mDecoder;
+};
+
+TEST_F(CachingDecoderTest, ReplaysLoop)
+{
+  nsTArray<RefPtr<MediaRawData>> samples = MakeSamples();
+  nsTArray<int64_t> first = Play(samples);
+  EXPECT_EQ(10u, first.Length());
+  EXPECT_EQ(10u, uint32_t(mDecoder->mInputs));
+  // Not looping yet.
+  EXPECT_EQ(0u, OutputCachingDecoder::TotalCachedBytes());
+
+  nsTArray<int64_t> second = Play(samples);
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(20u, uint32_t(mDecoder->mInputs));
+  EXPECT_GT(OutputCachingDecoder::TotalCachedBytes(), 0u);
+
+  for (int loop = 0; loop < 3; loop++) {
+    nsTArray<int64_t> again = Play(samples);
+    EXPECT_EQ(first, again);
+  }
+  // Only the first two passes were decoded.
+  EXPECT_EQ(20u, uint32_t(mDecoder->mInputs));
+  EXPECT_EQ(30u, mCache->ReplayedFrames());
+  EXPECT_EQ(50u, uint32_t(mCallback.mInputExhausted));
+  EXPECT_EQ(5u, uint32_t(mCallback.mDrainComplete));
+
+  mCache->Shutdown();
+  EXPECT_EQ(0u, OutputCachingDecoder::TotalCachedBytes());
+}
+
+TEST_F(CachingDecoderTest, DoesntCacheWithoutLoop)
+{
+  nsTArray<RefPtr<MediaRawData>> samples = MakeSamples();
+  Play(samples);
+  // A seek elsewhere than the start of the stream isn't a loop.
+  nsTArray<RefPtr<MediaRawData>> end(samples);
+  end.RemoveElementsAt(0, 5);
+  Play(end);
+  EXPECT_EQ(0u, OutputCachingDecoder::TotalCachedBytes());
+  EXPECT_EQ(15u, uint32_t(mDecoder->mInputs));
+  EXPECT_EQ(0u, mCache->ReplayedFrames());
+}
+
+TEST_F(CachingDecoderTest, DecodesChangedContent)
+{
+  Play(MakeSamples());
+  nsTArray<int64_t> first = Play(MakeSamples());
+  nsTArray<int64_t> changed = Play(MakeSamples(6));
+  // Samples 0 to 5 are replayed, then the decoder catches up from the
+  // keyframe at 4 and decodes the rest. Frames 4 and 5 come either from the
+  // cache or from the decoder, depending on when they were recorded, but
+  // never from both.
+  EXPECT_EQ(first, changed);
+  EXPECT_EQ(20u + 2u + 4u, uint32_t(mDecoder->mInputs));
+  EXPECT_GE(mCache->ReplayedFrames(), 4u);
+  EXPECT_LE(mCache->ReplayedFrames(), 6u);
+  EXPECT_EQ(30u, uint32_t(mCallback.mInputExhausted));
+
+  // The changed pass wasn't recorded from its start, so the next one is
+  // decoded again.
+  Play(MakeSamples(6));
+  EXPECT_EQ(36u, uint32_t(mDecoder->mInputs));
+}
+
+TEST_F(CachingDecoderTest, DoesntReplayPartialPass)
+{
+  nsTArray<RefPtr<MediaRawData>> samples = MakeSamples();
+  Play(samples);
+  // A seek before the end of the second pass, which was being recorded.
+  mCache->Flush();
+  for (uint32_t i = 0; i < 5; i++) {
+    mCache->Input(samples[i]);
+  }
+  mTaskQueue->AwaitIdle();
+  mCallback.TakeTimes();
+
+  Play(samples);
+  EXPECT_EQ(25u, uint32_t(mDecoder->mInputs));
+  Play(samples);
+  EXPECT_EQ(25u, uint32_t(mDecoder->mInputs));
+}
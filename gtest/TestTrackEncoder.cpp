@@ -4,7 +4,9 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include "gtest/gtest.h"
+#include "EncodedFrameRingBuffer.h"
 #include "OpusTrackEncoder.h"
+#include "PassthroughTrackEncoder.h"
 
 using namespace mozilla;
 
@@ -92,3 +94,287 @@ TEST(Media, OpusEncoder_Resample)
   EXPECT_FALSE(TestOpusResampler(1, 9600) == 9600);
   EXPECT_FALSE(TestOpusResampler(1, 44100) == 44100);
 }
+
+TEST(Media, EncoderSpeedController_SpeedsUpUnderLoad)
+{
+  EncoderSpeedController controller(3);
+  TimeDuration frame = TimeDuration::FromMilliseconds(33);
+  // Encoding takes as long as the frame lasts: speed up, one level at a time,
+  // until the fastest level is reached.
+  uint32_t changes = 0;
+  for (int i = 0; i < 200; i++) {
+    uint32_t before = controller.Level();
+    if (controller.Update(frame, frame, TimeDuration())) {
+      changes++;
+      EXPECT_EQ(controller.Level(), before + 1);
+    }
+  }
+  EXPECT_EQ(changes, 3u);
+  EXPECT_EQ(controller.Level(), 3u);
+}
+
+TEST(Media, EncoderSpeedController_SpeedsUpWhenQueueGrows)
+{
+  EncoderSpeedController controller(3);
+  TimeDuration frame = TimeDuration::FromMilliseconds(33);
+  // Encoding is fast, but data keeps piling up.
+  for (int i = 0; i < 20; i++) {
+    controller.Update(TimeDuration::FromMilliseconds(5), frame, frame * 5);
+  }
+  EXPECT_GT(controller.Level(), 0u);
+}
+
+TEST(Media, EncoderSpeedController_SlowsDownWhenIdle)
+{
+  EncoderSpeedController controller(3);
+  TimeDuration frame = TimeDuration::FromMilliseconds(20);
+  for (int i = 0; i < 50; i++) {
+    controller.Update(frame, frame, TimeDuration());
+  }
+  uint32_t loaded = controller.Level();
+  EXPECT_GT(loaded, 0u);
+
+  // Going back to a higher quality is slower than degrading it, to avoid
+  // oscillating between levels.
+  for (int i = 0; i < 30; i++) {
+    controller.Update(TimeDuration::FromMilliseconds(1), frame, TimeDuration());
+  }
+  EXPECT_EQ(controller.Level(), loaded);
+  for (int i = 0; i < 1000; i++) {
+    controller.Update(TimeDuration::FromMilliseconds(1), frame, TimeDuration());
+  }
+  EXPECT_EQ(controller.Level(), 0u);
+}
+
+static already_AddRefed<EncodedFrame>
+CreatePassthroughFrame(EncodedFrame::FrameType aType, uint64_t aTime,
+                       uint64_t aDuration)
+{
+  RefPtr<EncodedFrame> frame = new EncodedFrame();
+  frame->SetFrameType(aType);
+  frame->SetTimeStamp(aTime);
+  frame->SetDuration(aDuration);
+  return frame.forget();
+}
+
+TEST(Media, PassthroughFrameQueue_StartsAtKeyFrame)
+{
+  PassthroughFrameQueue queue;
+  RefPtr<EncodedFrame> frame =
+    CreatePassthroughFrame(EncodedFrame::VP8_P_FRAME, 1000000, 33333);
+  EXPECT_FALSE(queue.Push(frame));
+  frame = CreatePassthroughFrame(EncodedFrame::VP8_I_FRAME, 1033333, 33333);
+  EXPECT_TRUE(queue.Push(frame));
+  frame = CreatePassthroughFrame(EncodedFrame::VP8_P_FRAME, 1066666, 33333);
+  EXPECT_TRUE(queue.Push(frame));
+  EXPECT_EQ(queue.DroppedFrames(), 1u);
+
+  EncodedFrameContainer container;
+  queue.TakeFrames(container);
+  EXPECT_TRUE(queue.IsEmpty());
+  const nsTArray<RefPtr<EncodedFrame>>& frames = container.GetEncodedFrames();
+  ASSERT_EQ(frames.Length(), 2u);
+  // Output starts at 0.
+  EXPECT_EQ(frames[0]->GetTimeStamp(), 0u);
+  EXPECT_EQ(frames[1]->GetTimeStamp(), 33333u);
+}
+
+TEST(Media, PassthroughFrameQueue_SourceChange)
+{
+  PassthroughFrameQueue queue;
+  RefPtr<EncodedFrame> frame =
+    CreatePassthroughFrame(EncodedFrame::VP8_I_FRAME, 0, 40000);
+  EXPECT_TRUE(queue.Push(frame));
+  frame = CreatePassthroughFrame(EncodedFrame::VP8_P_FRAME, 40000, 40000);
+  EXPECT_TRUE(queue.Push(frame));
+
+  // The new source restarts its timeline; its frames are held back until its
+  // first keyframe, which follows the last frame of the previous source.
+  queue.SourceChanged();
+  frame = CreatePassthroughFrame(EncodedFrame::VP8_P_FRAME, 5000000, 40000);
+  EXPECT_FALSE(queue.Push(frame));
+  frame = CreatePassthroughFrame(EncodedFrame::VP8_I_FRAME, 5040000, 40000);
+  EXPECT_TRUE(queue.Push(frame));
+  frame = CreatePassthroughFrame(EncodedFrame::VP8_P_FRAME, 5080000, 40000);
+  EXPECT_TRUE(queue.Push(frame));
+
+  EncodedFrameContainer container;
+  queue.TakeFrames(container);
+  const nsTArray<RefPtr<EncodedFrame>>& frames = container.GetEncodedFrames();
+  ASSERT_EQ(frames.Length(), 4u);
+  EXPECT_EQ(frames[2]->GetTimeStamp(), 80000u);
+  EXPECT_EQ(frames[3]->GetTimeStamp(), 120000u);
+}
+
+TEST(Media, PassthroughFrameQueue_SharedTimeline)
+{
+  RefPtr<PassthroughTimeline> timeline = new PassthroughTimeline();
+  PassthroughFrameQueue video(timeline);
+  PassthroughFrameQueue audio(timeline);
+
+  // Audio starts before the first video keyframe; both tracks are rebased by
+  // the offset of the first keyframe seen, the audio one.
+  RefPtr<EncodedFrame> frame =
+    CreatePassthroughFrame(EncodedFrame::OPUS_AUDIO_FRAME, 1000000, 960);
+  EXPECT_TRUE(audio.Push(frame));
+  // The caller's frame is left as it was.
+  EXPECT_EQ(frame->GetTimeStamp(), 1000000u);
+  frame = CreatePassthroughFrame(EncodedFrame::VP8_P_FRAME, 1000000, 40000);
+  EXPECT_FALSE(video.Push(frame));
+  frame = CreatePassthroughFrame(EncodedFrame::VP8_I_FRAME, 1040000, 40000);
+  EXPECT_TRUE(video.Push(frame));
+  frame = CreatePassthroughFrame(EncodedFrame::OPUS_AUDIO_FRAME, 1020000, 960);
+  EXPECT_TRUE(audio.Push(frame));
+
+  // After a source change, the video keyframe places the new source after
+  // the end of both tracks, and audio follows the same offset.
+  video.SourceChanged();
+  audio.SourceChanged();
+  frame = CreatePassthroughFrame(EncodedFrame::VP8_I_FRAME, 3000000, 40000);
+  EXPECT_TRUE(video.Push(frame));
+  frame = CreatePassthroughFrame(EncodedFrame::OPUS_AUDIO_FRAME, 3020000, 960);
+  EXPECT_TRUE(audio.Push(frame));
+
+  EncodedFrameContainer videoFrames;
+  video.TakeFrames(videoFrames);
+  ASSERT_EQ(videoFrames.GetEncodedFrames().Length(), 2u);
+  EXPECT_EQ(videoFrames.GetEncodedFrames()[0]->GetTimeStamp(), 40000u);
+  EXPECT_EQ(videoFrames.GetEncodedFrames()[1]->GetTimeStamp(), 80000u);
+
+  EncodedFrameContainer audioFrames;
+  audio.TakeFrames(audioFrames);
+  ASSERT_EQ(audioFrames.GetEncodedFrames().Length(), 3u);
+  EXPECT_EQ(audioFrames.GetEncodedFrames()[0]->GetTimeStamp(), 0u);
+  EXPECT_EQ(audioFrames.GetEncodedFrames()[1]->GetTimeStamp(), 20000u);
+  EXPECT_EQ(audioFrames.GetEncodedFrames()[2]->GetTimeStamp(), 100000u);
+}
+
+TEST(Media, PassthroughAudioTrackEncoder)
+{
+  RefPtr<OpusMetadata> meta = new OpusMetadata();
+  meta->mChannels = 2;
+  meta->mSamplingFrequency = 48000;
+  PassthroughAudioTrackEncoder encoder(meta);
+
+  RefPtr<TrackMetadataBase> outMeta = encoder.GetMetadata();
+  EXPECT_EQ(outMeta.get(), meta.get());
+
+  // Every Opus packet can start decoding. Packets last 20ms, i.e. 960
+  // samples at 48kHz.
+  for (uint64_t i = 0; i < 3; i++) {
+    RefPtr<EncodedFrame> frame =
+      CreatePassthroughFrame(EncodedFrame::OPUS_AUDIO_FRAME,
+                             1000000 + 20000 * i, 960);
+    encoder.AppendEncodedFrame(frame);
+  }
+  // The next source starts right after the end of the last packet.
+  encoder.NotifySourceChanged(meta);
+  RefPtr<EncodedFrame> frame =
+    CreatePassthroughFrame(EncodedFrame::OPUS_AUDIO_FRAME, 0, 960);
+  encoder.AppendEncodedFrame(frame);
+  encoder.NotifyEndOfEncodedStream();
+
+  EncodedFrameContainer container;
+  EXPECT_EQ(encoder.GetEncodedTrack(container), NS_OK);
+  const nsTArray<RefPtr<EncodedFrame>>& frames = container.GetEncodedFrames();
+  ASSERT_EQ(frames.Length(), 4u);
+  // Rebased to 0 and kept 20ms apart.
+  for (uint64_t i = 0; i < 4; i++) {
+    EXPECT_EQ(frames[i]->GetTimeStamp(), 20000 * i);
+    EXPECT_EQ(frames[i]->GetDuration(), 960u);
+  }
+  EXPECT_TRUE(encoder.IsEncodingComplete());
+  EXPECT_EQ(encoder.DroppedFrames(), 0u);
+}
+
+TEST(Media, PassthroughAudioTrackEncoder_KindChangeFails)
+{
+  RefPtr<OpusMetadata> meta = new OpusMetadata();
+  PassthroughAudioTrackEncoder encoder(meta);
+  // Stand-in for a source of another codec.
+  class OtherMetadata : public TrackMetadataBase
+  {
+    MetadataKind GetKind() const override { return METADATA_VORBIS; }
+  };
+  RefPtr<TrackMetadataBase> other = new OtherMetadata();
+  encoder.NotifySourceChanged(other);
+
+  EncodedFrameContainer container;
+  EXPECT_TRUE(NS_FAILED(encoder.GetEncodedTrack(container)));
+}
+
+static void
+AppendToRingBuffer(EncodedFrameRingBuffer& aBuffer, EncodedFrame* aFrame)
+{
+  EncodedFrameContainer container;
+  container.AppendEncodedFrame(aFrame);
+  if (aFrame->GetFrameType() == EncodedFrame::OPUS_AUDIO_FRAME) {
+    aBuffer.AppendAudio(container);
+  } else {
+    aBuffer.AppendVideo(container);
+  }
+}
+
+TEST(Media, EncodedFrameRingBuffer_TrimsWholeGops)
+{
+  EncodedFrameRingBuffer buffer(1000000);
+  // 3.4s of 10fps video with a keyframe every second, and 20ms audio packets.
+  for (uint64_t time = 0; time <= 3400000; time += 20000) {
+    if (time % 100000 == 0) {
+      RefPtr<EncodedFrame> frame =
+        CreatePassthroughFrame(time % 1000000 ? EncodedFrame::VP8_P_FRAME
+                                              : EncodedFrame::VP8_I_FRAME,
+                               time, 100000);
+      AppendToRingBuffer(buffer, frame);
+    }
+    RefPtr<EncodedFrame> frame =
+      CreatePassthroughFrame(EncodedFrame::OPUS_AUDIO_FRAME, time, 960);
+    AppendToRingBuffer(buffer, frame);
+  }
+
+  // The last second starts at 2.4s, inside the GOP starting at 2s.
+  EXPECT_EQ(buffer.StartTime(), 2000000u);
+  EXPECT_EQ(buffer.BufferedTime(), 1400000u);
+
+  EncodedFrameContainer video;
+  buffer.CopyVideo(video);
+  const nsTArray<RefPtr<EncodedFrame>>& videoFrames = video.GetEncodedFrames();
+  ASSERT_EQ(videoFrames.Length(), 15u);
+  EXPECT_EQ(videoFrames[0]->GetFrameType(), EncodedFrame::VP8_I_FRAME);
+  // The clip starts at 0.
+  EXPECT_EQ(videoFrames[0]->GetTimeStamp(), 0u);
+  EXPECT_EQ(videoFrames[14]->GetTimeStamp(), 1400000u);
+
+  EncodedFrameContainer audio;
+  buffer.CopyAudio(audio);
+  const nsTArray<RefPtr<EncodedFrame>>& audioFrames = audio.GetEncodedFrames();
+  ASSERT_EQ(audioFrames.Length(), 71u);
+  EXPECT_EQ(audioFrames[0]->GetTimeStamp(), 0u);
+  EXPECT_EQ(audioFrames[0]->GetDuration(), 960u);
+}
+
+TEST(Media, EncodedFrameRingBuffer_StartsAtKeyFrame)
+{
+  EncodedFrameRingBuffer buffer(1000000);
+  RefPtr<EncodedFrame> frame =
+    CreatePassthroughFrame(EncodedFrame::VP8_P_FRAME, 0, 40000);
+  AppendToRingBuffer(buffer, frame);
+  EXPECT_TRUE(buffer.IsEmpty());
+  EXPECT_EQ(buffer.DroppedFrames(), 1u);
+
+  nsTArray<uint8_t> data;
+  data.AppendElement(42);
+  frame = CreatePassthroughFrame(EncodedFrame::VP8_I_FRAME, 40000, 40000);
+  frame->SwapInFrameData(data);
+  AppendToRingBuffer(buffer, frame);
+
+  // Clips copy the frames, so that they can be taken repeatedly.
+  for (int i = 0; i < 2; i++) {
+    EncodedFrameContainer video;
+    buffer.CopyVideo(video);
+    ASSERT_EQ(video.GetEncodedFrames().Length(), 1u);
+    EXPECT_EQ(video.GetEncodedFrames()[0]->GetFrameData(),
+              nsTArray<uint8_t>({ 42 }));
+  }
+  EXPECT_EQ(frame->GetTimeStamp(), 40000u);
+}
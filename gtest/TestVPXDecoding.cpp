@@ -4,13 +4,24 @@
 
 #include "gtest/gtest.h"
 #include "mozilla/ArrayUtils.h"
+#include "mozilla/Logging.h"
+#include "mozilla/TimeStamp.h"
+#include "nsPrintfCString.h"
 #include "nsTArray.h"
+#include "nsThreadUtils.h"
+#include "MockMediaResource.h"
 #include "VPXDecoder.h"
+#include "WebMDemuxer.h"
+#include "prsystem.h"
 
-#include <stdio.h>
+#include <algorithm>
 
 using namespace mozilla;
 
+static LazyLogModule sBenchmarkLog("VP9ThreadingBenchmark");
+#define BENCH_LOG(msg, ...) \
+  MOZ_LOG(sBenchmarkLog, LogLevel::Info, (msg, ##__VA_ARGS__))
+
 static void
 ReadVPXFile(const char* aPath, nsTArray<uint8_t>& aBuffer)
 {
@@ -101,3 +112,102 @@ TEST(libvpx, test_cases)
     EXPECT_EQ(VPX_CODEC_OK, r);
   }
 }
+
+TEST(libvpx, DecodeThreads)
+{
+  int cpus = PR_GetNumberOfProcessors();
+  EXPECT_EQ(std::min(2, cpus), VPXDecoder::DecodeThreads(VPXDecoder::VP8, 3840, 2160));
+  EXPECT_EQ(std::min(2, cpus), VPXDecoder::DecodeThreads(VPXDecoder::VP9, 640, 360));
+  EXPECT_EQ(std::min(4, cpus), VPXDecoder::DecodeThreads(VPXDecoder::VP9, 1920, 1080));
+  EXPECT_EQ(std::min(8, cpus), VPXDecoder::DecodeThreads(VPXDecoder::VP9, 3840, 2160));
+  // At least as many threads as the width based count used before.
+  EXPECT_EQ(std::min(4, cpus), VPXDecoder::DecodeThreads(VPXDecoder::VP9, 1024, 576));
+  EXPECT_EQ(std::min(8, cpus), VPXDecoder::DecodeThreads(VPXDecoder::VP9, 2048, 858));
+  // Portrait frames get as many threads as landscape ones of the same area.
+  EXPECT_EQ(VPXDecoder::DecodeThreads(VPXDecoder::VP9, 1080, 1920),
+            VPXDecoder::DecodeThreads(VPXDecoder::VP9, 1920, 1080));
+  EXPECT_GE(VPXDecoder::DecodeThreads(VPXDecoder::VP9, 0, 0), 1);
+}
+
+// Demuxes all the video samples of a WebM file, spinning the main thread.
+static void
+DemuxWebMVideo(const char* aFileName, nsTArray<RefPtr<MediaRawData>>& aSamples)
+{
+  RefPtr<MockMediaResource> resource =
+    new MockMediaResource(aFileName, NS_LITERAL_CSTRING("video/webm"));
+  ASSERT_EQ(NS_OK, resource->Open(nullptr));
+  RefPtr<WebMDemuxer> demuxer = new WebMDemuxer(resource);
+
+  bool done = false;
+  demuxer->Init()->Then(AbstractThread::MainThread(), __func__,
+    [&]() {
+      RefPtr<MediaTrackDemuxer> track =
+        demuxer->GetTrackDemuxer(TrackInfo::kVideoTrack, 0);
+      track->GetSamples(INT32_MAX)->Then(AbstractThread::MainThread(), __func__,
+        [&](RefPtr<MediaTrackDemuxer::SamplesHolder> aHolder) {
+          aSamples.AppendElements(aHolder->mSamples);
+          done = true;
+        },
+        [&](const MediaResult& aError) { done = true; });
+    },
+    [&](const MediaResult& aError) { done = true; });
+  while (!done) {
+    NS_ProcessNextEvent();
+  }
+}
+
+// Decodes aSamples with a context set up as VPXDecoder does, returning the
+// decoding rate in frames per second.
+static double
+DecodeVP9(const nsTArray<RefPtr<MediaRawData>>& aSamples, int aThreads,
+          uint32_t* aFrames)
+{
+  vpx_codec_ctx_t ctx;
+  PodZero(&ctx);
+  EXPECT_EQ(NS_OK, VPXDecoder::InitContext(&ctx, VPXDecoder::VP9, aThreads));
+
+  *aFrames = 0;
+  TimeStamp start = TimeStamp::Now();
+  for (const auto& sample : aSamples) {
+    EXPECT_EQ(VPX_CODEC_OK, vpx_codec_decode(&ctx, sample->Data(),
+                                             sample->Size(), nullptr, 0));
+    vpx_codec_iter_t iter = nullptr;
+    while (vpx_codec_get_frame(&ctx, &iter)) {
+      (*aFrames)++;
+    }
+  }
+  TimeDuration elapsed = TimeStamp::Now() - start;
+  vpx_codec_destroy(&ctx);
+  return *aFrames / std::max(elapsed.ToSeconds(), 1e-6);
+}
+
+// Not a pass/fail check of the speed: reports how much of the added threads
+// VP9 decoding actually uses, i.e. its speed up over a single thread. Too slow
+// for the other gtests; run it with --gtest_also_run_disabled_tests. Each
+// thread count records one property, also logged with
+// MOZ_LOG=VP9ThreadingBenchmark:3.
+TEST(libvpx, DISABLED_VP9ThreadingBenchmark)
+{
+  nsTArray<RefPtr<MediaRawData>> samples;
+  DemuxWebMVideo("vp9cake.webm", samples);
+  ASSERT_GT(samples.Length(), 0u);
+
+  uint32_t singleFrames = 0;
+  double single = DecodeVP9(samples, 1, &singleFrames);
+  ASSERT_GT(singleFrames, 0u);
+
+  int threadCounts[] = { 2, 4, 8 };
+  for (int threads : threadCounts) {
+    if (threads > PR_GetNumberOfProcessors()) {
+      break;
+    }
+    uint32_t frames = 0;
+    double fps = DecodeVP9(samples, threads, &frames);
+    EXPECT_EQ(singleFrames, frames);
+    nsPrintfCString name("threads-%d", threads);
+    nsPrintfCString results("fps=%.1f parallelism=%.2f single-thread-fps=%.1f",
+                            fps, fps / single, single);
+    BENCH_LOG("%s: %s", name.get(), results.get());
+    ::testing::Test::RecordProperty(name.get(), results.get());
+  }
+}
@@ -10,6 +10,7 @@
 #include "ImageContainer.h"
 #include "MediaStreamGraph.h"
 #include "MediaStreamListener.h"
+#include "PassthroughTrackEncoder.h"
 #include "WebMWriter.h" // TODO: it's weird to include muxer header to get the class definition of VP8 METADATA
 
 using ::testing::TestWithParam;
@@ -300,3 +301,63 @@ TEST(VP8VideoTrackEncoder, EncodeComplete)
   EncodedFrameContainer container;
   EXPECT_TRUE(NS_SUCCEEDED(encoder.GetEncodedTrack(container)));
 }
+
+// Renditions test
+TEST(VP8VideoTrackEncoder, Renditions)
+{
+  TestVP8TrackEncoder encoder;
+  RefPtr<TrackMetadataBase> smallMeta =
+    encoder.CreateRenditionMetadata(160, 120);
+  PassthroughVideoTrackEncoder small(smallMeta, 90000);
+  RefPtr<TrackMetadataBase> mediumMeta =
+    encoder.CreateRenditionMetadata(320, 240);
+  PassthroughVideoTrackEncoder medium(mediumMeta, 90000);
+  EXPECT_TRUE(NS_SUCCEEDED(encoder.AddRendition(160, 120, 100000, &small)));
+  EXPECT_TRUE(NS_SUCCEEDED(encoder.AddRendition(320, 240, 300000, &medium)));
+  InitParam param = {true, 640, 480};
+  encoder.TestInit(param);
+  // Too late once initialized.
+  PassthroughVideoTrackEncoder late(mediumMeta, 90000);
+  EXPECT_TRUE(NS_FAILED(encoder.AddRendition(320, 240, 300000, &late)));
+
+  // 3 seconds of video.
+  nsTArray<RefPtr<Image>> images;
+  YUVBufferGenerator generator;
+  generator.Init(mozilla::gfx::IntSize(640, 480));
+  generator.Generate(images);
+  VideoSegment segment;
+  for (nsTArray<RefPtr<Image>>::size_type i = 0; i < images.Length(); i++)
+  {
+    RefPtr<Image> image = images[i];
+    segment.AppendFrame(image.forget(),
+                        mozilla::StreamTime(90000),
+                        generator.GetSize(),
+                        PRINCIPAL_HANDLE_NONE);
+  }
+  encoder.SetCurrentFrames(segment);
+  VideoSegment endSegment;
+  encoder.NotifyQueuedTrackChanges(nullptr, 0, 0,
+                                   TrackEventCommand::TRACK_EVENT_ENDED,
+                                   endSegment);
+
+  EncodedFrameContainer container;
+  EXPECT_TRUE(NS_SUCCEEDED(encoder.GetEncodedTrack(container)));
+  const nsTArray<RefPtr<EncodedFrame>>& frames = container.GetEncodedFrames();
+  ASSERT_FALSE(frames.IsEmpty());
+
+  // Every rendition has the same frames, with keyframes at the same times,
+  // and is ended along with the main track.
+  for (PassthroughVideoTrackEncoder* rendition : { &small, &medium }) {
+    EncodedFrameContainer renditionContainer;
+    EXPECT_TRUE(NS_SUCCEEDED(rendition->GetEncodedTrack(renditionContainer)));
+    EXPECT_TRUE(rendition->IsEncodingComplete());
+    const nsTArray<RefPtr<EncodedFrame>>& renditionFrames =
+      renditionContainer.GetEncodedFrames();
+    ASSERT_EQ(renditionFrames.Length(), frames.Length());
+    for (size_t i = 0; i < frames.Length(); i++) {
+      EXPECT_EQ(renditionFrames[i]->GetTimeStamp(), frames[i]->GetTimeStamp());
+      EXPECT_EQ(renditionFrames[i]->GetDuration(), frames[i]->GetDuration());
+      EXPECT_EQ(renditionFrames[i]->GetFrameType(), frames[i]->GetFrameType());
+    }
+  }
+}
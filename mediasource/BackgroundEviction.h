@@ -0,0 +1,40 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* vim: set ts=8 sts=2 et sw=2 tw=80: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef MOZILLA_BACKGROUNDEVICTION_H_
+#define MOZILLA_BACKGROUNDEVICTION_H_
+
+#include <algorithm>
+#include <stdint.h>
+
+namespace mozilla {
+
+// The space to keep free below aThreshold so that the next aAppends appends
+// of aAverageAppendSize bytes don't have to evict first. Capped so that a few
+// very large appends don't make us throw most of the buffer away. 0 means
+// there is no headroom to keep.
+inline int64_t
+ComputeEvictionHeadroom(int64_t aAverageAppendSize, uint32_t aAppends,
+                        int64_t aThreshold)
+{
+  return std::min(aAverageAppendSize * aAppends, aThreshold / 4);
+}
+
+// How much to evict while idle so that aBuffered bytes leave aHeadroom free
+// below aThreshold. 0 if there is nothing to evict, or no headroom to keep.
+inline int64_t
+ComputeBackgroundEvictionSize(int64_t aBuffered, int64_t aHeadroom,
+                              int64_t aThreshold)
+{
+  if (aHeadroom <= 0) {
+    return 0;
+  }
+  return std::max<int64_t>(aBuffered + aHeadroom - aThreshold, 0);
+}
+
+} // namespace mozilla
+
+#endif /* MOZILLA_BACKGROUNDEVICTION_H_ */
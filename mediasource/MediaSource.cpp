@@ -136,17 +136,21 @@ MediaSource::Constructor(const GlobalObject& aGlobal,
 {
   nsCOMPtr<nsPIDOMWindowInner> window = do_QueryInterface(aGlobal.GetAsSupports());
   if (!window) {
-    aRv.Throw(NS_ERROR_UNEXPECTED);
+    // Workers would need the decoder calls to be proxied to the main thread
+    // through a handle attached to the media element.
+    aRv.Throw(NS_ERROR_DOM_NOT_SUPPORTED_ERR);
     return nullptr;
   }
+  RefPtr<MediaSourceThread> thread = MediaSourceThread::GetCurrent();
+  MOZ_ASSERT(thread, "Windows live on the main thread");
 
-  RefPtr<MediaSource> mediaSource = new MediaSource(window);
+  RefPtr<MediaSource> mediaSource = new MediaSource(window, thread);
   return mediaSource.forget();
 }
 
 MediaSource::~MediaSource()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_API("");
   if (mDecoder) {
     mDecoder->DetachMediaSource();
@@ -156,7 +160,7 @@ MediaSource::~MediaSource()
 SourceBufferList*
 MediaSource::SourceBuffers()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MOZ_ASSERT_IF(mReadyState == MediaSourceReadyState::Closed, mSourceBuffers->IsEmpty());
   return mSourceBuffers;
 }
@@ -164,7 +168,7 @@ MediaSource::SourceBuffers()
 SourceBufferList*
 MediaSource::ActiveSourceBuffers()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MOZ_ASSERT_IF(mReadyState == MediaSourceReadyState::Closed, mActiveSourceBuffers->IsEmpty());
   return mActiveSourceBuffers;
 }
@@ -172,14 +176,14 @@ MediaSource::ActiveSourceBuffers()
 MediaSourceReadyState
 MediaSource::ReadyState()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   return mReadyState;
 }
 
 double
 MediaSource::Duration()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   if (mReadyState == MediaSourceReadyState::Closed) {
     return UnspecifiedNaN<double>();
   }
@@ -190,7 +194,7 @@ MediaSource::Duration()
 void
 MediaSource::SetDuration(double aDuration, ErrorResult& aRv)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_API("SetDuration(aDuration=%f, ErrorResult)", aDuration);
   if (aDuration < 0 || IsNaN(aDuration)) {
     aRv.Throw(NS_ERROR_DOM_TYPE_ERR);
@@ -207,7 +211,7 @@ MediaSource::SetDuration(double aDuration, ErrorResult& aRv)
 void
 MediaSource::SetDuration(double aDuration)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_API("SetDuration(aDuration=%f)", aDuration);
   mDecoder->SetMediaSourceDuration(aDuration);
 }
@@ -215,7 +219,7 @@ MediaSource::SetDuration(double aDuration)
 already_AddRefed<SourceBuffer>
 MediaSource::AddSourceBuffer(const nsAString& aType, ErrorResult& aRv)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   DecoderDoctorDiagnostics diagnostics;
   nsresult rv = IsTypeSupported(aType, &diagnostics);
   diagnostics.StoreFormatDiagnostics(GetOwner()
@@ -256,7 +260,7 @@ MediaSource::AddSourceBuffer(const nsAString& aType, ErrorResult& aRv)
 void
 MediaSource::SourceBufferIsActive(SourceBuffer* aSourceBuffer)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   mActiveSourceBuffers->ClearSimple();
   bool found = false;
   for (uint32_t i = 0; i < mSourceBuffers->Length(); i++) {
@@ -273,7 +277,7 @@ MediaSource::SourceBufferIsActive(SourceBuffer* aSourceBuffer)
 void
 MediaSource::RemoveSourceBuffer(SourceBuffer& aSourceBuffer, ErrorResult& aRv)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   SourceBuffer* sourceBuffer = &aSourceBuffer;
   MSE_API("RemoveSourceBuffer(aSourceBuffer=%p)", sourceBuffer);
   if (!mSourceBuffers->Contains(sourceBuffer)) {
@@ -302,7 +306,7 @@ MediaSource::RemoveSourceBuffer(SourceBuffer& aSourceBuffer, ErrorResult& aRv)
 void
 MediaSource::EndOfStream(const Optional<MediaSourceEndOfStreamError>& aError, ErrorResult& aRv)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_API("EndOfStream(aError=%d)",
           aError.WasPassed() ? uint32_t(aError.Value()) : 0);
   if (mReadyState != MediaSourceReadyState::Open ||
@@ -334,7 +338,7 @@ MediaSource::EndOfStream(const Optional<MediaSourceEndOfStreamError>& aError, Er
 void
 MediaSource::EndOfStream(const MediaResult& aError)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_API("EndOfStream(aError=%d)", aError.Code());
 
   SetReadyState(MediaSourceReadyState::Ended);
@@ -367,7 +371,7 @@ MediaSource::Enabled(JSContext* cx, JSObject* aGlobal)
 void
 MediaSource::SetLiveSeekableRange(double aStart, double aEnd, ErrorResult& aRv)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
 
   // 1. If the readyState attribute is not "open" then throw an InvalidStateError
   // exception and abort these steps.
@@ -394,7 +398,7 @@ MediaSource::SetLiveSeekableRange(double aStart, double aEnd, ErrorResult& aRv)
 void
 MediaSource::ClearLiveSeekableRange(ErrorResult& aRv)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
 
   // 1. If the readyState attribute is not "open" then throw an InvalidStateError
   // exception and abort these steps.
@@ -412,6 +416,9 @@ bool
 MediaSource::Attach(MediaSourceDecoder* aDecoder)
 {
   MOZ_ASSERT(NS_IsMainThread());
+  // Attaching a MediaSource owned by another thread needs its decoder calls
+  // to be proxied to the main thread, which isn't supported yet.
+  MOZ_ASSERT(OnOwnerThread());
   MSE_DEBUG("Attach(aDecoder=%p) owner=%p", aDecoder, aDecoder->GetOwner());
   MOZ_ASSERT(aDecoder);
   MOZ_ASSERT(aDecoder->GetOwner());
@@ -430,7 +437,7 @@ MediaSource::Attach(MediaSourceDecoder* aDecoder)
 void
 MediaSource::Detach()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_DEBUG("mDecoder=%p owner=%p",
             mDecoder.get(), mDecoder ? mDecoder->GetOwner() : nullptr);
   if (!mDecoder) {
@@ -450,13 +457,15 @@ MediaSource::Detach()
   mDecoder = nullptr;
 }
 
-MediaSource::MediaSource(nsPIDOMWindowInner* aWindow)
+MediaSource::MediaSource(nsPIDOMWindowInner* aWindow,
+                         MediaSourceThread* aOwnerThread)
   : DOMEventTargetHelper(aWindow)
+  , mOwnerThread(aOwnerThread)
   , mDecoder(nullptr)
   , mPrincipal(nullptr)
   , mReadyState(MediaSourceReadyState::Closed)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   mSourceBuffers = new SourceBufferList(this);
   mActiveSourceBuffers = new SourceBufferList(this);
 
@@ -472,7 +481,7 @@ MediaSource::MediaSource(nsPIDOMWindowInner* aWindow)
 void
 MediaSource::SetReadyState(MediaSourceReadyState aState)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MOZ_ASSERT(aState != mReadyState);
   MSE_DEBUG("SetReadyState(aState=%d) mReadyState=%d", aState, mReadyState);
 
@@ -509,7 +518,7 @@ MediaSource::SetReadyState(MediaSourceReadyState aState)
 void
 MediaSource::DispatchSimpleEvent(const char* aName)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_API("Dispatch event '%s'", aName);
   DispatchTrustedEvent(NS_ConvertUTF8toUTF16(aName));
 }
@@ -519,13 +528,13 @@ MediaSource::QueueAsyncSimpleEvent(const char* aName)
 {
   MSE_DEBUG("Queuing event '%s'", aName);
   nsCOMPtr<nsIRunnable> event = new AsyncEventRunner<MediaSource>(this, aName);
-  NS_DispatchToMainThread(event);
+  mOwnerThread->Dispatch(event.forget());
 }
 
 void
 MediaSource::DurationChange(double aNewDuration, ErrorResult& aRv)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_DEBUG("DurationChange(aNewDuration=%f)", aNewDuration);
 
   // 1. If the current value of duration is equal to new duration, then return.
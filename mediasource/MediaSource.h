@@ -9,6 +9,7 @@
 
 #include "MediaSourceDecoder.h"
 #include "js/RootingAPI.h"
+#include "MediaSourceThread.h"
 #include "mozilla/Assertions.h"
 #include "mozilla/Attributes.h"
 #include "mozilla/DOMEventTargetHelper.h"
@@ -42,6 +43,14 @@ template <typename T> class Optional;
   { 0x3839d699, 0x22c5, 0x439f, \
   { 0x94, 0xca, 0x0e, 0x0b, 0x26, 0xf9, 0xca, 0xbf } }
 
+/**
+ * A MediaSource, its SourceBuffers and SourceBufferLists are only used on
+ * the thread which created the MediaSource, its owner thread, where their
+ * events are fired and their appends complete. The MediaSourceDecoder it is
+ * attached to lives on the main thread and nothing proxies to it yet, so the
+ * owner thread is always the main thread for now: the constructor rejects
+ * other globals.
+ */
 class MediaSource final : public DOMEventTargetHelper
 {
 public:
@@ -103,6 +112,16 @@ public:
     return mPrincipal;
   }
 
+  MediaSourceThread* OwnerThread() const
+  {
+    return mOwnerThread;
+  }
+
+  bool OnOwnerThread() const
+  {
+    return mOwnerThread->IsCurrentThreadIn();
+  }
+
   // Returns a string describing the state of the MediaSource internal
   // buffered data. Used for debugging purposes.
   void GetMozDebugReaderData(nsAString& aString);
@@ -119,7 +138,7 @@ private:
 
   ~MediaSource();
 
-  explicit MediaSource(nsPIDOMWindowInner* aWindow);
+  MediaSource(nsPIDOMWindowInner* aWindow, MediaSourceThread* aOwnerThread);
 
   friend class AsyncEventRunner<MediaSource>;
   void DispatchSimpleEvent(const char* aName);
@@ -133,6 +152,8 @@ private:
   // Mark SourceBuffer as active and rebuild ActiveSourceBuffers.
   void SourceBufferIsActive(SourceBuffer* aSourceBuffer);
 
+  const RefPtr<MediaSourceThread> mOwnerThread;
+
   RefPtr<SourceBufferList> mSourceBuffers;
   RefPtr<SourceBufferList> mActiveSourceBuffers;
 
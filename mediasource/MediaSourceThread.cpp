@@ -0,0 +1,55 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* vim: set ts=8 sts=2 et sw=2 tw=80: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "MediaSourceThread.h"
+
+#include "nsIRunnable.h"
+#include "nsThreadUtils.h"
+
+namespace mozilla {
+
+MediaSourceThread::MediaSourceThread(nsIEventTarget* aEventTarget,
+                                     AbstractThread* aAbstractThread)
+  : mEventTarget(aEventTarget)
+  , mAbstractThread(aAbstractThread)
+{
+  MOZ_ASSERT(aEventTarget);
+  MOZ_ASSERT(aAbstractThread);
+}
+
+/* static */ already_AddRefed<MediaSourceThread>
+MediaSourceThread::GetCurrent()
+{
+  nsCOMPtr<nsIEventTarget> eventTarget = NS_GetCurrentThread();
+  if (!eventTarget) {
+    return nullptr;
+  }
+  // DOM worker threads have no AbstractThread.
+  RefPtr<AbstractThread> abstractThread = NS_IsMainThread()
+    ? AbstractThread::MainThread() : AbstractThread::GetCurrent();
+  if (!abstractThread) {
+    return nullptr;
+  }
+  RefPtr<MediaSourceThread> thread =
+    new MediaSourceThread(eventTarget, abstractThread);
+  return thread.forget();
+}
+
+bool
+MediaSourceThread::IsCurrentThreadIn() const
+{
+  bool current = false;
+  return NS_SUCCEEDED(mEventTarget->IsOnCurrentThread(&current)) && current;
+}
+
+nsresult
+MediaSourceThread::Dispatch(already_AddRefed<nsIRunnable> aRunnable) const
+{
+  nsCOMPtr<nsIRunnable> runnable = aRunnable;
+  return mEventTarget->Dispatch(runnable, NS_DISPATCH_NORMAL);
+}
+
+} // namespace mozilla
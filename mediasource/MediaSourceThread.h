@@ -0,0 +1,53 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* vim: set ts=8 sts=2 et sw=2 tw=80: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef MOZILLA_MEDIASOURCETHREAD_H_
+#define MOZILLA_MEDIASOURCETHREAD_H_
+
+#include "mozilla/AbstractThread.h"
+#include "nsCOMPtr.h"
+#include "nsIEventTarget.h"
+#include "nsISupportsImpl.h"
+
+class nsIRunnable;
+
+namespace mozilla {
+
+// The thread a MediaSource and its SourceBuffers are created and used on.
+// Their events are queued to its event target, like NS_DispatchToMainThread
+// does for the main thread, and the promises of their TrackBuffersManagers
+// are resolved on its AbstractThread.
+class MediaSourceThread final
+{
+public:
+  NS_INLINE_DECL_THREADSAFE_REFCOUNTING(MediaSourceThread)
+
+  // Returns the current thread, or nullptr if promises can't be resolved on
+  // it, i.e. off the main thread if it has no AbstractThread.
+  static already_AddRefed<MediaSourceThread> GetCurrent();
+
+  bool IsCurrentThreadIn() const;
+
+  // Queues aRunnable as a normal event of the thread.
+  nsresult Dispatch(already_AddRefed<nsIRunnable> aRunnable) const;
+
+  AbstractThread* GetAbstractThread() const
+  {
+    return mAbstractThread;
+  }
+
+private:
+  MediaSourceThread(nsIEventTarget* aEventTarget,
+                    AbstractThread* aAbstractThread);
+  ~MediaSourceThread() {}
+
+  const nsCOMPtr<nsIEventTarget> mEventTarget;
+  const RefPtr<AbstractThread> mAbstractThread;
+};
+
+} // namespace mozilla
+
+#endif /* MOZILLA_MEDIASOURCETHREAD_H_ */
@@ -0,0 +1,159 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* vim: set ts=8 sts=2 et sw=2 tw=80: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef MOZILLA_SEGMENTFINGERPRINTS_H_
+#define MOZILLA_SEGMENTFINGERPRINTS_H_
+
+#include "mozilla/Move.h"
+#include "TimeUnits.h"
+#include "nsTArray.h"
+
+namespace mozilla {
+
+// Identifies a complete media segment by its content, its timestamps and
+// everything that determines where its frames end up, so that appending
+// the same segment again can be skipped while the frames it added are
+// still buffered.
+struct SegmentFingerprint
+{
+  // Whether both describe the same segment appended the same way.
+  bool Matches(const SegmentFingerprint& aOther) const
+  {
+    return mHash == aOther.mHash && mLength == aOther.mLength &&
+           mStart == aOther.mStart && mEnd == aOther.mEnd &&
+           mInitDataHash == aOther.mInitDataHash &&
+           mTimestampOffset == aOther.mTimestampOffset &&
+           mAppendWindow == aOther.mAppendWindow;
+  }
+
+  uint32_t mHash;
+  uint32_t mLength;
+  // Start and end timestamps as reported by the container parser.
+  int64_t mStart;
+  int64_t mEnd;
+  uint32_t mInitDataHash;
+  media::TimeUnit mTimestampOffset;
+  media::TimeInterval mAppendWindow;
+};
+
+// The media segments processed by a TrackBuffersManager, oldest first, along
+// with the frames each of them added to every track. Track must have an
+// mBufferedRanges member holding the intervals it currently buffers.
+template<typename Track>
+class SegmentFingerprintList
+{
+public:
+  // A processed segment, and the presentation intervals of the frames it
+  // added to each track.
+  struct Segment
+  {
+    explicit Segment(const SegmentFingerprint& aFingerprint)
+      : mFingerprint(aFingerprint)
+    {}
+
+    void AddFrames(const Track* aTrack, const media::TimeIntervals& aIntervals)
+    {
+      if (aIntervals.IsEmpty()) {
+        return;
+      }
+      for (auto& track : mTracks) {
+        if (track.mTrack == aTrack) {
+          track.mRanges += aIntervals;
+          return;
+        }
+      }
+      mTracks.AppendElement(TrackRanges{ aTrack, aIntervals });
+    }
+
+    // Whether every track still buffers all the frames the segment added to
+    // it. Each track is checked on its own: another track buffering the same
+    // interval doesn't make up for frames removed from this one.
+    bool IsBuffered() const
+    {
+      for (const auto& track : mTracks) {
+        media::TimeIntervals missing = track.mRanges;
+        missing -= track.mTrack->mBufferedRanges;
+        if (!missing.IsEmpty()) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    // Whether some of the frames the segment added to aTrack are in aRemoved.
+    bool Intersects(const Track* aTrack,
+                    const media::TimeIntervals& aRemoved) const
+    {
+      for (const auto& track : mTracks) {
+        if (track.mTrack != aTrack) {
+          continue;
+        }
+        media::TimeIntervals intersection = track.mRanges;
+        intersection.Intersection(aRemoved);
+        return !intersection.IsEmpty();
+      }
+      return false;
+    }
+
+    struct TrackRanges
+    {
+      const Track* mTrack;
+      media::TimeIntervals mRanges;
+    };
+
+    SegmentFingerprint mFingerprint;
+    nsTArray<TrackRanges> mTracks;
+  };
+
+  explicit SegmentFingerprintList(uint32_t aMaxLength)
+    : mMaxLength(aMaxLength)
+  {}
+
+  // Remember aSegment, forgetting the oldest segment if the list is full.
+  // Segments that added no frames are ignored.
+  void Append(Segment&& aSegment)
+  {
+    if (aSegment.mTracks.IsEmpty() || !mMaxLength) {
+      return;
+    }
+    if (mSegments.Length() >= mMaxLength) {
+      mSegments.RemoveElementAt(0);
+    }
+    mSegments.AppendElement(Move(aSegment));
+  }
+
+  // Whether a segment matching aFingerprint was processed and all the frames
+  // it added are still buffered.
+  bool IsBuffered(const SegmentFingerprint& aFingerprint) const
+  {
+    for (const auto& segment : mSegments) {
+      if (segment.mFingerprint.Matches(aFingerprint)) {
+        return segment.IsBuffered();
+      }
+    }
+    return false;
+  }
+
+  // Forget the segments some of whose frames got removed from aTrack.
+  void Invalidate(const Track* aTrack, const media::TimeIntervals& aRemoved)
+  {
+    for (uint32_t i = mSegments.Length(); i-- > 0; ) {
+      if (mSegments[i].Intersects(aTrack, aRemoved)) {
+        mSegments.RemoveElementAt(i);
+      }
+    }
+  }
+
+  uint32_t Length() const { return mSegments.Length(); }
+
+private:
+  const uint32_t mMaxLength;
+  nsTArray<Segment> mSegments;
+};
+
+} // namespace mozilla
+
+#endif /* MOZILLA_SEGMENTFINGERPRINTS_H_ */
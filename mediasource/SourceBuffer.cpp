@@ -49,7 +49,7 @@ namespace dom {
 void
 SourceBuffer::SetMode(SourceBufferAppendMode aMode, ErrorResult& aRv)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_API("SetMode(aMode=%d)", aMode);
   if (!IsAttached() || mUpdating) {
     aRv.Throw(NS_ERROR_DOM_INVALID_STATE_ERR);
@@ -80,7 +80,7 @@ SourceBuffer::SetMode(SourceBufferAppendMode aMode, ErrorResult& aRv)
 void
 SourceBuffer::SetTimestampOffset(double aTimestampOffset, ErrorResult& aRv)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_API("SetTimestampOffset(aTimestampOffset=%f)", aTimestampOffset);
   if (!IsAttached() || mUpdating) {
     aRv.Throw(NS_ERROR_DOM_INVALID_STATE_ERR);
@@ -103,7 +103,7 @@ SourceBuffer::SetTimestampOffset(double aTimestampOffset, ErrorResult& aRv)
 TimeRanges*
 SourceBuffer::GetBuffered(ErrorResult& aRv)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   // http://w3c.github.io/media-source/index.html#widl-SourceBuffer-buffered
   // 1. If this object has been removed from the sourceBuffers attribute of the parent media source then throw an InvalidStateError exception and abort these steps.
   if (!IsAttached()) {
@@ -136,7 +136,7 @@ SourceBuffer::GetTimeIntervals()
 void
 SourceBuffer::SetAppendWindowStart(double aAppendWindowStart, ErrorResult& aRv)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_API("SetAppendWindowStart(aAppendWindowStart=%f)", aAppendWindowStart);
   if (!IsAttached() || mUpdating) {
     aRv.Throw(NS_ERROR_DOM_INVALID_STATE_ERR);
@@ -153,7 +153,7 @@ SourceBuffer::SetAppendWindowStart(double aAppendWindowStart, ErrorResult& aRv)
 void
 SourceBuffer::SetAppendWindowEnd(double aAppendWindowEnd, ErrorResult& aRv)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_API("SetAppendWindowEnd(aAppendWindowEnd=%f)", aAppendWindowEnd);
   if (!IsAttached() || mUpdating) {
     aRv.Throw(NS_ERROR_DOM_INVALID_STATE_ERR);
@@ -170,7 +170,7 @@ SourceBuffer::SetAppendWindowEnd(double aAppendWindowEnd, ErrorResult& aRv)
 void
 SourceBuffer::AppendBuffer(const ArrayBuffer& aData, ErrorResult& aRv)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_API("AppendBuffer(ArrayBuffer)");
   aData.ComputeLengthAndData();
   AppendData(aData.Data(), aData.Length(), aRv);
@@ -179,7 +179,7 @@ SourceBuffer::AppendBuffer(const ArrayBuffer& aData, ErrorResult& aRv)
 void
 SourceBuffer::AppendBuffer(const ArrayBufferView& aData, ErrorResult& aRv)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_API("AppendBuffer(ArrayBufferView)");
   aData.ComputeLengthAndData();
   AppendData(aData.Data(), aData.Length(), aRv);
@@ -188,7 +188,7 @@ SourceBuffer::AppendBuffer(const ArrayBufferView& aData, ErrorResult& aRv)
 void
 SourceBuffer::Abort(ErrorResult& aRv)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_API("Abort()");
   if (!IsAttached()) {
     aRv.Throw(NS_ERROR_DOM_INVALID_STATE_ERR);
@@ -229,7 +229,7 @@ SourceBuffer::ResetParserState()
 void
 SourceBuffer::Remove(double aStart, double aEnd, ErrorResult& aRv)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_API("Remove(aStart=%f, aEnd=%f)", aStart, aEnd);
   if (!IsAttached()) {
     aRv.Throw(NS_ERROR_DOM_INVALID_STATE_ERR);
@@ -261,7 +261,7 @@ SourceBuffer::RangeRemoval(double aStart, double aEnd)
   mPendingRemoval.Begin(
     mTrackBuffersManager->RangeRemoval(TimeUnit::FromSeconds(aStart),
                                        TimeUnit::FromSeconds(aEnd))
-      ->Then(AbstractThread::MainThread(), __func__,
+      ->Then(mOwnerThread->GetAbstractThread(), __func__,
              [self] (bool) {
                self->mPendingRemoval.Complete();
                self->StopUpdating();
@@ -272,7 +272,7 @@ SourceBuffer::RangeRemoval(double aStart, double aEnd)
 void
 SourceBuffer::Detach()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_DEBUG("Detach");
   if (!mMediaSource) {
     MSE_DEBUG("Already detached");
@@ -291,7 +291,7 @@ SourceBuffer::Detach()
 void
 SourceBuffer::Ended()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MOZ_ASSERT(IsAttached());
   MSE_DEBUG("Ended");
   mTrackBuffersManager->Ended();
@@ -299,6 +299,7 @@ SourceBuffer::Ended()
 
 SourceBuffer::SourceBuffer(MediaSource* aMediaSource, const nsACString& aType)
   : DOMEventTargetHelper(aMediaSource->GetParentObject())
+  , mOwnerThread(aMediaSource->OwnerThread())
   , mMediaSource(aMediaSource)
   , mCurrentAttributes(aType.LowerCaseEqualsLiteral("audio/mpeg") ||
                        aType.LowerCaseEqualsLiteral("audio/aac"))
@@ -306,7 +307,7 @@ SourceBuffer::SourceBuffer(MediaSource* aMediaSource, const nsACString& aType)
   , mActive(false)
   , mType(aType)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MOZ_ASSERT(aMediaSource);
 
   mTrackBuffersManager =
@@ -327,7 +328,7 @@ SourceBuffer::SourceBuffer(MediaSource* aMediaSource, const nsACString& aType)
 
 SourceBuffer::~SourceBuffer()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MOZ_ASSERT(!mMediaSource);
   MSE_DEBUG("");
 }
@@ -347,7 +348,7 @@ SourceBuffer::WrapObject(JSContext* aCx, JS::Handle<JSObject*> aGivenProto)
 void
 SourceBuffer::DispatchSimpleEvent(const char* aName)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_API("Dispatch event '%s'", aName);
   DispatchTrustedEvent(NS_ConvertUTF8toUTF16(aName));
 }
@@ -357,13 +358,13 @@ SourceBuffer::QueueAsyncSimpleEvent(const char* aName)
 {
   MSE_DEBUG("Queuing event '%s'", aName);
   nsCOMPtr<nsIRunnable> event = new AsyncEventRunner<SourceBuffer>(this, aName);
-  NS_DispatchToMainThread(event, NS_DISPATCH_NORMAL);
+  mOwnerThread->Dispatch(event.forget());
 }
 
 void
 SourceBuffer::StartUpdating()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MOZ_ASSERT(!mUpdating);
   mUpdating = true;
   QueueAsyncSimpleEvent("updatestart");
@@ -372,7 +373,7 @@ SourceBuffer::StartUpdating()
 void
 SourceBuffer::StopUpdating()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   if (!mUpdating) {
     // The buffer append or range removal algorithm  has been interrupted by
     // abort().
@@ -386,7 +387,7 @@ SourceBuffer::StopUpdating()
 void
 SourceBuffer::AbortUpdating()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   mUpdating = false;
   QueueAsyncSimpleEvent("abort");
   QueueAsyncSimpleEvent("updateend");
@@ -395,7 +396,7 @@ SourceBuffer::AbortUpdating()
 void
 SourceBuffer::CheckEndTime()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   // Check if we need to update mMediaSource duration
   double endTime = mCurrentAttributes.GetGroupEndTimestamp().ToSeconds();
   double duration = mMediaSource->Duration();
@@ -416,7 +417,7 @@ SourceBuffer::AppendData(const uint8_t* aData, uint32_t aLength, ErrorResult& aR
   StartUpdating();
 
   mPendingAppend.Begin(mTrackBuffersManager->AppendData(data, mCurrentAttributes)
-                       ->Then(AbstractThread::MainThread(), __func__, this,
+                       ->Then(mOwnerThread->GetAbstractThread(), __func__, this,
                               &SourceBuffer::AppendDataCompletedWithSuccess,
                               &SourceBuffer::AppendDataErrored));
 }
@@ -467,7 +468,7 @@ SourceBuffer::AppendDataErrored(const MediaResult& aError)
 void
 SourceBuffer::AppendError(const MediaResult& aDecodeError)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
 
   ResetParserState();
 
@@ -530,7 +531,7 @@ SourceBuffer::PrepareAppend(const uint8_t* aData, uint32_t aLength, ErrorResult&
 double
 SourceBuffer::GetBufferedStart()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   ErrorResult dummy;
   RefPtr<TimeRanges> ranges = GetBuffered(dummy);
   return ranges->Length() > 0 ? ranges->GetStartTime() : 0;
@@ -539,7 +540,7 @@ SourceBuffer::GetBufferedStart()
 double
 SourceBuffer::GetBufferedEnd()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   ErrorResult dummy;
   RefPtr<TimeRanges> ranges = GetBuffered(dummy);
   return ranges->Length() > 0 ? ranges->GetEndTime() : 0;
@@ -548,7 +549,7 @@ SourceBuffer::GetBufferedEnd()
 double
 SourceBuffer::HighestStartTime()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   return mTrackBuffersManager
          ? mTrackBuffersManager->HighestStartTime().ToSeconds()
          : 0.0;
@@ -557,7 +558,7 @@ SourceBuffer::HighestStartTime()
 double
 SourceBuffer::HighestEndTime()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   return mTrackBuffersManager
          ? mTrackBuffersManager->HighestEndTime().ToSeconds()
          : 0.0;
@@ -166,6 +166,13 @@ private:
   void AppendDataCompletedWithSuccess(SourceBufferTask::AppendBufferResult aResult);
   void AppendDataErrored(const MediaResult& aError);
 
+  bool OnOwnerThread() const
+  {
+    return mOwnerThread->IsCurrentThreadIn();
+  }
+
+  // The owner thread of mMediaSource, kept once detached from it.
+  const RefPtr<MediaSourceThread> mOwnerThread;
   RefPtr<MediaSource> mMediaSource;
 
   RefPtr<TrackBuffersManager> mTrackBuffersManager;
@@ -36,7 +36,7 @@ SourceBufferList::~SourceBufferList()
 SourceBuffer*
 SourceBufferList::IndexedGetter(uint32_t aIndex, bool& aFound)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   aFound = aIndex < mSourceBuffers.Length();
 
   if (!aFound) {
@@ -48,14 +48,14 @@ SourceBufferList::IndexedGetter(uint32_t aIndex, bool& aFound)
 uint32_t
 SourceBufferList::Length()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   return mSourceBuffers.Length();
 }
 
 void
 SourceBufferList::Append(SourceBuffer* aSourceBuffer)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   mSourceBuffers.AppendElement(aSourceBuffer);
   QueueAsyncSimpleEvent("addsourcebuffer");
 }
@@ -63,14 +63,14 @@ SourceBufferList::Append(SourceBuffer* aSourceBuffer)
 void
 SourceBufferList::AppendSimple(SourceBuffer* aSourceBuffer)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   mSourceBuffers.AppendElement(aSourceBuffer);
 }
 
 void
 SourceBufferList::Remove(SourceBuffer* aSourceBuffer)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MOZ_ALWAYS_TRUE(mSourceBuffers.RemoveElement(aSourceBuffer));
   aSourceBuffer->Detach();
   QueueAsyncSimpleEvent("removesourcebuffer");
@@ -79,14 +79,14 @@ SourceBufferList::Remove(SourceBuffer* aSourceBuffer)
 bool
 SourceBufferList::Contains(SourceBuffer* aSourceBuffer)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   return mSourceBuffers.Contains(aSourceBuffer);
 }
 
 void
 SourceBufferList::Clear()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   for (uint32_t i = 0; i < mSourceBuffers.Length(); ++i) {
     mSourceBuffers[i]->Detach();
   }
@@ -97,21 +97,21 @@ SourceBufferList::Clear()
 void
 SourceBufferList::ClearSimple()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   mSourceBuffers.Clear();
 }
 
 bool
 SourceBufferList::IsEmpty()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   return mSourceBuffers.IsEmpty();
 }
 
 bool
 SourceBufferList::AnyUpdating()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   for (uint32_t i = 0; i < mSourceBuffers.Length(); ++i) {
     if (mSourceBuffers[i]->Updating()) {
       return true;
@@ -123,7 +123,7 @@ SourceBufferList::AnyUpdating()
 void
 SourceBufferList::RangeRemoval(double aStart, double aEnd)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_DEBUG("RangeRemoval(aStart=%f, aEnd=%f)", aStart, aEnd);
   for (uint32_t i = 0; i < mSourceBuffers.Length(); ++i) {
     mSourceBuffers[i]->RangeRemoval(aStart, aEnd);
@@ -133,7 +133,7 @@ SourceBufferList::RangeRemoval(double aStart, double aEnd)
 void
 SourceBufferList::Ended()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   for (uint32_t i = 0; i < mSourceBuffers.Length(); ++i) {
     mSourceBuffers[i]->Ended();
   }
@@ -142,7 +142,7 @@ SourceBufferList::Ended()
 double
 SourceBufferList::GetHighestBufferedEndTime()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   double highestEndTime = 0;
   for (uint32_t i = 0; i < mSourceBuffers.Length(); ++i) {
     highestEndTime = std::max(highestEndTime, mSourceBuffers[i]->GetBufferedEnd());
@@ -153,7 +153,7 @@ SourceBufferList::GetHighestBufferedEndTime()
 void
 SourceBufferList::DispatchSimpleEvent(const char* aName)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_API("Dispatch event '%s'", aName);
   DispatchTrustedEvent(NS_ConvertUTF8toUTF16(aName));
 }
@@ -163,11 +163,12 @@ SourceBufferList::QueueAsyncSimpleEvent(const char* aName)
 {
   MSE_DEBUG("Queue event '%s'", aName);
   nsCOMPtr<nsIRunnable> event = new AsyncEventRunner<SourceBufferList>(this, aName);
-  NS_DispatchToMainThread(event);
+  mOwnerThread->Dispatch(event.forget());
 }
 
 SourceBufferList::SourceBufferList(MediaSource* aMediaSource)
   : DOMEventTargetHelper(aMediaSource->GetParentObject())
+  , mOwnerThread(aMediaSource->OwnerThread())
   , mMediaSource(aMediaSource)
 {
   MOZ_ASSERT(aMediaSource);
@@ -182,7 +183,7 @@ SourceBufferList::GetParentObject() const
 double
 SourceBufferList::HighestStartTime()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   double highestStartTime = 0;
   for (auto& sourceBuffer : mSourceBuffers) {
     highestStartTime =
@@ -194,7 +195,7 @@ SourceBufferList::HighestStartTime()
 double
 SourceBufferList::HighestEndTime()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   double highestEndTime = 0;
   for (auto& sourceBuffer : mSourceBuffers) {
     highestEndTime =
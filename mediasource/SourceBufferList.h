@@ -95,6 +95,13 @@ private:
   void DispatchSimpleEvent(const char* aName);
   void QueueAsyncSimpleEvent(const char* aName);
 
+  bool OnOwnerThread() const
+  {
+    return mOwnerThread->IsCurrentThreadIn();
+  }
+
+  // The owner thread of mMediaSource.
+  const RefPtr<MediaSourceThread> mOwnerThread;
   RefPtr<MediaSource> mMediaSource;
   nsTArray<RefPtr<SourceBuffer> > mSourceBuffers;
 };
@@ -5,9 +5,11 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include "TrackBuffersManager.h"
+#include "BackgroundEviction.h"
 #include "ContainerParser.h"
 #include "MediaSourceDemuxer.h"
 #include "MediaSourceUtils.h"
+#include "mozilla/HashFunctions.h"
 #include "mozilla/Preferences.h"
 #include "mozilla/StateMirroring.h"
 #include "SourceBufferResource.h"
@@ -41,6 +43,9 @@ using media::TimeInterval;
 using media::TimeIntervals;
 typedef SourceBufferTask::AppendBufferResult AppendBufferResult;
 
+// Number of media segments remembered for detecting re-appended ones.
+static const uint32_t kMaxSegmentFingerprints = 256;
+
 static const char*
 AppendStateToStr(SourceBufferAttributes::AppendState aState)
 {
@@ -94,7 +99,12 @@ TrackBuffersManager::TrackBuffersManager(MediaSourceDecoder* aParentDecoder,
   , mType(aType)
   , mParser(ContainerParser::CreateForMIMEType(aType))
   , mProcessedInput(0)
+  , mInitDataHash(0)
+  , mSkipDuplicateSegments(Preferences::GetBool("media.mediasource.skip_duplicate_segments",
+                                                true))
+  , mSegmentFingerprints(kMaxSegmentFingerprints)
   , mTaskQueue(aParentDecoder->GetDemuxer()->GetTaskQueue())
+  , mOwnerThread(MediaSourceThread::GetCurrent())
   , mParentDecoder(new nsMainThreadPtrHolder<MediaSourceDecoder>(aParentDecoder, false /* strict */))
   , mEnded(false)
   , mVideoEvictionThreshold(Preferences::GetUint("media.mediasource.eviction_threshold.video",
@@ -102,6 +112,11 @@ TrackBuffersManager::TrackBuffersManager(MediaSourceDecoder* aParentDecoder,
   , mAudioEvictionThreshold(Preferences::GetUint("media.mediasource.eviction_threshold.audio",
                                                  20 * 1024 * 1024))
   , mEvictionState(EvictionState::NO_EVICTION_NEEDED)
+  , mEvictionHeadroomAppends(Preferences::GetUint("media.mediasource.eviction_headroom.appends",
+                                                  1))
+  , mAverageAppendSize(0)
+  , mLastPlaybackTime(0)
+  , mBackgroundEvictionPending(false)
   , mMonitor("TrackBuffersManager")
 {
   MOZ_ASSERT(NS_IsMainThread(), "Must be instanciated on the main thread");
@@ -116,7 +131,7 @@ RefPtr<TrackBuffersManager::AppendPromise>
 TrackBuffersManager::AppendData(MediaByteBuffer* aData,
                                 const SourceBufferAttributes& aAttributes)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_DEBUG("Appending %lld bytes", aData->Length());
 
   mEnded = false;
@@ -163,7 +178,8 @@ TrackBuffersManager::ProcessTasks()
   }
   RefPtr<SourceBufferTask> task = mQueue.Pop();
   if (!task) {
-    // nothing to do.
+    // nothing to do; use the idle time to make room for the next append.
+    MaybeScheduleBackgroundEviction();
     return;
   }
   switch (task->GetType()) {
@@ -217,7 +233,7 @@ TrackBuffersManager::ProcessTasks()
 void
 TrackBuffersManager::AbortAppendData()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_DEBUG("");
 
   QueueTask(new AbortTask());
@@ -226,7 +242,7 @@ TrackBuffersManager::AbortAppendData()
 void
 TrackBuffersManager::ResetParserState(SourceBufferAttributes& aAttributes)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_DEBUG("");
 
   // Spec states:
@@ -249,7 +265,7 @@ TrackBuffersManager::ResetParserState(SourceBufferAttributes& aAttributes)
 RefPtr<TrackBuffersManager::RangeRemovalPromise>
 TrackBuffersManager::RangeRemoval(TimeUnit aStart, TimeUnit aEnd)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_DEBUG("From %.2f to %.2f", aStart.ToSeconds(), aEnd.ToSeconds());
 
   mEnded = false;
@@ -262,12 +278,18 @@ TrackBuffersManager::RangeRemoval(TimeUnit aStart, TimeUnit aEnd)
 TrackBuffersManager::EvictDataResult
 TrackBuffersManager::EvictData(const TimeUnit& aPlaybackTime, int64_t aSize)
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
 
   if (aSize > EvictionThreshold()) {
     // We're adding more data than we can hold.
     return EvictDataResult::BUFFER_FULL;
   }
+
+  // Remember what appends look like for the background eviction.
+  const int64_t average = mAverageAppendSize;
+  mAverageAppendSize = average ? (average * 7 + aSize) / 8 : aSize;
+  mLastPlaybackTime = aPlaybackTime.ToMicroseconds();
+
   const int64_t toEvict = GetSize() + aSize - EvictionThreshold();
 
   const uint32_t canEvict =
@@ -356,7 +378,7 @@ TrackBuffersManager::Ended()
 void
 TrackBuffersManager::Detach()
 {
-  MOZ_ASSERT(NS_IsMainThread());
+  MOZ_ASSERT(OnOwnerThread());
   MSE_DEBUG("");
   QueueTask(new DetachTask());
 }
@@ -383,6 +405,8 @@ TrackBuffersManager::CompleteResetParserState()
     track->mQueuedSamples.Clear();
   }
 
+  mPendingSegment.reset();
+
   // 7. Remove all bytes from the input buffer.
   mInputBuffer = nullptr;
   if (mCurrentInputBuffer) {
@@ -417,13 +441,76 @@ TrackBuffersManager::EvictionThreshold() const
   return mAudioEvictionThreshold;
 }
 
+int64_t
+TrackBuffersManager::EvictionHeadroom() const
+{
+  return ComputeEvictionHeadroom(mAverageAppendSize, mEvictionHeadroomAppends,
+                                 EvictionThreshold());
+}
+
+void
+TrackBuffersManager::MaybeScheduleBackgroundEviction()
+{
+  MOZ_ASSERT(OnTaskQueue());
+
+  if (mBackgroundEvictionPending || !mTaskQueue ||
+      mEvictionState == EvictionState::EVICTION_NEEDED) {
+    // Already scheduled, detached, or an eviction task is on its way.
+    return;
+  }
+  // Nothing to do without headroom to keep: background eviction is disabled
+  // through media.mediasource.eviction_headroom.appends, or nothing was
+  // appended yet to size it from. Appends evict on their own as needed.
+  if (!ComputeBackgroundEvictionSize(mSizeSourceBuffer, EvictionHeadroom(),
+                                     EvictionThreshold())) {
+    return;
+  }
+  mBackgroundEvictionPending = true;
+  GetTaskQueue()->Dispatch(
+    NewRunnableMethod(this, &TrackBuffersManager::DoBackgroundEviction));
+}
+
+void
+TrackBuffersManager::DoBackgroundEviction()
+{
+  if (!mTaskQueue) {
+    // We've been detached in the meantime.
+    return;
+  }
+  MOZ_ASSERT(OnTaskQueue());
+  mBackgroundEvictionPending = false;
+
+  if (mCurrentTask || mQueue.Length()) {
+    // An append or another task arrived; it takes precedence. We'll try again
+    // once the queue is idle.
+    MSE_DEBUGV("Background eviction cancelled");
+    return;
+  }
+  if (mEvictionState == EvictionState::EVICTION_NEEDED) {
+    return;
+  }
+  const int64_t toEvict =
+    ComputeBackgroundEvictionSize(mSizeSourceBuffer, EvictionHeadroom(),
+                                  EvictionThreshold());
+  if (!toEvict) {
+    return;
+  }
+  MSE_DEBUG("Background eviction of %lld bytes to keep %lldkB of headroom",
+            toEvict, EvictionHeadroom() / 1024);
+  DoEvictData(TimeUnit::FromMicroseconds(mLastPlaybackTime), toEvict,
+              /* aPlayedDataOnly = */ true);
+}
+
 void
 TrackBuffersManager::DoEvictData(const TimeUnit& aPlaybackTime,
-                                 int64_t aSizeToEvict)
+                                 int64_t aSizeToEvict,
+                                 bool aPlayedDataOnly)
 {
   MOZ_ASSERT(OnTaskQueue());
 
-  mEvictionState = EvictionState::EVICTION_COMPLETED;
+  if (!aPlayedDataOnly) {
+    mEvictionState = EvictionState::EVICTION_COMPLETED;
+  }
 
   // Video is what takes the most space, only evict there if we have video.
   auto& track = HasVideo() ? mVideoTracks : mAudioTracks;
@@ -460,7 +547,7 @@ TrackBuffersManager::DoEvictData(const TimeUnit& aPlaybackTime,
                    TimeUnit::FromMicroseconds(buffer[lastKeyFrameIndex]->mTime - 1)));
   }
 
-  if (mSizeSourceBuffer <= finalSize) {
+  if (mSizeSourceBuffer <= finalSize || aPlayedDataOnly) {
     return;
   }
 
@@ -702,6 +789,31 @@ TrackBuffersManager::SegmentParserLoop()
       // If so, recreate a new demuxer to ensure that the demuxer is only fed
       // monotonically increasing data.
       if (mNewMediaSegmentStarted) {
+        if (NS_SUCCEEDED(newData) && !mPendingInputBuffer) {
+          Maybe<SegmentFingerprint> fingerprint =
+            FingerprintInputBuffer(start, end);
+          mPendingSegment.reset();
+          if (fingerprint && mSegmentFingerprints.IsBuffered(*fingerprint)) {
+            // This exact segment was appended before and none of its frames
+            // got removed since: processing it again would only replace the
+            // frames with identical ones.
+            MSE_DEBUG("Skipping already buffered media segment [%lld, %lld]",
+                      start, end);
+            mInputBuffer = nullptr;
+            RecreateParser(true);
+            mNewMediaSegmentStarted = false;
+            // As after a discontinuity, the next coded frame group will start
+            // anew.
+            for (auto& track : GetTracksList()) {
+              track->ResetAppendState();
+            }
+            SetAppendState(AppendState::WAITING_FOR_SEGMENT);
+            continue;
+          }
+          if (fingerprint) {
+            mPendingSegment.emplace(*fingerprint);
+          }
+        }
         if (NS_SUCCEEDED(newData) && mLastParsedEndTime.isSome() &&
             start < mLastParsedEndTime.ref().ToMicroseconds()) {
           MSE_DEBUG("Re-creating demuxer");
@@ -756,6 +868,7 @@ void
 TrackBuffersManager::NeedMoreData()
 {
   MSE_DEBUG("");
+  mPendingSegment.reset();
   MOZ_DIAGNOSTIC_ASSERT(mCurrentTask && mCurrentTask->GetType() == SourceBufferTask::Type::AppendBuffer);
   MOZ_DIAGNOSTIC_ASSERT(mSourceBufferAttributes);
 
@@ -773,6 +886,7 @@ TrackBuffersManager::RejectAppend(const MediaResult& aRejectValue, const char* a
 {
   MSE_DEBUG("rv=%u", aRejectValue.Code());
   MOZ_DIAGNOSTIC_ASSERT(mCurrentTask && mCurrentTask->GetType() == SourceBufferTask::Type::AppendBuffer);
+  mPendingSegment.reset();
 
   mCurrentTask->As<AppendBufferTask>()->mPromise.Reject(aRejectValue, __func__);
   mSourceBufferAttributes = nullptr;
@@ -1103,6 +1217,7 @@ TrackBuffersManager::OnDemuxerInitDone(nsresult)
 
   // We now have a valid init data ; we can store it for later use.
   mInitData = mParser->InitData();
+  mInitDataHash = HashBytes(mInitData->Elements(), mInitData->Length());
 
   // 3. Remove the initialization segment bytes from the beginning of the input buffer.
   // This step has already been done in InitializationSegmentReceived when we
@@ -1304,6 +1419,7 @@ TrackBuffersManager::CompleteCodedFrameProcessing()
 
   // 5. If the input buffer does not contain a complete media segment, then jump to the need more data step below.
   if (mParser->MediaSegmentRange().IsEmpty()) {
+    mPendingSegment.reset();
     ResolveProcessing(true, __func__);
     return;
   }
@@ -1331,6 +1447,11 @@ TrackBuffersManager::CompleteCodedFrameProcessing()
   mInputDemuxer->NotifyDataRemoved();
   RecreateParser(true);
 
+  if (mPendingSegment) {
+    mSegmentFingerprints.Append(Move(*mPendingSegment));
+    mPendingSegment.reset();
+  }
+
   // 7. Set append state to WAITING_FOR_SEGMENT.
   SetAppendState(AppendState::WAITING_FOR_SEGMENT);
 
@@ -1743,6 +1864,9 @@ TrackBuffersManager::InsertFrames(TrackBuffer& aSamples,
 
   // Update our buffered range with new sample interval.
   trackBuffer.mBufferedRanges += aIntervals;
+  if (mPendingSegment) {
+    mPendingSegment->AddFrames(&trackBuffer, aIntervals);
+  }
   // We allow a fuzz factor in our interval of half a frame length,
   // as fuzz is +/- value, giving an effective leeway of a full frame
   // length.
@@ -1876,6 +2000,7 @@ TrackBuffersManager::RemoveFrames(const TimeIntervals& aIntervals,
 
   // Update our buffered range to exclude the range just removed.
   aTrackData.mBufferedRanges -= removedIntervals;
+  mSegmentFingerprints.Invalidate(&aTrackData, removedIntervals);
 
   // Recalculate sanitized buffered ranges.
   aTrackData.mSanitizedBufferedRanges = aTrackData.mBufferedRanges;
@@ -1901,6 +2026,40 @@ TrackBuffersManager::RemoveFrames(const TimeIntervals& aIntervals,
   return firstRemovedIndex.ref();
 }
 
+Maybe<SegmentFingerprint>
+TrackBuffersManager::FingerprintInputBuffer(int64_t aStart, int64_t aEnd)
+{
+  MOZ_ASSERT(OnTaskQueue());
+
+  // Only segments processed independently of what was appended before them
+  // can be identified by their content: in sequence mode, or when generating
+  // timestamps, where the frames end up depends on the previous segments.
+  if (!mSkipDuplicateSegments ||
+      mSourceBufferAttributes->GetAppendMode() != SourceBufferAppendMode::Segments ||
+      mSourceBufferAttributes->mGenerateTimestamps) {
+    return Nothing();
+  }
+  // The input buffer must hold exactly one complete media segment. This isn't
+  // known for containers that only find a segment's end once the next one
+  // starts.
+  MediaByteRange mediaRange = mParser->MediaSegmentRange();
+  if (mediaRange.IsEmpty() ||
+      mediaRange.mStart != int64_t(mProcessedInput - mInputBuffer->Length()) ||
+      mediaRange.mEnd != int64_t(mProcessedInput)) {
+    return Nothing();
+  }
+
+  SegmentFingerprint fingerprint;
+  fingerprint.mHash = HashBytes(mInputBuffer->Elements(), mInputBuffer->Length());
+  fingerprint.mLength = mInputBuffer->Length();
+  fingerprint.mStart = aStart;
+  fingerprint.mEnd = aEnd;
+  fingerprint.mInitDataHash = mInitDataHash;
+  fingerprint.mTimestampOffset = mSourceBufferAttributes->GetTimestampOffset();
+  fingerprint.mAppendWindow = mAppendWindow;
+  return Some(Move(fingerprint));
+}
+
 void
 TrackBuffersManager::RecreateParser(bool aReuseInitData)
 {
@@ -17,6 +17,8 @@
 #include "MediaDataDemuxer.h"
 #include "MediaResult.h"
 #include "MediaSourceDecoder.h"
+#include "MediaSourceThread.h"
+#include "SegmentFingerprints.h"
 #include "SourceBufferTask.h"
 #include "TimeUnits.h"
 #include "nsAutoPtr.h"
@@ -235,6 +237,19 @@ private:
   // Length already processed in current media segment.
   uint32_t mProcessedInput;
   Maybe<media::TimeUnit> mLastParsedEndTime;
+  // Hash of mInitData.
+  uint32_t mInitDataHash;
+
+  struct TrackData;
+  // Fingerprint of the input buffer if it holds exactly one complete media
+  // segment whose processing doesn't depend on earlier appends.
+  Maybe<SegmentFingerprint> FingerprintInputBuffer(int64_t aStart, int64_t aEnd);
+  const bool mSkipDuplicateSegments;
+  typedef SegmentFingerprintList<TrackData> SegmentList;
+  // Segments processed, oldest first.
+  SegmentList mSegmentFingerprints;
+  // The segment being processed, recorded once complete.
+  Maybe<SegmentList::Segment> mPendingSegment;
 
   void OnDemuxerInitDone(nsresult);
   void OnDemuxerInitFailed(const MediaResult& aFailure);
@@ -257,7 +272,15 @@ private:
     OnDemuxFailed(TrackType::kAudioTrack, aError);
   }
 
-  void DoEvictData(const media::TimeUnit& aPlaybackTime, int64_t aSizeToEvict);
+  // If aPlayedDataOnly is true, only data before aPlaybackTime is removed.
+  void DoEvictData(const media::TimeUnit& aPlaybackTime, int64_t aSizeToEvict,
+                   bool aPlayedDataOnly = false);
+  // Free space below the eviction threshold kept available by evicting
+  // played data while the task queue is idle, so that appends don't have to
+  // wait for an eviction or fail with the buffer full.
+  int64_t EvictionHeadroom() const;
+  void MaybeScheduleBackgroundEviction();
+  void DoBackgroundEviction();
 
   struct TrackData
   {
@@ -448,6 +471,13 @@ private:
     return !GetTaskQueue() || GetTaskQueue()->IsCurrentThreadIn();
   }
   RefPtr<AutoTaskQueue> mTaskQueue;
+  // Owner thread of the SourceBuffer, on which the SourceBuffer methods are
+  // called and their promises are resolved.
+  const RefPtr<MediaSourceThread> mOwnerThread;
+  bool OnOwnerThread() const
+  {
+    return mOwnerThread->IsCurrentThreadIn();
+  }
 
   // SourceBuffer Queues and running context.
   SourceBufferTaskQueue mQueue;
@@ -485,6 +515,16 @@ private:
     EVICTION_COMPLETED,
   };
   Atomic<EvictionState> mEvictionState;
+  // Number of average-sized appends worth of headroom to keep free through
+  // background eviction. 0 disables background eviction.
+  const uint32_t mEvictionHeadroomAppends;
+  // Moving average of the size of appended data, and the playback position
+  // last given to EvictData(). Written on the owner thread, read on the task
+  // queue.
+  Atomic<int64_t> mAverageAppendSize;
+  Atomic<int64_t> mLastPlaybackTime;
+  // Set while a background eviction is dispatched. Task queue only.
+  bool mBackgroundEvictionPending;
 
   // Monitor to protect following objects accessed across multiple threads.
   mutable Monitor mMonitor;
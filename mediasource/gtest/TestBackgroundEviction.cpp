@@ -0,0 +1,51 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "gtest/gtest.h"
+#include "BackgroundEviction.h"
+
+using namespace mozilla;
+
+static const int64_t kThreshold = 100 * 1024 * 1024;
+
+TEST(BackgroundEviction, Headroom)
+{
+  EXPECT_EQ(ComputeEvictionHeadroom(1024 * 1024, 3, kThreshold),
+            3 * 1024 * 1024);
+  // Capped to a quarter of the threshold.
+  EXPECT_EQ(ComputeEvictionHeadroom(20 * 1024 * 1024, 3, kThreshold),
+            kThreshold / 4);
+  // Disabled, or nothing appended yet.
+  EXPECT_EQ(ComputeEvictionHeadroom(1024 * 1024, 0, kThreshold), 0);
+  EXPECT_EQ(ComputeEvictionHeadroom(0, 3, kThreshold), 0);
+}
+
+TEST(BackgroundEviction, EvictsDownToHeadroom)
+{
+  const int64_t headroom = 3 * 1024 * 1024;
+  // Enough room left.
+  EXPECT_EQ(ComputeBackgroundEvictionSize(0, headroom, kThreshold), 0);
+  EXPECT_EQ(
+    ComputeBackgroundEvictionSize(kThreshold - headroom, headroom, kThreshold),
+    0);
+  EXPECT_EQ(ComputeBackgroundEvictionSize(kThreshold - 1024 * 1024, headroom,
+                                          kThreshold),
+            2 * 1024 * 1024);
+  EXPECT_EQ(ComputeBackgroundEvictionSize(kThreshold, headroom, kThreshold),
+            headroom);
+}
+
+TEST(BackgroundEviction, SkippedWithoutHeadroom)
+{
+  // A full buffer is left for the next append to evict from.
+  EXPECT_EQ(ComputeBackgroundEvictionSize(kThreshold, 0, kThreshold), 0);
+  EXPECT_EQ(ComputeBackgroundEvictionSize(kThreshold + 1024, 0, kThreshold),
+            0);
+  EXPECT_EQ(ComputeBackgroundEvictionSize(
+              kThreshold,
+              ComputeEvictionHeadroom(1024 * 1024, 0, kThreshold),
+              kThreshold),
+            0);
+}
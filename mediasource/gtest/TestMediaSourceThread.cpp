@@ -0,0 +1,114 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "gtest/gtest.h"
+#include "MediaSourceThread.h"
+#include "mozilla/Monitor.h"
+#include "mozilla/MozPromise.h"
+#include "mozilla/SharedThreadPool.h"
+#include "mozilla/SyncRunnable.h"
+#include "mozilla/TaskQueue.h"
+#include "nsThreadUtils.h"
+#include "VideoUtils.h"
+
+using namespace mozilla;
+
+typedef MozPromise<bool, nsresult, /* IsExclusive = */ true> TestPromise;
+
+TEST(MediaSourceThread, MainThread)
+{
+  RefPtr<MediaSourceThread> thread = MediaSourceThread::GetCurrent();
+  ASSERT_TRUE(thread);
+  EXPECT_TRUE(thread->IsCurrentThreadIn());
+  EXPECT_EQ(thread->GetAbstractThread(), AbstractThread::MainThread());
+}
+
+TEST(MediaSourceThread, RequiresAbstractThread)
+{
+  // Like a DOM worker thread, a bare XPCOM thread has no AbstractThread.
+  nsCOMPtr<nsIThread> xpcomThread;
+  ASSERT_TRUE(NS_SUCCEEDED(
+    NS_NewNamedThread("MSE Test", getter_AddRefs(xpcomThread))));
+  bool found = true;
+  nsCOMPtr<nsIRunnable> r = NS_NewRunnableFunction([&found]() {
+    RefPtr<MediaSourceThread> thread = MediaSourceThread::GetCurrent();
+    found = !!thread;
+  });
+  SyncRunnable::DispatchToThread(xpcomThread, r);
+  EXPECT_FALSE(found);
+  xpcomThread->Shutdown();
+}
+
+TEST(MediaSourceThread, OffMainThread)
+{
+  nsCOMPtr<nsIThread> xpcomThread;
+  ASSERT_TRUE(NS_SUCCEEDED(
+    NS_NewNamedThread("MSE Test", getter_AddRefs(xpcomThread))));
+  RefPtr<AbstractThread> abstractThread =
+    AbstractThread::CreateXPCOMThreadWrapper(xpcomThread, false);
+  RefPtr<TaskQueue> taskQueue =
+    new TaskQueue(GetMediaThreadPool(MediaThreadType::PLAYBACK));
+
+  Monitor monitor("TestMediaSourceThread");
+  RefPtr<MediaSourceThread> owner;
+  nsTArray<int> events;
+  bool resolvedOnOwner = false;
+  bool done = false;
+
+  nsCOMPtr<nsIRunnable> r = NS_NewRunnableFunction([&]() {
+    owner = MediaSourceThread::GetCurrent();
+    if (!owner) {
+      MonitorAutoLock mon(monitor);
+      done = true;
+      mon.NotifyAll();
+      return;
+    }
+    // Events run in order on the owner thread.
+    for (int i = 0; i < 3; i++) {
+      nsCOMPtr<nsIRunnable> event = NS_NewRunnableFunction([&, i]() {
+        events.AppendElement(owner->IsCurrentThreadIn() ? i : -1);
+      });
+      owner->Dispatch(event.forget());
+    }
+    // As with the TrackBuffersManager, the promise is resolved on a task
+    // queue and completes on the owner thread.
+    RefPtr<TestPromise::Private> p = new TestPromise::Private(__func__);
+    p->Then(owner->GetAbstractThread(), __func__,
+            [&](bool) {
+              MonitorAutoLock mon(monitor);
+              resolvedOnOwner = owner->IsCurrentThreadIn();
+              done = true;
+              mon.NotifyAll();
+            },
+            [&](nsresult) {
+              MonitorAutoLock mon(monitor);
+              done = true;
+              mon.NotifyAll();
+            });
+    taskQueue->Dispatch(NS_NewRunnableFunction([p]() {
+      p->Resolve(true, __func__);
+    }));
+  });
+  xpcomThread->Dispatch(r, NS_DISPATCH_NORMAL);
+  {
+    MonitorAutoLock mon(monitor);
+    while (!done) {
+      mon.Wait();
+    }
+  }
+
+  ASSERT_TRUE(owner);
+  EXPECT_FALSE(owner->IsCurrentThreadIn());
+  EXPECT_TRUE(resolvedOnOwner);
+  ASSERT_EQ(3u, events.Length());
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(i, events[i]);
+  }
+
+  owner = nullptr;
+  taskQueue->BeginShutdown();
+  taskQueue->AwaitShutdownAndIdle();
+  xpcomThread->Shutdown();
+}
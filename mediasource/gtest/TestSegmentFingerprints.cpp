@@ -0,0 +1,128 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "gtest/gtest.h"
+#include "SegmentFingerprints.h"
+
+using namespace mozilla;
+using media::TimeInterval;
+using media::TimeIntervals;
+using media::TimeUnit;
+
+struct FakeTrack
+{
+  TimeIntervals mBufferedRanges;
+};
+
+typedef SegmentFingerprintList<FakeTrack> FakeSegmentList;
+
+static TimeIntervals
+Seconds(double aStart, double aEnd)
+{
+  return TimeIntervals(TimeInterval(TimeUnit::FromSeconds(aStart),
+                                    TimeUnit::FromSeconds(aEnd)));
+}
+
+static SegmentFingerprint
+MakeFingerprint(uint32_t aHash, int64_t aStart)
+{
+  SegmentFingerprint fingerprint;
+  fingerprint.mHash = aHash;
+  fingerprint.mLength = 1024;
+  fingerprint.mStart = aStart;
+  fingerprint.mEnd = aStart + 2000000;
+  fingerprint.mInitDataHash = 42;
+  fingerprint.mTimestampOffset = TimeUnit();
+  fingerprint.mAppendWindow =
+    TimeInterval(TimeUnit(), TimeUnit::FromInfinity());
+  return fingerprint;
+}
+
+// Record a segment that added [aStart, aEnd) to both tracks, as appending
+// it would.
+static void
+AppendSegment(FakeSegmentList& aList, const SegmentFingerprint& aFingerprint,
+              FakeTrack& aVideo, FakeTrack& aAudio, double aStart, double aEnd)
+{
+  FakeSegmentList::Segment segment(aFingerprint);
+  segment.AddFrames(&aVideo, Seconds(aStart, aEnd));
+  segment.AddFrames(&aAudio, Seconds(aStart, aEnd));
+  aVideo.mBufferedRanges += Seconds(aStart, aEnd);
+  aAudio.mBufferedRanges += Seconds(aStart, aEnd);
+  aList.Append(Move(segment));
+}
+
+TEST(SegmentFingerprints, SkipsBufferedDuplicate)
+{
+  FakeSegmentList list(256);
+  FakeTrack video, audio;
+  AppendSegment(list, MakeFingerprint(1, 0), video, audio, 0, 2);
+  AppendSegment(list, MakeFingerprint(2, 2000000), video, audio, 2, 4);
+  EXPECT_EQ(2u, list.Length());
+
+  EXPECT_TRUE(list.IsBuffered(MakeFingerprint(1, 0)));
+  EXPECT_TRUE(list.IsBuffered(MakeFingerprint(2, 2000000)));
+  // Different content, or the same content appended differently.
+  EXPECT_FALSE(list.IsBuffered(MakeFingerprint(3, 0)));
+  SegmentFingerprint offset = MakeFingerprint(1, 0);
+  offset.mTimestampOffset = TimeUnit::FromSeconds(10);
+  EXPECT_FALSE(list.IsBuffered(offset));
+}
+
+TEST(SegmentFingerprints, PartialEvictionOnOneTrack)
+{
+  FakeSegmentList list(256);
+  FakeTrack video, audio;
+  AppendSegment(list, MakeFingerprint(1, 0), video, audio, 0, 2);
+
+  // The audio frames in [1, 2) are gone. The video track still buffering
+  // that interval doesn't make the segment buffered.
+  audio.mBufferedRanges -= Seconds(1, 2);
+  EXPECT_FALSE(list.IsBuffered(MakeFingerprint(1, 0)));
+
+  audio.mBufferedRanges += Seconds(1, 2);
+  EXPECT_TRUE(list.IsBuffered(MakeFingerprint(1, 0)));
+}
+
+TEST(SegmentFingerprints, InvalidatedByRangeRemoval)
+{
+  FakeSegmentList list(256);
+  FakeTrack video, audio, other;
+  AppendSegment(list, MakeFingerprint(1, 0), video, audio, 0, 2);
+  AppendSegment(list, MakeFingerprint(2, 2000000), video, audio, 2, 4);
+
+  // Removing frames from a track the segment didn't add to, or outside of
+  // what it added, keeps it.
+  list.Invalidate(&other, Seconds(0, 4));
+  list.Invalidate(&video, Seconds(5, 6));
+  EXPECT_EQ(2u, list.Length());
+
+  // As remove(1, 1.5) does on the video track.
+  video.mBufferedRanges -= Seconds(1, 1.5);
+  list.Invalidate(&video, Seconds(1, 1.5));
+  EXPECT_EQ(1u, list.Length());
+  EXPECT_FALSE(list.IsBuffered(MakeFingerprint(1, 0)));
+  EXPECT_TRUE(list.IsBuffered(MakeFingerprint(2, 2000000)));
+
+  // Buffering the interval again doesn't bring the segment back.
+  video.mBufferedRanges += Seconds(1, 1.5);
+  EXPECT_FALSE(list.IsBuffered(MakeFingerprint(1, 0)));
+}
+
+TEST(SegmentFingerprints, Capacity)
+{
+  FakeSegmentList list(2);
+  FakeTrack video, audio;
+  AppendSegment(list, MakeFingerprint(1, 0), video, audio, 0, 2);
+  AppendSegment(list, MakeFingerprint(2, 2000000), video, audio, 2, 4);
+  AppendSegment(list, MakeFingerprint(3, 4000000), video, audio, 4, 6);
+  EXPECT_EQ(2u, list.Length());
+  EXPECT_FALSE(list.IsBuffered(MakeFingerprint(1, 0)));
+  EXPECT_TRUE(list.IsBuffered(MakeFingerprint(3, 4000000)));
+
+  // A segment that added no frames isn't remembered.
+  list.Append(FakeSegmentList::Segment(MakeFingerprint(4, 6000000)));
+  EXPECT_EQ(2u, list.Length());
+}
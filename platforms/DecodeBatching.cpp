@@ -0,0 +1,157 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* vim:set ts=2 sw=2 sts=2 et cindent: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "DecodeBatching.h"
+#include "PlatformDecoderModule.h"
+#include "mozilla/Move.h"
+#include "mozilla/PodOperations.h"
+
+namespace mozilla {
+
+InputBatcher::InputBatcher()
+  : mMutex("InputBatcher")
+  , mDroppedBatches(0)
+  , mOpen(false)
+{
+}
+
+bool
+InputBatcher::Push(MediaRawData* aSample)
+{
+  MutexAutoLock lock(mMutex);
+  if (mOpen) {
+    MOZ_ASSERT(!mBatches.IsEmpty());
+    mBatches.LastElement().AppendElement(aSample);
+    return false;
+  }
+  mBatches.AppendElement()->AppendElement(aSample);
+  mOpen = true;
+  return true;
+}
+
+void
+InputBatcher::Seal()
+{
+  MutexAutoLock lock(mMutex);
+  mOpen = false;
+}
+
+nsTArray<RefPtr<MediaRawData>>
+InputBatcher::TakeBatch()
+{
+  MutexAutoLock lock(mMutex);
+  nsTArray<RefPtr<MediaRawData>> batch;
+  if (mDroppedBatches) {
+    mDroppedBatches--;
+    return batch;
+  }
+  if (mBatches.IsEmpty()) {
+    return batch;
+  }
+  batch.SwapElements(mBatches[0]);
+  mBatches.RemoveElementAt(0);
+  if (mBatches.IsEmpty()) {
+    mOpen = false;
+  }
+  return batch;
+}
+
+void
+InputBatcher::Clear()
+{
+  MutexAutoLock lock(mMutex);
+  mDroppedBatches += mBatches.Length();
+  mBatches.Clear();
+  mOpen = false;
+}
+
+AudioDataMerger::AudioDataMerger(MediaDataDecoderCallback* aCallback,
+                                 int64_t aMaxDurationUs)
+  : mCallback(aCallback)
+  , mMaxDurationUs(aMaxDurationUs)
+  , mPendingFrames(0)
+{
+}
+
+bool
+AudioDataMerger::CanMerge(const AudioData* aData) const
+{
+  if (mPending.IsEmpty()) {
+    return true;
+  }
+  const AudioData* first = mPending[0];
+  const AudioData* last = mPending.LastElement();
+  // Timestamps derived from frame counts may be rounded differently; a
+  // microsecond apart is still contiguous.
+  int64_t gap = aData->mTime - last->GetEndTime();
+  return !aData->mDiscontinuity &&
+         aData->mChannels == first->mChannels &&
+         aData->mRate == first->mRate &&
+         gap >= -1 && gap <= 1 &&
+         aData->GetEndTime() - first->mTime <= mMaxDurationUs;
+}
+
+void
+AudioDataMerger::Output(AudioData* aData)
+{
+  if (!CanMerge(aData)) {
+    OutputPending();
+  }
+  mPending.AppendElement(aData);
+  mPendingFrames += aData->mFrames;
+}
+
+void
+AudioDataMerger::OutputPending()
+{
+  if (mPending.IsEmpty()) {
+    return;
+  }
+  if (mPending.Length() == 1) {
+    mCallback->Output(mPending[0]);
+    Reset();
+    return;
+  }
+
+  const AudioData* first = mPending[0];
+  uint32_t channels = first->mChannels;
+  AlignedAudioBuffer buffer(mPendingFrames * channels);
+  if (!buffer) {
+    // Output the data as it came rather than not at all.
+    for (const auto& data : mPending) {
+      mCallback->Output(data);
+    }
+    Reset();
+    return;
+  }
+  AudioDataValue* dest = buffer.get();
+  for (const auto& data : mPending) {
+    size_t samples = data->mFrames * channels;
+    PodCopy(dest, data->mAudioData.get(), samples);
+    dest += samples;
+  }
+
+  RefPtr<AudioData> merged =
+    new AudioData(first->mOffset,
+                  first->mTime,
+                  mPending.LastElement()->GetEndTime() - first->mTime,
+                  mPendingFrames,
+                  Move(buffer),
+                  channels,
+                  first->mRate);
+  merged->mDiscontinuity = first->mDiscontinuity;
+  Reset();
+  mCallback->Output(merged);
+}
+
+void
+AudioDataMerger::Reset()
+{
+  mPending.Clear();
+  mPendingFrames = 0;
+}
+
+} // namespace mozilla
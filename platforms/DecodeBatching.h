@@ -0,0 +1,95 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* vim:set ts=2 sw=2 sts=2 et cindent: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#if !defined(DecodeBatching_h_)
+#define DecodeBatching_h_
+
+#include "MediaData.h"
+#include "mozilla/Mutex.h"
+#include "nsTArray.h"
+
+namespace mozilla {
+
+class MediaDataDecoderCallback;
+
+// Groups the samples given to a decoder's Input() while its task queue is
+// busy, so that they are decoded by a single task rather than one task per
+// sample:
+//
+//   void Input(MediaRawData* aSample)
+//   {
+//     if (mInputBatcher.Push(aSample)) {
+//       mTaskQueue->Dispatch(... ProcessDecode ...);
+//     }
+//   }
+//   void ProcessDecode()
+//   {
+//     nsTArray<RefPtr<MediaRawData>> samples = mInputBatcher.TakeBatch();
+//     ...
+//   }
+//
+// Each Push() returning true starts a batch and requires dispatching one task,
+// which takes that batch. Operations dispatched to the same task queue that
+// later samples mustn't overtake (Drain, ...) must call Seal() first.
+// Threadsafe.
+class InputBatcher
+{
+public:
+  InputBatcher();
+
+  // Queues aSample. Returns true if a new batch was started, in which case
+  // a task taking it must be dispatched.
+  bool Push(MediaRawData* aSample);
+  // Makes the next Push() start a new batch.
+  void Seal();
+  // Returns the oldest batch, or nothing if Clear() dropped it.
+  nsTArray<RefPtr<MediaRawData>> TakeBatch();
+  // Drops all queued samples, e.g. when flushing.
+  void Clear();
+
+private:
+  Mutex mMutex;
+  nsTArray<nsTArray<RefPtr<MediaRawData>>> mBatches;
+  // Number of batches dropped by Clear() whose tasks haven't run yet.
+  uint32_t mDroppedBatches;
+  // True if the last batch may still be appended to.
+  bool mOpen;
+};
+
+// Merges contiguous AudioData output while decoding a batch of samples into
+// fewer, longer ones, to reduce the number of callbacks and of chunks handed
+// down the audio pipeline. Timestamps are kept exact: data is only merged if
+// it starts where the previous data ends, has the same format and isn't
+// flagged as a discontinuity. Only accessed on the decoder's task queue.
+class AudioDataMerger
+{
+public:
+  static const int64_t kDefaultMaxDurationUs = 100000;
+
+  explicit AudioDataMerger(MediaDataDecoderCallback* aCallback,
+                           int64_t aMaxDurationUs = kDefaultMaxDurationUs);
+
+  // Queues aData, outputting what is queued first if aData can't be merged
+  // with it.
+  void Output(AudioData* aData);
+  // Outputs the queued data. To be called at the end of each batch, before
+  // InputExhausted(), and before reporting an error.
+  void OutputPending();
+  // Drops the queued data.
+  void Reset();
+
+private:
+  bool CanMerge(const AudioData* aData) const;
+
+  MediaDataDecoderCallback* mCallback;
+  const int64_t mMaxDurationUs;
+  nsTArray<RefPtr<AudioData>> mPending;
+  uint32_t mPendingFrames;
+};
+
+} // namespace mozilla
+
+#endif // DecodeBatching_h_
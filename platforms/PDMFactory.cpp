@@ -37,6 +37,7 @@
 #include "MediaPrefs.h"
 #include "FuzzingWrapper.h"
 #include "H264Converter.h"
+#include "OutputCachingDecoder.h"
 
 #include "AgnosticDecoderModule.h"
 #include "EMEDecoderModule.h"
@@ -75,6 +76,7 @@ public:
 #ifdef MOZ_FFMPEG
     FFmpegRuntimeLinker::Init();
 #endif
+    OutputCachingDecoder::InitPrefs();
   }
 };
 
@@ -277,6 +279,12 @@ PDMFactory::CreateDecoderWithPDM(PlatformDecoderModule* aPDM,
     return nullptr;
   }
 
+  if (aPDM->CreatesWrappingDecoder(config)) {
+    m = config.IsAudio() ? aPDM->CreateAudioDecoder(aParams)
+                         : aPDM->CreateVideoDecoder(aParams);
+    return m.forget();
+  }
+
   if (config.IsAudio()) {
     m = aPDM->CreateAudioDecoder(aParams);
     return m.forget();
@@ -298,6 +306,16 @@ PDMFactory::CreateDecoderWithPDM(PlatformDecoderModule* aPDM,
     callback = callbackWrapper.get();
   }
 
+  // Short clips, often looping, are cached once decoded. The cache sits
+  // between the fuzzing wrapper and the decoder so that replayed frames are
+  // fuzzed too.
+  RefPtr<OutputCachingDecoder> cache;
+  if (!aParams.mUseBlankDecoder && aParams.mTaskQueue &&
+      OutputCachingDecoder::ShouldCache(config)) {
+    cache = new OutputCachingDecoder(aParams.mTaskQueue, callback);
+    callback = cache.get();
+  }
+
   CreateDecoderParams params = aParams;
   params.mCallback = callback;
 
@@ -314,6 +332,11 @@ PDMFactory::CreateDecoderWithPDM(PlatformDecoderModule* aPDM,
     m = aPDM->CreateVideoDecoder(params);
   }
 
+  if (cache && m) {
+    cache->SetDecoder(m.forget());
+    m = cache.forget();
+  }
+
   if (callbackWrapper && m) {
     m = new DecoderFuzzingWrapper(m.forget(), callbackWrapper.forget());
   }
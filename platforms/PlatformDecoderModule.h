@@ -139,6 +139,15 @@ public:
   // feeding it to MediaDataDecoder::Input.
   virtual ConversionRequired DecoderNeedsConversion(const TrackInfo& aConfig) const = 0;
 
+  // Indicates that decoders created for aConfig merely wrap a decoder created
+  // by another PDMFactory, which already added the format conversion and other
+  // wrappers. PDMFactory then returns them as they are, rather than wrapping
+  // the chain a second time.
+  virtual bool CreatesWrappingDecoder(const TrackInfo& aConfig) const
+  {
+    return false;
+  }
+
 protected:
   PlatformDecoderModule() {}
   virtual ~PlatformDecoderModule() {}
@@ -303,6 +312,17 @@ public:
   // Reuse the decoder if the decoder support recycling.
   // Currently, only Android video decoder will return true.
   virtual bool SupportDecoderRecycling() const { return false; }
+
+  // Decoders that can switch to new codec parameters of the same codec (e.g.
+  // a new H.264 SPS/PPS at an adaptive streaming rendition switch) without
+  // being shut down return true, and then implement Reconfigure().
+  virtual bool SupportsReconfiguration() const { return false; }
+
+  // Applies aConfig to the samples given to Input() from now on. Frames of
+  // the samples already given are still output, so unlike re-creating the
+  // decoder no queued frames are dropped. Called on the reader's task queue,
+  // like Input(); failures are reported through the callback's Error().
+  virtual void Reconfigure(const TrackInfo& aConfig) {}
 };
 
 } // namespace mozilla
@@ -29,6 +29,7 @@ OpusDataDecoder::OpusDataDecoder(const CreateDecoderParams& aParams)
   : mInfo(aParams.AudioConfig())
   , mTaskQueue(aParams.mTaskQueue)
   , mCallback(aParams.mCallback)
+  , mOutputMerger(aParams.mCallback)
   , mOpusDecoder(nullptr)
   , mSkip(0)
   , mDecodedHeader(false)
@@ -145,22 +146,32 @@ OpusDataDecoder::DecodeHeader(const unsigned char* aData, size_t aLength)
 void
 OpusDataDecoder::Input(MediaRawData* aSample)
 {
-  mTaskQueue->Dispatch(NewRunnableMethod<RefPtr<MediaRawData>>(
-                       this, &OpusDataDecoder::ProcessDecode, aSample));
+  if (mInputBatcher.Push(aSample)) {
+    mTaskQueue->Dispatch(NewRunnableMethod(this,
+                                           &OpusDataDecoder::ProcessDecode));
+  }
 }
 
 void
-OpusDataDecoder::ProcessDecode(MediaRawData* aSample)
+OpusDataDecoder::ProcessDecode()
 {
-  if (mIsFlushing) {
-    return;
+  nsTArray<RefPtr<MediaRawData>> samples = mInputBatcher.TakeBatch();
+  for (const auto& sample : samples) {
+    if (mIsFlushing) {
+      mOutputMerger.Reset();
+      return;
+    }
+    MediaResult rv = DoDecode(sample);
+    if (NS_FAILED(rv)) {
+      mOutputMerger.OutputPending();
+      mCallback->Error(rv);
+      return;
+    }
   }
-
-  MediaResult rv = DoDecode(aSample);
-  if (NS_FAILED(rv)) {
-    mCallback->Error(rv);
+  if (samples.IsEmpty()) {
     return;
   }
+  mOutputMerger.OutputPending();
   mCallback->InputExhausted();
 }
 
@@ -294,13 +305,13 @@ OpusDataDecoder::DoDecode(MediaRawData* aSample)
       RESULT_DETAIL("Overflow shifting tstamp by codec delay"));
   };
 
-  mCallback->Output(new AudioData(aSample->mOffset,
-                                  time.value(),
-                                  duration.value(),
-                                  frames,
-                                  Move(buffer),
-                                  mOpusParser->mChannels,
-                                  mOpusParser->mRate));
+  mOutputMerger.Output(new AudioData(aSample->mOffset,
+                                     time.value(),
+                                     duration.value(),
+                                     frames,
+                                     Move(buffer),
+                                     mOpusParser->mChannels,
+                                     mOpusParser->mRate));
   mFrames += frames;
   return NS_OK;
 }
@@ -314,6 +325,7 @@ OpusDataDecoder::ProcessDrain()
 void
 OpusDataDecoder::Drain()
 {
+  mInputBatcher.Seal();
   mTaskQueue->Dispatch(NewRunnableMethod(this, &OpusDataDecoder::ProcessDrain));
 }
 
@@ -324,6 +336,7 @@ OpusDataDecoder::Flush()
     return;
   }
   mIsFlushing = true;
+  mInputBatcher.Clear();
   nsCOMPtr<nsIRunnable> runnable = NS_NewRunnableFunction([this] () {
     MOZ_ASSERT(mOpusDecoder);
     // Reset the decoder.
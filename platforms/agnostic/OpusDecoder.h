@@ -6,6 +6,7 @@
 #if !defined(OpusDecoder_h_)
 #define OpusDecoder_h_
 
+#include "DecodeBatching.h"
 #include "PlatformDecoderModule.h"
 
 #include "mozilla/Maybe.h"
@@ -46,13 +47,15 @@ public:
 private:
   nsresult DecodeHeader(const unsigned char* aData, size_t aLength);
 
-  void ProcessDecode(MediaRawData* aSample);
+  void ProcessDecode();
   MediaResult DoDecode(MediaRawData* aSample);
   void ProcessDrain();
 
   const AudioInfo& mInfo;
   const RefPtr<TaskQueue> mTaskQueue;
   MediaDataDecoderCallback* mCallback;
+  InputBatcher mInputBatcher;
+  AudioDataMerger mOutputMerger;
 
   // Opus decoder state
   nsAutoPtr<OpusParser> mOpusParser;
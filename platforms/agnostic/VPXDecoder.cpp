@@ -34,38 +34,6 @@ static int MimeTypeToCodec(const nsACString& aMimeType)
   return -1;
 }
 
-static nsresult
-InitContext(vpx_codec_ctx_t* aCtx,
-            const VideoInfo& aInfo,
-            const int aCodec)
-{
-  int decode_threads = 2;
-
-  vpx_codec_iface_t* dx = nullptr;
-  if (aCodec == VPXDecoder::Codec::VP8) {
-    dx = vpx_codec_vp8_dx();
-  }
-  else if (aCodec == VPXDecoder::Codec::VP9) {
-    dx = vpx_codec_vp9_dx();
-    if (aInfo.mDisplay.width >= 2048) {
-      decode_threads = 8;
-    }
-    else if (aInfo.mDisplay.width >= 1024) {
-      decode_threads = 4;
-    }
-  }
-  decode_threads = std::min(decode_threads, PR_GetNumberOfProcessors());
-
-  vpx_codec_dec_cfg_t config;
-  config.threads = decode_threads;
-  config.w = config.h = 0; // set after decode
-
-  if (!dx || vpx_codec_dec_init(aCtx, dx, &config, 0)) {
-    return NS_ERROR_FAILURE;
-  }
-  return NS_OK;
-}
-
 VPXDecoder::VPXDecoder(const CreateDecoderParams& aParams)
   : mImageContainer(aParams.mImageContainer)
   , mTaskQueue(aParams.mTaskQueue)
@@ -73,6 +41,7 @@ VPXDecoder::VPXDecoder(const CreateDecoderParams& aParams)
   , mIsFlushing(false)
   , mInfo(aParams.VideoConfig())
   , mCodec(MimeTypeToCodec(aParams.VideoConfig().mMimeType))
+  , mDecodeThreads(0)
 {
   MOZ_COUNT_CTOR(VPXDecoder);
   PodZero(&mVPX);
@@ -93,12 +62,14 @@ VPXDecoder::Shutdown()
 RefPtr<MediaDataDecoder::InitPromise>
 VPXDecoder::Init()
 {
-  if (NS_FAILED(InitContext(&mVPX, mInfo, mCodec))) {
+  mDecodeThreads =
+    DecodeThreads(mCodec, mInfo.mDisplay.width, mInfo.mDisplay.height);
+  if (NS_FAILED(InitContext(&mVPX, mCodec, mDecodeThreads))) {
     return VPXDecoder::InitPromise::CreateAndReject(NS_ERROR_DOM_MEDIA_FATAL_ERR,
                                                     __func__);
   }
   if (mInfo.HasAlpha()) {
-    if (NS_FAILED(InitContext(&mVPXAlpha, mInfo, mCodec))) {
+    if (NS_FAILED(InitContext(&mVPXAlpha, mCodec, mDecodeThreads))) {
       return VPXDecoder::InitPromise::CreateAndReject(NS_ERROR_DOM_MEDIA_FATAL_ERR,
                                                       __func__);
     }
@@ -136,6 +107,11 @@ VPXDecoder::DoDecode(MediaRawData* aSample)
                "VPX Decode Keyframe error sample->mKeyframe and si.si_kf out of sync");
 #endif
 
+  MediaResult rv = MaybeResizeThreads(aSample);
+  if (NS_FAILED(rv)) {
+    return rv;
+  }
+
   if (vpx_codec_err_t r = vpx_codec_decode(&mVPX, aSample->Data(), aSample->Size(), nullptr, 0)) {
     LOG("VPX Decode error: %s", vpx_codec_err_to_string(r));
     return MediaResult(
@@ -279,6 +255,48 @@ VPXDecoder::Drain()
   mTaskQueue->Dispatch(NewRunnableMethod(this, &VPXDecoder::ProcessDrain));
 }
 
+MediaResult
+VPXDecoder::MaybeResizeThreads(MediaRawData* aSample)
+{
+  MOZ_ASSERT(mTaskQueue->IsCurrentThreadIn());
+  // Frames may only change size at a keyframe without referencing previous
+  // frames, so that's when the contexts can be replaced without losing state.
+  if (mCodec != Codec::VP9 || !aSample->mKeyframe) {
+    return NS_OK;
+  }
+  vpx_codec_stream_info_t si;
+  PodZero(&si);
+  si.sz = sizeof(si);
+  if (vpx_codec_peek_stream_info(vpx_codec_vp9_dx(), aSample->Data(),
+                                 aSample->Size(), &si) ||
+      !si.w || !si.h) {
+    // Let vpx_codec_decode() report the error, if any.
+    return NS_OK;
+  }
+  int threads = DecodeThreads(mCodec, si.w, si.h);
+  if (threads == mDecodeThreads) {
+    return NS_OK;
+  }
+  LOG("Frame size now %ux%u, using %d threads instead of %d",
+      si.w, si.h, threads, mDecodeThreads);
+  vpx_codec_destroy(&mVPX);
+  PodZero(&mVPX);
+  if (NS_FAILED(InitContext(&mVPX, mCodec, threads))) {
+    return MediaResult(NS_ERROR_DOM_MEDIA_FATAL_ERR,
+                       RESULT_DETAIL("Couldn't re-create VPX context"));
+  }
+  if (mInfo.HasAlpha()) {
+    vpx_codec_destroy(&mVPXAlpha);
+    PodZero(&mVPXAlpha);
+    if (NS_FAILED(InitContext(&mVPXAlpha, mCodec, threads))) {
+      return MediaResult(NS_ERROR_DOM_MEDIA_FATAL_ERR,
+                         RESULT_DETAIL("Couldn't re-create VPX alpha context"));
+    }
+  }
+  mDecodeThreads = threads;
+  return NS_OK;
+}
+
 MediaResult
 VPXDecoder::DecodeAlpha(vpx_image_t** aImgAlpha,
                         MediaRawData* aSample)
@@ -305,6 +323,66 @@ VPXDecoder::DecodeAlpha(vpx_image_t** aImgAlpha,
   return NS_OK;
 }
 
+/* static */
+int
+VPXDecoder::DecodeThreads(int aCodec, int32_t aWidth, int32_t aHeight)
+{
+  int threads = 2;
+  if (aCodec == Codec::VP9) {
+    // With row based multithreading, VP9 scales with the number of
+    // superblock rows rather than tile columns, so go by the frame area.
+    int64_t pixels = int64_t(aWidth) * aHeight;
+    if (pixels >= 2560 * 1440) {
+      threads = 8;
+    } else if (pixels >= 1280 * 720) {
+      threads = 4;
+    }
+    // Never fewer than the tile column based count used before, which wide
+    // but short frames still benefit from.
+    int32_t size = std::max(aWidth, aHeight);
+    if (size >= 2048) {
+      threads = std::max(threads, 8);
+    } else if (size >= 1024) {
+      threads = std::max(threads, 4);
+    }
+  }
+  return std::max(1, std::min(threads, PR_GetNumberOfProcessors()));
+}
+
+/* static */
+nsresult
+VPXDecoder::InitContext(vpx_codec_ctx_t* aCtx, int aCodec, int aThreads)
+{
+  vpx_codec_iface_t* dx = nullptr;
+  if (aCodec == Codec::VP8) {
+    dx = vpx_codec_vp8_dx();
+  } else if (aCodec == Codec::VP9) {
+    dx = vpx_codec_vp9_dx();
+  }
+
+  vpx_codec_dec_cfg_t config;
+  config.threads = aThreads;
+  config.w = config.h = 0; // set after decode
+
+  if (!dx || vpx_codec_dec_init(aCtx, dx, &config, 0)) {
+    return NS_ERROR_FAILURE;
+  }
+
+  if (aCodec == Codec::VP9) {
+    // These controls only exist in recent libvpx; failing to set them just
+    // leaves the default, tile based, threading in place.
+#ifdef VPX_CTRL_VP9D_SET_ROW_MT
+    if (aThreads > 1) {
+      vpx_codec_control(aCtx, VP9D_SET_ROW_MT, 1);
+    }
+#endif
+#ifdef VPX_CTRL_VP9D_SET_LOOP_FILTER_OPT
+    vpx_codec_control(aCtx, VP9D_SET_LOOP_FILTER_OPT, 1);
+#endif
+  }
+  return NS_OK;
+}
+
 /* static */
 bool
 VPXDecoder::IsVPX(const nsACString& aMimeType, uint8_t aCodecMask)
@@ -46,9 +46,21 @@ public:
   static bool IsVP8(const nsACString& aMimeType);
   static bool IsVP9(const nsACString& aMimeType);
 
+  // Number of threads to decode aCodec frames of the given size with, bounded
+  // by the number of processors.
+  static int DecodeThreads(int aCodec, int32_t aWidth, int32_t aHeight);
+
+  // Initialises aCtx to decode aCodec with aThreads threads. For VP9 this
+  // also enables row based multithreading when libvpx supports it, so that
+  // streams encoded with few tile columns can still use all the threads.
+  static nsresult InitContext(vpx_codec_ctx_t* aCtx, int aCodec, int aThreads);
+
 private:
   void ProcessDecode(MediaRawData* aSample);
   MediaResult DoDecode(MediaRawData* aSample);
+  // libvpx can't change the thread count of a context, so re-create the
+  // contexts at a VP9 keyframe whose size calls for another thread count.
+  MediaResult MaybeResizeThreads(MediaRawData* aSample);
   void ProcessDrain();
   MediaResult DecodeAlpha(vpx_image_t** aImgAlpha,
                           MediaRawData* aSample);
@@ -67,6 +79,10 @@ private:
   const VideoInfo& mInfo;
 
   const int mCodec;
+
+  // Threads the contexts were created with. Only used on mTaskQueue once
+  // Init() has completed.
+  int mDecodeThreads;
 };
 
 } // namespace mozilla
@@ -34,6 +34,7 @@ VorbisDataDecoder::VorbisDataDecoder(const CreateDecoderParams& aParams)
   : mInfo(aParams.AudioConfig())
   , mTaskQueue(aParams.mTaskQueue)
   , mCallback(aParams.mCallback)
+  , mOutputMerger(aParams.mCallback)
   , mPacketCount(0)
   , mFrames(0)
   , mIsFlushing(false)
@@ -126,24 +127,34 @@ void
 VorbisDataDecoder::Input(MediaRawData* aSample)
 {
   MOZ_ASSERT(mCallback->OnReaderTaskQueue());
-  mTaskQueue->Dispatch(NewRunnableMethod<RefPtr<MediaRawData>>(
-                       this, &VorbisDataDecoder::ProcessDecode, aSample));
+  if (mInputBatcher.Push(aSample)) {
+    mTaskQueue->Dispatch(NewRunnableMethod(this,
+                                           &VorbisDataDecoder::ProcessDecode));
+  }
 }
 
 void
-VorbisDataDecoder::ProcessDecode(MediaRawData* aSample)
+VorbisDataDecoder::ProcessDecode()
 {
   MOZ_ASSERT(mTaskQueue->IsCurrentThreadIn());
-  if (mIsFlushing) {
-    return;
+  nsTArray<RefPtr<MediaRawData>> samples = mInputBatcher.TakeBatch();
+  for (const auto& sample : samples) {
+    if (mIsFlushing) {
+      mOutputMerger.Reset();
+      return;
+    }
+    MediaResult rv = DoDecode(sample);
+    if (NS_FAILED(rv)) {
+      mOutputMerger.OutputPending();
+      mCallback->Error(rv);
+      return;
+    }
   }
-
-  MediaResult rv = DoDecode(aSample);
-  if (NS_FAILED(rv)) {
-    mCallback->Error(rv);
-  } else {
-    mCallback->InputExhausted();
+  if (samples.IsEmpty()) {
+    return;
   }
+  mOutputMerger.OutputPending();
+  mCallback->InputExhausted();
 }
 
 MediaResult
@@ -234,13 +245,13 @@ VorbisDataDecoder::DoDecode(MediaRawData* aSample)
     data = mAudioConverter->Process(Move(data));
 
     aTotalFrames += frames;
-    mCallback->Output(new AudioData(aOffset,
-                                    time.value(),
-                                    duration.value(),
-                                    frames,
-                                    data.Forget(),
-                                    channels,
-                                    rate));
+    mOutputMerger.Output(new AudioData(aOffset,
+                                       time.value(),
+                                       duration.value(),
+                                       frames,
+                                       data.Forget(),
+                                       channels,
+                                       rate));
     mFrames += frames;
     err = vorbis_synthesis_read(&mVorbisDsp, frames);
     if (err) {
@@ -265,6 +276,7 @@ void
 VorbisDataDecoder::Drain()
 {
   MOZ_ASSERT(mCallback->OnReaderTaskQueue());
+  mInputBatcher.Seal();
   mTaskQueue->Dispatch(NewRunnableMethod(this, &VorbisDataDecoder::ProcessDrain));
 }
 
@@ -273,6 +285,7 @@ VorbisDataDecoder::Flush()
 {
   MOZ_ASSERT(mCallback->OnReaderTaskQueue());
   mIsFlushing = true;
+  mInputBatcher.Clear();
   nsCOMPtr<nsIRunnable> r = NS_NewRunnableFunction([this] () {
     // Ignore failed results from vorbis_synthesis_restart. They
     // aren't fatal and it fails when ResetDecode is called at a
@@ -6,6 +6,7 @@
 #if !defined(VorbisDecoder_h_)
 #define VorbisDecoder_h_
 
+#include "DecodeBatching.h"
 #include "PlatformDecoderModule.h"
 #include "mozilla/Maybe.h"
 #include "AudioConverter.h"
@@ -41,13 +42,15 @@ public:
 private:
   nsresult DecodeHeader(const unsigned char* aData, size_t aLength);
 
-  void ProcessDecode(MediaRawData* aSample);
+  void ProcessDecode();
   MediaResult DoDecode(MediaRawData* aSample);
   void ProcessDrain();
 
   const AudioInfo& mInfo;
   const RefPtr<TaskQueue> mTaskQueue;
   MediaDataDecoderCallback* mCallback;
+  InputBatcher mInputBatcher;
+  AudioDataMerger mOutputMerger;
 
   // Vorbis decoder state
   vorbis_info mVorbisInfo;
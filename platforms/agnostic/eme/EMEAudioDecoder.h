@@ -28,6 +28,9 @@ public:
 private:
   void InitTags(nsTArray<nsCString>& aTags) override;
   nsCString GetNodeId() override;
+  // The CDM's sessions and keys die with its process; only the page can
+  // establish them again.
+  bool CanRestart() const override { return false; }
 
   RefPtr<CDMProxy> mProxy;
 };
@@ -55,6 +55,14 @@ public:
       return;
     }
 
+    if (!aSample->mCrypto.mValid && !mDecrypts.Count()) {
+      // Clear samples, such as an unencrypted lead-in, skip the round trip
+      // through the CDM unless that would let them overtake samples still
+      // being decrypted.
+      mDecoder->Input(aSample);
+      return;
+    }
+
     nsAutoPtr<MediaRawDataWriter> writer(aSample->CreateWriter());
     mProxy->GetSessionIdsForKeyId(aSample->mCrypto.mKeyId,
                                   writer->mCrypto.mSessionIds);
@@ -222,7 +230,8 @@ CreateDecoderWrapper(MediaDataDecoderCallback* aCallback, CDMProxy* aProxy, Task
   if (!s) {
     return nullptr;
   }
-  RefPtr<AbstractThread> thread(s->GetAbstractGMPThread());
+  // The decoder must share the GMP actor thread of the CDM's decryptor.
+  RefPtr<AbstractThread> thread(s->GetAbstractShardThread(aProxy->GetNodeId()));
   if (!thread) {
     return nullptr;
   }
@@ -231,6 +240,14 @@ CreateDecoderWrapper(MediaDataDecoderCallback* aCallback, CDMProxy* aProxy, Task
   return decoder.forget();
 }
 
+bool
+EMEDecoderModule::CreatesWrappingDecoder(const TrackInfo& aConfig) const
+{
+  // EMEDecryptor wraps a decoder from mPDM, which has already added the
+  // H264Converter and other wrappers around it.
+  return !SupportsMimeType(aConfig.mMimeType, nullptr);
+}
+
 already_AddRefed<MediaDataDecoder>
 EMEDecoderModule::CreateVideoDecoder(const CreateDecoderParams& aParams)
 {
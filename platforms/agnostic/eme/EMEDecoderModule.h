@@ -35,6 +35,10 @@ protected:
   ConversionRequired
   DecoderNeedsConversion(const TrackInfo& aConfig) const override;
 
+  // True if the CDM only decrypts, in which case the decoder comes from mPDM.
+  bool
+  CreatesWrappingDecoder(const TrackInfo& aConfig) const override;
+
   bool
   SupportsMimeType(const nsACString& aMimeType,
                    DecoderDoctorDiagnostics* aDiagnostics) const override;
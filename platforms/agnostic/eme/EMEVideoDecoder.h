@@ -34,6 +34,9 @@ private:
   void InitTags(nsTArray<nsCString>& aTags) override;
   nsCString GetNodeId() override;
   uint32_t DecryptorId() const override { return mDecryptorId; }
+  // The CDM's sessions and keys die with its process; only the page can
+  // establish them again.
+  bool CanRestart() const override { return false; }
   GMPUniquePtr<GMPVideoEncodedFrame> CreateFrame(MediaRawData* aSample) override;
 
   RefPtr<CDMProxy> mProxy;
@@ -15,13 +15,12 @@ namespace mozilla {
 #if defined(DEBUG)
 bool IsOnGMPThread()
 {
-  nsCOMPtr<mozIGeckoMediaPluginService> mps = do_GetService("@mozilla.org/gecko-media-plugin-service;1");
-  MOZ_ASSERT(mps);
-
-  nsCOMPtr<nsIThread> gmpThread;
-  nsresult rv = mps->GetThread(getter_AddRefs(gmpThread));
-  MOZ_ASSERT(NS_SUCCEEDED(rv) && gmpThread);
-  return NS_GetCurrentThread() == gmpThread;
+  RefPtr<gmp::GeckoMediaPluginService> service =
+    gmp::GeckoMediaPluginService::GetGeckoMediaPluginService();
+  MOZ_ASSERT(service);
+  // The actors assert they're on their own shard; we just check we're on
+  // one of them.
+  return service && service->IsOnActorThread();
 }
 #endif
 
@@ -136,6 +135,16 @@ AudioCallbackAdapter::Terminated()
                                RESULT_DETAIL("Audio GMP decoder terminated.")));
 }
 
+void
+AudioCallbackAdapter::Crashed()
+{
+  if (mDecoder && mDecoder->Restart()) {
+    return;
+  }
+  mCallback->Error(MediaResult(NS_ERROR_DOM_MEDIA_FATAL_ERR,
+                               RESULT_DETAIL("Audio GMP decoder terminated.")));
+}
+
 GMPAudioDecoderParams::GMPAudioDecoderParams(const CreateDecoderParams& aParams)
   : mConfig(aParams.AudioConfig())
   , mTaskQueue(aParams.mTaskQueue)
@@ -170,11 +179,15 @@ GMPAudioDecoder::GMPAudioDecoder(const GMPAudioDecoderParams& aParams)
   , mGMP(nullptr)
   , mAdapter(aParams.mAdapter)
   , mCrashHelper(aParams.mCrashHelper)
+  , mRestarts(0)
+  , mRestarting(false)
+  , mDrainAfterRestart(false)
 {
   MOZ_ASSERT(!mAdapter || mCallback == mAdapter->Callback());
   if (!mAdapter) {
     mAdapter = new AudioCallbackAdapter(mCallback);
   }
+  mAdapter->SetDecoder(this);
 }
 
 void
@@ -200,10 +213,10 @@ GMPAudioDecoder::GMPInitDone(GMPAudioDecoderProxy* aGMP)
   MOZ_ASSERT(IsOnGMPThread());
 
   if (!aGMP) {
-    mInitPromise.RejectIfExists(NS_ERROR_DOM_MEDIA_FATAL_ERR, __func__);
+    InitFailed();
     return;
   }
-  if (mInitPromise.IsEmpty()) {
+  if (mInitPromise.IsEmpty() && !mRestarting) {
     // GMP must have been shutdown while we were waiting for Init operation
     // to complete.
     aGMP->Close();
@@ -221,12 +234,67 @@ GMPAudioDecoder::GMPInitDone(GMPAudioDecoderProxy* aGMP)
                                  mAdapter);
   if (NS_FAILED(rv)) {
     aGMP->Close();
-    mInitPromise.Reject(NS_ERROR_DOM_MEDIA_FATAL_ERR, __func__);
+    InitFailed();
     return;
   }
 
   mGMP = aGMP;
-  mInitPromise.Resolve(TrackInfo::kAudioTrack, __func__);
+  if (!mRestarting) {
+    mInitPromise.Resolve(TrackInfo::kAudioTrack, __func__);
+    return;
+  }
+
+  mRestarting = false;
+  nsTArray<RefPtr<MediaRawData>> samples;
+  samples.SwapElements(mPendingSamples);
+  for (const auto& sample : samples) {
+    Decode(sample);
+  }
+  if (mDrainAfterRestart) {
+    mDrainAfterRestart = false;
+    Drain();
+  }
+}
+
+void
+GMPAudioDecoder::InitFailed()
+{
+  if (mRestarting) {
+    mRestarting = false;
+    mPendingSamples.Clear();
+    mCallback->Error(MediaResult(NS_ERROR_DOM_MEDIA_FATAL_ERR,
+                                 RESULT_DETAIL("Couldn't restart audio GMP decoder")));
+    return;
+  }
+  mInitPromise.RejectIfExists(NS_ERROR_DOM_MEDIA_FATAL_ERR, __func__);
+}
+
+bool
+GMPAudioDecoder::Restart()
+{
+  MOZ_ASSERT(IsOnGMPThread());
+
+  if (!mGMP || !CanRestart() || mRestarts >= kMaxRestarts) {
+    return false;
+  }
+  mRestarts++;
+
+  // The actor is dead already; closing it releases our reference.
+  mGMP->Close();
+  mGMP = nullptr;
+
+  // The service reuses a running plugin process if there is one, and
+  // launches a new one otherwise.
+  nsTArray<nsCString> tags;
+  InitTags(tags);
+  UniquePtr<GetGMPAudioDecoderCallback> callback(new GMPInitDoneCallback(this));
+  if (NS_FAILED(mMPS->GetGMPAudioDecoder(mCrashHelper, &tags, GetNodeId(), Move(callback)))) {
+    return false;
+  }
+
+  mRestarting = true;
+  mAdapter->RecaptureAudioPosition();
+  return true;
 }
 
 RefPtr<MediaDataDecoder::InitPromise>
@@ -255,12 +323,23 @@ GMPAudioDecoder::Input(MediaRawData* aSample)
   MOZ_ASSERT(IsOnGMPThread());
 
   RefPtr<MediaRawData> sample(aSample);
+  if (mRestarting) {
+    mPendingSamples.AppendElement(sample);
+    return;
+  }
   if (!mGMP) {
     mCallback->Error(MediaResult(NS_ERROR_DOM_MEDIA_FATAL_ERR,
                                  RESULT_DETAIL("mGMP not initialized")));
     return;
   }
 
+  Decode(sample);
+}
+
+void
+GMPAudioDecoder::Decode(MediaRawData* aSample)
+{
+  RefPtr<MediaRawData> sample(aSample);
   mAdapter->SetLastStreamOffset(sample->mOffset);
 
   gmp::GMPAudioSamplesImpl samples(sample, mConfig.mChannels, mConfig.mRate);
@@ -275,6 +354,9 @@ GMPAudioDecoder::Flush()
 {
   MOZ_ASSERT(IsOnGMPThread());
 
+  mPendingSamples.Clear();
+  mDrainAfterRestart = false;
+
   if (!mGMP || NS_FAILED(mGMP->Reset())) {
     // Abort the flush.
     mCallback->FlushComplete();
@@ -286,6 +368,10 @@ GMPAudioDecoder::Drain()
 {
   MOZ_ASSERT(IsOnGMPThread());
 
+  if (mRestarting) {
+    mDrainAfterRestart = true;
+    return;
+  }
   if (!mGMP || NS_FAILED(mGMP->Drain())) {
     mCallback->DrainComplete();
   }
@@ -295,6 +381,9 @@ void
 GMPAudioDecoder::Shutdown()
 {
   mInitPromise.RejectIfExists(NS_ERROR_DOM_MEDIA_CANCELED, __func__);
+  // A GMP arriving after this is closed by GMPInitDone().
+  mRestarting = false;
+  mPendingSamples.Clear();
   if (!mGMP) {
     return;
   }
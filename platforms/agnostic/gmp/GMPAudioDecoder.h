@@ -15,10 +15,13 @@
 
 namespace mozilla {
 
+class GMPAudioDecoder;
+
 class AudioCallbackAdapter : public GMPAudioDecoderCallbackProxy {
 public:
   explicit AudioCallbackAdapter(MediaDataDecoderCallbackProxy* aCallback)
    : mCallback(aCallback)
+   , mDecoder(nullptr)
    , mLastStreamOffset(0)
    , mAudioFrameSum(0)
    , mAudioFrameOffset(0)
@@ -27,6 +30,9 @@ public:
 
   MediaDataDecoderCallbackProxy* Callback() const { return mCallback; }
 
+  // The decoder to restart if the GMP terminates.
+  void SetDecoder(GMPAudioDecoder* aDecoder) { mDecoder = aDecoder; }
+
   // GMPAudioDecoderCallbackProxy
   void Decoded(const nsTArray<int16_t>& aPCM, uint64_t aTimeStamp, uint32_t aChannels, uint32_t aRate) override;
   void InputDataExhausted() override;
@@ -34,13 +40,18 @@ public:
   void ResetComplete() override;
   void Error(GMPErr aErr) override;
   void Terminated() override;
+  void Crashed() override;
 
   void SetLastStreamOffset(int64_t aStreamOffset) {
     mLastStreamOffset = aStreamOffset;
   }
 
+  // A restarted GMP numbers its output from the next sample's timestamp.
+  void RecaptureAudioPosition() { mMustRecaptureAudioPosition = true; }
+
 private:
   MediaDataDecoderCallbackProxy* mCallback;
+  GMPAudioDecoder* mDecoder;
   int64_t mLastStreamOffset;
 
   int64_t mAudioFrameSum;
@@ -74,9 +85,17 @@ public:
     return "GMP audio decoder";
   }
 
+  // Called when the GMP terminated unexpectedly, e.g. because its process
+  // crashed. Relaunches it and continues with the following samples; the
+  // ones being decoded at the time are lost. Returns false if the decoder
+  // can't be restarted and the error should be reported.
+  bool Restart();
+
 protected:
   virtual void InitTags(nsTArray<nsCString>& aTags);
   virtual nsCString GetNodeId();
+  // Whether the GMP can be relaunched without losing state held by it.
+  virtual bool CanRestart() const { return true; }
 
 private:
 
@@ -97,6 +116,12 @@ private:
     RefPtr<GMPAudioDecoder> mDecoder;
   };
   void GMPInitDone(GMPAudioDecoderProxy* aGMP);
+  void InitFailed();
+  void Decode(MediaRawData* aSample);
+
+  // Restarts per decoder, so that a plugin crashing on some content doesn't
+  // get relaunched forever.
+  static const uint32_t kMaxRestarts = 3;
 
   const AudioInfo mConfig;
   MediaDataDecoderCallbackProxy* mCallback;
@@ -105,6 +130,12 @@ private:
   nsAutoPtr<AudioCallbackAdapter> mAdapter;
   MozPromiseHolder<InitPromise> mInitPromise;
   RefPtr<GMPCrashHelper> mCrashHelper;
+
+  // Samples given while the GMP restarts.
+  nsTArray<RefPtr<MediaRawData>> mPendingSamples;
+  uint32_t mRestarts;
+  bool mRestarting;
+  bool mDrainAfterRestart;
 };
 
 } // namespace mozilla
@@ -40,7 +40,7 @@ CreateDecoderWrapper(MediaDataDecoderCallback* aCallback)
   if (!s) {
     return nullptr;
   }
-  RefPtr<AbstractThread> thread(s->GetAbstractGMPThread());
+  RefPtr<AbstractThread> thread(s->GetAbstractShardThread(SHARED_GMP_DECODING_NODE_ID));
   if (!thread) {
     return nullptr;
   }
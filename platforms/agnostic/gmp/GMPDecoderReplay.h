@@ -0,0 +1,94 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* vim:set ts=2 sw=2 sts=2 et cindent: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#if !defined(GMPDecoderReplay_h_)
+#define GMPDecoderReplay_h_
+
+#include <algorithm>
+#include <stdint.h>
+#include "MediaData.h"
+#include "nsTArray.h"
+
+namespace mozilla {
+
+// The samples a restarted video GMP is fed again so that it can carry on
+// where the previous one stopped: those since the last keyframe, as long as
+// there are no more than aMaxLength of them.
+class GMPReplaySamples {
+public:
+  explicit GMPReplaySamples(size_t aMaxLength)
+    : mMaxLength(aMaxLength)
+    , mReplayable(false)
+  {}
+
+  // Keeps aSample if the samples since the last keyframe can be replayed.
+  // While aRestarting, the samples are all needed by the restarting GMP and
+  // are kept past the limit.
+  void Append(MediaRawData* aSample, bool aRestarting)
+  {
+    if (aSample->mKeyframe) {
+      mSamples.Clear();
+      mReplayable = true;
+    }
+    if (!mReplayable) {
+      return;
+    }
+    if (mSamples.Length() >= mMaxLength && !aRestarting) {
+      Clear();
+      return;
+    }
+    mSamples.AppendElement(aSample);
+  }
+
+  // Forgets the samples; they can be kept again from the next keyframe.
+  void Clear()
+  {
+    mSamples.Clear();
+    mReplayable = false;
+  }
+
+  // Whether Samples() holds everything since the last keyframe.
+  bool IsReplayable() const { return mReplayable; }
+  const nsTArray<RefPtr<MediaRawData>>& Samples() const { return mSamples; }
+
+private:
+  const size_t mMaxLength;
+  nsTArray<RefPtr<MediaRawData>> mSamples;
+  bool mReplayable;
+};
+
+// Frames output before a GMP restart are decoded again from the last
+// keyframe; this tells which ones to drop rather than output twice.
+class GMPOutputSkipper {
+public:
+  GMPOutputSkipper()
+    : mLastOutputTime(INT64_MIN)
+    , mSkipUntil(INT64_MIN)
+  {}
+
+  bool ShouldOutput(int64_t aTime) const { return aTime > mSkipUntil; }
+  void NotifyOutput(int64_t aTime)
+  {
+    mLastOutputTime = std::max(mLastOutputTime, aTime);
+  }
+
+  // The GMP restarted: skip frames up to the last one output.
+  void Restarted() { mSkipUntil = mLastOutputTime; }
+  // Decoding restarts elsewhere in the stream, e.g. after a seek.
+  void Reset()
+  {
+    mLastOutputTime = INT64_MIN;
+    mSkipUntil = INT64_MIN;
+  }
+
+private:
+  int64_t mLastOutputTime;
+  int64_t mSkipUntil;
+};
+
+} // namespace mozilla
+
+#endif // GMPDecoderReplay_h_
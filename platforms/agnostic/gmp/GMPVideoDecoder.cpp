@@ -12,6 +12,8 @@
 #include "GMPDecoderModule.h"
 #include "VPXDecoder.h"
 
+#include <algorithm>
+
 namespace mozilla {
 
 #if defined(DEBUG)
@@ -25,6 +27,11 @@ VideoCallbackAdapter::Decoded(GMPVideoi420Frame* aDecodedFrame)
 
   MOZ_ASSERT(IsOnGMPThread());
 
+  int64_t time = decodedFrame->Timestamp();
+  if (!mSkipper.ShouldOutput(time)) {
+    return;
+  }
+
   VideoData::YCbCrBuffer b;
   for (int i = 0; i < kGMPNumOfPlanes; ++i) {
     b.mPlanes[i].mData = decodedFrame->Buffer(GMPPlaneType(i));
@@ -52,6 +59,7 @@ VideoCallbackAdapter::Decoded(GMPVideoi420Frame* aDecodedFrame)
                                  -1,
                                  pictureRegion);
   if (v) {
+    mSkipper.NotifyOutput(time);
     mCallback->Output(v);
   } else {
     mCallback->Error(MediaResult(NS_ERROR_OUT_OF_MEMORY, __func__));
@@ -109,6 +117,17 @@ VideoCallbackAdapter::Terminated()
                                RESULT_DETAIL("Video GMP decoder terminated.")));
 }
 
+void
+VideoCallbackAdapter::Crashed()
+{
+  // Note that this *may* be called from the proxy thread also.
+  if (mDecoder && mDecoder->Restart()) {
+    return;
+  }
+  mCallback->Error(MediaResult(NS_ERROR_DOM_MEDIA_FATAL_ERR,
+                               RESULT_DETAIL("Video GMP decoder terminated.")));
+}
+
 GMPVideoDecoderParams::GMPVideoDecoderParams(const CreateDecoderParams& aParams)
   : mConfig(aParams.VideoConfig())
   , mTaskQueue(aParams.mTaskQueue)
@@ -147,6 +166,11 @@ GMPVideoDecoder::GMPVideoDecoder(const GMPVideoDecoderParams& aParams)
   , mAdapter(aParams.mAdapter)
   , mConvertNALUnitLengths(false)
   , mCrashHelper(aParams.mCrashHelper)
+  , mReplaySamples(kMaxReplaySamples)
+  , mRestarts(0)
+  , mRestarting(false)
+  , mDrainAfterRestart(false)
+  , mWaitForKeyframe(false)
 {
   MOZ_ASSERT(!mAdapter || mCallback == mAdapter->Callback());
   if (!mAdapter) {
@@ -155,6 +179,7 @@ GMPVideoDecoder::GMPVideoDecoder(const GMPVideoDecoderParams& aParams)
                                                   mConfig.mDisplay.height),
                                         aParams.mImageContainer);
   }
+  mAdapter->SetDecoder(this);
 }
 
 void
@@ -237,12 +262,12 @@ GMPVideoDecoder::GMPInitDone(GMPVideoDecoderProxy* aGMP, GMPVideoHost* aHost)
   MOZ_ASSERT(IsOnGMPThread());
 
   if (!aGMP) {
-    mInitPromise.RejectIfExists(NS_ERROR_DOM_MEDIA_FATAL_ERR, __func__);
+    InitFailed();
     return;
   }
   MOZ_ASSERT(aHost);
 
-  if (mInitPromise.IsEmpty()) {
+  if (mInitPromise.IsEmpty() && !mRestarting) {
     // GMP must have been shutdown while we were waiting for Init operation
     // to complete.
     aGMP->Close();
@@ -266,7 +291,7 @@ GMPVideoDecoder::GMPInitDone(GMPVideoDecoderProxy* aGMP, GMPVideoHost* aHost)
   } else {
     // Unrecognized mime type
     aGMP->Close();
-    mInitPromise.Reject(NS_ERROR_DOM_MEDIA_FATAL_ERR, __func__);
+    InitFailed();
     return;
   }
   codec.mWidth = mConfig.mImage.width;
@@ -278,7 +303,7 @@ GMPVideoDecoder::GMPInitDone(GMPVideoDecoderProxy* aGMP, GMPVideoHost* aHost)
                                  PR_GetNumberOfProcessors());
   if (NS_FAILED(rv)) {
     aGMP->Close();
-    mInitPromise.Reject(NS_ERROR_DOM_MEDIA_FATAL_ERR, __func__);
+    InitFailed();
     return;
   }
 
@@ -295,7 +320,71 @@ GMPVideoDecoder::GMPInitDone(GMPVideoDecoderProxy* aGMP, GMPVideoHost* aHost)
   // and do not include the length of the buffer length field.
   mConvertNALUnitLengths = mGMP->GetDisplayName().EqualsLiteral("gmpopenh264");
 
-  mInitPromise.Resolve(TrackInfo::kVideoTrack, __func__);
+  if (!mRestarting) {
+    mInitPromise.Resolve(TrackInfo::kVideoTrack, __func__);
+    return;
+  }
+
+  mRestarting = false;
+  nsTArray<RefPtr<MediaRawData>> samples(mReplaySamples.Samples());
+  for (const auto& sample : samples) {
+    Decode(sample);
+  }
+  if (mDrainAfterRestart) {
+    mDrainAfterRestart = false;
+    Drain();
+  }
+}
+
+void
+GMPVideoDecoder::InitFailed()
+{
+  if (mRestarting) {
+    mRestarting = false;
+    mCallback->Error(MediaResult(NS_ERROR_DOM_MEDIA_FATAL_ERR,
+                                 RESULT_DETAIL("Couldn't restart video GMP decoder")));
+    return;
+  }
+  mInitPromise.RejectIfExists(NS_ERROR_DOM_MEDIA_FATAL_ERR, __func__);
+}
+
+bool
+GMPVideoDecoder::Restart()
+{
+  MOZ_ASSERT(IsOnGMPThread());
+
+  if (!mGMP || !CanRestart() || mRestarts >= kMaxRestarts) {
+    return false;
+  }
+  mRestarts++;
+
+  // The actor is dead already; closing it releases our reference.
+  mGMP->Close();
+  mGMP = nullptr;
+  mHost = nullptr;
+
+  // The service reuses a running plugin process if there is one, and
+  // launches a new one otherwise.
+  nsTArray<nsCString> tags;
+  InitTags(tags);
+  UniquePtr<GetGMPVideoDecoderCallback> callback(new GMPInitDoneCallback(this));
+  if (NS_FAILED(mMPS->GetDecryptingGMPVideoDecoder(mCrashHelper,
+                                                   &tags,
+                                                   GetNodeId(),
+                                                   Move(callback),
+                                                   DecryptorId()))) {
+    return false;
+  }
+
+  mRestarting = true;
+  mAdapter->SkipOutputFramesAgain();
+  if (!mReplaySamples.IsReplayable()) {
+    // The samples since the last keyframe weren't kept; the new GMP can only
+    // start decoding at the next one.
+    mReplaySamples.Clear();
+    mWaitForKeyframe = true;
+  }
+  return true;
 }
 
 RefPtr<MediaDataDecoder::InitPromise>
@@ -328,12 +417,34 @@ GMPVideoDecoder::Input(MediaRawData* aSample)
   MOZ_ASSERT(IsOnGMPThread());
 
   RefPtr<MediaRawData> sample(aSample);
+  if (mWaitForKeyframe) {
+    if (!sample->mKeyframe) {
+      // Can't be decoded by a GMP restarted since the last keyframe.
+      mCallback->InputExhausted();
+      return;
+    }
+    mWaitForKeyframe = false;
+  }
+  if (CanRestart()) {
+    mReplaySamples.Append(sample, mRestarting);
+  }
+  if (mRestarting) {
+    // Decoded along with the replayed samples once the GMP is back.
+    return;
+  }
   if (!mGMP) {
     mCallback->Error(MediaResult(NS_ERROR_DOM_MEDIA_FATAL_ERR,
                                  RESULT_DETAIL("mGMP not initialized")));
     return;
   }
 
+  Decode(sample);
+}
+
+void
+GMPVideoDecoder::Decode(MediaRawData* aSample)
+{
+  RefPtr<MediaRawData> sample(aSample);
   mAdapter->SetLastStreamOffset(sample->mOffset);
 
   GMPUniquePtr<GMPVideoEncodedFrame> frame = CreateFrame(sample);
@@ -355,6 +466,11 @@ GMPVideoDecoder::Flush()
 {
   MOZ_ASSERT(IsOnGMPThread());
 
+  // Decoding restarts at a keyframe, possibly earlier in the stream.
+  mReplaySamples.Clear();
+  mDrainAfterRestart = false;
+  mAdapter->ResetOutputTimes();
+
   if (!mGMP || NS_FAILED(mGMP->Reset())) {
     // Abort the flush.
     mCallback->FlushComplete();
@@ -366,6 +482,10 @@ GMPVideoDecoder::Drain()
 {
   MOZ_ASSERT(IsOnGMPThread());
 
+  if (mRestarting) {
+    mDrainAfterRestart = true;
+    return;
+  }
   if (!mGMP || NS_FAILED(mGMP->Drain())) {
     mCallback->DrainComplete();
   }
@@ -375,6 +495,9 @@ void
 GMPVideoDecoder::Shutdown()
 {
   mInitPromise.RejectIfExists(NS_ERROR_DOM_MEDIA_CANCELED, __func__);
+  // A GMP arriving after this is closed by GMPInitDone().
+  mRestarting = false;
+  mReplaySamples.Clear();
   // Note that this *may* be called from the proxy thread also.
   if (!mGMP) {
     return;
@@ -7,6 +7,7 @@
 #if !defined(GMPVideoDecoder_h_)
 #define GMPVideoDecoder_h_
 
+#include "GMPDecoderReplay.h"
 #include "GMPVideoDecoderProxy.h"
 #include "ImageContainer.h"
 #include "MediaDataDecoderProxy.h"
@@ -16,12 +17,15 @@
 
 namespace mozilla {
 
+class GMPVideoDecoder;
+
 class VideoCallbackAdapter : public GMPVideoDecoderCallbackProxy {
 public:
   VideoCallbackAdapter(MediaDataDecoderCallbackProxy* aCallback,
                        VideoInfo aVideoInfo,
                        layers::ImageContainer* aImageContainer)
    : mCallback(aCallback)
+   , mDecoder(nullptr)
    , mLastStreamOffset(0)
    , mVideoInfo(aVideoInfo)
    , mImageContainer(aImageContainer)
@@ -29,6 +33,9 @@ public:
 
   MediaDataDecoderCallbackProxy* Callback() const { return mCallback; }
 
+  // The decoder to restart if the GMP terminates.
+  void SetDecoder(GMPVideoDecoder* aDecoder) { mDecoder = aDecoder; }
+
   // GMPVideoDecoderCallbackProxy
   void Decoded(GMPVideoi420Frame* aDecodedFrame) override;
   void ReceivedDecodedReferenceFrame(const uint64_t aPictureId) override;
@@ -38,14 +45,22 @@ public:
   void ResetComplete() override;
   void Error(GMPErr aErr) override;
   void Terminated() override;
+  void Crashed() override;
 
   void SetLastStreamOffset(int64_t aStreamOffset) {
     mLastStreamOffset = aStreamOffset;
   }
 
+  // Frames output before a restart are decoded again from the last keyframe;
+  // drop them rather than outputting them twice.
+  void SkipOutputFramesAgain() { mSkipper.Restarted(); }
+  void ResetOutputTimes() { mSkipper.Reset(); }
+
 private:
   MediaDataDecoderCallbackProxy* mCallback;
+  GMPVideoDecoder* mDecoder;
   int64_t mLastStreamOffset;
+  GMPOutputSkipper mSkipper;
 
   VideoInfo mVideoInfo;
   RefPtr<layers::ImageContainer> mImageContainer;
@@ -79,10 +94,18 @@ public:
     return "GMP video decoder";
   }
 
+  // Called when the GMP terminated unexpectedly, e.g. because its process
+  // crashed. Relaunches it and feeds it the samples since the last keyframe,
+  // so that playback continues. Returns false if the decoder can't be
+  // restarted and the error should be reported.
+  bool Restart();
+
 protected:
   virtual void InitTags(nsTArray<nsCString>& aTags);
   virtual nsCString GetNodeId();
   virtual uint32_t DecryptorId() const { return 0; }
+  // Whether the GMP can be relaunched without losing state held by it.
+  virtual bool CanRestart() const { return true; }
   virtual GMPUniquePtr<GMPVideoEncodedFrame> CreateFrame(MediaRawData* aSample);
   virtual const VideoInfo& GetConfig() const;
 
@@ -105,6 +128,15 @@ private:
     RefPtr<GMPVideoDecoder> mDecoder;
   };
   void GMPInitDone(GMPVideoDecoderProxy* aGMP, GMPVideoHost* aHost);
+  void InitFailed();
+  void Decode(MediaRawData* aSample);
+
+  // Restarts per decoder, so that a plugin crashing on some content doesn't
+  // get relaunched forever.
+  static const uint32_t kMaxRestarts = 3;
+  // Samples kept for replaying since the last keyframe. Longer GOPs wait for
+  // the next keyframe after a restart instead.
+  static const size_t kMaxReplaySamples = 300;
 
   const VideoInfo mConfig;
   MediaDataDecoderCallbackProxy* mCallback;
@@ -115,6 +147,12 @@ private:
   bool mConvertNALUnitLengths;
   MozPromiseHolder<InitPromise> mInitPromise;
   RefPtr<GMPCrashHelper> mCrashHelper;
+
+  GMPReplaySamples mReplaySamples;
+  uint32_t mRestarts;
+  bool mRestarting;
+  bool mDrainAfterRestart;
+  bool mWaitForKeyframe;
 };
 
 } // namespace mozilla
@@ -18,6 +18,7 @@ FFmpegAudioDecoder<LIBAV_VER>::FFmpegAudioDecoder(FFmpegLibWrapper* aLib,
   TaskQueue* aTaskQueue, MediaDataDecoderCallback* aCallback,
   const AudioInfo& aConfig)
   : FFmpegDataDecoder(aLib, aTaskQueue, aCallback, GetCodecId(aConfig.mMimeType))
+  , mOutputMerger(aCallback)
 {
   MOZ_COUNT_CTOR(FFmpegAudioDecoder);
   // Use a new MediaByteBuffer as the object will be modified during initialization.
@@ -189,7 +190,7 @@ FFmpegAudioDecoder<LIBAV_VER>::DoDecode(MediaRawData* aSample)
                                              Move(audio),
                                              numChannels,
                                              samplingRate);
-      mCallback->Output(data);
+      mOutputMerger.Output(data);
       pts += duration;
       if (!pts.IsValid()) {
         return MediaResult(
@@ -204,6 +205,18 @@ FFmpegAudioDecoder<LIBAV_VER>::DoDecode(MediaRawData* aSample)
   return NS_OK;
 }
 
+void
+FFmpegAudioDecoder<LIBAV_VER>::OutputBatch()
+{
+  mOutputMerger.OutputPending();
+}
+
+void
+FFmpegAudioDecoder<LIBAV_VER>::DiscardBatch()
+{
+  mOutputMerger.Reset();
+}
+
 void
 FFmpegAudioDecoder<LIBAV_VER>::ProcessDrain()
 {
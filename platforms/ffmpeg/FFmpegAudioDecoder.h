@@ -37,6 +37,10 @@ public:
 private:
   MediaResult DoDecode(MediaRawData* aSample) override;
   void ProcessDrain() override;
+  void OutputBatch() override;
+  void DiscardBatch() override;
+
+  AudioDataMerger mOutputMerger;
 };
 
 } // namespace mozilla
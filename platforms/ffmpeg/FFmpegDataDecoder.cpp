@@ -4,6 +4,7 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
+#include "mozilla/Maybe.h"
 #include "mozilla/SyncRunnable.h"
 #include "mozilla/TaskQueue.h"
 
@@ -54,7 +55,10 @@ FFmpegDataDecoder<LIBAV_VER>::InitDecoder()
     return NS_ERROR_FAILURE;
   }
 
-  StaticMutexAutoLock mon(sMonitor);
+  Maybe<StaticMutexAutoLock> mon;
+  if (!mLib->mHasLockManager) {
+    mon.emplace(sMonitor);
+  }
 
   if (!(mCodecContext = mLib->avcodec_alloc_context3(codec))) {
     NS_WARNING("Couldn't init ffmpeg context");
@@ -103,25 +107,38 @@ FFmpegDataDecoder<LIBAV_VER>::Shutdown()
 }
 
 void
-FFmpegDataDecoder<LIBAV_VER>::ProcessDecode(MediaRawData* aSample)
+FFmpegDataDecoder<LIBAV_VER>::ProcessDecode()
 {
   MOZ_ASSERT(mTaskQueue->IsCurrentThreadIn());
-  if (mIsFlushing) {
-    return;
+  nsTArray<RefPtr<MediaRawData>> samples = mInputBatcher.TakeBatch();
+  for (const auto& sample : samples) {
+    if (mIsFlushing) {
+      DiscardBatch();
+      return;
+    }
+    MediaResult rv = DoDecode(sample);
+    if (NS_FAILED(rv)) {
+      OutputBatch();
+      mCallback->Error(rv);
+      return;
+    }
   }
-  MediaResult rv = DoDecode(aSample);
-  if (NS_FAILED(rv)) {
-    mCallback->Error(rv);
-  } else {
-    mCallback->InputExhausted();
+  if (samples.IsEmpty()) {
+    return;
   }
+  OutputBatch();
+  mCallback->InputExhausted();
 }
 
 void
 FFmpegDataDecoder<LIBAV_VER>::Input(MediaRawData* aSample)
 {
-  mTaskQueue->Dispatch(NewRunnableMethod<RefPtr<MediaRawData>>(
-    this, &FFmpegDataDecoder::ProcessDecode, aSample));
+  // Samples arriving while a previous one is decoded are decoded together by
+  // a single task.
+  if (mInputBatcher.Push(aSample)) {
+    mTaskQueue->Dispatch(NewRunnableMethod(
+      this, &FFmpegDataDecoder::ProcessDecode));
+  }
 }
 
 void
@@ -129,6 +146,7 @@ FFmpegDataDecoder<LIBAV_VER>::Flush()
 {
   MOZ_ASSERT(mCallback->OnReaderTaskQueue());
   mIsFlushing = true;
+  mInputBatcher.Clear();
   nsCOMPtr<nsIRunnable> runnable =
     NewRunnableMethod(this, &FFmpegDataDecoder<LIBAV_VER>::ProcessFlush);
   SyncRunnable::DispatchToThread(mTaskQueue, runnable);
@@ -139,6 +157,7 @@ void
 FFmpegDataDecoder<LIBAV_VER>::Drain()
 {
   MOZ_ASSERT(mCallback->OnReaderTaskQueue());
+  mInputBatcher.Seal();
   nsCOMPtr<nsIRunnable> runnable =
     NewRunnableMethod(this, &FFmpegDataDecoder<LIBAV_VER>::ProcessDrain);
   mTaskQueue->Dispatch(runnable.forget());
@@ -156,7 +175,10 @@ FFmpegDataDecoder<LIBAV_VER>::ProcessFlush()
 void
 FFmpegDataDecoder<LIBAV_VER>::ProcessShutdown()
 {
-  StaticMutexAutoLock mon(sMonitor);
+  Maybe<StaticMutexAutoLock> mon;
+  if (!mLib->mHasLockManager) {
+    mon.emplace(sMonitor);
+  }
 
   if (mCodecContext) {
     mLib->avcodec_close(mCodecContext);
@@ -171,6 +193,23 @@ FFmpegDataDecoder<LIBAV_VER>::ProcessShutdown()
   }
 }
 
+nsresult
+FFmpegDataDecoder<LIBAV_VER>::ReopenDecoder()
+{
+  MOZ_ASSERT(mTaskQueue->IsCurrentThreadIn());
+  {
+    Maybe<StaticMutexAutoLock> mon;
+    if (!mLib->mHasLockManager) {
+      mon.emplace(sMonitor);
+    }
+    if (mCodecContext) {
+      mLib->avcodec_close(mCodecContext);
+      mLib->av_freep(&mCodecContext);
+    }
+  }
+  return InitDecoder();
+}
+
 AVFrame*
 FFmpegDataDecoder<LIBAV_VER>::PrepareFrame()
 {
@@ -7,6 +7,7 @@
 #ifndef __FFmpegDataDecoder_h__
 #define __FFmpegDataDecoder_h__
 
+#include "DecodeBatching.h"
 #include "PlatformDecoderModule.h"
 #include "FFmpegLibWrapper.h"
 #include "mozilla/StaticMutex.h"
@@ -46,6 +47,15 @@ protected:
   virtual void InitCodecContext() {}
   AVFrame*        PrepareFrame();
   nsresult        InitDecoder();
+  // Closes the codec context and opens a new one using the current
+  // mExtraData, keeping mFrame. Runs on mTaskQueue.
+  nsresult        ReopenDecoder();
+  // Called on mTaskQueue once a batch of samples has been decoded, or if
+  // decoding it failed, to output data held back while decoding it.
+  virtual void OutputBatch() {}
+  // Called on mTaskQueue instead of OutputBatch() when a flush interrupted
+  // decoding a batch.
+  virtual void DiscardBatch() {}
 
   FFmpegLibWrapper* mLib;
   MediaDataDecoderCallback* mCallback;
@@ -55,16 +65,21 @@ protected:
   RefPtr<MediaByteBuffer> mExtraData;
   AVCodecID mCodecID;
 
+  const RefPtr<TaskQueue> mTaskQueue;
+  // Set/cleared on reader thread calling Flush() to indicate that output is
+  // not required and so input samples on mTaskQueue need not be processed.
+  Atomic<bool> mIsFlushing;
+  // Samples given to Input() that mTaskQueue hasn't processed yet.
+  InputBatcher mInputBatcher;
+
 private:
-  void ProcessDecode(MediaRawData* aSample);
+  void ProcessDecode();
   virtual MediaResult DoDecode(MediaRawData* aSample) = 0;
   virtual void ProcessDrain() = 0;
 
+  // Serializes opening and closing codecs if libavcodec can't do so itself,
+  // see FFmpegLibWrapper::mHasLockManager.
   static StaticMutex sMonitor;
-  const RefPtr<TaskQueue> mTaskQueue;
-  // Set/cleared on reader thread calling Flush() to indicate that output is
-  // not required and so input samples on mTaskQueue need not be processed.
-  Atomic<bool> mIsFlushing;
 };
 
 } // namespace mozilla
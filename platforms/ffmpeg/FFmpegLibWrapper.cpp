@@ -8,12 +8,47 @@
 #include "mozilla/PodOperations.h"
 #include "mozilla/Types.h"
 #include "prlink.h"
+#include "prlock.h"
 
 #define AV_LOG_DEBUG    48
 
+// enum AVLockOp, identical in all supported versions.
+#define AV_LOCK_CREATE  0
+#define AV_LOCK_OBTAIN  1
+#define AV_LOCK_RELEASE 2
+#define AV_LOCK_DESTROY 3
+
 namespace mozilla
 {
 
+// Lock manager given to av_lockmgr_register(). Threaded FFmpeg builds
+// already install a default one (see Unlink()), but Libav and builds
+// without pthreads have none, and there avcodec_open2() fails when called
+// from several threads at once. Registering our own guarantees with every
+// supported library that libavcodec serializes the codec inits which need
+// it, so that the decoders can skip their global mutex (see
+// FFmpegDataDecoder::sMonitor); its success is what mHasLockManager records.
+static int
+LockManager(void** aMutex, int aOp)
+{
+  switch (aOp) {
+    case AV_LOCK_CREATE:
+      *aMutex = PR_NewLock();
+      return *aMutex ? 0 : 1;
+    case AV_LOCK_OBTAIN:
+      PR_Lock(static_cast<PRLock*>(*aMutex));
+      return 0;
+    case AV_LOCK_RELEASE:
+      return PR_Unlock(static_cast<PRLock*>(*aMutex)) == PR_SUCCESS ? 0 : 1;
+    case AV_LOCK_DESTROY:
+      PR_DestroyLock(static_cast<PRLock*>(*aMutex));
+      *aMutex = nullptr;
+      return 0;
+    default:
+      return 1;
+  }
+}
+
 FFmpegLibWrapper::LinkResult
 FFmpegLibWrapper::Link()
 {
@@ -140,6 +175,11 @@ FFmpegLibWrapper::Link()
 #undef AV_FUNC_OPTION
 
   avcodec_register_all();
+  mHasLockManager = av_lockmgr_register(LockManager) == 0;
+  if (!mHasLockManager) {
+    FFMPEG_LOG("Couldn't register lock manager, decoders will be opened one "
+               "at a time");
+  }
 #ifdef DEBUG
   av_log_set_level(AV_LOG_DEBUG);
 #endif
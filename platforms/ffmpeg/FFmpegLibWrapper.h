@@ -53,6 +53,11 @@ struct MOZ_ONLY_USED_TO_AVOID_STATIC_CONSTRUCTORS FFmpegLibWrapper
   // 0 indicates that the function wasn't initialized with Link().
   int mVersion;
 
+  // True if our lock manager is registered with libavcodec, which then
+  // serializes the parts of avcodec_open2() and avcodec_close() that aren't
+  // threadsafe itself. Decoders may then be opened and closed concurrently.
+  bool mHasLockManager;
+
   // libavcodec
   unsigned (*avcodec_version)();
   int (*av_lockmgr_register)(int (*cb)(void** mutex, int op));
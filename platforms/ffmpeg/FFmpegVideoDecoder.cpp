@@ -345,15 +345,68 @@ FFmpegVideoDecoder<LIBAV_VER>::DoDecode(MediaRawData* aSample,
 }
 
 void
-FFmpegVideoDecoder<LIBAV_VER>::ProcessDrain()
+FFmpegVideoDecoder<LIBAV_VER>::OutputDelayedFrames()
 {
   RefPtr<MediaRawData> empty(new MediaRawData());
   empty->mTimecode = mLastInputDts;
   bool gotFrame = false;
   while (NS_SUCCEEDED(DoDecode(empty, &gotFrame)) && gotFrame);
+}
+
+void
+FFmpegVideoDecoder<LIBAV_VER>::ProcessDrain()
+{
+  OutputDelayedFrames();
   mCallback->DrainComplete();
 }
 
+void
+FFmpegVideoDecoder<LIBAV_VER>::Reconfigure(const TrackInfo& aConfig)
+{
+  MOZ_ASSERT(mCallback->OnReaderTaskQueue());
+  MOZ_ASSERT(aConfig.GetAsVideoInfo());
+  // Queued behind the samples already given to Input(), which are decoded
+  // with the previous configuration.
+  mInputBatcher.Seal();
+  RefPtr<FFmpegVideoDecoder<LIBAV_VER>> self = this;
+  VideoInfo config = *aConfig.GetAsVideoInfo();
+  mTaskQueue->Dispatch(NS_NewRunnableFunction([self, config]() {
+    self->ProcessReconfigure(config);
+  }));
+}
+
+void
+FFmpegVideoDecoder<LIBAV_VER>::ProcessReconfigure(const VideoInfo& aConfig)
+{
+  MOZ_ASSERT(mTaskQueue->IsCurrentThreadIn());
+  FFMPEG_LOG("Reconfiguring FFmpeg decoder to %dx%d.",
+             aConfig.mImage.width, aConfig.mImage.height);
+
+  // Closing the context would discard the frames it is holding for
+  // reordering. Unless we're being flushed anyway, output them first.
+  if (!mIsFlushing) {
+    OutputDelayedFrames();
+  }
+
+  mInfo = aConfig;
+  // The current context points to the old extradata until it's closed.
+  RefPtr<MediaByteBuffer> previousExtraData = mExtraData.forget();
+  mExtraData = new MediaByteBuffer;
+  mExtraData->AppendElements(*aConfig.mExtraData);
+  if (mCodecParser) {
+    // InitCodecContext() creates a new one.
+    mLib->av_parser_close(mCodecParser);
+    mCodecParser = nullptr;
+  }
+  mPtsContext.Reset();
+  mDurationMap.Clear();
+
+  if (NS_FAILED(ReopenDecoder())) {
+    mCallback->Error(MediaResult(NS_ERROR_DOM_MEDIA_FATAL_ERR,
+                                 RESULT_DETAIL("Couldn't reconfigure decoder")));
+  }
+}
+
 void
 FFmpegVideoDecoder<LIBAV_VER>::ProcessFlush()
 {
@@ -45,12 +45,22 @@ public:
   }
   static AVCodecID GetCodecId(const nsACString& aMimeType);
 
+  // H.264 extradata is only read when opening the codec, so a new SPS/PPS
+  // is applied by re-opening the codec context on our task queue, after the
+  // frames still buffered for the previous configuration have been output.
+  bool SupportsReconfiguration() const override
+  {
+    return mCodecID == AV_CODEC_ID_H264;
+  }
+  void Reconfigure(const TrackInfo& aConfig) override;
+
 private:
   MediaResult DoDecode(MediaRawData* aSample) override;
   MediaResult DoDecode(MediaRawData* aSample, bool* aGotFrame);
   MediaResult DoDecode(MediaRawData* aSample, uint8_t* aData, int aSize, bool* aGotFrame);
   void ProcessDrain() override;
   void ProcessFlush() override;
+  void ProcessReconfigure(const VideoInfo& aConfig);
   void OutputDelayedFrames();
 
   /**
@@ -88,9 +88,75 @@ DecoderFuzzingWrapper::IsHardwareAccelerated(nsACString& aFailureReason) const
   return mDecoder->IsHardwareAccelerated(aFailureReason);
 }
 
+DecoderLatencySimulator::DecoderLatencySimulator(const DecoderLatencyModel& aModel)
+  : mModel(aModel)
+  // XorShift128+ must not be seeded with all zeroes.
+  , mRNG(aModel.mSeed, aModel.mSeed ^ 0x9E3779B97F4A7C15ULL)
+  , mFrameCount(0)
+  , mFramesInBatch(0)
+  , mStalls(0)
+{
+}
+
+TimeDuration
+DecoderLatencySimulator::NextLatency()
+{
+  TimeDuration latency = mModel.mMeanLatency;
+  if (mModel.mLatencyJitter) {
+    // Uniform in [-jitter, +jitter].
+    latency += mModel.mLatencyJitter.MultDouble(2.0 * mRNG.nextDouble() - 1.0);
+  }
+  ++mFrameCount;
+  if (mModel.mStallPeriod && mFrameCount % mModel.mStallPeriod == 0) {
+    latency += mModel.mStallDuration;
+    ++mStalls;
+  }
+  return latency > TimeDuration() ? latency : TimeDuration();
+}
+
+TimeStamp
+DecoderLatencySimulator::NextFrameDue(TimeStamp aNow, TimeStamp* aOutBatchDue)
+{
+  TimeStamp due = aNow + NextLatency();
+  if (!mLastDue.IsNull() && due < mLastDue) {
+    due = mLastDue;
+  }
+  mLastDue = due;
+
+  if (mModel.mBatchSize <= 1) {
+    *aOutBatchDue = due;
+    return due;
+  }
+  if (++mFramesInBatch < mModel.mBatchSize) {
+    return TimeStamp();
+  }
+  // Frames are in order, so the last one is the latest of the batch.
+  mFramesInBatch = 0;
+  *aOutBatchDue = due;
+  return due;
+}
+
+TimeStamp
+DecoderLatencySimulator::FlushBatch()
+{
+  mFramesInBatch = 0;
+  return mLastDue;
+}
+
+void
+DecoderLatencySimulator::Reset()
+{
+  mFramesInBatch = 0;
+  mLastDue = TimeStamp();
+}
+
 DecoderCallbackFuzzingWrapper::DecoderCallbackFuzzingWrapper(MediaDataDecoderCallback* aCallback)
   : mCallback(aCallback)
   , mDontDelayInputExhausted(false)
+  , mFramesOutput(0)
+  , mFramesDelayed(0)
+  , mStalls(0)
+  , mMaxQueuedFrames(0)
   , mDraining(false)
   , mTaskQueue(new TaskQueue(SharedThreadPool::Get(NS_LITERAL_CSTRING("MediaFuzzingWrapper"), 1)))
 {
@@ -120,6 +186,61 @@ DecoderCallbackFuzzingWrapper::SetDontDelayInputExhausted(
   mDontDelayInputExhausted = aDontDelayInputExhausted;
 }
 
+void
+DecoderCallbackFuzzingWrapper::SetLatencyModel(const DecoderLatencyModel& aModel)
+{
+  CFW_LOGD("seed=%llu mean=%fms jitter=%fms stall=%fms every %u batch=%u",
+           aModel.mSeed, aModel.mMeanLatency.ToMilliseconds(),
+           aModel.mLatencyJitter.ToMilliseconds(),
+           aModel.mStallDuration.ToMilliseconds(), aModel.mStallPeriod,
+           aModel.mBatchSize);
+  if (aModel.IsEnabled()) {
+    mLatencySimulator = MakeUnique<DecoderLatencySimulator>(aModel);
+  } else {
+    mLatencySimulator = nullptr;
+  }
+}
+
+DecoderLatencyStats
+DecoderCallbackFuzzingWrapper::GetLatencyStats() const
+{
+  DecoderLatencyStats stats;
+  stats.mFramesOutput = mFramesOutput;
+  stats.mFramesDelayed = mFramesDelayed;
+  stats.mStalls = mStalls;
+  stats.mMaxQueuedFrames = mMaxQueuedFrames;
+  return stats;
+}
+
+void
+DecoderCallbackFuzzingWrapper::QueueFrameFromModel(MediaData* aData)
+{
+  MOZ_ASSERT(mTaskQueue->IsCurrentThreadIn());
+  MOZ_ASSERT(mLatencySimulator);
+  TimeStamp batchDue;
+  TimeStamp due = mLatencySimulator->NextFrameDue(TimeStamp::Now(), &batchDue);
+  mDelayedOutput.push_back(DelayedFrame(aData, due));
+  if (!batchDue.IsNull()) {
+    // This frame completes a batch: release the whole batch together.
+    for (auto& frame : mDelayedOutput) {
+      if (frame.mDue.IsNull()) {
+        frame.mDue = batchDue;
+      }
+    }
+  }
+  mFramesDelayed++;
+  mStalls = mLatencySimulator->Stalls();
+  if (mDelayedOutput.size() > mMaxQueuedFrames) {
+    mMaxQueuedFrames = uint32_t(mDelayedOutput.size());
+  }
+  CFW_LOGD("delaying output of sample@%lld, total queued:%d",
+           aData->mTime, int(mDelayedOutput.size()));
+  if (!mDelayedOutputTimer) {
+    mDelayedOutputTimer = new MediaTimer();
+  }
+  ScheduleOutputDelayedFrame();
+}
+
 void
 DecoderCallbackFuzzingWrapper::Output(MediaData* aData)
 {
@@ -132,18 +253,22 @@ DecoderCallbackFuzzingWrapper::Output(MediaData* aData)
   }
   CFW_LOGV("aData.mTime=%lld", aData->mTime);
   MOZ_ASSERT(mCallback);
+  if (mLatencySimulator) {
+    QueueFrameFromModel(aData);
+    return;
+  }
   if (mFrameOutputMinimumInterval) {
     if (!mPreviousOutput.IsNull()) {
       if (!mDelayedOutput.empty()) {
         // We already have some delayed frames, just add this one to the queue.
-        mDelayedOutput.push_back(MakePair<RefPtr<MediaData>, bool>(aData, false));
+        mDelayedOutput.push_back(DelayedFrame(aData, TimeStamp()));
         CFW_LOGD("delaying output of sample@%lld, total queued:%d",
                  aData->mTime, int(mDelayedOutput.size()));
         return;
       }
       if (TimeStamp::Now() < mPreviousOutput + mFrameOutputMinimumInterval) {
         // Frame arriving too soon after the previous one, start queuing.
-        mDelayedOutput.push_back(MakePair<RefPtr<MediaData>, bool>(aData, false));
+        mDelayedOutput.push_back(DelayedFrame(aData, TimeStamp()));
         CFW_LOGD("delaying output of sample@%lld, first queued", aData->mTime);
         if (!mDelayedOutputTimer) {
           mDelayedOutputTimer = new MediaTimer();
@@ -158,6 +283,7 @@ DecoderCallbackFuzzingWrapper::Output(MediaData* aData)
 
   // Passing the data straight through, no need to dispatch to another queue,
   // callback should deal with that.
+  mFramesOutput++;
   mCallback->Output(aData);
 }
 
@@ -182,11 +308,14 @@ DecoderCallbackFuzzingWrapper::InputExhausted()
     mTaskQueue->Dispatch(NewRunnableMethod(this, &DecoderCallbackFuzzingWrapper::InputExhausted));
     return;
   }
-  if (!mDontDelayInputExhausted && !mDelayedOutput.empty()) {
-    MediaDataAndInputExhausted& last = mDelayedOutput.back();
+  // Don't hold InputExhausted behind a frame waiting for its batch to
+  // complete, as the rest of the batch needs more input.
+  if (!mDontDelayInputExhausted && !mDelayedOutput.empty() &&
+      !(mLatencySimulator && mDelayedOutput.back().mDue.IsNull())) {
+    DelayedFrame& last = mDelayedOutput.back();
     CFW_LOGD("InputExhausted delayed until after output of sample@%lld",
-             last.first()->mTime);
-    last.second() = true;
+             last.mData->mTime);
+    last.mInputExhausted = true;
     return;
   }
   CFW_LOGV("");
@@ -210,6 +339,16 @@ DecoderCallbackFuzzingWrapper::DrainComplete()
     // Queued output waiting -> Make sure we call DrainComplete when it's empty.
     CFW_LOGD("Delayed output -> DrainComplete later");
     mDraining = true;
+    if (mLatencySimulator && mLatencySimulator->FramesInBatch()) {
+      // No more input is coming, release the incomplete batch.
+      TimeStamp due = mLatencySimulator->FlushBatch();
+      for (auto& frame : mDelayedOutput) {
+        if (frame.mDue.IsNull()) {
+          frame.mDue = due;
+        }
+      }
+      ScheduleOutputDelayedFrame();
+    }
   }
 }
 
@@ -233,6 +372,27 @@ DecoderCallbackFuzzingWrapper::OnReaderTaskQueue()
   return mCallback->OnReaderTaskQueue();
 }
 
+TimeStamp
+DecoderCallbackFuzzingWrapper::NextOutputTime() const
+{
+  MOZ_ASSERT(mTaskQueue->IsCurrentThreadIn());
+  TimeStamp next;
+  if (!mPreviousOutput.IsNull() && mFrameOutputMinimumInterval) {
+    next = mPreviousOutput + mFrameOutputMinimumInterval;
+  }
+  if (mLatencySimulator && !mDelayedOutput.empty()) {
+    const TimeStamp& due = mDelayedOutput.front().mDue;
+    if (due.IsNull()) {
+      // Waiting for the rest of the batch.
+      return TimeStamp();
+    }
+    if (next.IsNull() || due > next) {
+      next = due;
+    }
+  }
+  return next;
+}
+
 void
 DecoderCallbackFuzzingWrapper::ScheduleOutputDelayedFrame()
 {
@@ -241,11 +401,13 @@ DecoderCallbackFuzzingWrapper::ScheduleOutputDelayedFrame()
     // A delayed output is already scheduled, no need for more than one timer.
     return;
   }
+  TimeStamp next = NextOutputTime();
+  if (next.IsNull()) {
+    return;
+  }
   RefPtr<DecoderCallbackFuzzingWrapper> self = this;
   mDelayedOutputRequest.Begin(
-    mDelayedOutputTimer->WaitUntil(
-      mPreviousOutput + mFrameOutputMinimumInterval,
-      __func__)
+    mDelayedOutputTimer->WaitUntil(next, __func__)
     ->Then(mTaskQueue, __func__,
            [self] () -> void {
              if (self->mDelayedOutputRequest.Exists()) {
@@ -273,16 +435,24 @@ DecoderCallbackFuzzingWrapper::OutputDelayedFrame()
     }
     return;
   }
-  MediaDataAndInputExhausted& data = mDelayedOutput.front();
-  CFW_LOGD("Outputting delayed sample@%lld, remaining:%d",
-          data.first()->mTime, int(mDelayedOutput.size() - 1));
-  mPreviousOutput = TimeStamp::Now();
-  mCallback->Output(data.first());
-  if (data.second()) {
-    CFW_LOGD("InputExhausted after delayed sample@%lld", data.first()->mTime);
-    mCallback->InputExhausted();
-  }
-  mDelayedOutput.pop_front();
+  // With a latency model, output every frame that is due now, so that a
+  // batch comes out in one burst.
+  TimeStamp now = TimeStamp::Now();
+  do {
+    DelayedFrame& data = mDelayedOutput.front();
+    CFW_LOGD("Outputting delayed sample@%lld, remaining:%d",
+            data.mData->mTime, int(mDelayedOutput.size() - 1));
+    mPreviousOutput = now;
+    mFramesOutput++;
+    mCallback->Output(data.mData);
+    if (data.mInputExhausted) {
+      CFW_LOGD("InputExhausted after delayed sample@%lld", data.mData->mTime);
+      mCallback->InputExhausted();
+    }
+    mDelayedOutput.pop_front();
+  } while (mLatencySimulator && !mFrameOutputMinimumInterval &&
+           !mDelayedOutput.empty() && !mDelayedOutput.front().mDue.IsNull() &&
+           mDelayedOutput.front().mDue <= now);
   if (!mDelayedOutput.empty()) {
     // More output -> Send it later.
     ScheduleOutputDelayedFrame();
@@ -308,6 +478,9 @@ DecoderCallbackFuzzingWrapper::ClearDelayedOutput()
   mDelayedOutputRequest.DisconnectIfExists();
   mDelayedOutputTimer = nullptr;
   mDelayedOutput.clear();
+  if (mLatencySimulator) {
+    mLatencySimulator->Reset();
+  }
 }
 
 void
@@ -7,7 +7,9 @@
 #if !defined(FuzzingWrapper_h_)
 #define FuzzingWrapper_h_
 
-#include "mozilla/Pair.h"
+#include "mozilla/Atomics.h"
+#include "mozilla/UniquePtr.h"
+#include "mozilla/XorShift128PlusRNG.h"
 #include "PlatformDecoderModule.h"
 
 #include <deque>
@@ -39,6 +41,75 @@ namespace mozilla {
 // DecoderFuzzingWrapper is what the reader sees as decoder, it owns the
 // real decoder and the DecoderCallbackFuzzingWrapper.
 
+// Deterministic model of extra decoder output latency, used to simulate
+// slow, stalling or bursty decoders in a repeatable way. The latencies are
+// added on top of whatever the wrapped decoder takes.
+struct DecoderLatencyModel
+{
+  // Seed of the pseudo-random latency distribution. The same seed gives the
+  // same sequence of latencies.
+  uint64_t mSeed = 1;
+  // Each frame is delayed by a latency uniformly distributed in
+  // [mMeanLatency - mLatencyJitter, mMeanLatency + mLatencyJitter].
+  TimeDuration mMeanLatency;
+  TimeDuration mLatencyJitter;
+  // Every mStallPeriod-th frame is delayed by an extra mStallDuration.
+  // 0 disables stalls.
+  uint32_t mStallPeriod = 0;
+  TimeDuration mStallDuration;
+  // Frames are held back until mBatchSize of them are ready, and then output
+  // all at once. Incomplete batches are released on drain.
+  uint32_t mBatchSize = 1;
+
+  bool IsEnabled() const
+  {
+    return mMeanLatency || mLatencyJitter ||
+           (mStallPeriod && mStallDuration) || mBatchSize > 1;
+  }
+};
+
+// Computes the per-frame latencies of a DecoderLatencyModel. Output frames
+// keep their order, so a frame is never due before the previous one.
+class DecoderLatencySimulator
+{
+public:
+  explicit DecoderLatencySimulator(const DecoderLatencyModel& aModel);
+
+  // Due time of the next output frame produced at aNow, or a null TimeStamp
+  // if the frame must wait for the rest of its batch. When a frame completes
+  // a batch, aOutBatchDue is set to the due time of the whole batch.
+  TimeStamp NextFrameDue(TimeStamp aNow, TimeStamp* aOutBatchDue);
+  // Number of frames waiting for their batch to complete.
+  uint32_t FramesInBatch() const { return mFramesInBatch; }
+  // Due time of the pending incomplete batch, when releasing it early.
+  TimeStamp FlushBatch();
+  // Forget about queued frames (e.g. on flush); the random sequence carries
+  // on, so runs stay repeatable.
+  void Reset();
+
+  uint32_t Stalls() const { return mStalls; }
+
+private:
+  TimeDuration NextLatency();
+
+  const DecoderLatencyModel mModel;
+  non_crypto::XorShift128PlusRNG mRNG;
+  uint64_t mFrameCount;
+  uint32_t mFramesInBatch;
+  uint32_t mStalls;
+  TimeStamp mLastDue;
+};
+
+// Counters describing the effect of a DecoderLatencyModel, readable from any
+// thread.
+struct DecoderLatencyStats
+{
+  uint32_t mFramesOutput = 0;
+  uint32_t mFramesDelayed = 0;
+  uint32_t mStalls = 0;
+  uint32_t mMaxQueuedFrames = 0;
+};
+
 class DecoderCallbackFuzzingWrapper : public MediaDataDecoderCallback
 {
 public:
@@ -54,6 +125,11 @@ public:
   // If true, InputExhausted are passed through immediately; This could result
   // in lots of frames being decoded and queued for delayed output!
   void SetDontDelayInputExhausted(bool aDontDelayInputExhausted);
+  // Delay output according to a deterministic latency model. Combines with
+  // the minimum output interval if both are set.
+  void SetLatencyModel(const DecoderLatencyModel& aModel);
+
+  DecoderLatencyStats GetLatencyStats() const;
 
 private:
   virtual ~DecoderCallbackFuzzingWrapper();
@@ -75,11 +151,27 @@ private:
   // Members for minimum frame output interval & InputExhausted,
   // should only be accessed on mTaskQueue.
   TimeStamp mPreviousOutput;
-  // First member is the frame to be delayed.
-  // Second member is true if an 'InputExhausted' arrived after that frame; in
-  // which case an InputExhausted will be sent after finally outputting the frame.
-  typedef Pair<RefPtr<MediaData>, bool> MediaDataAndInputExhausted;
-  std::deque<MediaDataAndInputExhausted> mDelayedOutput;
+  struct DelayedFrame
+  {
+    DelayedFrame(MediaData* aData, TimeStamp aDue)
+      : mData(aData)
+      , mInputExhausted(false)
+      , mDue(aDue)
+    {}
+    RefPtr<MediaData> mData;
+    // True if an 'InputExhausted' arrived after that frame; in which case an
+    // InputExhausted will be sent after finally outputting the frame.
+    bool mInputExhausted;
+    // When using a latency model, time at which the frame may be output, or
+    // null while waiting for the rest of its batch.
+    TimeStamp mDue;
+  };
+  std::deque<DelayedFrame> mDelayedOutput;
+  UniquePtr<DecoderLatencySimulator> mLatencySimulator;
+  Atomic<uint32_t> mFramesOutput;
+  Atomic<uint32_t> mFramesDelayed;
+  Atomic<uint32_t> mStalls;
+  Atomic<uint32_t> mMaxQueuedFrames;
   RefPtr<MediaTimer> mDelayedOutputTimer;
   MozPromiseRequestHolder<MediaTimerPromise> mDelayedOutputRequest;
   // If draining, a 'DrainComplete' will be sent after all delayed frames have
@@ -88,6 +180,8 @@ private:
   // All callbacks are redirected through this task queue, both to avoid locking
   // and to have a consistent sequencing of callbacks.
   RefPtr<TaskQueue> mTaskQueue;
+  void QueueFrameFromModel(MediaData* aData);
+  TimeStamp NextOutputTime() const;
   void ScheduleOutputDelayedFrame();
   void OutputDelayedFrame();
 public: // public for the benefit of DecoderFuzzingWrapper.
@@ -7,6 +7,7 @@
 #include "mozilla/TaskQueue.h"
 
 #include "H264Converter.h"
+#include "H264Normalizer.h"
 #include "ImageContainer.h"
 #include "MediaInfo.h"
 #include "MediaPrefs.h"
@@ -52,7 +53,13 @@ H264Converter::Init()
 void
 H264Converter::Input(MediaRawData* aSample)
 {
-  if (!mp4_demuxer::AnnexB::ConvertSampleToAVCC(aSample)) {
+  if (mInputFormat == H264Normalizer::Format::Unknown) {
+    mInputFormat =
+      H264Normalizer::DetectFormat(mCurrentConfig.mExtraData, aSample);
+  }
+
+  if (!IsAnnexBPassthrough() &&
+      !mp4_demuxer::AnnexB::ConvertSampleToAVCC(aSample)) {
     // We need AVCC content to be able to later parse the SPS.
     // This is a no-op if the data is already AVCC.
     mCallback->Error(MediaResult(NS_ERROR_OUT_OF_MEMORY,
@@ -105,8 +112,7 @@ H264Converter::Input(MediaRawData* aSample)
     return;
   }
 
-  if (!mNeedAVCC &&
-      !mp4_demuxer::AnnexB::ConvertSampleToAnnexB(aSample, mNeedKeyframe)) {
+  if (!ConvertSampleToDecoderFormat(aSample, mNeedKeyframe)) {
     mCallback->Error(MediaResult(NS_ERROR_OUT_OF_MEMORY,
                                  RESULT_DETAIL("ConvertSampleToAnnexB")));
     return;
@@ -217,8 +223,7 @@ H264Converter::CreateDecoder(DecoderDoctorDiagnostics* aDiagnostics)
 nsresult
 H264Converter::CreateDecoderAndInit(MediaRawData* aSample)
 {
-  RefPtr<MediaByteBuffer> extra_data =
-    mp4_demuxer::AnnexB::ExtractExtraData(aSample);
+  RefPtr<MediaByteBuffer> extra_data = ExtractExtraData(aSample);
   if (!mp4_demuxer::AnnexB::HasSPS(extra_data)) {
     return NS_ERROR_NOT_INITIALIZED;
   }
@@ -252,8 +257,7 @@ H264Converter::OnDecoderInitDone(const TrackType aTrackType)
       }
       mNeedKeyframe = false;
     }
-    if (!mNeedAVCC &&
-        !mp4_demuxer::AnnexB::ConvertSampleToAnnexB(sample, mNeedKeyframe)) {
+    if (!ConvertSampleToDecoderFormat(sample, mNeedKeyframe)) {
       mCallback->Error(MediaResult(NS_ERROR_OUT_OF_MEMORY,
                                    RESULT_DETAIL("ConvertSampleToAnnexB")));
       mMediaRawSamples.Clear();
@@ -279,8 +283,7 @@ H264Converter::OnDecoderInitFailed(MediaResult aError)
 nsresult
 H264Converter::CheckForSPSChange(MediaRawData* aSample)
 {
-  RefPtr<MediaByteBuffer> extra_data =
-    mp4_demuxer::AnnexB::ExtractExtraData(aSample);
+  RefPtr<MediaByteBuffer> extra_data = ExtractExtraData(aSample);
   if (!mp4_demuxer::AnnexB::HasSPS(extra_data) ||
       mp4_demuxer::AnnexB::CompareExtraData(extra_data,
                                             mCurrentConfig.mExtraData)) {
@@ -294,6 +297,14 @@ H264Converter::CheckForSPSChange(MediaRawData* aSample)
     mNeedKeyframe = true;
     return NS_OK;
   }
+  if (mDecoder->SupportsReconfiguration()) {
+    // Switch the decoder to the new parameter sets in place; frames of the
+    // samples already queued are still output.
+    UpdateConfigFromExtraData(extra_data);
+    mDecoder->Reconfigure(mCurrentConfig);
+    mNeedKeyframe = true;
+    return NS_OK;
+  }
   // The SPS has changed, signal to flush the current decoder and create a
   // new one.
   mDecoder->Flush();
@@ -301,6 +312,38 @@ H264Converter::CheckForSPSChange(MediaRawData* aSample)
   return CreateDecoderAndInit(aSample);
 }
 
+bool
+H264Converter::IsAnnexBPassthrough() const
+{
+  return !mNeedAVCC && mInputFormat == H264Normalizer::Format::AnnexB;
+}
+
+already_AddRefed<MediaByteBuffer>
+H264Converter::ExtractExtraData(MediaRawData* aSample) const
+{
+  if (IsAnnexBPassthrough()) {
+    return H264Normalizer::ExtractAnnexBExtraData(aSample);
+  }
+  return mp4_demuxer::AnnexB::ExtractExtraData(aSample);
+}
+
+bool
+H264Converter::ConvertSampleToDecoderFormat(MediaRawData* aSample,
+                                            bool aAddSPS)
+{
+  if (mNeedAVCC) {
+    // Input() already converted it.
+    return true;
+  }
+  if (IsAnnexBPassthrough()) {
+    // Already Annex B; only add the parameter sets if they aren't in-band.
+    return !aAddSPS ||
+           H264Normalizer::PrependParameterSets(aSample,
+                                                mCurrentConfig.mExtraData);
+  }
+  return mp4_demuxer::AnnexB::ConvertSampleToAnnexB(aSample, aAddSPS);
+}
+
 void
 H264Converter::UpdateConfigFromExtraData(MediaByteBuffer* aExtraData)
 {
@@ -7,6 +7,7 @@
 #ifndef mozilla_H264Converter_h
 #define mozilla_H264Converter_h
 
+#include "H264Normalizer.h"
 #include "PlatformDecoderModule.h"
 
 namespace mozilla {
@@ -57,6 +58,12 @@ private:
   nsresult CreateDecoderAndInit(MediaRawData* aSample);
   nsresult CheckForSPSChange(MediaRawData* aSample);
   void UpdateConfigFromExtraData(MediaByteBuffer* aExtraData);
+  // True if both the input and the decoder are Annex B, in which case
+  // samples are passed through without being converted to AVCC and back.
+  bool IsAnnexBPassthrough() const;
+  already_AddRefed<MediaByteBuffer> ExtractExtraData(MediaRawData* aSample) const;
+  // Brings an AVCC or Annex B sample to the format the decoder needs.
+  bool ConvertSampleToDecoderFormat(MediaRawData* aSample, bool aAddSPS);
 
   void OnDecoderInitDone(const TrackType aTrackType);
   void OnDecoderInitFailed(MediaResult aError);
@@ -74,6 +81,8 @@ private:
   bool mNeedAVCC;
   nsresult mLastError;
   bool mNeedKeyframe = true;
+  // Bitstream format of the input, detected from the first sample.
+  H264Normalizer::Format mInputFormat = H264Normalizer::Format::Unknown;
 };
 
 } // namespace mozilla
@@ -0,0 +1,198 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* vim:set ts=2 sw=2 sts=2 et cindent: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "H264Normalizer.h"
+#include "mp4_demuxer/AnnexB.h"
+#include "mozilla/Pair.h"
+#include "nsAutoPtr.h"
+
+#include <algorithm>
+#include <string.h>
+
+namespace mozilla
+{
+
+static const uint8_t kNALTypeSPS = 7;
+static const uint8_t kNALTypePPS = 8;
+
+// NAL unit types 1 to 5 are coded slices; parameter sets come before them.
+static bool
+IsSlice(uint8_t aNALType)
+{
+  return aNALType >= 1 && aNALType <= 5;
+}
+
+static bool
+StartsWithStartCode(const uint8_t* aData, size_t aSize)
+{
+  return (aSize >= 3 && aData[0] == 0 && aData[1] == 0 && aData[2] == 1) ||
+         (aSize >= 4 && aData[0] == 0 && aData[1] == 0 && aData[2] == 0 &&
+          aData[3] == 1);
+}
+
+/* static */ H264Normalizer::Format
+H264Normalizer::DetectFormat(const MediaByteBuffer* aExtraData,
+                             const MediaRawData* aSample)
+{
+  // An avcC box starts with configurationVersion 1 and its samples are
+  // length prefixed, whatever the first bytes happen to look like.
+  if (aExtraData && aExtraData->Length() >= 7 && (*aExtraData)[0] == 1) {
+    return Format::AVCC;
+  }
+  if (StartsWithStartCode(aSample->Data(), aSample->Size())) {
+    return Format::AnnexB;
+  }
+  return Format::Unknown;
+}
+
+/* static */ const uint8_t*
+H264Normalizer::FindStartCode(const uint8_t* aStart, const uint8_t* aEnd)
+{
+  static const uint64_t kOnes = 0x0101010101010101ULL;
+  static const uint64_t kHighs = 0x8080808080808080ULL;
+
+  const uint8_t* p = aStart;
+  while (aEnd - p >= 3) {
+    if (aEnd - p >= 8) {
+      uint64_t word;
+      memcpy(&word, p, sizeof(word));
+      if (!((word - kOnes) & ~word & kHighs)) {
+        // No zero byte in these 8 bytes, so no start code begins here.
+        p += 8;
+        continue;
+      }
+    }
+    const uint8_t* limit = p + std::min<ptrdiff_t>(8, aEnd - 2 - p);
+    for (; p < limit; p++) {
+      if (p[0] == 0 && p[1] == 0 && p[2] == 1) {
+        return p;
+      }
+    }
+  }
+  return aEnd;
+}
+
+AnnexBNALIterator::AnnexBNALIterator(const uint8_t* aData, size_t aSize)
+  : mEnd(aData + aSize)
+{
+  const uint8_t* start = H264Normalizer::FindStartCode(aData, mEnd);
+  mNext = start == mEnd ? mEnd : start + 3;
+}
+
+bool
+AnnexBNALIterator::Next(const uint8_t** aNAL, size_t* aSize)
+{
+  while (mNext < mEnd) {
+    const uint8_t* nal = mNext;
+    const uint8_t* next = H264Normalizer::FindStartCode(nal, mEnd);
+    mNext = next == mEnd ? mEnd : next + 3;
+    // Drop trailing_zero_8bits, including the leading zero of a 4 bytes
+    // start code.
+    while (next > nal && next[-1] == 0) {
+      next--;
+    }
+    if (next > nal) {
+      *aNAL = nal;
+      *aSize = next - nal;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* static */ already_AddRefed<MediaByteBuffer>
+H264Normalizer::ExtractAnnexBExtraData(const MediaRawData* aSample)
+{
+  RefPtr<MediaByteBuffer> extraData = new MediaByteBuffer;
+
+  nsTArray<Pair<const uint8_t*, size_t>> sps;
+  nsTArray<Pair<const uint8_t*, size_t>> pps;
+  AnnexBNALIterator it(aSample->Data(), aSample->Size());
+  const uint8_t* nal;
+  size_t size;
+  while (it.Next(&nal, &size)) {
+    uint8_t type = nal[0] & 0x1f;
+    if (IsSlice(type)) {
+      break;
+    }
+    if (size > UINT16_MAX) {
+      continue;
+    }
+    if (type == kNALTypeSPS && size >= 4 && sps.Length() < 31) {
+      sps.AppendElement(MakePair(nal, size));
+    } else if (type == kNALTypePPS && pps.Length() < 255) {
+      pps.AppendElement(MakePair(nal, size));
+    }
+  }
+  if (sps.IsEmpty()) {
+    return extraData.forget();
+  }
+
+  const uint8_t* firstSPS = sps[0].first();
+  extraData->AppendElement(uint8_t(1)); // configurationVersion
+  extraData->AppendElement(firstSPS[1]); // AVCProfileIndication
+  extraData->AppendElement(firstSPS[2]); // profile_compatibility
+  extraData->AppendElement(firstSPS[3]); // AVCLevelIndication
+  extraData->AppendElement(uint8_t(0xfc | 3)); // lengthSizeMinusOne: 4 bytes
+  extraData->AppendElement(uint8_t(0xe0 | sps.Length()));
+  for (const auto& unit : sps) {
+    extraData->AppendElement(uint8_t(unit.second() >> 8));
+    extraData->AppendElement(uint8_t(unit.second()));
+    extraData->AppendElements(unit.first(), unit.second());
+  }
+  extraData->AppendElement(uint8_t(pps.Length()));
+  for (const auto& unit : pps) {
+    extraData->AppendElement(uint8_t(unit.second() >> 8));
+    extraData->AppendElement(uint8_t(unit.second()));
+    extraData->AppendElements(unit.first(), unit.second());
+  }
+  return extraData.forget();
+}
+
+/* static */ bool
+H264Normalizer::HasAnnexBSPS(const MediaRawData* aSample)
+{
+  AnnexBNALIterator it(aSample->Data(), aSample->Size());
+  const uint8_t* nal;
+  size_t size;
+  while (it.Next(&nal, &size)) {
+    uint8_t type = nal[0] & 0x1f;
+    if (type == kNALTypeSPS) {
+      return true;
+    }
+    if (IsSlice(type)) {
+      return false;
+    }
+  }
+  return false;
+}
+
+/* static */ bool
+H264Normalizer::PrependParameterSets(MediaRawData* aSample,
+                                     const MediaByteBuffer* aExtraData)
+{
+  if (!aSample->mKeyframe || HasAnnexBSPS(aSample)) {
+    return true;
+  }
+  RefPtr<MediaByteBuffer> annexB =
+    mp4_demuxer::AnnexB::ConvertExtraDataToAnnexB(aExtraData);
+  if (!annexB || annexB->IsEmpty()) {
+    return true;
+  }
+  nsAutoPtr<MediaRawDataWriter> writer(aSample->CreateWriter());
+  if (!writer->Prepend(annexB->Elements(), annexB->Length())) {
+    return false;
+  }
+  // The parameter sets are in the clear; account for them in the first
+  // subsample so that decryption still lines up.
+  if (aSample->mCrypto.mValid) {
+    MOZ_ASSERT(writer->mCrypto.mPlainSizes.Length() > 0);
+    writer->mCrypto.mPlainSizes[0] += annexB->Length();
+  }
+  return true;
+}
+
+} // namespace mozilla
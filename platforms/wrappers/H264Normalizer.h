@@ -0,0 +1,76 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* vim:set ts=2 sw=2 sts=2 et cindent: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef mozilla_H264Normalizer_h
+#define mozilla_H264Normalizer_h
+
+#include "MediaData.h"
+
+namespace mozilla {
+
+// Helpers letting H264Converter bring a sample to the bitstream format its
+// decoder requires in at most one pass over the payload.
+//
+// The generic path converts every sample to AVCC so that the SPS can be
+// extracted, then back to Annex B if that's what the decoder wants. When
+// both the input and the decoder are Annex B, the payload doesn't need to be
+// rewritten at all: the SPS/PPS can be read from the NAL units preceding the
+// first slice, and only keyframes missing in-band parameter sets need them
+// prepended.
+class H264Normalizer
+{
+public:
+  enum class Format : uint8_t
+  {
+    Unknown,
+    AVCC,
+    AnnexB,
+  };
+
+  // Determines the bitstream format from the stream's extra data and the
+  // first sample. Meant to be called once per stream.
+  static Format DetectFormat(const MediaByteBuffer* aExtraData,
+                             const MediaRawData* aSample);
+
+  // Returns the position of the next 00 00 01 start code in [aStart, aEnd),
+  // or aEnd if there is none. Scans a machine word at a time.
+  static const uint8_t* FindStartCode(const uint8_t* aStart,
+                                      const uint8_t* aEnd);
+
+  // Returns avcC extra data built from the SPS and PPS NAL units found before
+  // the first slice of an Annex B sample, in the same layout as
+  // mp4_demuxer::AnnexB::ExtractExtraData() produces for the sample
+  // converted to AVCC. The buffer is empty if there is no SPS.
+  static already_AddRefed<MediaByteBuffer>
+  ExtractAnnexBExtraData(const MediaRawData* aSample);
+
+  // True if an SPS precedes the first slice of an Annex B sample.
+  static bool HasAnnexBSPS(const MediaRawData* aSample);
+
+  // Prepends the parameter sets of aExtraData (avcC) to an Annex B
+  // keyframe, unless it already carries them.
+  static bool PrependParameterSets(MediaRawData* aSample,
+                                   const MediaByteBuffer* aExtraData);
+};
+
+// Iterates over the NAL units of an Annex B payload, without the start codes
+// and trailing zero bytes.
+class AnnexBNALIterator
+{
+public:
+  AnnexBNALIterator(const uint8_t* aData, size_t aSize);
+
+  // Returns false once all NAL units have been returned.
+  bool Next(const uint8_t** aNAL, size_t* aSize);
+
+private:
+  const uint8_t* mNext;
+  const uint8_t* const mEnd;
+};
+
+} // namespace mozilla
+
+#endif // mozilla_H264Normalizer_h
@@ -0,0 +1,504 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* vim:set ts=2 sw=2 sts=2 et cindent: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "OutputCachingDecoder.h"
+#include "MediaData.h"
+#include "MediaInfo.h"
+#include "mozilla/HashFunctions.h"
+#include "mozilla/IntegerPrintfMacros.h"
+#include "mozilla/Preferences.h"
+#include "mozilla/TaskQueue.h"
+
+#undef LOG
+#define LOG(arg, ...) MOZ_LOG(sPDMLog, mozilla::LogLevel::Debug, ("OutputCachingDecoder(%p)::%s: " arg, this, __func__, ##__VA_ARGS__))
+
+namespace mozilla {
+
+Atomic<size_t> OutputCachingDecoder::sTotalCachedBytes(0);
+// 3s of 1080p fit in the default budget.
+uint32_t OutputCachingDecoder::sMemoryBudgetMB = 384;
+uint32_t OutputCachingDecoder::sMaxDurationMs = 10000;
+
+static size_t
+FrameSize(const VideoData* aFrame)
+{
+  // Most decoders output 4:2:0 frames; this is only used to keep the memory
+  // use in check.
+  return size_t(aFrame->mDisplay.width) * aFrame->mDisplay.height * 3 / 2 +
+         sizeof(VideoData);
+}
+
+OutputCachingDecoder::SampleKey::SampleKey(const MediaRawData* aSample)
+  : mTime(aSample->mTime)
+  , mSize(aSample->Size())
+  , mHash(HashBytes(aSample->Data(), aSample->Size()))
+{
+}
+
+/* static */ void
+OutputCachingDecoder::InitPrefs()
+{
+  MOZ_ASSERT(NS_IsMainThread());
+  static bool sPrefsRegistered = false;
+  if (sPrefsRegistered) {
+    return;
+  }
+  sPrefsRegistered = true;
+  Preferences::AddUintVarCache(&sMemoryBudgetMB,
+                               "media.output-cache.memory-budget-mb",
+                               sMemoryBudgetMB);
+  Preferences::AddUintVarCache(&sMaxDurationMs,
+                               "media.output-cache.max-duration-ms",
+                               sMaxDurationMs);
+}
+
+/* static */ bool
+OutputCachingDecoder::ShouldCache(const TrackInfo& aConfig)
+{
+  return aConfig.IsVideo() && !aConfig.mCrypto.mValid && sMemoryBudgetMB &&
+         aConfig.mDuration > 0 &&
+         aConfig.mDuration <= int64_t(sMaxDurationMs) * 1000;
+}
+
+OutputCachingDecoder::OutputCachingDecoder(TaskQueue* aTaskQueue,
+                                           MediaDataDecoderCallback* aCallback)
+  : mTaskQueue(aTaskQueue)
+  , mCallback(aCallback)
+  , mReplayMutex("OutputCachingDecoder::mReplayMutex")
+  , mFlushCount(0)
+  , mMutex("OutputCachingDecoder")
+  , mState(State::WaitingForLoop)
+  , mFlushedBeforeLoop(false)
+  , mDraining(false)
+  , mCachedBytes(0)
+  , mSampleCount(0)
+  , mSeekThreshold(kNoThreshold)
+  , mRecordedThreshold(kNoThreshold)
+  , mReplaySample(0)
+  , mReplayFrame(0)
+  , mDropInputExhausted(0)
+  , mReplayedFrames(0)
+{
+  MOZ_ASSERT(aTaskQueue);
+  MOZ_ASSERT(aCallback);
+}
+
+OutputCachingDecoder::~OutputCachingDecoder()
+{
+  MutexAutoLock lock(mMutex);
+  ClearRecording();
+}
+
+void
+OutputCachingDecoder::SetDecoder(already_AddRefed<MediaDataDecoder> aDecoder)
+{
+  MOZ_ASSERT(!mDecoder);
+  mDecoder = aDecoder;
+}
+
+RefPtr<MediaDataDecoder::InitPromise>
+OutputCachingDecoder::Init()
+{
+  MOZ_ASSERT(mDecoder);
+  RefPtr<InitPromise> p = mInitPromise.Ensure(__func__);
+  RefPtr<OutputCachingDecoder> self = this;
+  mInitRequest.Begin(mDecoder->Init()
+    ->Then(AbstractThread::GetCurrent()->AsTaskQueue(), __func__,
+           [self] (TrackInfo::TrackType aType) {
+             self->mInitRequest.Complete();
+             // Hardware decoders output into a small pool of surfaces, which
+             // holding on to frames would starve.
+             nsAutoCString reason;
+             if (self->mDecoder->IsHardwareAccelerated(reason)) {
+               MutexAutoLock lock(self->mMutex);
+               self->ClearRecording();
+               self->mState = State::Disabled;
+             }
+             self->mInitPromise.Resolve(aType, __func__);
+           },
+           [self] (MediaResult aError) {
+             self->mInitRequest.Complete();
+             self->mInitPromise.Reject(aError, __func__);
+           }));
+  return p;
+}
+
+void
+OutputCachingDecoder::ClearRecording()
+{
+  mMutex.AssertCurrentThreadOwns();
+  sTotalCachedBytes -= mCachedBytes;
+  mCachedBytes = 0;
+  mSamples.Clear();
+  mFrames.Clear();
+  mSampleCount = 0;
+  mReplaySample = 0;
+  mReplayFrame = 0;
+  mReplayedSamples.Clear();
+  mReplayedTimes.Clear();
+  mDraining = false;
+}
+
+void
+OutputCachingDecoder::StartRecording()
+{
+  mMutex.AssertCurrentThreadOwns();
+  ClearRecording();
+  mState = State::Recording;
+}
+
+void
+OutputCachingDecoder::TakeReplayFrames(uint32_t aSampleCount,
+                                       nsTArray<RefPtr<MediaData>>& aFrames)
+{
+  mMutex.AssertCurrentThreadOwns();
+  for (; mReplayFrame < mFrames.Length() &&
+         mFrames[mReplayFrame].mSampleCount <= aSampleCount;
+       mReplayFrame++) {
+    // The reader may hold on to frames it was given; hand out a new one
+    // sharing the image every time.
+    const VideoData* frame =
+      static_cast<const VideoData*>(mFrames[mReplayFrame].mFrame.get());
+    RefPtr<VideoData> copy =
+      VideoData::ShallowCopyUpdateTimestamp(frame, frame->mTime);
+    aFrames.AppendElement(copy.forget());
+  }
+}
+
+void
+OutputCachingDecoder::StopReplaying(
+  nsTArray<RefPtr<MediaRawData>>& aCatchUpSamples,
+  nsTArray<RefPtr<MediaData>>& aPendingFrames)
+{
+  mMutex.AssertCurrentThreadOwns();
+  LOG("Samples differ from the recorded ones at %u/%zu, decoding again",
+      mReplaySample, mSamples.Length());
+  // Frames are recorded when the decoder outputs them, possibly a few
+  // samples late, so some of those of the previous group of pictures may
+  // still be waiting to be replayed.
+  int64_t catchUpStart =
+    mReplayedSamples.IsEmpty() ? INT64_MIN : mReplayedSamples[0]->mTime;
+  for (uint32_t i = mReplayFrame; i < mFrames.Length(); i++) {
+    const VideoData* frame =
+      static_cast<const VideoData*>(mFrames[i].mFrame.get());
+    if (frame->mTime < catchUpStart) {
+      RefPtr<VideoData> copy =
+        VideoData::ShallowCopyUpdateTimestamp(frame, frame->mTime);
+      aPendingFrames.AppendElement(copy.forget());
+    }
+  }
+  aCatchUpSamples.SwapElements(mReplayedSamples);
+  mDropTimes.SwapElements(mReplayedTimes);
+  mDropInputExhausted = aCatchUpSamples.Length();
+  ClearRecording();
+  mState = State::Idle;
+}
+
+void
+OutputCachingDecoder::DispatchReplayedFrames(
+  nsTArray<RefPtr<MediaData>>&& aFrames, ReplayEnd aEnd)
+{
+  RefPtr<OutputCachingDecoder> self = this;
+  nsTArray<RefPtr<MediaData>> frames;
+  frames.SwapElements(aFrames);
+  uint32_t flushCount;
+  {
+    MutexAutoLock lock(mReplayMutex);
+    flushCount = mFlushCount;
+  }
+  mTaskQueue->Dispatch(NS_NewRunnableFunction([self, frames, aEnd, flushCount]() {
+    MutexAutoLock lock(self->mReplayMutex);
+    if (self->mFlushCount != flushCount) {
+      return;
+    }
+    for (const auto& frame : frames) {
+      self->mCallback->Output(frame);
+    }
+    self->mReplayedFrames += frames.Length();
+    if (aEnd == ReplayEnd::InputExhausted) {
+      self->mCallback->InputExhausted();
+    } else if (aEnd == ReplayEnd::DrainComplete) {
+      self->mCallback->DrainComplete();
+    }
+  }));
+}
+
+void
+OutputCachingDecoder::Input(MediaRawData* aSample)
+{
+  MOZ_ASSERT(mCallback->OnReaderTaskQueue());
+  SampleKey key(aSample);
+  nsTArray<RefPtr<MediaData>> frames;
+  nsTArray<RefPtr<MediaRawData>> catchUpSamples;
+  bool replay = false;
+  {
+    MutexAutoLock lock(mMutex);
+    if (mState == State::WaitingForLoop) {
+      if (mLoopStart.isNothing()) {
+        mLoopStart.emplace(key);
+      } else if (mFlushedBeforeLoop && *mLoopStart == key) {
+        LOG("Stream looped, recording it");
+        StartRecording();
+      }
+      mFlushedBeforeLoop = false;
+    }
+    if (mState == State::Armed) {
+      if (!mSamples.IsEmpty() && mSamples[0] == key &&
+          mSeekThreshold == mRecordedThreshold) {
+        LOG("Replaying %zu frames of %zu samples",
+            mFrames.Length(), mSamples.Length());
+        mState = State::Replaying;
+        mReplaySample = 0;
+        mReplayFrame = 0;
+      } else {
+        StartRecording();
+      }
+    } else if (mState == State::Recorded) {
+      // More samples after a drain: the recording doesn't cover the stream.
+      ClearRecording();
+      mState = State::Idle;
+    }
+
+    if (mState == State::Recording) {
+      if (mSamples.IsEmpty()) {
+        mRecordedThreshold = mSeekThreshold;
+      }
+      mSamples.AppendElement(key);
+      mSampleCount++;
+    } else if (mState == State::Replaying) {
+      if (mReplaySample < mSamples.Length() && mSamples[mReplaySample] == key) {
+        if (aSample->mKeyframe) {
+          mReplayedSamples.Clear();
+          mReplayedTimes.Clear();
+        }
+        mReplayedSamples.AppendElement(aSample);
+        mReplaySample++;
+        TakeReplayFrames(mReplaySample, frames);
+        for (const auto& frame : frames) {
+          mReplayedTimes.AppendElement(frame->mTime);
+        }
+        replay = true;
+      } else {
+        StopReplaying(catchUpSamples, frames);
+      }
+    }
+  }
+
+  if (replay) {
+    DispatchReplayedFrames(Move(frames), ReplayEnd::InputExhausted);
+    return;
+  }
+  if (!frames.IsEmpty()) {
+    DispatchReplayedFrames(Move(frames), ReplayEnd::None);
+  }
+  for (const auto& sample : catchUpSamples) {
+    mDecoder->Input(sample);
+  }
+  mDecoder->Input(aSample);
+}
+
+void
+OutputCachingDecoder::Flush()
+{
+  MOZ_ASSERT(mCallback->OnReaderTaskQueue());
+  mDecoder->Flush();
+  {
+    // Replayed frames already dispatched are discarded.
+    MutexAutoLock lock(mReplayMutex);
+    mFlushCount++;
+  }
+
+  MutexAutoLock lock(mMutex);
+  mSeekThreshold = kNoThreshold;
+  mDropTimes.Clear();
+  mDropInputExhausted = 0;
+  switch (mState) {
+    case State::Recorded:
+    case State::Armed:
+    case State::Replaying:
+      mState = State::Armed;
+      mReplaySample = 0;
+      mReplayFrame = 0;
+      mReplayedSamples.Clear();
+      mReplayedTimes.Clear();
+      break;
+    case State::Recording:
+    case State::Idle:
+      StartRecording();
+      break;
+    case State::WaitingForLoop:
+      mFlushedBeforeLoop = true;
+      break;
+    case State::Disabled:
+      break;
+  }
+}
+
+void
+OutputCachingDecoder::Drain()
+{
+  MOZ_ASSERT(mCallback->OnReaderTaskQueue());
+  nsTArray<RefPtr<MediaData>> frames;
+  nsTArray<RefPtr<MediaRawData>> catchUpSamples;
+  bool replay = false;
+  {
+    MutexAutoLock lock(mMutex);
+    if (mState == State::Replaying) {
+      if (mReplaySample == mSamples.Length()) {
+        TakeReplayFrames(UINT32_MAX, frames);
+        mState = State::Recorded;
+        replay = true;
+      } else {
+        // Drained early; the decoder has to output the frames it would still
+        // have been holding.
+        StopReplaying(catchUpSamples, frames);
+      }
+    } else if (mState == State::Recording) {
+      mDraining = true;
+    }
+  }
+
+  if (replay) {
+    DispatchReplayedFrames(Move(frames), ReplayEnd::DrainComplete);
+    return;
+  }
+  if (!frames.IsEmpty()) {
+    DispatchReplayedFrames(Move(frames), ReplayEnd::None);
+  }
+  for (const auto& sample : catchUpSamples) {
+    mDecoder->Input(sample);
+  }
+  mDecoder->Drain();
+}
+
+void
+OutputCachingDecoder::Shutdown()
+{
+  mInitRequest.DisconnectIfExists();
+  mInitPromise.RejectIfExists(NS_ERROR_DOM_MEDIA_CANCELED, __func__);
+  mDecoder->Shutdown();
+  MutexAutoLock lock(mMutex);
+  ClearRecording();
+  mState = State::Disabled;
+}
+
+bool
+OutputCachingDecoder::IsHardwareAccelerated(nsACString& aFailureReason) const
+{
+  return mDecoder->IsHardwareAccelerated(aFailureReason);
+}
+
+const char*
+OutputCachingDecoder::GetDescriptionName() const
+{
+  return mDecoder->GetDescriptionName();
+}
+
+void
+OutputCachingDecoder::SetSeekThreshold(const media::TimeUnit& aTime)
+{
+  mDecoder->SetSeekThreshold(aTime);
+  MutexAutoLock lock(mMutex);
+  mSeekThreshold = aTime.IsValid() ? aTime.ToMicroseconds() : kNoThreshold;
+}
+
+void
+OutputCachingDecoder::Output(MediaData* aData)
+{
+  {
+    MutexAutoLock lock(mMutex);
+    size_t dropIndex = mDropTimes.IndexOf(aData->mTime);
+    if (dropIndex != mDropTimes.NoIndex) {
+      // Already output from the cache.
+      mDropTimes.RemoveElementAt(dropIndex);
+      return;
+    }
+    if (mState == State::Recording) {
+      size_t size = aData->mType == MediaData::VIDEO_DATA
+                    ? FrameSize(static_cast<VideoData*>(aData)) : 0;
+      if (!size ||
+          sTotalCachedBytes + size > size_t(sMemoryBudgetMB) * 1024 * 1024) {
+        LOG("Can't cache frame at %" PRId64 ", %zu bytes already cached",
+            aData->mTime, size_t(sTotalCachedBytes));
+        ClearRecording();
+        mState = State::Disabled;
+      } else {
+        CachedFrame* cached = mFrames.AppendElement();
+        cached->mFrame = VideoData::ShallowCopyUpdateTimestamp(
+          static_cast<VideoData*>(aData), aData->mTime);
+        cached->mSampleCount = mSampleCount;
+        mCachedBytes += size;
+        sTotalCachedBytes += size;
+      }
+    }
+  }
+  mCallback->Output(aData);
+}
+
+void
+OutputCachingDecoder::Error(const MediaResult& aError)
+{
+  {
+    MutexAutoLock lock(mMutex);
+    ClearRecording();
+    mState = State::Disabled;
+  }
+  mCallback->Error(aError);
+}
+
+void
+OutputCachingDecoder::InputExhausted()
+{
+  {
+    MutexAutoLock lock(mMutex);
+    if (mDropInputExhausted) {
+      // For a catch up sample the reader didn't feed.
+      mDropInputExhausted--;
+      return;
+    }
+  }
+  mCallback->InputExhausted();
+}
+
+void
+OutputCachingDecoder::DrainComplete()
+{
+  {
+    MutexAutoLock lock(mMutex);
+    if (mState == State::Recording && mDraining) {
+      mDraining = false;
+      if (mSamples.IsEmpty()) {
+        mState = State::Idle;
+      } else {
+        LOG("Recorded %zu frames of %zu samples, %zu bytes",
+            mFrames.Length(), mSamples.Length(), mCachedBytes);
+        mState = State::Recorded;
+      }
+    }
+  }
+  mCallback->DrainComplete();
+}
+
+void
+OutputCachingDecoder::ReleaseMediaResources()
+{
+  mCallback->ReleaseMediaResources();
+}
+
+bool
+OutputCachingDecoder::OnReaderTaskQueue()
+{
+  return mCallback->OnReaderTaskQueue();
+}
+
+void
+OutputCachingDecoder::WaitingForKey()
+{
+  mCallback->WaitingForKey();
+}
+
+} // namespace mozilla
+#undef LOG
@@ -0,0 +1,207 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* vim:set ts=2 sw=2 sts=2 et cindent: */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#if !defined(OutputCachingDecoder_h_)
+#define OutputCachingDecoder_h_
+
+#include "mozilla/Atomics.h"
+#include "mozilla/Maybe.h"
+#include "mozilla/Mutex.h"
+#include "PlatformDecoderModule.h"
+
+namespace mozilla {
+
+// Video decoder wrapper keeping the frames of a short looping stream once it
+// has been fully decoded, so that playing it again doesn't need to decode it
+// again.
+//
+// The wrapper is both the MediaDataDecoder seen by the reader and the
+// callback of the decoder it wraps:
+//          ======> OutputCachingDecoder ======>
+//   reader                                      decoder
+//          <------ OutputCachingDecoder <------
+//
+// Nothing is recorded until the stream loops, i.e. until after a flush the
+// decoder is fed again the first sample it was ever fed. From then on, while
+// the decoder is fed from a flush until it is drained, the wrapper records a
+// key (timestamp, size and hash of the content) for every sample, and
+// shallow copies, sharing their images, of the frames output after each of
+// them. When, after the next flush, the reader feeds the same samples
+// again, the recorded frames are output instead of calling the decoder. If
+// the samples start differing, the samples since the last keyframe are given
+// to the decoder, whose frames that were already replayed are dropped, and
+// decoding carries on as normal.
+//
+// Recording stops for good when the frames don't fit in the memory budget,
+// which is shared by all instances, or when the decoder is hardware
+// accelerated.
+class OutputCachingDecoder
+  : public MediaDataDecoder
+  , public MediaDataDecoderCallback
+{
+public:
+  // Registers the prefs controlling the cache. Main thread only.
+  static void InitPrefs();
+
+  // True if a decoder for aConfig should be wrapped.
+  static bool ShouldCache(const TrackInfo& aConfig);
+
+  // aCallback is the reader's callback. The decoder to wrap must be created
+  // with this object as its callback, then given to SetDecoder().
+  OutputCachingDecoder(TaskQueue* aTaskQueue,
+                       MediaDataDecoderCallback* aCallback);
+  void SetDecoder(already_AddRefed<MediaDataDecoder> aDecoder);
+
+  // MediaDataDecoder implementation.
+  RefPtr<InitPromise> Init() override;
+  void Input(MediaRawData* aSample) override;
+  void Flush() override;
+  void Drain() override;
+  void Shutdown() override;
+  bool IsHardwareAccelerated(nsACString& aFailureReason) const override;
+  const char* GetDescriptionName() const override;
+  void SetSeekThreshold(const media::TimeUnit& aTime) override;
+
+  // MediaDataDecoderCallback implementation, called by the wrapped decoder.
+  void Output(MediaData* aData) override;
+  void Error(const MediaResult& aError) override;
+  void InputExhausted() override;
+  void DrainComplete() override;
+  void ReleaseMediaResources() override;
+  bool OnReaderTaskQueue() override;
+  void WaitingForKey() override;
+
+  // Bytes currently held by all instances.
+  static size_t TotalCachedBytes() { return sTotalCachedBytes; }
+  // Frames output from the cache rather than by the decoder.
+  uint32_t ReplayedFrames() const { return mReplayedFrames; }
+
+private:
+  ~OutputCachingDecoder();
+
+  enum class State
+  {
+    // The stream hasn't looped yet; mLoopStart is the first sample fed.
+    WaitingForLoop,
+    // Recording what the decoder is fed and outputs since the last flush.
+    Recording,
+    // A whole pass has been recorded up to a drain, waiting for a flush.
+    Recorded,
+    // Flushed after a recorded pass: the next sample tells if it's played
+    // again.
+    Armed,
+    // Outputting recorded frames.
+    Replaying,
+    // Nothing usable is recorded; recording starts again at the next flush.
+    Idle,
+    // The stream doesn't fit in the budget or can't be cached.
+    Disabled,
+  };
+
+  struct SampleKey
+  {
+    explicit SampleKey(const MediaRawData* aSample);
+    bool operator==(const SampleKey& aOther) const
+    {
+      return mTime == aOther.mTime && mSize == aOther.mSize &&
+             mHash == aOther.mHash;
+    }
+    int64_t mTime;
+    size_t mSize;
+    uint32_t mHash;
+  };
+
+  struct CachedFrame
+  {
+    RefPtr<MediaData> mFrame;
+    // Number of samples fed when the frame was output; frames output while
+    // draining have the number of samples of the whole pass.
+    uint32_t mSampleCount;
+  };
+
+  // All the following run with mMutex held.
+  void ClearRecording();
+  // Discards any recording and records from the next sample on.
+  void StartRecording();
+  // Moves the frames recorded for the first aSampleCount samples, from
+  // mReplayFrame onwards, into aFrames.
+  void TakeReplayFrames(uint32_t aSampleCount,
+                        nsTArray<RefPtr<MediaData>>& aFrames);
+  // Stops replaying. Returns the samples the decoder must be fed to catch
+  // up, i.e. those since the last keyframe, and the recorded frames preceding
+  // that keyframe which haven't been replayed yet, as the decoder won't
+  // output them.
+  void StopReplaying(nsTArray<RefPtr<MediaRawData>>& aCatchUpSamples,
+                     nsTArray<RefPtr<MediaData>>& aPendingFrames);
+
+  // What to notify after outputting replayed frames.
+  enum class ReplayEnd
+  {
+    None,
+    InputExhausted,
+    DrainComplete,
+  };
+  // Outputs replayed frames on mTaskQueue, where the wrapped decoder outputs
+  // its own too.
+  void DispatchReplayedFrames(nsTArray<RefPtr<MediaData>>&& aFrames,
+                              ReplayEnd aEnd);
+
+  RefPtr<MediaDataDecoder> mDecoder;
+  const RefPtr<TaskQueue> mTaskQueue;
+  MediaDataDecoderCallback* mCallback;
+
+  // Decoder init, to find out if it is hardware accelerated.
+  MozPromiseHolder<InitPromise> mInitPromise;
+  MozPromiseRequestHolder<InitPromise> mInitRequest;
+
+  // Taken while outputting replayed frames, and by Flush() to discard the
+  // pending ones.
+  Mutex mReplayMutex;
+  // Incremented by every flush; replayed frames dispatched before it are
+  // discarded.
+  uint32_t mFlushCount;
+
+  // Protects all the following.
+  Mutex mMutex;
+  State mState;
+  // Key of the first sample fed, and whether the first sample fed after the
+  // last flush is yet to come, while waiting for the stream to loop.
+  Maybe<SampleKey> mLoopStart;
+  bool mFlushedBeforeLoop;
+  bool mDraining;
+  nsTArray<SampleKey> mSamples;
+  nsTArray<CachedFrame> mFrames;
+  size_t mCachedBytes;
+  // Samples fed since recording started.
+  uint32_t mSampleCount;
+  // Seek threshold the decoder was given since the last flush, and the one
+  // in effect when recording; the decoder may drop frames before it. In
+  // microseconds, kNoThreshold if none.
+  static const int64_t kNoThreshold = INT64_MIN;
+  int64_t mSeekThreshold;
+  int64_t mRecordedThreshold;
+  // Replay position, in mSamples and mFrames.
+  uint32_t mReplaySample;
+  uint32_t mReplayFrame;
+  // Samples replayed since the last keyframe, and the timestamps of the
+  // frames replayed for them.
+  nsTArray<RefPtr<MediaRawData>> mReplayedSamples;
+  nsTArray<int64_t> mReplayedTimes;
+  // After replaying stopped: frames the decoder outputs again, and
+  // InputExhausted notifications for catch up samples, to swallow.
+  nsTArray<int64_t> mDropTimes;
+  uint32_t mDropInputExhausted;
+
+  Atomic<uint32_t> mReplayedFrames;
+  static Atomic<size_t> sTotalCachedBytes;
+  // Cached pref values.
+  static uint32_t sMemoryBudgetMB;
+  static uint32_t sMaxDurationMs;
+};
+
+} // namespace mozilla
+
+#endif // OutputCachingDecoder_h_